@@ -62,13 +62,26 @@ AsyncSocketBase::doSend(const StunTuple& destination, unsigned short channel, co
    else
    {
       // Add Turn Framing
-      const auto frame = allocateBuffer(4);
+      unsigned short msgsize = htons((unsigned short)(data->size() - bufferStartPos));
       channel = htons(channel);
-      memcpy(&(*frame)[0], &channel, 2);
-      unsigned short msgsize = htons((unsigned short)data->size());
-      memcpy(&(*frame)[2], (void*)&msgsize, 2);
+      if(bufferStartPos == 0 && data->headroom() >= 4 && data.use_count() == 1)
+      {
+         // Received buffers leave room for the framing in front of the data, so
+         // relayed data can be sent as is.  Only done when no one else holds the
+         // buffer, as they would see the framing.
+         data->prepend(4);
+         memcpy(&(*data)[0], &channel, 2);
+         memcpy(&(*data)[2], (void*)&msgsize, 2);
+         mSendDataQueue.push_back(SendData(destination, nullptr, data, 0));
+      }
+      else
+      {
+         const auto frame = allocateBuffer(4);
+         memcpy(&(*frame)[0], &channel, 2);
+         memcpy(&(*frame)[2], (void*)&msgsize, 2);
+         mSendDataQueue.push_back(SendData(destination, frame, data, bufferStartPos));
+      }
       // TODO !SLG! - if sending over TCP/TLS then message must be padded to be on a 4 byte boundary
-      mSendDataQueue.push_back(SendData(destination, frame, data, bufferStartPos));
    }
    if (!writeInProgress)
    {
@@ -101,12 +114,13 @@ AsyncSocketBase::handleSend(const asio::error_code& e)
 void 
 AsyncSocketBase::sendFirstQueuedData()
 {
-   std::vector<asio::const_buffer> bufs;
+   // Fixed size, so nothing is allocated per send; an empty frame buffer is skipped by asio
+   SendBuffers bufs;
    if (mSendDataQueue.front().mFrameData) // If we have frame data
    {
-      bufs.push_back(asio::buffer(mSendDataQueue.front().mFrameData->data(), mSendDataQueue.front().mFrameData->size()));
+      bufs[0] = asio::buffer(mSendDataQueue.front().mFrameData->data(), mSendDataQueue.front().mFrameData->size());
    }
-   bufs.push_back(asio::buffer(mSendDataQueue.front().mData->data()+mSendDataQueue.front().mBufferStartPos, mSendDataQueue.front().mData->size()-mSendDataQueue.front().mBufferStartPos));
+   bufs[1] = asio::buffer(mSendDataQueue.front().mData->data()+mSendDataQueue.front().mBufferStartPos, mSendDataQueue.front().mData->size()-mSendDataQueue.front().mBufferStartPos);
    transportSend(mSendDataQueue.front().mDestination, bufs);
 }
 
@@ -122,7 +136,10 @@ AsyncSocketBase::doReceive()
    if(!mReceiving)
    {
       mReceiving=true;
-      mReceiveBuffer = allocateBuffer(RECEIVE_BUFFER_SIZE);
+      if(usesReceiveBuffer())
+      {
+         mReceiveBuffer = allocateBuffer(RECEIVE_BUFFER_SIZE);
+      }
       transportReceive();
    }
 }
@@ -139,7 +156,10 @@ AsyncSocketBase::doFramedReceive()
    if(!mReceiving)
    {
       mReceiving=true;
-      mReceiveBuffer = allocateBuffer(RECEIVE_BUFFER_SIZE);
+      if(usesReceiveBuffer())
+      {
+         mReceiveBuffer = allocateBuffer(RECEIVE_BUFFER_SIZE);
+      }
       transportFramedReceive();
    }
 }
@@ -171,7 +191,7 @@ AsyncSocketBase::close()
 std::shared_ptr<DataBuffer>  
 AsyncSocketBase::allocateBuffer(const size_t size)
 {
-   return std::make_shared<DataBuffer>(size);
+   return DataBuffer::allocatePooled(size);
 }
 
 } // namespace
@@ -9,6 +9,7 @@
 #include "DataBuffer.hxx"
 #include "StunTuple.hxx"
 
+#include <array>
 #include <cstddef>
 #include <deque>
 #include <functional>
@@ -20,6 +21,12 @@ constexpr size_t RECEIVE_BUFFER_SIZE = 4096; // ?slg? should we shrink this to s
 
 namespace reTurn {
 
+#ifdef SO_REUSEPORT
+/// Lets a socket per thread listen on the same address and port; the kernel
+/// spreads incoming datagrams (by source) and connections over them
+typedef asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT> reuse_port;
+#endif
+
 class AsyncSocketBaseHandler;
 class AsyncSocketBaseDestroyedHandler;
 
@@ -28,6 +35,8 @@ class AsyncSocketBase :
 {
 public:
    using BeforeClosedHandler = std::function<void(unsigned int)>;
+   /// Optional framing (e.g. a ChannelData header) followed by the data
+   typedef std::array<asio::const_buffer, 2> SendBuffers;
 
    explicit AsyncSocketBase(asio::io_service& ioService);
    virtual ~AsyncSocketBase();
@@ -50,6 +59,7 @@ public:
    bool isConnected() const noexcept { return mConnected; }
    asio::ip::address& getConnectedAddress() noexcept { return mConnectedAddress; }
    unsigned short getConnectedPort() const noexcept { return mConnectedPort; }
+   asio::io_service& getIOService() noexcept { return mIOService; }
 
    virtual void setOnBeforeSocketClosedFp(BeforeClosedHandler fp) { mOnBeforeSocketCloseFp = std::move(fp); }
 
@@ -68,6 +78,7 @@ public:
    virtual void onSendFailure(const asio::error_code& e) = 0;
 
    /// Utility API
+   /// Note:  the buffer contents are not initialized, see DataBuffer::allocatePooled
    static std::shared_ptr<DataBuffer> allocateBuffer(size_t size);
 
    // Stubbed out async handlers needed by Protocol specific Subclasses of this - the requirement for these 
@@ -92,6 +103,9 @@ protected:
    /// Receive Buffer and state
    std::shared_ptr<DataBuffer> mReceiveBuffer;
    bool mReceiving;
+   /// False if transportReceive reads into buffers of its own, so that
+   /// doReceive need not allocate mReceiveBuffer
+   virtual bool usesReceiveBuffer() const { return true; }
 
    /// Connected Info and State
    asio::ip::address mConnectedAddress;
@@ -105,15 +119,7 @@ protected:
    /// just before the socket is closed
    BeforeClosedHandler mOnBeforeSocketCloseFp;
 
-private:
-   virtual void transportSend(const StunTuple& destination, std::vector<asio::const_buffer>& buffers) = 0;
-   virtual void transportReceive() = 0;
-   virtual void transportFramedReceive() = 0;
-   virtual void transportClose() = 0;
-
-   virtual asio::ip::address getSenderEndpointAddress() = 0;
-   virtual unsigned short getSenderEndpointPort() = 0;
-
+   /// Sends the data at the front of the queue; handleSend removes it once sent
    virtual void sendFirstQueuedData();
    class SendData
    {
@@ -128,6 +134,15 @@ private:
    /// Queue of data to send
    typedef std::deque<SendData> SendDataQueue;
    SendDataQueue mSendDataQueue;
+
+private:
+   virtual void transportSend(const StunTuple& destination, const SendBuffers& buffers) = 0;
+   virtual void transportReceive() = 0;
+   virtual void transportFramedReceive() = 0;
+   virtual void transportClose() = 0;
+
+   virtual asio::ip::address getSenderEndpointAddress() = 0;
+   virtual unsigned short getSenderEndpointPort() = 0;
 };
 
 typedef std::shared_ptr<AsyncSocketBase> ConnectionPtr;
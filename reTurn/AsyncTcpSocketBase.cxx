@@ -123,7 +123,7 @@ AsyncTcpSocketBase::getSenderEndpointPort()
 }
 
 void 
-AsyncTcpSocketBase::transportSend(const StunTuple& destination, std::vector<asio::const_buffer>& buffers)
+AsyncTcpSocketBase::transportSend(const StunTuple& destination, const SendBuffers& buffers)
 {
    // Note: destination is ignored for TCP
    asio::async_write(mSocket, buffers, 
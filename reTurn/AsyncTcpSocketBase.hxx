@@ -22,7 +22,7 @@ public:
 
    void transportReceive() override;
    void transportFramedReceive() override;
-   void transportSend(const StunTuple& destination, std::vector<asio::const_buffer>& buffers) override;
+   void transportSend(const StunTuple& destination, const SendBuffers& buffers) override;
    void transportClose() override;
 
    virtual void setConnectedAddressAndPort();  // Used by server side so that get fn's will work
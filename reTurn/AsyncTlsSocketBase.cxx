@@ -279,7 +279,7 @@ AsyncTlsSocketBase::getSenderEndpointPort()
 }
 
 void 
-AsyncTlsSocketBase::transportSend(const StunTuple& destination, std::vector<asio::const_buffer>& buffers)
+AsyncTlsSocketBase::transportSend(const StunTuple& destination, const SendBuffers& buffers)
 {
    // Note: destination is ignored for TLS
    asio::async_write(mSocket, buffers, 
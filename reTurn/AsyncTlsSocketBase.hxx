@@ -28,7 +28,7 @@ public:
 
    void transportReceive() override;
    void transportFramedReceive() override;
-   void transportSend(const StunTuple& destination, std::vector<asio::const_buffer>& buffers) override;
+   void transportSend(const StunTuple& destination, const SendBuffers& buffers) override;
    void transportClose() override;
 
    asio::ip::address getSenderEndpointAddress() override;
@@ -1,8 +1,16 @@
 #include <functional>
+#include <vector>
+#ifdef __linux__
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
 
 #include "AsyncUdpSocketBase.hxx"
 #include "AsyncSocketBaseHandler.hxx"
 #include <rutil/Logger.hxx>
+#include <rutil/compat.hxx>
 #include "ReTurnSubsystem.hxx"
 
 #define RESIPROCATE_SUBSYSTEM ReTurnSubsystem::RETURN
@@ -11,13 +19,51 @@ using namespace std;
 
 namespace reTurn {
 
+class AsyncUdpSocketBase::Batch
+{
+public:
+#ifdef __linux__
+   explicit Batch(unsigned int size) :
+      mBuffers(size), mRxAddresses(size), mRxIovecs(size), mRxMessages(size),
+      mTxAddresses(size), mTxIovecs(size * 2), mTxMessages(size) {}
+
+   // receiveBatches reads these while handing datagrams off, and a handler
+   // may send, so sending has arrays of its own
+   std::vector<std::shared_ptr<DataBuffer> > mBuffers;  // receive buffers, replaced once handed off
+   std::vector<sockaddr_storage> mRxAddresses;
+   std::vector<iovec> mRxIovecs;
+   std::vector<mmsghdr> mRxMessages;
+   std::vector<sockaddr_storage> mTxAddresses;
+   std::vector<iovec> mTxIovecs;                        // two per message, for framing and data
+   std::vector<mmsghdr> mTxMessages;
+#endif
+};
+
 AsyncUdpSocketBase::AsyncUdpSocketBase(asio::io_service& ioService) 
    : AsyncSocketBase(ioService),
      mSocket(ioService),
-     mResolver(ioService)
+     mResolver(ioService),
+     mBatchSize(1),
+     mReadWaitPending(false)
+{
+}
+
+AsyncUdpSocketBase::~AsyncUdpSocketBase()
 {
 }
 
+void
+AsyncUdpSocketBase::setBatchSize(unsigned int batchSize)
+{
+   // Note:  must be called before receiving starts
+#ifdef __linux__
+   mBatchSize = resip::resipMin(resip::resipMax(batchSize, 1u), MaxBatchSize);
+   mBatch.reset(mBatchSize > 1 ? new Batch(mBatchSize) : nullptr);
+#else
+   mBatchSize = 1;
+#endif
+}
+
 unsigned int 
 AsyncUdpSocketBase::getSocketDescriptor() 
 { 
@@ -26,6 +72,12 @@ AsyncUdpSocketBase::getSocketDescriptor()
 
 asio::error_code 
 AsyncUdpSocketBase::bind(const asio::ip::address& address, unsigned short port)
+{
+   return bind(address, port, false /* reusePort */);
+}
+
+asio::error_code 
+AsyncUdpSocketBase::bind(const asio::ip::address& address, unsigned short port, bool reusePort)
 {
    asio::error_code errorCode;
    mSocket.open(address.is_v6() ? asio::ip::udp::v6() : asio::ip::udp::v4(), errorCode);
@@ -41,6 +93,12 @@ AsyncUdpSocketBase::bind(const asio::ip::address& address, unsigned short port)
 #endif
 #endif
       mSocket.set_option(asio::ip::udp::socket::reuse_address(true), errorCode);
+#ifdef SO_REUSEPORT
+      if(reusePort)
+      {
+         mSocket.set_option(reuse_port(true), errorCode);
+      }
+#endif
       mSocket.set_option(asio::socket_base::receive_buffer_size(66560));
       //mSocket.set_option(asio::socket_base::send_buffer_size(66560));
       mSocket.bind(asio::ip::udp::endpoint(address, port), errorCode);
@@ -94,21 +152,184 @@ AsyncUdpSocketBase::getSenderEndpointPort()
 }
 
 void 
-AsyncUdpSocketBase::transportSend(const StunTuple& destination, std::vector<asio::const_buffer>& buffers)
+AsyncUdpSocketBase::transportSend(const StunTuple& destination, const SendBuffers& buffers)
 {
-   //InfoLog(<< "AsyncUdpSocketBase::transportSend " << buffers.size() << " buffer(s) to " << destination << " - buf1 size=" << buffer_size(buffers.front()));
+   //InfoLog(<< "AsyncUdpSocketBase::transportSend " << buffers.size() << " buffer(s) to " << destination << " - buf1 size=" << buffer_size(buffers[0]));
    mSocket.async_send_to(buffers, 
                          asio::ip::udp::endpoint(destination.getAddress(), destination.getPort()), 
                          std::bind(&AsyncUdpSocketBase::handleSend, shared_from_this(), std::placeholders::_1));
 }
 
+void
+AsyncUdpSocketBase::sendFirstQueuedData()
+{
+#ifdef __linux__
+   if(mBatch && mSendDataQueue.size() > 1)
+   {
+      sendQueuedBatches();
+      if(mSendDataQueue.empty())
+      {
+         return;
+      }
+   }
+#endif
+   AsyncSocketBase::sendFirstQueuedData();
+}
+
+void
+AsyncUdpSocketBase::sendQueuedBatches()
+{
+#ifdef __linux__
+   // Datagrams that queued up while asio was sending go out together.  Any
+   // that do not fit in the socket buffer are left for asio to send.
+   Batch& batch = *mBatch;
+   while(mSendDataQueue.size() > 1)
+   {
+      unsigned int count = resip::resipMin((unsigned int)mSendDataQueue.size(), mBatchSize);
+      for(unsigned int i = 0; i < count; i++)
+      {
+         const SendData& sendData = mSendDataQueue[i];
+         iovec* iov = &batch.mTxIovecs[i * 2];
+         size_t numIov = 0;
+         if(sendData.mFrameData)
+         {
+            iov[numIov].iov_base = (void*)sendData.mFrameData->data();
+            iov[numIov++].iov_len = sendData.mFrameData->size();
+         }
+         iov[numIov].iov_base = (void*)(sendData.mData->data() + sendData.mBufferStartPos);
+         iov[numIov++].iov_len = sendData.mData->size() - sendData.mBufferStartPos;
+
+         memset(&batch.mTxMessages[i], 0, sizeof(mmsghdr));
+         sendData.mDestination.toSockaddr((sockaddr*)&batch.mTxAddresses[i]);
+         batch.mTxMessages[i].msg_hdr.msg_name = &batch.mTxAddresses[i];
+         batch.mTxMessages[i].msg_hdr.msg_namelen = sendData.mDestination.getAddress().is_v6() ? sizeof(sockaddr_in6) : sizeof(sockaddr_in);
+         batch.mTxMessages[i].msg_hdr.msg_iov = iov;
+         batch.mTxMessages[i].msg_hdr.msg_iovlen = numIov;
+      }
+
+      int sent = ::sendmmsg(mSocket.native_handle(), &batch.mTxMessages[0], count, MSG_DONTWAIT);
+      if(sent < 0)
+      {
+         if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+         {
+            return;
+         }
+         // The datagram at the front failed, as it would have with asio
+         asio::error_code ec(errno, asio::error::get_system_category());
+         DebugLog(<< "sendQueuedBatches with error: " << ec);
+         onSendFailure(ec);
+         mSendDataQueue.pop_front();
+         continue;
+      }
+      for(int i = 0; i < sent; i++)
+      {
+         onSendSuccess();
+         mSendDataQueue.pop_front();
+      }
+   }
+#endif
+}
+
 void 
 AsyncUdpSocketBase::transportReceive()
 {
+#ifdef __linux__
+   if(mBatch)
+   {
+      // Wait for the socket to be readable, then read all there is with recvmmsg
+      if(!mReadWaitPending)
+      {
+         mReadWaitPending = true;
+         mSocket.async_wait(asio::socket_base::wait_read,
+                            std::bind(&AsyncUdpSocketBase::handleReadable, std::static_pointer_cast<AsyncUdpSocketBase>(shared_from_this()), std::placeholders::_1));
+      }
+      return;
+   }
+#endif
    mSocket.async_receive_from(asio::buffer((void*)mReceiveBuffer->data(), RECEIVE_BUFFER_SIZE), mSenderEndpoint,
                std::bind(&AsyncUdpSocketBase::handleReceive, shared_from_this(), std::placeholders::_1, std::placeholders::_2));
 }
 
+void
+AsyncUdpSocketBase::handleReadable(const asio::error_code& e)
+{
+   mReadWaitPending = false;
+   if(e)
+   {
+      handleReceive(e, 0);
+      return;
+   }
+   receiveBatches();
+}
+
+void
+AsyncUdpSocketBase::receiveBatches()
+{
+#ifdef __linux__
+   // asio's reactor is edge triggered, so the socket must be read until it is
+   // empty.  After a few full batches other sockets get a turn, and we come back.
+   const unsigned int maxBatchesPerTurn = 4;
+   Batch& batch = *mBatch;
+   bool drained = false;
+   for(unsigned int batches = 0; mReceiving && !drained && batches < maxBatchesPerTurn; batches++)
+   {
+      for(unsigned int i = 0; i < mBatchSize; i++)
+      {
+         if(!batch.mBuffers[i])
+         {
+            batch.mBuffers[i] = allocateBuffer(RECEIVE_BUFFER_SIZE);
+         }
+         batch.mRxIovecs[i].iov_base = (void*)batch.mBuffers[i]->data();
+         batch.mRxIovecs[i].iov_len = RECEIVE_BUFFER_SIZE;
+         memset(&batch.mRxMessages[i], 0, sizeof(mmsghdr));
+         batch.mRxMessages[i].msg_hdr.msg_name = &batch.mRxAddresses[i];
+         batch.mRxMessages[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+         batch.mRxMessages[i].msg_hdr.msg_iov = &batch.mRxIovecs[i];
+         batch.mRxMessages[i].msg_hdr.msg_iovlen = 1;
+      }
+
+      int count = ::recvmmsg(mSocket.native_handle(), &batch.mRxMessages[0], mBatchSize, MSG_DONTWAIT, 0);
+      if(count < 0)
+      {
+         if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+         {
+            drained = true;
+            break;
+         }
+         handleReceive(asio::error_code(errno, asio::error::get_system_category()), 0);
+         return;
+      }
+      drained = count < (int)mBatchSize;
+
+      // Each datagram is handed off as if received on its own; the handlers
+      // call doReceive to ask for more, as usual
+      mReceiving = false;
+      for(int i = 0; i < count; i++)
+      {
+         std::shared_ptr<DataBuffer> data;
+         data.swap(batch.mBuffers[i]);
+         data->truncate(batch.mRxMessages[i].msg_len);
+         size_t addressSize = resip::resipMin((size_t)batch.mRxMessages[i].msg_hdr.msg_namelen, mSenderEndpoint.capacity());
+         memcpy(mSenderEndpoint.data(), &batch.mRxAddresses[i], addressSize);
+         mSenderEndpoint.resize(addressSize);
+         onReceiveSuccess(mSenderEndpoint.address(), mSenderEndpoint.port(), data);
+      }
+   }
+
+   if(mReceiving)
+   {
+      if(drained)
+      {
+         transportReceive();
+      }
+      else
+      {
+         mIOService.post(std::bind(&AsyncUdpSocketBase::receiveBatches, std::static_pointer_cast<AsyncUdpSocketBase>(shared_from_this())));
+      }
+   }
+#endif
+}
+
 void 
 AsyncUdpSocketBase::transportFramedReceive()
 {
@@ -6,6 +6,8 @@
 #include <asio/ssl.hpp>
 #endif
 
+#include <memory>
+
 #include "AsyncSocketBase.hxx"
 
 namespace reTurn {
@@ -14,20 +16,28 @@ class AsyncUdpSocketBase : public AsyncSocketBase
 {
 public:
    explicit AsyncUdpSocketBase(asio::io_service& ioService);
+   ~AsyncUdpSocketBase();
 
    unsigned int getSocketDescriptor() override;
 
    asio::error_code bind(const asio::ip::address& address, unsigned short port) override;
+   asio::error_code bind(const asio::ip::address& address, unsigned short port, bool reusePort);
    void connect(const std::string& address, unsigned short port) override;
 
    void transportReceive() override;
    void transportFramedReceive() override;
-   void transportSend(const StunTuple& destination, std::vector<asio::const_buffer>& buffers) override;
+   void transportSend(const StunTuple& destination, const SendBuffers& buffers) override;
    void transportClose() override;
 
    asio::ip::address getSenderEndpointAddress() override;
    unsigned short getSenderEndpointPort() override;
 
+   /// Receive, and send when datagrams are queued, up to batchSize datagrams per
+   /// system call (recvmmsg/sendmmsg), on platforms that have them.  The default
+   /// of 1 receives and sends each datagram with its own asio operation.
+   void setBatchSize(unsigned int batchSize);
+   static const unsigned int MaxBatchSize = 64;
+
 protected:
    asio::ip::udp::socket mSocket;
    asio::ip::udp::resolver mResolver;
@@ -37,9 +47,18 @@ protected:
 
    void handleUdpResolve(const asio::error_code& ec,
                          asio::ip::udp::resolver::iterator endpoint_iterator) override;
+   void sendFirstQueuedData() override;
+   bool usesReceiveBuffer() const override { return !mBatch; }
 
 private:
-
+   void handleReadable(const asio::error_code& e);
+   void receiveBatches();
+   void sendQueuedBatches();
+
+   unsigned int mBatchSize;
+   bool mReadWaitPending;
+   class Batch;  // recvmmsg/sendmmsg state, only created when batching
+   std::unique_ptr<Batch> mBatch;
 };
 
 }
@@ -1,7 +1,7 @@
 #ifndef CHANNELMANAGER_HXX
 #define CHANNELMANAGER_HXX
 
-#include <map>
+#include <rutil/HashMap.hxx>
 #include "RemotePeer.hxx"
 
 namespace reTurn {
@@ -22,8 +22,8 @@ public:
    RemotePeer* findRemotePeerByPeerAddress(const StunTuple& peerAddress);
 
 private:
-   typedef std::map<unsigned short,RemotePeer*> ChannelRemotePeerMap;
-   typedef std::map<StunTuple,RemotePeer*> TupleRemotePeerMap;
+   typedef HashMap<unsigned short,RemotePeer*> ChannelRemotePeerMap;
+   typedef HashMap<StunTuple,RemotePeer*> TupleRemotePeerMap;
    ChannelRemotePeerMap mChannelRemotePeerMap;
    TupleRemotePeerMap mTupleRemotePeerMap;
 
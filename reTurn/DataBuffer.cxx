@@ -1,15 +1,145 @@
 #include "DataBuffer.hxx"
 #include <memory.h>
+#include <new>
+#include <vector>
 #include "rutil/ResipAssert.h"
 #include <rutil/WinLeakCheck.hxx>
 
 namespace reTurn {
 
+namespace
+{
+
+// Set once this thread's free lists have been destroyed at thread exit, after
+// which blocks go straight back to the heap
+thread_local bool threadFreeListsDestroyed = false;
+
+// Blocks of one size, kept for reuse by the thread that freed them.  A block
+// freed on another thread than the one it came from just joins that thread's
+// list.
+class FreeList
+{
+public:
+   explicit FreeList(size_t blockSize) : mBlockSize(blockSize) {}
+   ~FreeList()
+   {
+      threadFreeListsDestroyed = true;
+      for(std::vector<void*>::iterator it = mBlocks.begin(); it != mBlocks.end(); it++)
+      {
+         ::operator delete(*it);
+      }
+   }
+
+   void* allocate()
+   {
+      if(mBlocks.empty())
+      {
+         return ::operator new(mBlockSize);
+      }
+      void* block = mBlocks.back();
+      mBlocks.pop_back();
+      return block;
+   }
+
+   void deallocate(void* block)
+   {
+      if(mBlocks.size() < MaxFreeBlocks)
+      {
+         mBlocks.push_back(block);
+      }
+      else
+      {
+         ::operator delete(block);
+      }
+   }
+
+private:
+   static const size_t MaxFreeBlocks = 1024;
+   const size_t mBlockSize;
+   std::vector<void*> mBlocks;
+};
+
+template<size_t BlockSize>
+FreeList& 
+threadFreeList()
+{
+   static thread_local FreeList freeList(BlockSize);
+   return freeList;
+}
+
+template<size_t BlockSize>
+void* 
+allocateBlock()
+{
+   if(threadFreeListsDestroyed)
+   {
+      return ::operator new(BlockSize);
+   }
+   return threadFreeList<BlockSize>().allocate();
+}
+
+template<size_t BlockSize>
+void 
+deallocateBlock(void* block)
+{
+   if(threadFreeListsDestroyed)
+   {
+      ::operator delete(block);
+      return;
+   }
+   threadFreeList<BlockSize>().deallocate(block);
+}
+
+// Gives allocate_shared the DataBuffer and its control block from a free list
+template<class T>
+class PoolAllocator
+{
+public:
+   typedef T value_type;
+
+   PoolAllocator() {}
+   template<class U> PoolAllocator(const PoolAllocator<U>&) {}
+
+   T* allocate(size_t n)
+   {
+      if(n != 1)
+      {
+         return static_cast<T*>(::operator new(n * sizeof(T)));
+      }
+      return static_cast<T*>(allocateBlock<sizeof(T)>());
+   }
+
+   void deallocate(T* p, size_t n)
+   {
+      if(n != 1)
+      {
+         ::operator delete(p);
+         return;
+      }
+      deallocateBlock<sizeof(T)>(p);
+   }
+};
+
+template<class T, class U>
+bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&) { return true; }
+template<class T, class U>
+bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&) { return false; }
+
+}
+
 void ArrayDeallocator(char* data)
 {
    delete [] data;
 }
 
+void PoolDeallocator(char* data)
+{
+   if(data)
+   {
+      deallocateBlock<DataBuffer::Headroom + DataBuffer::PoolBufferSize>(data);
+   }
+}
+
 DataBuffer::DataBuffer(const char* const data, const size_t size, deallocator dealloc)
    : mBuffer(nullptr)
    , mSize(size)
@@ -51,6 +181,25 @@ DataBuffer* DataBuffer::own(char* const data, const size_t size, deallocator dea
    return buff;
 }
 
+std::shared_ptr<DataBuffer> 
+DataBuffer::allocatePooled(const size_t size)
+{
+   std::shared_ptr<DataBuffer> buff;
+   if(size <= PoolBufferSize)
+   {
+      buff = std::allocate_shared<DataBuffer>(PoolAllocator<DataBuffer>(), (size_t)0, PoolDeallocator);
+      buff->mBuffer = static_cast<char*>(allocateBlock<Headroom + PoolBufferSize>());
+   }
+   else
+   {
+      buff = std::make_shared<DataBuffer>((size_t)0);
+      buff->mBuffer = new char[Headroom + size];
+   }
+   buff->mStart = buff->mBuffer + Headroom;
+   buff->mSize = size;
+   return buff;
+}
+
 const char* 
 DataBuffer::data() const noexcept
 { 
@@ -79,14 +228,14 @@ char&
 DataBuffer::operator[](const size_t p)
 { 
    resip_assert(p < mSize); 
-   return mBuffer[p]; 
+   return mStart[p]; 
 }
 
 char 
 DataBuffer::operator[](const size_t p) const
 { 
    resip_assert(p < mSize); 
-   return mBuffer[p]; 
+   return mStart[p]; 
 }
 
 size_t
@@ -106,6 +255,21 @@ DataBuffer::offset(const size_t bytes)
    return mSize;
 }
 
+size_t
+DataBuffer::prepend(const size_t bytes)
+{ 
+   resip_assert(bytes <= headroom()); 
+   mStart = mStart-bytes; 
+   mSize = mSize+bytes; 
+   return mSize;
+}
+
+size_t
+DataBuffer::headroom() const noexcept
+{ 
+   return mStart - mBuffer;
+}
+
 } // namespace
 
 
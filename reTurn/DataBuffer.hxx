@@ -2,10 +2,12 @@
 #define DATA_BUFFER_HXX
 
 #include <cstddef>
+#include <memory>
 
 namespace reTurn {
 
 void ArrayDeallocator(char* data);
+void PoolDeallocator(char* data);
 
 class DataBuffer
 {
@@ -18,6 +20,14 @@ public:
 
    static DataBuffer* own(char* data, size_t size, deallocator dealloc = ArrayDeallocator);
 
+   /// Returns an uninitialized buffer of size bytes, with Headroom bytes free in
+   /// front of it.  Buffers of up to PoolBufferSize bytes, and the DataBuffer and
+   /// shared_ptr control block holding them, come from a per thread free list,
+   /// so the relay path does not go to the heap for every packet.
+   static std::shared_ptr<DataBuffer> allocatePooled(size_t size);
+   static const size_t Headroom = 8;  // room for a ChannelData header, keeping data aligned
+   static const size_t PoolBufferSize = 4096;
+
    const char* data() const noexcept;
    size_t size() const noexcept;
    char& operator[](size_t p);
@@ -25,6 +35,10 @@ public:
 
    size_t truncate(size_t newSize);
    size_t offset(size_t bytes);
+   /// Moves the start of the buffer back by bytes, into the space before it, eg.
+   /// to add framing in front of the data without copying it
+   size_t prepend(size_t bytes);
+   size_t headroom() const noexcept;
 
    char* mutableData() noexcept;
    size_t& mutableSize() noexcept;
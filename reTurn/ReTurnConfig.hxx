@@ -58,6 +58,8 @@ public:
    asio::ip::address mTurnAddress;
    asio::ip::address mTurnV6Address;
    asio::ip::address mAltStunAddress;
+   unsigned long mNumThreads;
+   unsigned long mUdpBatchSize;
 
    resip::Data mAuthenticationRealm;
    int mUserDatabaseCheckInterval;
@@ -1402,6 +1402,7 @@ StunMessage::encodeAtrUnknown(char* ptr, const StunAtrUnknown& atr)
    {
       ptr = encode16(ptr, atr.attrType[i]);
    }
+   memset(ptr, 0, padsize);  // buffers are not zeroed when allocated
    return ptr+padsize;
 }
 
@@ -60,6 +60,27 @@ StunTuple::operator<(const StunTuple& rhs) const
    return false;
 }
 
+size_t
+StunTuple::hash() const
+{
+   // Mixed rather than summed, since clients behind one NAT differ only in port
+   size_t h = hash(mAddress);
+   h ^= mPort + 0x9e3779b9 + (h << 6) + (h >> 2);
+   h ^= mTransport + 0x9e3779b9 + (h << 6) + (h >> 2);
+   return h;
+}
+
+size_t
+StunTuple::hash(const asio::ip::address& address)
+{
+   if(address.is_v4())
+   {
+      return size_t(address.to_v4().to_uint());
+   }
+   asio::ip::address_v6::bytes_type buf = address.to_v6().to_bytes();
+   return resip::Data::rawHash(buf.data(), buf.size());
+}
+
 void
 StunTuple::toSockaddr(sockaddr* addr) const
 {
@@ -115,6 +136,8 @@ operator<<(EncodeStream& strm, const StunTuple& tuple)
 
 } // namespace
 
+HashValueImp(reTurn::StunTuple, data.hash());
+
 
 /* ====================================================================
 
@@ -12,6 +12,7 @@
 
 #include "rutil/Socket.hxx"
 #include "rutil/compat.hxx"
+#include "rutil/HashMap.hxx"
 
 
 #include <asio/ip/address.hpp>
@@ -38,6 +39,9 @@ public:
    bool operator!=(const StunTuple& rhs) const;
    bool operator<(const StunTuple& rhs) const;
 
+   size_t hash() const;
+   static size_t hash(const asio::ip::address& address);
+
    TransportType getTransportType() const { return mTransport; }
    void setTransportType(TransportType transport) { mTransport = transport; }
 
@@ -59,8 +63,17 @@ private:
 
 EncodeStream& operator<<(EncodeStream& strm, const StunTuple& tuple);
 
+// For HashMaps keyed on an address, e.g. permissions
+class StunAddressHash
+{
+public:
+   size_t operator()(const asio::ip::address& address) const { return StunTuple::hash(address); }
+};
+
 } 
 
+HashValue(reTurn::StunTuple);
+
 #endif
 
 
@@ -20,7 +20,8 @@ public:
   TcpServer& operator=(const TcpServer&) = delete;
 
   /// Create the server to listen on the specified TCP address and port
-  explicit TcpServer(asio::io_service& ioService, RequestHandler& rqeuestHandler, const asio::ip::address& address, unsigned short port);
+  /// reusePort allows other TcpServers, run by other threads, to listen on the same address and port
+  explicit TcpServer(asio::io_service& ioService, RequestHandler& rqeuestHandler, const asio::ip::address& address, unsigned short port, bool reusePort = false);
 
   void start();
 
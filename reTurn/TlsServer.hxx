@@ -24,7 +24,8 @@ public:
   TlsServer& operator=(const TlsServer&) = delete;
 
   /// Create the server to listen on the specified TCP address and port
-  explicit TlsServer(asio::io_service& ioService, RequestHandler& requestHandler, const asio::ip::address& address, unsigned short port);
+  /// reusePort allows other TlsServers, run by other threads, to listen on the same address and port
+  explicit TlsServer(asio::io_service& ioService, RequestHandler& requestHandler, const asio::ip::address& address, unsigned short port, bool reusePort = false);
 
   void start();
 
@@ -41,7 +41,7 @@ TurnAllocation::TurnAllocation(TurnManager& turnManager,
    mRequestedTuple(requestedTuple),
    mTurnManager(turnManager),
    mTurnAllocationManager(turnAllocationManager),
-   mAllocationTimer(turnManager.getIOService()),
+   mAllocationTimer(localTurnSocket->getIOService()),
    mLocalTurnSocket(localTurnSocket),
    mBadChannelErrorLogged(false),
    mNoPermissionToPeerLogged(false),
@@ -85,7 +85,10 @@ TurnAllocation::startRelay()
 {
    if(mRequestedTuple.getTransportType() == StunTuple::UDP)
    {
-      mUdpRelayServer = std::make_shared<UdpRelayServer>(mTurnManager.getIOService(), *this);
+      // The relay runs on the same thread as the socket the allocation was made on, so
+      // the allocation is only ever touched by that thread
+      mUdpRelayServer = std::make_shared<UdpRelayServer>(mLocalTurnSocket->getIOService(), *this);
+      mUdpRelayServer->setBatchSize(mTurnManager.getConfig().mUdpBatchSize);
       if(!mUdpRelayServer->startReceiving())
       {
          stopRelay();  // Ensure allocation timer is stopped
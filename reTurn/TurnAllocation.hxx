@@ -1,7 +1,7 @@
 #ifndef TURNALLOCATION_HXX
 #define TURNALLOCATION_HXX
 
-#include <map>
+#include <rutil/HashMap.hxx>
 #include <asio.hpp>
 #ifdef USE_SSL
 #include <asio/ssl.hpp>
@@ -82,7 +82,7 @@ private:
    time_t    mExpires;
    //unsigned int mBandwidth; // future use
 
-   typedef std::map<asio::ip::address,TurnPermission*> TurnPermissionMap;
+   typedef HashMap<asio::ip::address,TurnPermission*,StunAddressHash> TurnPermissionMap;
    TurnPermissionMap mTurnPermissionMap;
 
    TurnManager& mTurnManager;
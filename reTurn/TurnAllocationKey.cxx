@@ -8,20 +8,21 @@ namespace reTurn {
 TurnAllocationKey::TurnAllocationKey(const StunTuple& clientLocalTuple, 
                                      const StunTuple& clientRemoteTuple) :
    mClientLocalTuple(clientLocalTuple),
-   mClientRemoteTuple(clientRemoteTuple)
+   mClientRemoteTuple(clientRemoteTuple),
+   mHash(clientRemoteTuple.hash() ^ (clientLocalTuple.hash() + 0x9e3779b9 + (clientRemoteTuple.hash() << 6) + (clientRemoteTuple.hash() >> 2)))
 {
 }
 
 bool 
 TurnAllocationKey::operator==(const TurnAllocationKey& rhs) const
 {
-   return mClientLocalTuple == rhs.mClientLocalTuple && mClientRemoteTuple == rhs.mClientRemoteTuple;
+   return mHash == rhs.mHash && mClientLocalTuple == rhs.mClientLocalTuple && mClientRemoteTuple == rhs.mClientRemoteTuple;
 }
 
 bool 
 TurnAllocationKey::operator!=(const TurnAllocationKey& rhs) const
 {
-   return mClientLocalTuple != rhs.mClientLocalTuple || mClientRemoteTuple != rhs.mClientRemoteTuple;
+   return mHash != rhs.mHash || mClientLocalTuple != rhs.mClientLocalTuple || mClientRemoteTuple != rhs.mClientRemoteTuple;
 }
 
 bool 
@@ -41,6 +42,8 @@ TurnAllocationKey::operator<(const TurnAllocationKey& rhs) const
 
 } // namespace
 
+HashValueImp(reTurn::TurnAllocationKey, data.hash());
+
 
 /* ====================================================================
 
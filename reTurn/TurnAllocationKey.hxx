@@ -17,16 +17,22 @@ public:
    bool operator!=(const TurnAllocationKey& rhs) const;
    bool operator<(const TurnAllocationKey& rhs) const;
 
+   // Computed once, since keys are looked up for every relayed packet
+   size_t hash() const { return mHash; }
+
    const StunTuple& getClientLocalTuple() const { return mClientLocalTuple; }
    const StunTuple& getClientRemoteTuple() const { return mClientRemoteTuple; }
 
 private:
    StunTuple mClientLocalTuple;
    StunTuple mClientRemoteTuple;
+   size_t mHash;
 };
 
 } 
 
+HashValue(reTurn::TurnAllocationKey);
+
 #endif
 
 
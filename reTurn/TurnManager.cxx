@@ -33,6 +33,7 @@ TurnManager::~TurnManager()
 unsigned short 
 TurnManager::allocateAnyPort(StunTuple::TransportType transport)
 {
+   resip::Lock lock(mMutex);
    PortAllocationMap& portAllocationMap = getPortAllocationMap(transport);
    unsigned short startPortToCheck = advanceLastAllocatedPort(transport);
    unsigned short portToCheck = startPortToCheck;
@@ -48,6 +49,7 @@ TurnManager::allocateAnyPort(StunTuple::TransportType transport)
 unsigned short 
 TurnManager::allocateEvenPort(StunTuple::TransportType transport)
 {
+   resip::Lock lock(mMutex);
    PortAllocationMap& portAllocationMap = getPortAllocationMap(transport);
    unsigned short startPortToCheck = advanceLastAllocatedPort(transport);
    // Ensure start port is even
@@ -69,6 +71,7 @@ TurnManager::allocateEvenPort(StunTuple::TransportType transport)
 unsigned short 
 TurnManager::allocateOddPort(StunTuple::TransportType transport)
 {
+   resip::Lock lock(mMutex);
    PortAllocationMap& portAllocationMap = getPortAllocationMap(transport);
    unsigned short startPortToCheck = advanceLastAllocatedPort(transport);
    // Ensure start port is odd
@@ -89,6 +92,7 @@ TurnManager::allocateOddPort(StunTuple::TransportType transport)
 unsigned short 
 TurnManager::allocateEvenPortPair(StunTuple::TransportType transport)
 {
+   resip::Lock lock(mMutex);
    PortAllocationMap& portAllocationMap = getPortAllocationMap(transport);
    unsigned short startPortToCheck = advanceLastAllocatedPort(transport);
    // Ensure start port is even and that start port + 1 is in range
@@ -112,6 +116,7 @@ TurnManager::allocateEvenPortPair(StunTuple::TransportType transport)
 bool 
 TurnManager::allocatePort(StunTuple::TransportType transport, unsigned short port, bool reserved)
 {
+   resip::Lock lock(mMutex);
    if(port >= mConfig.mAllocationPortRangeMin && port <= mConfig.mAllocationPortRangeMax)
    {
       PortAllocationMap& portAllocationMap = getPortAllocationMap(transport);
@@ -138,6 +143,7 @@ TurnManager::allocatePort(StunTuple::TransportType transport, unsigned short por
 void 
 TurnManager::deallocatePort(StunTuple::TransportType transport, unsigned short port)
 {
+   resip::Lock lock(mMutex);
    if(port >= mConfig.mAllocationPortRangeMin && port <= mConfig.mAllocationPortRangeMax)
    {
       PortAllocationMap& portAllocationMap = getPortAllocationMap(transport);
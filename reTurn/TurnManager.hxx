@@ -6,11 +6,13 @@
 #ifdef USE_SSL
 #include <asio/ssl.hpp>
 #endif
+#include <rutil/Mutex.hxx>
 #include "ReTurnConfig.hxx"
 #include "StunTuple.hxx"
 
 namespace reTurn {
 
+/// Shared by all of the server threads; the port allocation methods are thread safe
 class TurnManager
 {
 public:
@@ -43,6 +45,7 @@ private:
    unsigned short mLastAllocatedTcpPort;
    PortAllocationMap& getPortAllocationMap(StunTuple::TransportType transport);
    unsigned short advanceLastAllocatedPort(StunTuple::TransportType transport, unsigned int numToAdvance = 1);
+   resip::Mutex mMutex;  // protects the port allocation state
 
    asio::io_service& mIOService;
    const ReTurnConfig& mConfig;
@@ -13,6 +13,7 @@
 #endif
 #include <functional>
 
+#include <map>
 #include <vector>
 
 #include <rutil/Data.hxx>
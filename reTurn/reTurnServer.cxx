@@ -23,6 +23,9 @@
 #include "ReTurnSubsystem.hxx"
 
 #include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
 
 #define RESIPROCATE_SUBSYSTEM ReTurnSubsystem::RETURN
 
@@ -46,6 +49,109 @@ BOOL WINAPI console_ctrl_handler(DWORD ctrl_type)
 }
 #endif // defined(_WIN32)
 
+namespace reTurn
+{
+
+// The STUN/TURN listeners run by one thread.  When there is more than one
+// thread, each has its own set listening on the same addresses and ports.
+class ReTurnServerSockets
+{
+public:
+   ReTurnServerSockets(asio::io_service& ioService, RequestHandler& requestHandler, const ReTurnConfig& config, bool reusePort);
+   void start();
+
+private:
+   std::shared_ptr<UdpServer> mUdpTurnServer;  // also a1p1StunUdpServer
+   std::shared_ptr<TcpServer> mTcpTurnServer;
+#ifdef USE_SSL
+   std::shared_ptr<TlsServer> mTlsTurnServer;
+#endif
+   std::shared_ptr<UdpServer> mA1p2StunUdpServer;
+   std::shared_ptr<UdpServer> mA2p1StunUdpServer;
+   std::shared_ptr<UdpServer> mA2p2StunUdpServer;
+
+#ifdef USE_IPV6
+   std::shared_ptr<UdpServer> mUdpV6TurnServer;
+   std::shared_ptr<TcpServer> mTcpV6TurnServer;
+#ifdef USE_SSL
+   std::shared_ptr<TlsServer> mTlsV6TurnServer;
+#endif
+#endif
+};
+
+ReTurnServerSockets::ReTurnServerSockets(asio::io_service& ioService, RequestHandler& requestHandler, const ReTurnConfig& config, bool reusePort)
+{
+   mUdpTurnServer = std::make_shared<UdpServer>(ioService, requestHandler, config.mTurnAddress, config.mTurnPort, reusePort);
+   mTcpTurnServer = std::make_shared<TcpServer>(ioService, requestHandler, config.mTurnAddress, config.mTurnPort, reusePort);
+#ifdef USE_SSL
+   if(config.mTlsTurnPort != 0)
+   {
+      mTlsTurnServer = std::make_shared<TlsServer>(ioService, requestHandler, config.mTurnAddress, config.mTlsTurnPort, reusePort);
+   }
+#endif
+
+#ifdef USE_IPV6
+   mUdpV6TurnServer = std::make_shared<UdpServer>(ioService, requestHandler, config.mTurnV6Address, config.mTurnPort, reusePort);
+   mTcpV6TurnServer = std::make_shared<TcpServer>(ioService, requestHandler, config.mTurnV6Address, config.mTurnPort, reusePort);
+#ifdef USE_SSL
+   if(config.mTlsTurnPort != 0)
+   {
+      mTlsV6TurnServer = std::make_shared<TlsServer>(ioService, requestHandler, config.mTurnV6Address, config.mTlsTurnPort, reusePort);
+   }
+#endif
+#endif
+
+   if(config.mAltStunPort != 0) // if alt stun port is non-zero, then RFC3489 support is enabled
+   {
+      mA1p2StunUdpServer = std::make_shared<UdpServer>(ioService, requestHandler, config.mTurnAddress, config.mAltStunPort, reusePort);
+      mA2p1StunUdpServer = std::make_shared<UdpServer>(ioService, requestHandler, config.mAltStunAddress, config.mTurnPort, reusePort);
+      mA2p2StunUdpServer = std::make_shared<UdpServer>(ioService, requestHandler, config.mAltStunAddress, config.mAltStunPort, reusePort);
+      mUdpTurnServer->setAlternateUdpServers(mA1p2StunUdpServer.get(), mA2p1StunUdpServer.get(), mA2p2StunUdpServer.get());
+      mA1p2StunUdpServer->setAlternateUdpServers(mUdpTurnServer.get(), mA2p2StunUdpServer.get(), mA2p1StunUdpServer.get());
+      mA2p1StunUdpServer->setAlternateUdpServers(mA2p2StunUdpServer.get(), mUdpTurnServer.get(), mA1p2StunUdpServer.get());
+      mA2p2StunUdpServer->setAlternateUdpServers(mA2p1StunUdpServer.get(), mA1p2StunUdpServer.get(), mUdpTurnServer.get());
+   }
+
+   // Relayed data arrives on the TURN ports, the STUN only ports do not need batching
+   mUdpTurnServer->setBatchSize(config.mUdpBatchSize);
+#ifdef USE_IPV6
+   mUdpV6TurnServer->setBatchSize(config.mUdpBatchSize);
+#endif
+}
+
+void
+ReTurnServerSockets::start()
+{
+   if(mA1p2StunUdpServer)
+   {
+      mA1p2StunUdpServer->start();
+      mA2p1StunUdpServer->start();
+      mA2p2StunUdpServer->start();
+   }
+
+   mUdpTurnServer->start();
+   mTcpTurnServer->start();
+#ifdef USE_SSL
+   if(mTlsTurnServer)
+   {
+      mTlsTurnServer->start();
+   }
+#endif
+
+#ifdef USE_IPV6
+   mUdpV6TurnServer->start();
+   mTcpV6TurnServer->start();
+#ifdef USE_SSL
+   if(mTlsV6TurnServer)
+   {
+      mTlsV6TurnServer->start();
+   }
+#endif
+#endif
+}
+
+}
+
 int main(int argc, char* argv[])
 {
    reTurn::ReTurnServerProcess proc;
@@ -93,23 +199,26 @@ reTurn::ReTurnServerProcess::main(int argc, char* argv[])
       resip::Log::initialize(reTurnConfig, argv[0]);
 
       // Initialize server.
-      asio::io_service ioService;                                // The one and only ioService for the stunServer
-      reTurn::TurnManager turnManager(ioService, reTurnConfig);  // The one and only Turn Manager
-
-      std::shared_ptr<reTurn::UdpServer> udpTurnServer;  // also a1p1StunUdpServer
-      std::shared_ptr<reTurn::TcpServer> tcpTurnServer;
-#ifdef USE_SSL
-      std::shared_ptr<reTurn::TlsServer> tlsTurnServer;
+      unsigned int numThreads = reTurnConfig.mNumThreads;
+      if(numThreads == 0)
+      {
+         numThreads = resip::resipMax(std::thread::hardware_concurrency(), 1u);
+      }
+#ifndef SO_REUSEPORT
+      if(numThreads > 1)
+      {
+         WarningLog(<< "NumThreads = " << numThreads << " needs SO_REUSEPORT, which this platform does not have, using 1 thread");
+         numThreads = 1;
+      }
 #endif
-      std::shared_ptr<reTurn::UdpServer> a1p2StunUdpServer;
-      std::shared_ptr<reTurn::UdpServer> a2p1StunUdpServer;
-      std::shared_ptr<reTurn::UdpServer> a2p2StunUdpServer;
+      InfoLog(<< "Running " << numThreads << " server thread(s)");
 
-#ifdef USE_IPV6
-      std::shared_ptr<reTurn::UdpServer> udpV6TurnServer;
-      std::shared_ptr<reTurn::TcpServer> tcpV6TurnServer;
-      std::shared_ptr<reTurn::TlsServer> tlsV6TurnServer;
-#endif
+      std::vector<std::unique_ptr<asio::io_service> > ioServices;      // One per thread
+      for(unsigned int i = 0; i < numThreads; i++)
+      {
+         ioServices.push_back(std::unique_ptr<asio::io_service>(new asio::io_service));
+      }
+      reTurn::TurnManager turnManager(*ioServices.front(), reTurnConfig);  // The one and only Turn Manager
 
       // The one and only RequestHandler - if altStunPort is non-zero, then assume RFC3489 support is enabled and pass settings to request handler
       reTurn::RequestHandler requestHandler(turnManager, 
@@ -118,57 +227,18 @@ reTurn::ReTurnServerProcess::main(int argc, char* argv[])
          reTurnConfig.mAltStunPort != 0 ? &reTurnConfig.mAltStunAddress : 0, 
          reTurnConfig.mAltStunPort != 0 ? &reTurnConfig.mAltStunPort : 0); 
 
-      udpTurnServer = std::make_shared<reTurn::UdpServer>(ioService, requestHandler, reTurnConfig.mTurnAddress, reTurnConfig.mTurnPort);
-      tcpTurnServer = std::make_shared<reTurn::TcpServer>(ioService, requestHandler, reTurnConfig.mTurnAddress, reTurnConfig.mTurnPort);
-#ifdef USE_SSL
-      if(reTurnConfig.mTlsTurnPort != 0)
+      // Each thread listens on all of the configured ports, allocations stay
+      // on the thread that created them
+      std::vector<std::unique_ptr<reTurn::ReTurnServerSockets> > serverSockets;
+      for(unsigned int i = 0; i < numThreads; i++)
       {
-         tlsTurnServer = std::make_shared<reTurn::TlsServer>(ioService, requestHandler, reTurnConfig.mTurnAddress, reTurnConfig.mTlsTurnPort);
+         serverSockets.push_back(std::unique_ptr<reTurn::ReTurnServerSockets>(
+            new reTurn::ReTurnServerSockets(*ioServices[i], requestHandler, reTurnConfig, numThreads > 1 /* reusePort */)));
       }
-#endif
-
-#ifdef USE_IPV6
-      udpV6TurnServer = std::make_shared<reTurn::UdpServer>(ioService, requestHandler, reTurnConfig.mTurnV6Address, reTurnConfig.mTurnPort);
-      tcpV6TurnServer = std::make_shared<reTurn::TcpServer>(ioService, requestHandler, reTurnConfig.mTurnV6Address, reTurnConfig.mTurnPort);
-      if(reTurnConfig.mTlsTurnPort != 0)
+      for(unsigned int i = 0; i < numThreads; i++)
       {
-         tlsV6TurnServer = std::make_shared<reTurn::TlsServer>(ioService, requestHandler, reTurnConfig.mTurnV6Address, reTurnConfig.mTlsTurnPort);
+         serverSockets[i]->start();
       }
-#endif
-
-      if(reTurnConfig.mAltStunPort != 0) // if alt stun port is non-zero, then RFC3489 support is enabled
-      {
-         a1p2StunUdpServer = std::make_shared<reTurn::UdpServer>(ioService, requestHandler, reTurnConfig.mTurnAddress, reTurnConfig.mAltStunPort);
-         a2p1StunUdpServer = std::make_shared<reTurn::UdpServer>(ioService, requestHandler, reTurnConfig.mAltStunAddress, reTurnConfig.mTurnPort);
-         a2p2StunUdpServer = std::make_shared<reTurn::UdpServer>(ioService, requestHandler, reTurnConfig.mAltStunAddress, reTurnConfig.mAltStunPort);
-         udpTurnServer->setAlternateUdpServers(a1p2StunUdpServer.get(), a2p1StunUdpServer.get(), a2p2StunUdpServer.get());
-         a1p2StunUdpServer->setAlternateUdpServers(udpTurnServer.get(), a2p2StunUdpServer.get(), a2p1StunUdpServer.get());
-         a2p1StunUdpServer->setAlternateUdpServers(a2p2StunUdpServer.get(), udpTurnServer.get(), a1p2StunUdpServer.get());
-         a2p2StunUdpServer->setAlternateUdpServers(a2p1StunUdpServer.get(), a1p2StunUdpServer.get(), udpTurnServer.get());
-         a1p2StunUdpServer->start();
-         a2p1StunUdpServer->start();
-         a2p2StunUdpServer->start();
-      }
-
-      udpTurnServer->start();
-      tcpTurnServer->start();
-#ifdef USE_SSL
-      if(tlsTurnServer)
-      {
-         tlsTurnServer->start();
-      }
-#endif
-
-#ifdef USE_IPV6
-      udpV6TurnServer->start();
-      tcpV6TurnServer->start();
-#ifdef USE_SSL
-      if(tlsV6TurnServer)
-      {
-         tlsV6TurnServer->start();
-      }
-#endif
-#endif
 
       // Drop privileges (can do this now that sockets are bound)
       if(!reTurnConfig.mRunAsUser.empty())
@@ -177,12 +247,12 @@ reTurn::ReTurnServerProcess::main(int argc, char* argv[])
          dropPrivileges(reTurnConfig.mRunAsUser, reTurnConfig.mRunAsGroup);
       }
 
-      ReTurnUserFileScanner userFileScanner(ioService, reTurnConfig);
+      ReTurnUserFileScanner userFileScanner(*ioServices.front(), reTurnConfig);
       userFileScanner.start();
 
 #ifdef _WIN32
       // Set console control handler to allow server to be stopped.
-      console_ctrl_function = [&ioService] { ioService.stop(); };
+      console_ctrl_function = [&ioServices] { for(auto& ioService : ioServices) ioService->stop(); };
       SetConsoleCtrlHandler(console_ctrl_handler, TRUE);
 #else
       // Block all signals for background thread.
@@ -192,9 +262,14 @@ reTurn::ReTurnServerProcess::main(int argc, char* argv[])
       pthread_sigmask(SIG_BLOCK, &new_mask, &old_mask);
 #endif
 
-      // Run the ioService until stopped.
+      // Run the ioServices until stopped.
       // Create a pool of threads to run all of the io_services.
-      asio::thread thread([&ioService] { ioService.run(); });
+      std::vector<std::unique_ptr<asio::thread> > threads;
+      for(auto& ioService : ioServices)
+      {
+         asio::io_service* service = ioService.get();
+         threads.push_back(std::unique_ptr<asio::thread>(new asio::thread([service] { service->run(); })));
+      }
 
 #ifndef _WIN32
       // Restore previous signals.
@@ -209,11 +284,17 @@ reTurn::ReTurnServerProcess::main(int argc, char* argv[])
       pthread_sigmask(SIG_BLOCK, &wait_mask, 0);
       int sig = 0;
       sigwait(&wait_mask, &sig);
-      ioService.stop();
+      for(auto& ioService : ioServices)
+      {
+         ioService->stop();
+      }
 #endif
 
-      // Wait for thread to exit
-      thread.join();
+      // Wait for threads to exit
+      for(auto& thread : threads)
+      {
+         thread->join();
+      }
    }
    catch (const std::exception& e)
    {
@@ -0,0 +1,161 @@
+// Times the lookups done for every relayed packet - allocation, permission
+// and channel - with many allocations, against the std::maps they used to be
+
+#include <iostream>
+#include <map>
+#include <vector>
+#include <asio.hpp>
+
+#include <rutil/HashMap.hxx>
+#include <rutil/Logger.hxx>
+#include <rutil/ResipAssert.h>
+#include <rutil/Timer.hxx>
+
+#include "../StunTuple.hxx"
+#include "../TurnAllocationKey.hxx"
+#include "../ChannelManager.hxx"
+
+using namespace reTurn;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM resip::Subsystem::TEST
+
+static const unsigned int NumAllocations = 100000;
+static const unsigned int NumPeers = 4;      // permissions and channels per allocation
+static const unsigned int NumLookups = 1000000;
+
+static StunTuple
+clientTuple(unsigned int i)
+{
+   return StunTuple(StunTuple::UDP, asio::ip::address_v4(0x0a000000 + i / 8), 40000 + i % 8);
+}
+
+static StunTuple
+peerTuple(unsigned int i, unsigned int peer)
+{
+   return StunTuple(StunTuple::UDP, asio::ip::address_v4(0xc6330000 + (i * NumPeers + peer) % 65536), 50000 + peer);
+}
+
+int main(int argc, char* argv[])
+{
+   resip::Log::initialize(resip::Log::Cout, resip::Log::Warning, "");
+
+   StunTuple local(StunTuple::UDP, asio::ip::address::from_string("192.0.2.1"), 3478);
+   vector<TurnAllocationKey> keys;
+   keys.reserve(NumAllocations);
+   for(unsigned int i = 0; i < NumAllocations; i++)
+   {
+      keys.push_back(TurnAllocationKey(local, clientTuple(i)));
+   }
+
+   // What each lookup did before: trees keyed on the tuples
+   map<TurnAllocationKey, unsigned int> allocationTree;
+   vector<map<asio::ip::address, unsigned int> > permissionTrees(NumAllocations);
+   vector<map<unsigned short, unsigned int> > channelTrees(NumAllocations);
+   vector<map<StunTuple, unsigned int> > peerTrees(NumAllocations);
+
+   HashMap<TurnAllocationKey, unsigned int> allocations;
+   vector<HashMap<asio::ip::address, unsigned int, StunAddressHash> > permissions(NumAllocations);
+   vector<ChannelManager> channelManagers(NumAllocations);
+
+   for(unsigned int i = 0; i < NumAllocations; i++)
+   {
+      allocationTree[keys[i]] = i;
+      allocations[keys[i]] = i;
+      for(unsigned int peer = 0; peer < NumPeers; peer++)
+      {
+         StunTuple tuple = peerTuple(i, peer);
+         permissionTrees[i][tuple.getAddress()] = peer;
+         permissions[i][tuple.getAddress()] = peer;
+         RemotePeer* remotePeer = channelManagers[i].createChannelBinding(tuple);
+         channelTrees[i][remotePeer->getChannel()] = peer;
+         peerTrees[i][tuple] = peer;
+      }
+   }
+   resip_assert(allocations.size() == NumAllocations);
+   resip_assert(allocationTree.size() == NumAllocations);
+
+   // Pick the packets up front, so both runs do the same lookups
+   vector<unsigned int> packets(NumLookups);
+   for(unsigned int n = 0; n < NumLookups; n++)
+   {
+      packets[n] = (n * 7919) % NumAllocations;
+   }
+
+   // A packet from a client on a channel, then one from a peer
+   unsigned int found = 0;
+   uint64_t start = resip::Timer::getTimeMicroSec();
+   for(unsigned int n = 0; n < NumLookups; n++)
+   {
+      unsigned int i = allocationTree.find(keys[packets[n]])->second;
+      StunTuple tuple = peerTuple(i, n % NumPeers);
+      map<StunTuple, unsigned int>::iterator peerIt = peerTrees[i].find(tuple);
+      if(permissionTrees[i].find(tuple.getAddress()) != permissionTrees[i].end() && peerIt != peerTrees[i].end())
+      {
+         found++;
+      }
+   }
+   uint64_t treeTime = resip::Timer::getTimeMicroSec() - start;
+   resip_assert(found == NumLookups);
+
+   found = 0;
+   start = resip::Timer::getTimeMicroSec();
+   for(unsigned int n = 0; n < NumLookups; n++)
+   {
+      unsigned int i = allocations.find(keys[packets[n]])->second;
+      StunTuple tuple = peerTuple(i, n % NumPeers);
+      RemotePeer* remotePeer = channelManagers[i].findRemotePeerByPeerAddress(tuple);
+      if(permissions[i].find(tuple.getAddress()) != permissions[i].end() && remotePeer &&
+         channelManagers[i].findRemotePeerByChannel(remotePeer->getChannel()) == remotePeer)
+      {
+         found++;
+      }
+   }
+   uint64_t hashTime = resip::Timer::getTimeMicroSec() - start;
+   resip_assert(found == NumLookups);
+
+   // Lookups that miss
+   resip_assert(allocations.find(TurnAllocationKey(local, clientTuple(NumAllocations))) == allocations.end());
+   resip_assert(channelManagers[0].findRemotePeerByPeerAddress(peerTuple(1, 0)) == 0);
+   resip_assert(permissions[0].find(asio::ip::address::from_string("::1")) == permissions[0].end());
+
+   cout << NumAllocations << " allocations with " << NumPeers << " permissions and channels each: "
+        << (double)treeTime * 1000 / NumLookups << " ns per packet with std::map, "
+        << (double)hashTime * 1000 / NumLookups << " ns per packet with hash lookups" << endl;
+   return 0;
+}
+
+
+/* ====================================================================
+
+ Copyright (c) 2007-2008, SIP Spectrum, Inc.
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are 
+ met:
+
+ 1. Redistributions of source code must retain the above copyright 
+    notice, this list of conditions and the following disclaimer. 
+
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution. 
+
+ 3. Neither the name of SIP Spectrum nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission. 
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR 
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ ==================================================================== */
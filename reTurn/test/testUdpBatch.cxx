@@ -0,0 +1,139 @@
+// Drives a batched AsyncUdpSocketBase over loopback with bursts larger than
+// its batch size: it echoes every datagram it receives back to the sender, so
+// both recvmmsg and sendmmsg are used, and the datagrams and their source
+// addresses and ports are checked on both sides
+
+#include <iostream>
+#include <map>
+#include <memory>
+#include <vector>
+#include <asio.hpp>
+
+#include <rutil/Data.hxx>
+#include <rutil/Logger.hxx>
+#include <rutil/ResipAssert.h>
+
+#include "../AsyncUdpSocketBase.hxx"
+#include "../DataBuffer.hxx"
+#include "../StunTuple.hxx"
+
+using namespace reTurn;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM resip::Subsystem::TEST
+
+static const unsigned int BatchSize = 8;
+static const unsigned int NumPeers = 3;
+static const unsigned int NumRounds = 20;
+static const unsigned int BurstSize = 10;   // per peer and round; small enough for the socket buffers
+
+class EchoSocket : public AsyncUdpSocketBase
+{
+public:
+   explicit EchoSocket(asio::io_service& ioService) : AsyncUdpSocketBase(ioService), mSent(0), mFailures(0) {}
+
+   unsigned short getLocalPort() { return mSocket.local_endpoint().port(); }
+
+   void onReceiveSuccess(const asio::ip::address& address, unsigned short port, const std::shared_ptr<DataBuffer>& data) override
+   {
+      StunTuple source(StunTuple::UDP, address, port);
+      mReceived.push_back(make_pair(source, resip::Data(data->data(), data->size())));
+      doSend(source, data);
+      doReceive();
+   }
+   void onReceiveFailure(const asio::error_code& e) override { mFailures++; }
+   void onSendSuccess() override { mSent++; }
+   void onSendFailure(const asio::error_code& e) override { mFailures++; }
+
+   vector<pair<StunTuple, resip::Data> > mReceived;
+   unsigned int mSent;
+   unsigned int mFailures;
+};
+
+// sizes vary, so datagrams cut short or run together show
+static resip::Data
+payload(unsigned int peer, unsigned int i)
+{
+   resip::Data data("peer" + resip::Data(peer) + " datagram " + resip::Data(i) + " ");
+   for(unsigned int c = 0; c < i % 40; c++)
+   {
+      data += (char)('a' + (peer + c) % 26);
+   }
+   return data;
+}
+
+int main(int argc, char* argv[])
+{
+   resip::Log::initialize(resip::Log::Cout, argc > 1 ? resip::Log::toLevel(argv[1]) : resip::Log::Warning, argv[0]);
+
+   asio::io_service ioService;
+   asio::ip::address loopback = asio::ip::address::from_string("127.0.0.1");
+
+   std::shared_ptr<EchoSocket> echo = std::make_shared<EchoSocket>(ioService);
+   echo->setBatchSize(BatchSize);
+   asio::error_code ec = echo->bind(loopback, 0);
+   resip_assert(!ec);
+   asio::ip::udp::endpoint echoEndpoint(loopback, echo->getLocalPort());
+   echo->doReceive();
+
+   vector<std::shared_ptr<asio::ip::udp::socket> > peers;
+   map<unsigned short, unsigned int> peerByPort;
+   for(unsigned int p = 0; p < NumPeers; p++)
+   {
+      std::shared_ptr<asio::ip::udp::socket> peer = std::make_shared<asio::ip::udp::socket>(ioService, asio::ip::udp::endpoint(loopback, 0));
+      peerByPort[peer->local_endpoint().port()] = p;
+      peers.push_back(peer);
+   }
+
+   unsigned int expected = 0;
+   vector<unsigned int> nextFromPeer(NumPeers, 0);
+   for(unsigned int round = 0; round < NumRounds; round++)
+   {
+      // the burst is all queued in the socket before the echo socket gets
+      // to run, so recvmmsg returns full batches, and the echoes queue up
+      // behind the first one and go out with sendmmsg
+      for(unsigned int i = round * BurstSize; i < (round + 1) * BurstSize; i++)
+      {
+         for(unsigned int p = 0; p < NumPeers; p++)
+         {
+            resip::Data data = payload(p, i);
+            peers[p]->send_to(asio::buffer(data.data(), data.size()), echoEndpoint);
+         }
+      }
+      expected += NumPeers * BurstSize;
+      while((echo->mReceived.size() < expected || echo->mSent < expected) && ioService.run_one())
+      {
+      }
+      resip_assert(echo->mFailures == 0);
+      resip_assert(echo->mReceived.size() == expected);
+      resip_assert(echo->mSent == expected);
+
+      for(unsigned int p = 0; p < NumPeers; p++)
+      {
+         char buffer[1024];
+         for(unsigned int i = round * BurstSize; i < (round + 1) * BurstSize; i++)
+         {
+            asio::ip::udp::endpoint sender;
+            size_t size = peers[p]->receive_from(asio::buffer(buffer, sizeof(buffer)), sender);
+            resip_assert(sender == echoEndpoint);
+            resip_assert(resip::Data(buffer, size) == payload(p, i));
+         }
+         resip_assert(peers[p]->available() == 0);
+      }
+   }
+
+   for(vector<pair<StunTuple, resip::Data> >::const_iterator it = echo->mReceived.begin(); it != echo->mReceived.end(); it++)
+   {
+      resip_assert(it->first.getAddress() == loopback);
+      map<unsigned short, unsigned int>::const_iterator peer = peerByPort.find(it->first.getPort());
+      resip_assert(peer != peerByPort.end());
+      // each peer's datagrams arrive in the order they were sent
+      resip_assert(it->second == payload(peer->second, nextFromPeer[peer->second]++));
+   }
+
+   echo->close();
+   ioService.run();
+
+   cout << "All OK" << endl;
+   return 0;
+}
@@ -3,6 +3,7 @@
 #include <WS2TCPIP.H>
 #else
 #include <netinet/in.h>
+#include <poll.h>
 #endif
 
 #include <rutil/Log.hxx>
@@ -95,6 +96,27 @@ FakeSelectSocketDescriptor::receive()
 }
 
 
+bool
+FakeSelectSocketDescriptor::wait(unsigned int timeoutMs)
+{
+   // poll rather than select: the descriptor can be above FD_SETSIZE in
+   // processes with many flows
+#ifdef WIN32
+   WSAPOLLFD pfd;
+   pfd.fd = mSocket;
+   pfd.events = POLLRDNORM;
+   pfd.revents = 0;
+   return ::WSAPoll(&pfd, 1, (INT)timeoutMs) > 0;
+#else
+   struct pollfd pfd;
+   pfd.fd = mPipe[0];
+   pfd.events = POLLIN;
+   pfd.revents = 0;
+   return ::poll(&pfd, 1, (int)timeoutMs) > 0;
+#endif
+}
+
+
 /* ====================================================================
 
  Copyright (c) 2007-2008, Plantronics, Inc.
@@ -30,6 +30,10 @@ public:
 
    void receive();
 
+   // waits up to timeoutMs for the descriptor to signal, returns true if it did
+
+   bool wait(unsigned int timeoutMs);
+
 
 private:
 #ifndef WIN32
@@ -142,7 +142,8 @@ Flow::Flow(asio::io_service& ioService,
     mAllocationProps(StunMessage::PropsNone),
     mReservationToken(0),
     mFlowState(Unconnected),
-    mReceivedDataFifo(maxReceiveFifoDuration, maxReceiveFifoSize)
+    mReceivedDataRing(maxReceiveFifoSize),
+    mReceiveSignalled(false)
 {
    InfoLog(<< "Flow: flow created for " << mLocalBinding << "  ComponentId=" << mComponentId);
 
@@ -349,94 +350,168 @@ Flow::processSendData(char* buffer, unsigned int& size, const asio::ip::address&
 asio::error_code 
 Flow::receiveFrom(const asio::ip::address& address, unsigned short port, char* buffer, unsigned int& size, unsigned int timeout)
 {
-   bool done = false;
-   asio::error_code errorCode;
-
    uint64_t startTime = Timer::getTimeMs();
-   unsigned int recvTimeout;
-   while(!done)
+   ReceivedData receivedData;
+   for(;;)
    {
-      // We define timeout of 0 differently then TimeLimitFifo - we want 0 to mean no-block at all
-      if(timeout == 0 && mReceivedDataFifo.empty())
+      uint64_t elapsed = Timer::getTimeMs() - startTime;
+      if(!popReceivedData(receivedData, elapsed < timeout ? (unsigned int)(timeout - elapsed) : 0))
       {
          // timeout
          return asio::error_code(flowmanager::ReceiveTimeout, asio::error::misc_category);
       }
 
-      recvTimeout = timeout ? (unsigned int)(timeout - (Timer::getTimeMs() - startTime)) : 0;
-      if(timeout != 0 && recvTimeout <= 0)
+      // discard any data not from address/port requested
+      if(address == receivedData.mAddress && port == receivedData.mPort)
       {
-         // timeout
-         return asio::error_code(flowmanager::ReceiveTimeout, asio::error::misc_category);
-      }
-      ReceivedData* receivedData = mReceivedDataFifo.getNext(recvTimeout);  
-      if(receivedData)
-      {
-         mFakeSelectSocketDescriptor.receive();
-
-         // discard any data not from address/port requested
-         if(address == receivedData->mAddress && port == receivedData->mPort)
-         {
-            errorCode = processReceivedData(buffer, size, receivedData);
-            done = true;
-         }
-         delete receivedData;
-      }
-      else
-      {
-         // timeout
-         errorCode = asio::error_code(flowmanager::ReceiveTimeout, asio::error::misc_category);
-         done = true;
+         return processReceivedData(buffer, size, receivedData);
       }
    }
-   return errorCode;
 }
 
 asio::error_code 
 Flow::receive(char* buffer, unsigned int& size, unsigned int timeout, asio::ip::address* sourceAddress, unsigned short* sourcePort)
 {
-   asio::error_code errorCode;
-
    //InfoLog(<< "Flow::receive called with buffer size=" << size << ", timeout=" << timeout);
-   // We define timeout of 0 differently then TimeLimitFifo - we want 0 to mean no-block at all
-   if(timeout == 0 && mReceivedDataFifo.empty())
+   ReceivedData receivedData;
+   if(!popReceivedData(receivedData, timeout))
    {
       // timeout
-      InfoLog(<< "Receive timeout (timeout==0 and fifo empty)!");
+      InfoLog(<< "Receive timeout!  ComponentId=" << mComponentId);
+      return asio::error_code(flowmanager::ReceiveTimeout, asio::error::misc_category);
+   }
+   return processReceivedData(buffer, size, receivedData, sourceAddress, sourcePort);
+}
+
+asio::error_code 
+Flow::receive(ReceivedData& receivedData, unsigned int timeout)
+{
+   if(!popReceivedData(receivedData, timeout))
+   {
       return asio::error_code(flowmanager::ReceiveTimeout, asio::error::misc_category);
    }
-   if(mReceivedDataFifo.empty())
+   return unprotectReceivedData(receivedData);
+}
+
+unsigned int
+Flow::receiveBatch(std::vector<ReceivedData>& receivedData, unsigned int maxPackets, unsigned int timeout)
+{
+   unsigned int count = 0;
+   ReceivedData packet;
+   while(count < maxPackets && popReceivedData(packet, count == 0 ? timeout : 0))
+   {
+      if(!unprotectReceivedData(packet))
+      {
+         receivedData.push_back(std::move(packet));
+         count++;
+      }
+   }
+   return count;
+}
+
+bool
+Flow::popReceivedData(ReceivedData& receivedData, unsigned int timeout)
+{
+   // A timeout of 0 means do not wait at all
+   auto take = [&receivedData](ReceivedData& slot)
    {
-      WarningLog(<< "Receive called when there is no data available!  ComponentId=" << mComponentId);
+      receivedData.mAddress = slot.mAddress;
+      receivedData.mPort = slot.mPort;
+      receivedData.mData = std::move(slot.mData);
+   };
+   uint64_t startTime = 0;
+   for(;;)
+   {
+      if(mReceivedDataRing.tryPop(take))
+      {
+         if(mReceivedDataRing.empty())
+         {
+            clearReceiveSignal();
+         }
+         return true;
+      }
+
+      clearReceiveSignal();
+      if(!mReceivedDataRing.empty())
+      {
+         continue;
+      }
+      if(timeout == 0)
+      {
+         return false;
+      }
+      if(startTime == 0)
+      {
+         startTime = Timer::getTimeMs();
+      }
+      uint64_t elapsed = Timer::getTimeMs() - startTime;
+      if(elapsed >= timeout)
+      {
+         return false;
+      }
+      // Signalled by onReceiveSuccess as soon as there is data
+      mFakeSelectSocketDescriptor.wait((unsigned int)(timeout - elapsed));
    }
+}
 
-   ReceivedData* receivedData = mReceivedDataFifo.getNext(timeout);   
-   if(receivedData)
+void
+Flow::clearReceiveSignal()
+{
+   // Called by the receiving thread when it has emptied the ring.  If a packet
+   // arrived in the meantime onReceiveSuccess either saw the flag cleared and
+   // signalled, or this sees the packet and signals again, so the descriptor
+   // stays readable while there is data.
+   if(mReceiveSignalled.exchange(false))
    {
       mFakeSelectSocketDescriptor.receive();
-      errorCode = processReceivedData(buffer, size, receivedData, sourceAddress, sourcePort);
-      delete receivedData;
    }
-   else
+   if(!mReceivedDataRing.empty() && !mReceiveSignalled.exchange(true))
    {
-      // timeout
-      InfoLog(<< "Receive timeout!  ComponentId=" << mComponentId);
-      errorCode = asio::error_code(flowmanager::ReceiveTimeout, asio::error::misc_category);
+      mFakeSelectSocketDescriptor.send();
    }
-   return errorCode;
 }
 
+asio::error_code 
+Flow::processReceivedData(char* buffer, unsigned int& size, ReceivedData& receivedData, asio::ip::address* sourceAddress, unsigned short* sourcePort)
+{
+   asio::error_code errorCode = unprotectReceivedData(receivedData);
+   if(!errorCode)
+   {
+      unsigned int receivedsize = (unsigned int)receivedData.mData->size();
+      if(size > receivedsize)
+      {
+         size = receivedsize;
+         memcpy(buffer, receivedData.mData->data(), size);
+         //InfoLog(<< "Received a buffer of size=" << receivedData.mData.size());
+      }
+      else
+      {
+         // Receive buffer too small
+         InfoLog(<< "Receive buffer too small for data size=" << receivedsize << "  ComponentId=" << mComponentId);
+         errorCode = asio::error_code(flowmanager::BufferTooSmall, asio::error::misc_category);
+      }
+      if(sourceAddress)
+      {
+         *sourceAddress = receivedData.mAddress;
+      }
+      if(sourcePort)
+      {
+         *sourcePort = receivedData.mPort;
+      }
+   }
+   return errorCode;
+}
 
 asio::error_code 
-Flow::processReceivedData(char* buffer, unsigned int& size, ReceivedData* receivedData, asio::ip::address* sourceAddress, unsigned short* sourcePort)
+Flow::unprotectReceivedData(ReceivedData& receivedData)
 {
    asio::error_code errorCode;
-   unsigned int receivedsize = receivedData->mData->size();
+   unsigned int receivedsize = (unsigned int)receivedData.mData->size();
 
    // SRTP Unprotect (if required)
    if(mMediaStream.mSRTPSessionInCreated)
    {
-      srtp_err_status_t status = mMediaStream.srtpUnprotect((void*)receivedData->mData->data(), (int*)&receivedsize, mComponentId == RTCP_COMPONENT_ID);
+      srtp_err_status_t status = mMediaStream.srtpUnprotect((void*)receivedData.mData->data(), (int*)&receivedsize, mComponentId == RTCP_COMPONENT_ID);
       if(status != srtp_err_status_ok)
       {
          ErrLog(<< "Unable to SRTP unprotect the packet (componentid=" << mComponentId << "), error code=" << status << "(" << srtp_error_string(status) << ")");
@@ -447,12 +522,12 @@ Flow::processReceivedData(char* buffer, unsigned int& size, ReceivedData* receiv
    else
    {
       Lock lock(mMutex);
-      DtlsSocket* dtlsSocket = getDtlsSocket(StunTuple(mLocalBinding.getTransportType(), receivedData->mAddress, receivedData->mPort));
+      DtlsSocket* dtlsSocket = getDtlsSocket(StunTuple(mLocalBinding.getTransportType(), receivedData.mAddress, receivedData.mPort));
       if(dtlsSocket)
       {
          if(((FlowDtlsSocketContext*)dtlsSocket->getSocketContext())->isSrtpInitialized())
          {
-            srtp_err_status_t status = ((FlowDtlsSocketContext*)dtlsSocket->getSocketContext())->srtpUnprotect((void*)receivedData->mData->data(), (int*)&receivedsize, mComponentId == RTCP_COMPONENT_ID);
+            srtp_err_status_t status = ((FlowDtlsSocketContext*)dtlsSocket->getSocketContext())->srtpUnprotect((void*)receivedData.mData->data(), (int*)&receivedsize, mComponentId == RTCP_COMPONENT_ID);
             if(status != srtp_err_status_ok)
             {
                ErrLog(<< "Unable to SRTP unprotect the packet (componentid=" << mComponentId << "), error code=" << status << "(" << srtp_error_string(status) << ")");
@@ -469,30 +544,12 @@ Flow::processReceivedData(char* buffer, unsigned int& size, ReceivedData* receiv
 #endif //USE_SSL
    if(!errorCode)
    {
-      if(size > receivedsize)
-      {
-         size = receivedsize;
-         memcpy(buffer, receivedData->mData->data(), size);
-         //InfoLog(<< "Received a buffer of size=" << receivedData->mData.size());
-      }
-      else
-      {
-         // Receive buffer too small
-         InfoLog(<< "Receive buffer too small for data size=" << receivedsize << "  ComponentId=" << mComponentId);
-         errorCode = asio::error_code(flowmanager::BufferTooSmall, asio::error::misc_category);
-      }
-      if(sourceAddress)
-      {
-         *sourceAddress = receivedData->mAddress;
-      }
-      if(sourcePort)
-      {
-         *sourcePort = receivedData->mPort;
-      }
+      // Unprotected in place, drop the SRTP authentication tag
+      receivedData.mData->truncate(receivedsize);
       if(mRtcpEventLoggingHandler.get())
       {
-         Data _buf(Data::Share, buffer, size);
-         StunTuple _source(mLocalBinding.getTransportType(), *sourceAddress, *sourcePort);
+         Data _buf(Data::Share, receivedData.mData->data(), receivedsize);
+         StunTuple _source(mLocalBinding.getTransportType(), receivedData.mAddress, receivedData.mPort);
          mRtcpEventLoggingHandler->inboundEvent(mFlowContext, _source, mLocalBinding, _buf);
       }
    }
@@ -839,13 +896,17 @@ Flow::onReceiveSuccess(unsigned int socketDesc, const asio::ip::address& address
    }
 #endif 
 
-   ReceivedData* receivedData = new ReceivedData(address, port, data);
-   if(!mReceivedDataFifo.add(receivedData, ReceivedDataFifo::EnforceTimeDepth))
+   auto fill = [&address, port, &data](ReceivedData& slot)
+   {
+      slot.mAddress = address;
+      slot.mPort = port;
+      slot.mData = data;
+   };
+   if(!mReceivedDataRing.tryPush(fill))
    {
-      WarningLog(<< "Flow::onReceiveSuccess: TimeLimitFifo is full (countDepth=" << mReceivedDataFifo.getCountDepth() << ", timeDepth=" << mReceivedDataFifo.getTimeDepth() << ") - discarding data!  socketDesc=" << socketDesc << ", fromAddress=" << address.to_string() << ", fromPort=" << port << ", size=" << data->size() << ", componentId=" << mComponentId);
-      delete receivedData;
+      WarningLog(<< "Flow::onReceiveSuccess: receive ring is full (" << mReceivedDataRing.capacity() << " packets) - discarding data!  socketDesc=" << socketDesc << ", fromAddress=" << address.to_string() << ", fromPort=" << port << ", size=" << data->size() << ", componentId=" << mComponentId);
    }
-   else
+   else if(!mReceiveSignalled.exchange(true))
    {
       mFakeSelectSocketDescriptor.send();
    }
@@ -5,8 +5,10 @@
 #include "config.h"
 #endif
 
+#include <atomic>
 #include <map>
-#include <rutil/TimeLimitFifo.hxx>
+#include <vector>
+#include <rutil/SpscRing.hxx>
 #include <rutil/Mutex.hxx>
 
 #include "Srtp2Helper.hxx"
@@ -45,7 +47,7 @@ class Flow : public TurnAsyncSocketHandler
 {
 public:
 
-   static int maxReceiveFifoDuration;
+   static int maxReceiveFifoDuration;  // no longer used, received packets are only limited by count
    static int maxReceiveFifoSize;
 
    enum FlowState
@@ -90,10 +92,32 @@ public:
    void sendTo(const asio::ip::address& address, unsigned short port, char* buffer, unsigned int size);
    void rawSendTo(const asio::ip::address& address, unsigned short port, const char* buffer, unsigned int size);
 
+   class ReceivedData
+   {
+   public:
+      ReceivedData() : mPort(0) {}
+      ReceivedData(const asio::ip::address& address, unsigned short port, std::shared_ptr<DataBuffer> data) :
+         mAddress(address), mPort(port), mData(data) {}
+
+      asio::ip::address mAddress;
+      unsigned short mPort;
+      std::shared_ptr<DataBuffer> mData;
+   };
+
    /// Receive Methods
+   /// Note:  only one thread may receive from a Flow at a time
    asio::error_code receive(char* buffer, unsigned int& size, unsigned int timeout, asio::ip::address* sourceAddress=0, unsigned short* sourcePort=0);
    asio::error_code receiveFrom(const asio::ip::address& address, unsigned short port, char* buffer, unsigned int& size, unsigned int timeout);
 
+   /// Receives without copying: receivedData.mData is the buffer the packet
+   /// was read into, SRTP unprotected in place and truncated to the payload
+   asio::error_code receive(ReceivedData& receivedData, unsigned int timeout);
+
+   /// Appends up to maxPackets packets to receivedData, as receive(ReceivedData&)
+   /// does, waiting up to timeout ms for the first one.  Packets that cannot
+   /// be unprotected are dropped.  Returns the number of packets appended.
+   unsigned int receiveBatch(std::vector<ReceivedData>& receivedData, unsigned int maxPackets, unsigned int timeout);
+
    /// Used to set where this flow should be sending to
    void setActiveDestination(const char* address, unsigned short port);
 
@@ -163,23 +187,19 @@ private:
    void changeFlowState(FlowState newState);
    const char* flowStateToString(FlowState state);
 
-   class ReceivedData
-   {
-   public:
-      ReceivedData(const asio::ip::address& address, unsigned short port, std::shared_ptr<DataBuffer> data) :
-         mAddress(address), mPort(port), mData(data) {}
-
-      asio::ip::address mAddress;
-      unsigned short mPort;
-      std::shared_ptr<DataBuffer> mData;
-   };
-   // FIFO for received data
-   typedef resip::TimeLimitFifo<ReceivedData> ReceivedDataFifo;
-   ReceivedDataFifo mReceivedDataFifo; 
+   // Received data, from the ioService thread to the thread calling receive.
+   // mFakeSelectSocketDescriptor is signalled (mReceiveSignalled) while
+   // there may be data in the ring, rather than once per packet.
+   typedef resip::SpscRing<ReceivedData> ReceivedDataRing;
+   ReceivedDataRing mReceivedDataRing;
+   std::atomic<bool> mReceiveSignalled;
+   bool popReceivedData(ReceivedData& receivedData, unsigned int timeout);
+   void clearReceiveSignal();
 
    // Helpers to perform SRTP protection/unprotection
    bool processSendData(char* buffer, unsigned int& size, const asio::ip::address& address, unsigned short port);
-   asio::error_code processReceivedData(char* buffer, unsigned int& size, ReceivedData* receivedData, asio::ip::address* sourceAddress=0, unsigned short* sourcePort=0);
+   asio::error_code processReceivedData(char* buffer, unsigned int& size, ReceivedData& receivedData, asio::ip::address* sourceAddress=0, unsigned short* sourcePort=0);
+   asio::error_code unprotectReceivedData(ReceivedData& receivedData);
    FakeSelectSocketDescriptor mFakeSelectSocketDescriptor;
 
    virtual void onConnectSuccess(unsigned int socketDesc, const asio::ip::address& address, unsigned short port);
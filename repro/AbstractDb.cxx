@@ -216,6 +216,15 @@ AbstractDb::getUserAuthInfo(  const AbstractDb::Key& key ) const
 }
 
 
+AbstractDb::LookupResult
+AbstractDb::lookupUserAuthInfo(  const AbstractDb::Key& key, resip::Data& a1 ) const
+{
+   a1 = getUserAuthInfo(key);
+
+   return a1.empty() ? LookupNotFound : LookupFound;
+}
+
+
 AbstractDb::Key 
 AbstractDb::firstUserKey()
 {
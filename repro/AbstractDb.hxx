@@ -111,6 +111,13 @@ class AbstractDb
       typedef std::vector<FilterRecord> FilterRecordList;
       typedef std::vector<SiloRecord> SiloRecordList;
 
+      typedef enum
+      {
+         LookupFound,
+         LookupNotFound,
+         LookupFailed   // eg. the database could not be reached
+      } LookupResult;
+
       virtual bool isSane() = 0;
 
       // functions for User Records 
@@ -118,6 +125,11 @@ class AbstractDb
       virtual void eraseUser(const Key& key);
       virtual UserRecord getUser(const Key& key) const;
       virtual resip::Data getUserAuthInfo(const Key& key) const;
+      // Like getUserAuthInfo(), but tells an unknown user from a failed
+      // lookup.  The default takes an empty result for an unknown user, as
+      // the record based databases fail hard on errors; a database whose
+      // getUserAuthInfo() returns empty on errors must override this.
+      virtual LookupResult lookupUserAuthInfo(const Key& key, resip::Data& a1) const;
       virtual Key firstUserKey();// return empty if no more
       virtual Key nextUserKey(); // return empty if no more 
 
@@ -4,12 +4,8 @@
 
 #include <iostream>
 
-// JSON library includes
-#include "cajun/json/reader.h"
-#include "cajun/json/writer.h"
-#include "cajun/json/elements.h"
-
 #include "repro/AccountingCollector.hxx"
+#include "repro/JsonStreamWriter.hxx"
 #include "repro/RequestContext.hxx"
 #include "repro/ProxyConfig.hxx"
 #include "repro/PersistentMessageQueue.hxx"
@@ -17,6 +13,7 @@
 #include "resip/stack/Helper.hxx"
 #include "resip/stack/SipMessage.hxx"
 #include "rutil/Logger.hxx"
+#include "rutil/Timer.hxx"
 
 #include "rutil/WinLeakCheck.hxx"
 
@@ -24,7 +21,6 @@
 
 using namespace resip;
 using namespace repro;
-using namespace json;
 using namespace std;
 
 const static Data sessionEventQueueName = "sessioneventqueue";
@@ -39,6 +35,17 @@ AccountingCollector::AccountingCollector(ProxyConfig& config) :
    mRegistrationAccountingAddRoutingHeaders(config.getConfigBool("RegistrationAccountingAddRoutingHeaders", false)),
    mRegistrationAccountingAddViaHeaders(config.getConfigBool("RegistrationAccountingAddViaHeaders", false)),
    mRegistrationAccountingLogRefreshes(config.getConfigBool("RegistrationAccountingLogRefreshes", false)),
+   mBatchSize(resipMax(config.getConfigUnsignedLong("AccountingBatchSize", 100), (unsigned long)1)),
+   mBatchWindowMs(config.getConfigUnsignedLong("AccountingBatchWindow", 20)),
+   mStatisticsIntervalSecs(config.getConfigUnsignedLong("AccountingStatisticsInterval", 300)),
+   mEventsWritten(0),
+   mEventsDropped(0),
+   mTransactions(0),
+   mMaxLatencyMs(0),
+   mLatencySumMs(0),
+   mLatencyEvents(0),
+   mIntervalTransactions(0),
+   mLastStatisticsLog(Timer::getTimeMs()),
    mFifo(0, 0)  // not limited by time or size
 {
    if(config.getConfigBool("SessionAccountingEnabled", false))
@@ -87,127 +94,121 @@ AccountingCollector::doRegistrationAccounting(AccountingCollector::RegistrationE
       ErrLog(<< "AccountingCollector::doRegistrationAccounting: missing proper callId header: " << msg);
       return;
    }
-   Object regEvent;
-   regEvent["EventId"] = Number(regevent);
+   JsonStreamWriter regEvent;
+   regEvent.member("EventId", regevent);
    switch(regevent)
    {
    case RegistrationAdded:
-      regEvent["EventName"] = String("Registration Added");
+      regEvent.member("EventName", "Registration Added");
       break;
    case RegistrationRefreshed:
-      regEvent["EventName"] = String("Registration Refreshed");
+      regEvent.member("EventName", "Registration Refreshed");
       break;
    case RegistrationRemoved:
-      regEvent["EventName"] = String("Registration Removed");
+      regEvent.member("EventName", "Registration Removed");
       break;
    case RegistrationRemovedAll:
-      regEvent["EventName"] = String("Registration Removed All");
+      regEvent.member("EventName", "Registration Removed All");
       break;
    }
-   regEvent["Datetime"] = String(Data::from(datetime).c_str());
-   regEvent["CallId"] = String(msg.header(h_CallId).value().c_str());
+   regEvent.member("Datetime", Data::from(datetime));
+   regEvent.member("CallId", msg.header(h_CallId).value());
    if(msg.exists(h_To) && msg.header(h_To).isWellFormed())
    {
+      regEvent.beginObject("User");
       if(!msg.header(h_To).displayName().empty())
       {
-         regEvent["User"]["DisplayName"] = String(msg.header(h_To).displayName().c_str());
+         regEvent.member("DisplayName", msg.header(h_To).displayName());
       }
-      regEvent["User"]["Aor"] = String(Data::from(msg.header(h_To).uri().getAorAsUri(msg.getSource().getType())).c_str());
+      regEvent.member("Aor", Data::from(msg.header(h_To).uri().getAorAsUri(msg.getSource().getType())));
+      regEvent.endObject();
    }
    if(msg.exists(h_From) && msg.header(h_From).isWellFormed())
    {
       if(msg.header(h_From).uri() != msg.header(h_To).uri()) // Only log from is different from To
       {
+         regEvent.beginObject("From");
          if(!msg.header(h_From).displayName().empty())
          {
-            regEvent["From"]["DisplayName"] = String(msg.header(h_From).displayName().c_str());
+            regEvent.member("DisplayName", msg.header(h_From).displayName());
          }
-         regEvent["From"]["Uri"] = String(Data::from(msg.header(h_From).uri()).c_str());
+         regEvent.member("Uri", Data::from(msg.header(h_From).uri()));
+         regEvent.endObject();
       }
    }
    if(msg.exists(h_Contacts) && !msg.header(h_Contacts).empty())
    {
-      Array arrayContacts;
+      regEvent.beginArray("Contacts");
       NameAddrs::const_iterator contactIt = msg.header(h_Contacts).begin();
       for(; contactIt != msg.header(h_Contacts).end(); contactIt++)
       {
          if(contactIt->isWellFormed())
          {
-            arrayContacts.Insert(String(Data::from(*contactIt).c_str()));
+            regEvent.element(Data::from(*contactIt));
          }
       }
-      if(!arrayContacts.Empty())
-      {
-         regEvent["Contacts"] = arrayContacts;
-      }
+      regEvent.endArray();
    }
    if(msg.exists(h_Expires) && msg.header(h_Expires).isWellFormed())
    {
-      regEvent["Expires"] = Number(msg.header(h_Expires).value());
+      regEvent.member("Expires", msg.header(h_Expires).value());
    }
    if(mRegistrationAccountingAddViaHeaders &&
       msg.exists(h_Vias) && !msg.header(h_Vias).empty())
    {
-      Array arrayVias;
+      regEvent.beginArray("Vias");
       Vias::const_iterator viaIt = msg.header(h_Vias).begin();
       for(; viaIt != msg.header(h_Vias).end(); viaIt++)
       {
          if(viaIt->isWellFormed())
          {
-            arrayVias.Insert(String(Data::from(*viaIt).c_str()));
+            regEvent.element(Data::from(*viaIt));
          }
       }
-      if(!arrayVias.Empty())
-      {
-         regEvent["Vias"] = arrayVias;
-      }
+      regEvent.endArray();
    }
    Tuple publicAddress = Helper::getClientPublicAddress(msg);
    if(publicAddress.getType() != UNKNOWN_TRANSPORT)
    {
-      regEvent["ClientPublicAddress"]["Transport"] = String(Tuple::toData(publicAddress.getType()).c_str());
-      regEvent["ClientPublicAddress"]["IP"] = String(Tuple::inet_ntop(publicAddress).c_str());
-      regEvent["ClientPublicAddress"]["Port"] = Number(publicAddress.getPort());
+      regEvent.beginObject("ClientPublicAddress");
+      regEvent.member("Transport", Tuple::toData(publicAddress.getType()));
+      regEvent.member("IP", Tuple::inet_ntop(publicAddress));
+      regEvent.member("Port", publicAddress.getPort());
+      regEvent.endObject();
    }
    if(mRegistrationAccountingAddRoutingHeaders &&
       msg.exists(h_Routes) && !msg.header(h_Routes).empty())
    {
-      Array arrayRoutes;
+      regEvent.beginArray("Routes");
       NameAddrs::const_iterator routeIt = msg.header(h_Routes).begin();
       for(; routeIt != msg.header(h_Routes).end(); routeIt++)
       {
          if(routeIt->isWellFormed())
          {
-            arrayRoutes.Insert(String(Data::from(*routeIt).c_str()));
+            regEvent.element(Data::from(*routeIt));
          }
       }
-      if(!arrayRoutes.Empty())
-      {
-         regEvent["Routes"] = arrayRoutes;
-      }
+      regEvent.endArray();
    }
    if(mRegistrationAccountingAddRoutingHeaders &&
       msg.exists(h_Paths) && !msg.header(h_Paths).empty())
    {
-      Array arrayPaths;
+      regEvent.beginArray("Paths");
       NameAddrs::const_iterator pathIt = msg.header(h_Paths).begin();
       for(; pathIt != msg.header(h_Paths).end(); pathIt++)
       {
          if(pathIt->isWellFormed())
          {
-            arrayPaths.Insert(String(Data::from(*pathIt).c_str()));
+            regEvent.element(Data::from(*pathIt));
          }
       }
-      if(!arrayPaths.Empty())
-      {
-         regEvent["Paths"] = arrayPaths;
-      }
+      regEvent.endArray();
    }
    if(msg.exists(h_UserAgent) && msg.header(h_UserAgent).isWellFormed())
    {
-      regEvent["UserAgent"] = String(msg.header(h_UserAgent).value().c_str());
+      regEvent.member("UserAgent", msg.header(h_UserAgent).value());
    }
-   pushEventObjectToQueue(regEvent, RegistrationEventType);
+   pushEventToQueue(regEvent.finish(), RegistrationEventType);
 }
 
 void
@@ -228,96 +229,93 @@ AccountingCollector::doSessionAccounting(const resip::SipMessage& msg, bool rece
                ErrLog(<< "AccountingCollector::doSessionAccounting: missing proper callId header: " << msg);
                return;
             }
-            Object sessionEvent;
-            sessionEvent["EventId"] = Number(SessionCreated);
-            sessionEvent["EventName"] = String("Session Created");
-            sessionEvent["Datetime"] = String(Data::from(datetime).c_str());
-            sessionEvent["CallId"] = String(msg.header(h_CallId).value().c_str());
-            sessionEvent["RequestUri"] = String(Data::from(msg.header(h_RequestLine).uri()).c_str());
+            JsonStreamWriter sessionEvent;
+            sessionEvent.member("EventId", SessionCreated);
+            sessionEvent.member("EventName", "Session Created");
+            sessionEvent.member("Datetime", Data::from(datetime));
+            sessionEvent.member("CallId", msg.header(h_CallId).value());
+            sessionEvent.member("RequestUri", Data::from(msg.header(h_RequestLine).uri()));
             if(msg.exists(h_To) && msg.header(h_To).isWellFormed())
             {
+               sessionEvent.beginObject("To");
                if(!msg.header(h_To).displayName().empty())
                {
-                  sessionEvent["To"]["DisplayName"] = String(msg.header(h_To).displayName().c_str());
+                  sessionEvent.member("DisplayName", msg.header(h_To).displayName());
                }
-               sessionEvent["To"]["Uri"] = String(Data::from(msg.header(h_To).uri()).c_str());
+               sessionEvent.member("Uri", Data::from(msg.header(h_To).uri()));
+               sessionEvent.endObject();
             }
             if(msg.exists(h_From) && msg.header(h_From).isWellFormed())
             {
+               sessionEvent.beginObject("From");
                if(!msg.header(h_From).displayName().empty())
                {
-                  sessionEvent["From"]["DisplayName"] = String(msg.header(h_From).displayName().c_str());
+                  sessionEvent.member("DisplayName", msg.header(h_From).displayName());
                }
-               sessionEvent["From"]["Uri"] = String(Data::from(msg.header(h_From).uri()).c_str());
+               sessionEvent.member("Uri", Data::from(msg.header(h_From).uri()));
+               sessionEvent.endObject();
             }
             if(msg.exists(h_Contacts) && !msg.header(h_Contacts).empty() && msg.header(h_Contacts).front().isWellFormed())
             {
-               sessionEvent["Contact"] = String(Data::from(msg.header(h_Contacts).front()).c_str());
+               sessionEvent.member("Contact", Data::from(msg.header(h_Contacts).front()));
             }
             if(mSessionAccountingAddViaHeaders &&
                msg.exists(h_Vias) && !msg.header(h_Vias).empty())
             {
-               Array arrayVias;
+               sessionEvent.beginArray("Vias");
                Vias::const_iterator viaIt = msg.header(h_Vias).begin();
                for(; viaIt != msg.header(h_Vias).end(); viaIt++)
                {
                   if(viaIt->isWellFormed())
                   {
-                     arrayVias.Insert(String(Data::from(*viaIt).c_str()));
+                     sessionEvent.element(Data::from(*viaIt));
                   }
                }
-               if(!arrayVias.Empty())
-               {
-                  sessionEvent["Vias"] = arrayVias;
-               }
+               sessionEvent.endArray();
             }
             Tuple publicAddress = Helper::getClientPublicAddress(msg);
             if(publicAddress.getType() != UNKNOWN_TRANSPORT)
             {
-               sessionEvent["ClientPublicAddress"]["Transport"] = String(Tuple::toData(publicAddress.getType()).c_str());
-               sessionEvent["ClientPublicAddress"]["IP"] = String(Tuple::inet_ntop(publicAddress).c_str());
-               sessionEvent["ClientPublicAddress"]["Port"] = Number(publicAddress.getPort());
+               sessionEvent.beginObject("ClientPublicAddress");
+               sessionEvent.member("Transport", Tuple::toData(publicAddress.getType()));
+               sessionEvent.member("IP", Tuple::inet_ntop(publicAddress));
+               sessionEvent.member("Port", publicAddress.getPort());
+               sessionEvent.endObject();
             }
             if(mSessionAccountingAddRoutingHeaders &&
                msg.exists(h_Routes) && !msg.header(h_Routes).empty())
             {
-               Array arrayRoutes;
+               sessionEvent.beginArray("Routes");
                NameAddrs::const_iterator routeIt = msg.header(h_Routes).begin();
                for(; routeIt != msg.header(h_Routes).end(); routeIt++)
                {
                   if(routeIt->isWellFormed())
                   {
-                     arrayRoutes.Insert(String(Data::from(*routeIt).c_str()));
+                     sessionEvent.element(Data::from(*routeIt));
                   }
                }
-               if(!arrayRoutes.Empty())
-               {
-                  sessionEvent["Routes"] = arrayRoutes;
-               }
+               sessionEvent.endArray();
             }
             if(mSessionAccountingAddRoutingHeaders &&
                msg.exists(h_RecordRoutes) && !msg.header(h_RecordRoutes).empty())
             {
-               Array arrayRecordRoutes;
+               sessionEvent.beginArray("RecordRoutes");
                NameAddrs::const_iterator recordRouteIt = msg.header(h_RecordRoutes).begin();
                for(; recordRouteIt != msg.header(h_RecordRoutes).end(); recordRouteIt++)
                {
                   if(recordRouteIt->isWellFormed())
                   {
-                     arrayRecordRoutes.Insert(String(Data::from(*recordRouteIt).c_str()));
+                     sessionEvent.element(Data::from(*recordRouteIt));
                   }
                }
-               if(!arrayRecordRoutes.Empty())
-               {
-                  sessionEvent["RecordRoutes"] = arrayRecordRoutes;
-               }
+               sessionEvent.endArray();
             }
             if(msg.exists(h_UserAgent) && msg.header(h_UserAgent).isWellFormed())
             {
-               sessionEvent["UserAgent"] = String(msg.header(h_UserAgent).value().c_str());
+               sessionEvent.member("UserAgent", msg.header(h_UserAgent).value());
             }
             context.setSessionCreatedEventSent();
-            pushEventObjectToQueue(sessionEvent, SessionEventType);
+            pushEventToQueue(sessionEvent.finish(), SessionEventType);
          }
          else
          {
@@ -328,30 +326,27 @@ AccountingCollector::doSessionAccounting(const resip::SipMessage& msg, bool rece
                ErrLog(<< "AccountingCollector::doSessionAccounting: missing proper callId header: " << msg);
                return;
             }
-            Object sessionEvent;
-            sessionEvent["EventId"] = Number(SessionRouted);
-            sessionEvent["EventName"] = String("Session Routed");
-            sessionEvent["Datetime"] = String(Data::from(datetime).c_str());
-            sessionEvent["CallId"] = String(msg.header(h_CallId).value().c_str());
-            sessionEvent["TargetUri"] = String(Data::from(msg.header(h_RequestLine).uri()).c_str());
+            JsonStreamWriter sessionEvent;
+            sessionEvent.member("EventId", SessionRouted);
+            sessionEvent.member("EventName", "Session Routed");
+            sessionEvent.member("Datetime", Data::from(datetime));
+            sessionEvent.member("CallId", msg.header(h_CallId).value());
+            sessionEvent.member("TargetUri", Data::from(msg.header(h_RequestLine).uri()));
             if(mSessionAccountingAddRoutingHeaders &&
                msg.exists(h_Routes) && !msg.header(h_Routes).empty())
             {
-               Array arrayRoutes;
+               sessionEvent.beginArray("Routes");
                NameAddrs::const_iterator routeIt = msg.header(h_Routes).begin();
                for(; routeIt != msg.header(h_Routes).end(); routeIt++)
                {
                   if(routeIt->isWellFormed())
                   {
-                     arrayRoutes.Insert(String(Data::from(*routeIt).c_str()));
+                     sessionEvent.element(Data::from(*routeIt));
                   }
                }
-               if(!arrayRoutes.Empty())
-               {
-                  sessionEvent["Routes"] = arrayRoutes;
-               }
+               sessionEvent.endArray();
             }
-            pushEventObjectToQueue(sessionEvent, SessionEventType);
+            pushEventToQueue(sessionEvent.finish(), SessionEventType);
          }
       }
       else if(msg.method() == BYE && received)
@@ -363,33 +358,37 @@ AccountingCollector::doSessionAccounting(const resip::SipMessage& msg, bool rece
             ErrLog(<< "AccountingCollector::doSessionAccounting: missing proper callId header: " << msg);
             return;
          }
-         Object sessionEvent;
-         sessionEvent["EventId"] = Number(SessionEnded);
-         sessionEvent["EventName"] = String("Session Ended");
-         sessionEvent["Datetime"] = String(Data::from(datetime).c_str());
-         sessionEvent["CallId"] = String(msg.header(h_CallId).value().c_str());
+         JsonStreamWriter sessionEvent;
+         sessionEvent.member("EventId", SessionEnded);
+         sessionEvent.member("EventName", "Session Ended");
+         sessionEvent.member("Datetime", Data::from(datetime));
+         sessionEvent.member("CallId", msg.header(h_CallId).value());
          if(msg.exists(h_From) && msg.header(h_From).isWellFormed())
          {
+            sessionEvent.beginObject("From");
             if(!msg.header(h_From).displayName().empty())
             {
-               sessionEvent["From"]["DisplayName"] = String(msg.header(h_From).displayName().c_str());
+               sessionEvent.member("DisplayName", msg.header(h_From).displayName());
             }
-            sessionEvent["From"]["Uri"] = String(Data::from(msg.header(h_From).uri()).c_str());
+            sessionEvent.member("Uri", Data::from(msg.header(h_From).uri()));
+            sessionEvent.endObject();
          }
          if(msg.exists(h_Reasons) && !msg.header(h_Reasons).empty() && msg.header(h_Reasons).front().isWellFormed())
          {
             // Just look at first occurance
-            sessionEvent["Reason"]["Value"] = String(msg.header(h_Reasons).front().value().c_str());
+            sessionEvent.beginObject("Reason");
+            sessionEvent.member("Value", msg.header(h_Reasons).front().value());
             if(msg.header(h_Reasons).front().exists(p_cause))
             {
-               sessionEvent["Reason"]["Cause"] = Number(msg.header(h_Reasons).front().param(p_cause));
+               sessionEvent.member("Cause", msg.header(h_Reasons).front().param(p_cause));
             }
             if(msg.header(h_Reasons).front().exists(p_text) && !msg.header(h_Reasons).front().param(p_text).empty())
             {
-               sessionEvent["Reason"]["Text"] = String(msg.header(h_Reasons).front().param(p_text).c_str());
+               sessionEvent.member("Text", msg.header(h_Reasons).front().param(p_text));
             }
+            sessionEvent.endObject();
          }
-         pushEventObjectToQueue(sessionEvent, SessionEventType);
+         pushEventToQueue(sessionEvent.finish(), SessionEventType);
       }
       else if(msg.method() == CANCEL && received)
       {
@@ -400,25 +399,27 @@ AccountingCollector::doSessionAccounting(const resip::SipMessage& msg, bool rece
             ErrLog(<< "AccountingCollector::doSessionAccounting: missing proper callId header: " << msg);
             return;
          }
-         Object sessionEvent;
-         sessionEvent["EventId"] = Number(SessionCancelled);
-         sessionEvent["EventName"] = String("Session Cancelled");
-         sessionEvent["Datetime"] = String(Data::from(datetime).c_str());
-         sessionEvent["CallId"] = String(msg.header(h_CallId).value().c_str());
+         JsonStreamWriter sessionEvent;
+         sessionEvent.member("EventId", SessionCancelled);
+         sessionEvent.member("EventName", "Session Cancelled");
+         sessionEvent.member("Datetime", Data::from(datetime));
+         sessionEvent.member("CallId", msg.header(h_CallId).value());
          if(msg.exists(h_Reasons) && !msg.header(h_Reasons).empty() && msg.header(h_Reasons).front().isWellFormed())
          {
             // Just look at first occurance
-            sessionEvent["Reason"]["Value"] = String(msg.header(h_Reasons).front().value().c_str());
+            sessionEvent.beginObject("Reason");
+            sessionEvent.member("Value", msg.header(h_Reasons).front().value());
             if(msg.header(h_Reasons).front().exists(p_cause))
             {
-               sessionEvent["Reason"]["Cause"] = Number(msg.header(h_Reasons).front().param(p_cause));
+               sessionEvent.member("Cause", msg.header(h_Reasons).front().param(p_cause));
             }
             if(msg.header(h_Reasons).front().exists(p_text) && !msg.header(h_Reasons).front().param(p_text).empty())
             {
-               sessionEvent["Reason"]["Text"] = String(msg.header(h_Reasons).front().param(p_text).c_str());
+               sessionEvent.member("Text", msg.header(h_Reasons).front().param(p_text));
             }
+            sessionEvent.endObject();
          }
-         pushEventObjectToQueue(sessionEvent, SessionEventType);
+         pushEventToQueue(sessionEvent.finish(), SessionEventType);
       }
       else if(msg.method() == REFER && received && msg.header(h_To).exists(p_tag))
       {
@@ -430,24 +431,26 @@ AccountingCollector::doSessionAccounting(const resip::SipMessage& msg, bool rece
             ErrLog(<< "AccountingCollector::doSessionAccounting: missing proper callId header: " << msg);
             return;
          }
-         Object sessionEvent;
-         sessionEvent["EventId"] = Number(SessionRedirected);
-         sessionEvent["EventName"] = String("Session Redirected");
-         sessionEvent["Datetime"] = String(Data::from(datetime).c_str());
-         sessionEvent["CallId"] = String(msg.header(h_CallId).value().c_str());
+         JsonStreamWriter sessionEvent;
+         sessionEvent.member("EventId", SessionRedirected);
+         sessionEvent.member("EventName", "Session Redirected");
+         sessionEvent.member("Datetime", Data::from(datetime));
+         sessionEvent.member("CallId", msg.header(h_CallId).value());
          if(msg.exists(h_From) && msg.header(h_From).isWellFormed())
          {
+            sessionEvent.beginObject("ReferredBy");
             if(!msg.header(h_From).displayName().empty())
             {
-               sessionEvent["ReferredBy"]["DisplayName"] = String(msg.header(h_From).displayName().c_str());
+               sessionEvent.member("DisplayName", msg.header(h_From).displayName());
             }
-            sessionEvent["ReferredBy"]["Uri"] = String(Data::from(msg.header(h_From).uri()).c_str());
+            sessionEvent.member("Uri", Data::from(msg.header(h_From).uri()));
+            sessionEvent.endObject();
          }
          if(msg.exists(h_ReferTo) && msg.header(h_ReferTo).isWellFormed())
          {
-            sessionEvent["TargetUri"] = String(Data::from(msg.header(h_ReferTo).uri()).c_str());
+            sessionEvent.member("TargetUri", Data::from(msg.header(h_ReferTo).uri()));
          }
-         pushEventObjectToQueue(sessionEvent, SessionEventType);
+         pushEventToQueue(sessionEvent.finish(), SessionEventType);
       }
    }
    // Response
@@ -465,38 +468,35 @@ AccountingCollector::doSessionAccounting(const resip::SipMessage& msg, bool rece
                ErrLog(<< "AccountingCollector::doSessionAccounting: missing proper callId header: " << msg);
                return;
             }
-            Object sessionEvent;
-            sessionEvent["EventId"] = Number(SessionEstablished);
-            sessionEvent["EventName"] = String("Session Established");
-            sessionEvent["Datetime"] = String(Data::from(datetime).c_str());
-            sessionEvent["CallId"] = String(msg.header(h_CallId).value().c_str());
+            JsonStreamWriter sessionEvent;
+            sessionEvent.member("EventId", SessionEstablished);
+            sessionEvent.member("EventName", "Session Established");
+            sessionEvent.member("Datetime", Data::from(datetime));
+            sessionEvent.member("CallId", msg.header(h_CallId).value());
             if(msg.exists(h_Contacts) && !msg.header(h_Contacts).empty() && msg.header(h_Contacts).front().isWellFormed())
             {
-               sessionEvent["Contact"] = String(Data::from(msg.header(h_Contacts).front()).c_str());
+               sessionEvent.member("Contact", Data::from(msg.header(h_Contacts).front()));
             }
             if(mSessionAccountingAddRoutingHeaders &&
                msg.exists(h_RecordRoutes) && !msg.header(h_RecordRoutes).empty())
             {
-               Array arrayRecordRoutes;
+               sessionEvent.beginArray("RecordRoutes");
                NameAddrs::const_iterator recordRouteIt = msg.header(h_RecordRoutes).begin();
                for(; recordRouteIt != msg.header(h_RecordRoutes).end(); recordRouteIt++)
                {
                   if(recordRouteIt->isWellFormed())
                   {
-                     arrayRecordRoutes.Insert(String(Data::from(*recordRouteIt).c_str()));
+                     sessionEvent.element(Data::from(*recordRouteIt));
                   }
                }
-               if(!arrayRecordRoutes.Empty())
-               {
-                  sessionEvent["RecordRoutes"] = arrayRecordRoutes;
-               }
+               sessionEvent.endArray();
             }
             if(msg.exists(h_UserAgent) && msg.header(h_UserAgent).isWellFormed())
             {
-               sessionEvent["UserAgent"] = String(msg.header(h_UserAgent).value().c_str());
+               sessionEvent.member("UserAgent", msg.header(h_UserAgent).value());
             }
             context.setSessionEstablishedEventSent();
-            pushEventObjectToQueue(sessionEvent, SessionEventType);
+            pushEventToQueue(sessionEvent.finish(), SessionEventType);
          }
          else if(msg.header(h_StatusLine).statusCode() >= 300 &&
                  msg.header(h_StatusLine).statusCode() < 400)
@@ -509,38 +509,35 @@ AccountingCollector::doSessionAccounting(const resip::SipMessage& msg, bool rece
                ErrLog(<< "AccountingCollector::doSessionAccounting: missing proper callId header: " << msg);
                return;
             }
-            Object sessionEvent;
-            sessionEvent["EventId"] = Number(SessionRedirected);
-            sessionEvent["EventName"] = String("Session Redirected");
-            sessionEvent["Datetime"] = String(Data::from(datetime).c_str());
-            sessionEvent["CallId"] = String(msg.header(h_CallId).value().c_str());
+            JsonStreamWriter sessionEvent;
+            sessionEvent.member("EventId", SessionRedirected);
+            sessionEvent.member("EventName", "Session Redirected");
+            sessionEvent.member("Datetime", Data::from(datetime));
+            sessionEvent.member("CallId", msg.header(h_CallId).value());
             if(msg.exists(h_Contacts) && !msg.header(h_Contacts).empty())
             {
-               Array arrayContacts;
+               sessionEvent.beginArray("TargetUris");
                NameAddrs::const_iterator contactIt = msg.header(h_Contacts).begin();
                for(; contactIt != msg.header(h_Contacts).end(); contactIt++)
                {
                   if(contactIt->isWellFormed())
                   {
-                     arrayContacts.Insert(String(Data::from(*contactIt).c_str()));
+                     sessionEvent.element(Data::from(*contactIt));
                   }
                }
-               if(!arrayContacts.Empty())
-               {
-                  sessionEvent["TargetUris"] = arrayContacts;
-               }
+               sessionEvent.endArray();
             }
             if(msg.exists(h_UserAgent) && msg.header(h_UserAgent).isWellFormed())
             {
-               sessionEvent["UserAgent"] = String(msg.header(h_UserAgent).value().c_str());
+               sessionEvent.member("UserAgent", msg.header(h_UserAgent).value());
             }
-            pushEventObjectToQueue(sessionEvent, SessionEventType);
+            pushEventToQueue(sessionEvent.finish(), SessionEventType);
          }
          else if(msg.header(h_StatusLine).statusCode() >= 400 &&
                  msg.header(h_StatusLine).statusCode() < 700)
          {
             // Session Error
-            Object sessionEvent;
+            JsonStreamWriter sessionEvent;
             // Session Answered
             DateCategory datetime;
             if(!msg.exists(h_CallId) || !msg.header(h_CallId).isWellFormed())
@@ -548,43 +545,49 @@ AccountingCollector::doSessionAccounting(const resip::SipMessage& msg, bool rece
                ErrLog(<< "AccountingCollector::doSessionAccounting: missing proper callId header: " << msg);
                return;
             }
-            sessionEvent["EventId"] = Number(SessionError);
-            sessionEvent["EventName"] = String("Session Error");
-            sessionEvent["Datetime"] = String(Data::from(datetime).c_str());
-            sessionEvent["CallId"] = String(msg.header(h_CallId).value().c_str());
-            sessionEvent["Status"]["Code"] = Number(msg.header(h_StatusLine).statusCode());
+            sessionEvent.member("EventId", SessionError);
+            sessionEvent.member("EventName", "Session Error");
+            sessionEvent.member("Datetime", Data::from(datetime));
+            sessionEvent.member("CallId", msg.header(h_CallId).value());
+            sessionEvent.beginObject("Status");
+            sessionEvent.member("Code", msg.header(h_StatusLine).statusCode());
             if(!msg.header(h_StatusLine).reason().empty())
             {
-               sessionEvent["Status"]["Text"] = String(msg.header(h_StatusLine).reason().c_str());
+               sessionEvent.member("Text", msg.header(h_StatusLine).reason());
             }
+            sessionEvent.endObject();
             if(msg.exists(h_Warnings) && !msg.header(h_Warnings).empty() && msg.header(h_Warnings).front().isWellFormed())
             {
                // Just look at first occurance
-               sessionEvent["Warning"]["Code"] = Number(msg.header(h_Warnings).front().code());
+               sessionEvent.beginObject("Warning");
+               sessionEvent.member("Code", msg.header(h_Warnings).front().code());
                if(!msg.header(h_Warnings).front().text().empty())
                {
-                  sessionEvent["Warning"]["Text"] = String(msg.header(h_Warnings).front().text().c_str());
+                  sessionEvent.member("Text", msg.header(h_Warnings).front().text());
                }
+               sessionEvent.endObject();
             }
             // Note: a reason header is not usually present on a response - but we will use one if it is
             if(msg.exists(h_Reasons) && !msg.header(h_Reasons).empty() && msg.header(h_Reasons).front().isWellFormed())
             {
                // Just look at first occurance
-               sessionEvent["Reason"]["Value"] = String(msg.header(h_Reasons).front().value().c_str());
+               sessionEvent.beginObject("Reason");
+               sessionEvent.member("Value", msg.header(h_Reasons).front().value());
                if(msg.header(h_Reasons).front().exists(p_cause))
                {
-                  sessionEvent["Reason"]["Cause"] = Number(msg.header(h_Reasons).front().param(p_cause));
+                  sessionEvent.member("Cause", msg.header(h_Reasons).front().param(p_cause));
                }
                if(msg.header(h_Reasons).front().exists(p_text) && !msg.header(h_Reasons).front().param(p_text).empty())
                {
-                  sessionEvent["Reason"]["Text"] = String(msg.header(h_Reasons).front().param(p_text).c_str());
+                  sessionEvent.member("Text", msg.header(h_Reasons).front().param(p_text));
                }
+               sessionEvent.endObject();
             }
             if(msg.exists(h_UserAgent) && msg.header(h_UserAgent).isWellFormed())
             {
-               sessionEvent["UserAgent"] = String(msg.header(h_UserAgent).value().c_str());
+               sessionEvent.member("UserAgent", msg.header(h_UserAgent).value());
             }
-            pushEventObjectToQueue(sessionEvent, SessionEventType);
+            pushEventToQueue(sessionEvent.finish(), SessionEventType);
          }
       }
    }
@@ -635,14 +638,12 @@ AccountingCollector::initializeEventQueue(FifoEventType type, bool destroyFirst)
 }
 
 void 
-AccountingCollector::pushEventObjectToQueue(Object& eventObject, AccountingCollector::FifoEventType type)
+AccountingCollector::pushEventToQueue(Data& json, AccountingCollector::FifoEventType type)
 {
    FifoEvent* eventData = new FifoEvent;
    eventData->mType = type;
-   {
-      DataStream ds(eventData->mData);
-      Writer::Write(eventObject, ds);
-   }
+   eventData->mData.takeBuf(json);
+   eventData->mQueuedAt = Timer::getTimeMs();
 
    // Note:  BerkeleyDb calls can block (ie. deaklock after consumer crash), so we use a 
    //        Fifo and thread to ensure we don't block the core proxy processing
@@ -650,46 +651,90 @@ AccountingCollector::pushEventObjectToQueue(Object& eventObject, AccountingColle
 }
 
 void 
-AccountingCollector::internalProcess(std::unique_ptr<FifoEvent> eventData)
+AccountingCollector::writeBatch(FifoEventType type, Batch& batch)
 {
-   InfoLog(<< "AccountingCollector::internalProcess: JSON=" << endl << eventData->mData);
+   if(batch.mEvents.empty())
+   {
+      return;
+   }
 
-   PersistentMessageEnqueue* queue = initializeEventQueue(eventData->mType);
+   PersistentMessageEnqueue* queue = initializeEventQueue(type);
 
+   bool written = false;
    if(!queue)
    {
-      ErrLog(<< "AccountingCollector: cannot initialize PersistentMessageQueue - dropping event!");
-      return;
+      ErrLog(<< "AccountingCollector: cannot initialize PersistentMessageQueue - dropping " << batch.mEvents.size() << " event(s)!");
    }
-
-   if(!queue->push(eventData->mData))
+   else if(queue->push(batch.mEvents))
+   {
+      written = true;
+   }
+   else
    {
       // Error pushing - see if db recovery is needed
       if(queue->isRecoveryNeeded())
       {
-         if((queue = initializeEventQueue(eventData->mType, true /* destoryFirst */)) == 0)
+         if((queue = initializeEventQueue(type, true /* destoryFirst */)) == 0)
          {
-            ErrLog(<< "AccountingCollector: cannot initialize PersistentMessageQueue - dropping event!");
-            return;
+            ErrLog(<< "AccountingCollector: cannot initialize PersistentMessageQueue - dropping " << batch.mEvents.size() << " event(s)!");
+         }
+         else if(queue->push(batch.mEvents))
+         {
+            written = true;
          }
          else
          {
-            if(!queue->push(eventData->mData))
-            {
-               ErrLog(<< "AccountingCollector: error pushing event to queue - dropping event!");
-            }
+            ErrLog(<< "AccountingCollector: error pushing events to queue - dropping " << batch.mEvents.size() << " event(s)!");
          }
       }
       else
       {
-         ErrLog(<< "AccountingCollector: error pushing event to queue - dropping event!");
+         ErrLog(<< "AccountingCollector: error pushing events to queue - dropping " << batch.mEvents.size() << " event(s)!");
       }
    }
+
+   if(written)
+   {
+      uint64_t now = Timer::getTimeMs();
+      uint64_t count = batch.mEvents.size();
+      mEventsWritten += count;
+      mTransactions++;
+      mIntervalTransactions++;
+      mLatencySumMs += count * now - batch.mQueuedAtSum;
+      mLatencyEvents += count;
+      if(now - batch.mOldestQueuedAt > mMaxLatencyMs)
+      {
+         mMaxLatencyMs = now - batch.mOldestQueuedAt;
+      }
+   }
+   else
+   {
+      mEventsDropped += batch.mEvents.size();
+   }
+   batch = Batch();
+}
+
+void
+AccountingCollector::logStatistics(uint64_t now)
+{
+   if(mIntervalTransactions > 0)
+   {
+      InfoLog(<< "AccountingCollector: " << mLatencyEvents << " event(s) written in " << mIntervalTransactions
+              << " transaction(s) in the last " << (now - mLastStatisticsLog) / 1000 << "s, queue depth=" << mFifo.size()
+              << ", latency avg=" << mLatencySumMs / mLatencyEvents << "ms max=" << mMaxLatencyMs << "ms"
+              << ", total written=" << mEventsWritten << " dropped=" << mEventsDropped);
+   }
+   mLatencySumMs = 0;
+   mLatencyEvents = 0;
+   mIntervalTransactions = 0;
+   mMaxLatencyMs = 0;
+   mLastStatisticsLog = now;
 }
 
 void 
 AccountingCollector::thread()
 {
+   Batch batches[2];  // by FifoEventType
    while (!isShutdown() || !mFifo.empty())  // Ensure we drain the queue before shutting down
    {
       try
@@ -697,7 +742,36 @@ AccountingCollector::thread()
          std::unique_ptr<FifoEvent> eventData(mFifo.getNext(1000));  // Only need to wake up to see if we are shutdown
          if (eventData)
          {
-            internalProcess(std::move(eventData));
+            // Gather what else arrives within the batch window, so that it is
+            // all written to disk in one go
+            uint64_t deadline = Timer::getTimeMs() + mBatchWindowMs;
+            unsigned int gathered = 0;
+            while(eventData)
+            {
+               DebugLog(<< "AccountingCollector::thread: JSON=" << endl << eventData->mData);
+               Batch& batch = batches[eventData->mType];
+               if(batch.mEvents.empty())
+               {
+                  batch.mOldestQueuedAt = eventData->mQueuedAt;
+               }
+               batch.mQueuedAtSum += eventData->mQueuedAt;
+               batch.mEvents.push_back(Data());
+               batch.mEvents.back().takeBuf(eventData->mData);
+               if(++gathered >= mBatchSize)
+               {
+                  break;
+               }
+               uint64_t now = Timer::getTimeMs();
+               int waitMs = (now >= deadline || isShutdown()) ? -1 /* don't wait */ : (int)(deadline - now);
+               eventData.reset(mFifo.getNext(waitMs));
+            }
+            writeBatch(SessionEventType, batches[SessionEventType]);
+            writeBatch(RegistrationEventType, batches[RegistrationEventType]);
+         }
+         uint64_t now = Timer::getTimeMs();
+         if(mStatisticsIntervalSecs != 0 && now - mLastStatisticsLog >= mStatisticsIntervalSecs * 1000)
+         {
+            logStatistics(now);
          }
       }
       catch (BaseException& e)
@@ -1,16 +1,13 @@
 #if !defined(RESIP_ACCOUNTINGCOLLECTOR_HXX)
 #define RESIP_ACCOUNTINGCOLLECTOR_HXX 
 
+#include <atomic>
 #include <memory>
+#include <vector>
 #include "rutil/ThreadIf.hxx"
 #include "rutil/TimeLimitFifo.hxx"
 #include "resip/stack/SipMessage.hxx"
 
-namespace json
-{
-   class Object;
-}
-
 namespace repro
 {
 class RequestContext;
@@ -45,6 +42,16 @@ public:
    virtual void doSessionAccounting(const resip::SipMessage& sip, bool received, RequestContext& context);
    virtual void doRegistrationAccounting(RegistrationEvent regevent, const resip::SipMessage& sip);
 
+   // Events are written to the queues in batches of up to
+   // AccountingBatchSize, each in one BerkeleyDb transaction.  Once an
+   // event arrives, up to AccountingBatchWindow ms is spent gathering others
+   // to go with it.
+   unsigned int getQueueDepth() const { return mFifo.size(); }  // events not written yet
+   uint64_t getEventsWritten() const { return mEventsWritten; }
+   uint64_t getEventsDropped() const { return mEventsDropped; }
+   uint64_t getTransactions() const { return mTransactions; }
+   uint64_t getMaxLatencyMs() const { return mMaxLatencyMs; }  // from an event being collected to it being written, since the last statistics log
+
 private:
    resip::Data mDbBaseDir;
    PersistentMessageEnqueue* mSessionEventQueue;
@@ -54,6 +61,18 @@ private:
    bool mRegistrationAccountingAddRoutingHeaders;
    bool mRegistrationAccountingAddViaHeaders;
    bool mRegistrationAccountingLogRefreshes;
+   unsigned int mBatchSize;
+   unsigned int mBatchWindowMs;
+   unsigned int mStatisticsIntervalSecs;
+
+   std::atomic<uint64_t> mEventsWritten;
+   std::atomic<uint64_t> mEventsDropped;
+   std::atomic<uint64_t> mTransactions;
+   std::atomic<uint64_t> mMaxLatencyMs;
+   uint64_t mLatencySumMs;  // since the last statistics log, like the rest below
+   uint64_t mLatencyEvents;
+   uint64_t mIntervalTransactions;
+   uint64_t mLastStatisticsLog;
 
    virtual void thread();
 
@@ -67,11 +86,21 @@ private:
    public:
       FifoEventType mType;
       resip::Data mData;
+      uint64_t mQueuedAt;  // ms
+   };
+   class Batch
+   {
+   public:
+      Batch() : mQueuedAtSum(0), mOldestQueuedAt(0) {}
+      std::vector<resip::Data> mEvents;
+      uint64_t mQueuedAtSum;
+      uint64_t mOldestQueuedAt;
    };
    resip::TimeLimitFifo<FifoEvent> mFifo;
    PersistentMessageEnqueue* initializeEventQueue(FifoEventType type, bool destroyFirst=false);
-   void pushEventObjectToQueue(json::Object& object, FifoEventType type);
-   void internalProcess(std::unique_ptr<FifoEvent> eventData);
+   void pushEventToQueue(resip::Data& json, FifoEventType type);
+   void writeBatch(FifoEventType type, Batch& batch);
+   void logStatistics(uint64_t now);
 };
 
 }
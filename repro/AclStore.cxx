@@ -3,6 +3,8 @@
   #include "config.h"
 #endif
 
+#include <algorithm>
+
 #include "rutil/Socket.hxx"
 #include "rutil/Logger.hxx"
 #include "rutil/ParseBuffer.hxx"
@@ -52,6 +54,7 @@ AclStore::AclStore(AbstractDb& db):
    } 
    mTlsPeerNameCursor = mTlsPeerNameList.begin();
    mAddressCursor = mAddressList.begin();
+   rebuildAddressIndex();
 }
 
 AclStore::~AclStore()
@@ -114,6 +117,7 @@ AclStore::addAcl(const resip::Data& tlsPeerName,
          WriteLock lock(mMutex);
          mAddressList.push_back(addressRecord);
          mAddressCursor = mAddressList.begin();  // Put cursor back at start
+         rebuildAddressIndex();
       }
    }
    else
@@ -311,6 +315,7 @@ AclStore::eraseAcl(const resip::Data& key)
       if(findAddressKey(key))
       {
          mAddressCursor = mAddressList.erase(mAddressCursor);
+         rebuildAddressIndex();
       }
    }
    else
@@ -515,15 +520,115 @@ AclStore::isTlsPeerNameTrusted(const std::list<Data>& tlsPeerNames)
 bool 
 AclStore::isAddressTrusted(const Tuple& address)
 {
-   ReadLock lock(mMutex);
-   for(AddressList::iterator i = mAddressList.begin(); i != mAddressList.end(); i++)
+   std::shared_ptr<const AddressIndex> index = std::atomic_load(&mAddressIndex);
+   return index->isTrusted(address);
+}
+
+
+void
+AclStore::rebuildAddressIndex()
+{
+   std::shared_ptr<const AddressIndex> index = std::make_shared<AddressIndex>(mAddressList);
+   std::atomic_store(&mAddressIndex, index);
+}
+
+// Points address at the IP address of tuple, in network byte order, and
+// returns its length in bits - 0 if it is neither IPv4 nor IPv6
+static int
+addressBits(const Tuple& tuple, const unsigned char*& address)
+{
+   const sockaddr& sa = tuple.getSockaddr();
+   if(sa.sa_family == AF_INET)
    {
-      if(i->mAddressTuple.isEqualWithMask(address, i->mMask, i->mAddressTuple.getPort() == 0))
+      address = (const unsigned char*)&((const sockaddr_in&)sa).sin_addr;
+      return 32;
+   }
+#ifdef USE_IPV6
+   if(sa.sa_family == AF_INET6)
+   {
+      address = (const unsigned char*)&((const sockaddr_in6&)sa).sin6_addr;
+      return 128;
+   }
+#endif
+   return 0;
+}
+
+static inline int
+bitAt(const unsigned char* address, int i)
+{
+   return (address[i >> 3] >> (7 - (i & 7))) & 1;
+}
+
+AclStore::AddressIndex::AddressIndex(const AddressList& addresses) :
+   mV4(1),
+   mV6(1)
+{
+   for(AddressList::const_iterator it = addresses.begin(); it != addresses.end(); it++)
+   {
+      const unsigned char* address = 0;
+      int bits = addressBits(it->mAddressTuple, address);
+      if(bits == 0)
       {
-         return true;
+         continue;
       }
+      Entry entry = { it->mAddressTuple.getPort(), it->mAddressTuple.getType() };
+      add(bits == 32 ? mV4 : mV6, address, std::max(0, std::min((int)it->mMask, bits)), entry);
    }
-   return false;
+}
+
+void
+AclStore::AddressIndex::add(std::vector<Node>& nodes, const unsigned char* address, int bits, const Entry& entry)
+{
+   unsigned int node = 0;
+   for(int i = 0; i < bits; i++)
+   {
+      int bit = bitAt(address, i);
+      if(nodes[node].mChildren[bit] == 0)
+      {
+         nodes[node].mChildren[bit] = (unsigned int)nodes.size();
+         nodes.push_back(Node());
+      }
+      node = nodes[node].mChildren[bit];
+   }
+   nodes[node].mEntries.push_back(entry);
+}
+
+bool
+AclStore::AddressIndex::find(const std::vector<Node>& nodes, const unsigned char* address, int bits, int port, TransportType type)
+{
+   unsigned int node = 0;
+   for(int i = 0; ; i++)
+   {
+      const std::vector<Entry>& entries = nodes[node].mEntries;
+      for(std::vector<Entry>::const_iterator it = entries.begin(); it != entries.end(); it++)
+      {
+         if(it->mType == type && (it->mPort == 0 || it->mPort == port))
+         {
+            return true;
+         }
+      }
+      if(i == bits)
+      {
+         return false;
+      }
+      node = nodes[node].mChildren[bitAt(address, i)];
+      if(node == 0)
+      {
+         return false;
+      }
+   }
+}
+
+bool
+AclStore::AddressIndex::isTrusted(const Tuple& address) const
+{
+   const unsigned char* bytes = 0;
+   int bits = addressBits(address, bytes);
+   if(bits == 0)
+   {
+      return false;
+   }
+   return find(bits == 32 ? mV4 : mV6, bytes, bits, address.getPort(), address.getType());
 }
 
 
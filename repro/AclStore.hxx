@@ -2,6 +2,8 @@
 #define REPRO_ACLSTORE_HXX
 
 #include <list>
+#include <memory>
+#include <vector>
 #include "rutil/Data.hxx"
 #include "rutil/RWMutex.hxx"
 #include "resip/stack/SipMessage.hxx"
@@ -83,11 +85,45 @@ class AclStore
       bool findTlsPeerNameKey(const Key& key); // move cursor to key
       bool findAddressKey(const Key& key); // move cursor to key
 
+      // Binary trie over the address bits of the address ACLs, one per
+      // address family.  A lookup takes one step per bit of the address,
+      // checking port and transport of the ACLs whose prefix ends there.
+      class AddressIndex
+      {
+         public:
+            AddressIndex(const AddressList& addresses);
+            bool isTrusted(const resip::Tuple& address) const;
+
+         private:
+            class Entry
+            {
+               public:
+                  int mPort;  // 0 matches any port
+                  resip::TransportType mType;
+            };
+            class Node
+            {
+               public:
+                  Node() { mChildren[0] = mChildren[1] = 0; }
+                  unsigned int mChildren[2];  // 0 is none, the root is never a child
+                  std::vector<Entry> mEntries;
+            };
+            static void add(std::vector<Node>& nodes, const unsigned char* address, int bits, const Entry& entry);
+            static bool find(const std::vector<Node>& nodes, const unsigned char* address, int bits, int port, resip::TransportType type);
+
+            std::vector<Node> mV4;
+            std::vector<Node> mV6;
+      };
+      // Replaced as a whole whenever mAddressList changes, so readers only
+      // need to take a reference and never wait for mMutex
+      void rebuildAddressIndex();
+
       resip::RWMutex mMutex;
       TlsPeerNameList mTlsPeerNameList;
       TlsPeerNameList::iterator mTlsPeerNameCursor;
       AddressList mAddressList;
       AddressList::iterator mAddressCursor;
+      std::shared_ptr<const AddressIndex> mAddressIndex;
 };
 
 }
@@ -112,6 +112,14 @@ CommandServer::handleRequest(unsigned int connectionId, unsigned int requestId,
       {
          handleGetDnsCacheRequest(connectionId, requestId, xml);
       }
+      else if(isEqualNoCase(xml.getTag(), "GetUserAuthCacheStats"))
+      {
+         handleGetUserAuthCacheStatsRequest(connectionId, requestId, xml);
+      }
+      else if(isEqualNoCase(xml.getTag(), "ClearUserAuthCache"))
+      {
+         handleClearUserAuthCacheRequest(connectionId, requestId, xml);
+      }
       else if(isEqualNoCase(xml.getTag(), "GetCongestionStats"))
       {
          handleGetCongestionStatsRequest(connectionId, requestId, xml);
@@ -253,6 +261,33 @@ CommandServer::onDnsCacheDumpRetrieved(std::pair<unsigned long, unsigned long> k
    }
 }
 
+void 
+CommandServer::handleGetUserAuthCacheStatsRequest(unsigned int connectionId, unsigned int requestId, XMLCursor& xml)
+{
+   InfoLog(<< "CommandServer::handleGetUserAuthCacheStatsRequest");
+
+   UserStore::AuthCacheStats stats = mReproRunner.getProxy()->getUserStore().getAuthCacheStats();
+   Data buffer;
+   {
+      DataStream strm(buffer);
+      strm << "Entries: " << stats.mEntries << endl
+           << "Hits: " << stats.mHits << endl
+           << "Negative hits: " << stats.mNegativeHits << endl
+           << "Misses: " << stats.mMisses << endl
+           << "Evictions: " << stats.mEvictions << endl;
+   }
+   sendResponse(connectionId, requestId, buffer, 200, "User auth cache stats retrieved.");
+}
+
+void 
+CommandServer::handleClearUserAuthCacheRequest(unsigned int connectionId, unsigned int requestId, XMLCursor& xml)
+{
+   InfoLog(<< "CommandServer::handleClearUserAuthCacheRequest");
+
+   mReproRunner.getProxy()->getUserStore().clearAuthCache();
+   sendResponse(connectionId, requestId, Data::Empty, 200, "User auth cache cleared.");
+}
+
 void 
 CommandServer::handleGetCongestionStatsRequest(unsigned int connectionId, unsigned int requestId, XMLCursor& xml)
 {
@@ -37,42 +37,24 @@ FilterStore::FilterStore(AbstractDb& db):
       FilterOp filter;
       filter.filterRecord =  mDb.getFilter(key);
       filter.key = key;
-      filter.pcond1 = 0;
-      filter.pcond2 = 0;
       
-      std::regex_constants::syntax_option_type flags = DefaultFlags;
-      if(filter.filterRecord.mActionData.find("$") == Data::npos)
-      {
-         flags |= std::regex_constants::nosubs;
-      }
-
       if(!filter.filterRecord.mCondition1Regex.empty())
       {
-         try
+         filter.pcond1 = compileRegex(filter.filterRecord.mCondition1Regex, filter.filterRecord.mActionData);
+         if(!filter.pcond1)
          {
-            filter.pcond1 = new std::regex(filter.filterRecord.mCondition1Regex.c_str(), flags);
-         }
-         catch (std::regex_error& ex)
-         {
-            delete filter.pcond1;
             ErrLog( << "Condition1Regex has invalid match expression: "
                    << filter.filterRecord.mCondition1Regex);
-            filter.pcond1 = 0;
          }
       }
 
       if(!filter.filterRecord.mCondition2Regex.empty())
       {
-         try
+         filter.pcond2 = compileRegex(filter.filterRecord.mCondition2Regex, filter.filterRecord.mActionData);
+         if(!filter.pcond2)
          {
-            filter.pcond2 = new std::regex(filter.filterRecord.mCondition2Regex.c_str(), flags);
-         }
-         catch (std::regex_error& ex)
-         {
-            delete filter.pcond2;
             ErrLog( << "Condition2Regex has invalid match expression: "
                    << filter.filterRecord.mCondition2Regex);
-            filter.pcond2 = 0;
          }
       }
 
@@ -81,22 +63,30 @@ FilterStore::FilterStore(AbstractDb& db):
       key = mDb.nextFilterKey();
    } 
    mCursor = mFilterOperators.begin();
+   rebuildPlan();
 }
 
 FilterStore::~FilterStore()
 {
-   for(FilterOpList::iterator i = mFilterOperators.begin(); i != mFilterOperators.end(); i++)
+   mFilterOperators.clear();
+}
+
+std::shared_ptr<const std::regex>
+FilterStore::compileRegex(const Data& regex, const Data& actionData)
+{
+   std::regex_constants::syntax_option_type flags = DefaultFlags;
+   if(actionData.find("$") == Data::npos)
    {
-      if (i->pcond1)
-      {
-         delete i->pcond1;
-      }
-      if (i->pcond2)
-      {
-         delete i->pcond2;
-      }
+      flags |= std::regex_constants::nosubs;
+   }
+   try
+   {
+      return std::make_shared<const std::regex>(regex.c_str(), flags);
+   }
+   catch (std::regex_error& ex)
+   {
+      return std::shared_ptr<const std::regex>();
    }
-   mFilterOperators.clear();
 }
 
 bool 
@@ -134,41 +124,19 @@ FilterStore::addFilter(const resip::Data& cond1Header,
    }
 
    filter.key = key;
-   filter.pcond1 = 0;
-   filter.pcond2 = 0;
-   std::regex_constants::syntax_option_type flags = DefaultFlags;
-   if(filter.filterRecord.mActionData.find("$") == Data::npos)
-   {
-      flags |= std::regex_constants::nosubs;
-   }
    if(!filter.filterRecord.mCondition1Regex.empty())
    {
-      try
-      {
-         filter.pcond1 = new std::regex(filter.filterRecord.mCondition1Regex.c_str(), flags);
-      }
-      catch (std::regex_error& ex)
-      {
-         delete filter.pcond1;
-         filter.pcond1 = 0;
-      }
+      filter.pcond1 = compileRegex(filter.filterRecord.mCondition1Regex, filter.filterRecord.mActionData);
    }
    if(!filter.filterRecord.mCondition2Regex.empty())
    {
-      try
-      {
-         filter.pcond2 = new std::regex(filter.filterRecord.mCondition2Regex.c_str(), flags);
-      }
-      catch (std::regex_error& ex)
-      {
-         delete filter.pcond2;
-         filter.pcond2 = 0;
-      }
+      filter.pcond2 = compileRegex(filter.filterRecord.mCondition2Regex, filter.filterRecord.mActionData);
    }
 
    {
       WriteLock lock(mMutex);
       mFilterOperators.insert( filter );
+      rebuildPlan();
    }
    mCursor = mFilterOperators.begin(); 
 
@@ -218,14 +186,6 @@ FilterStore::eraseFilter(const resip::Data& key)
          {
             FilterOpList::iterator i = it;
             it++;
-            if(i->pcond1)
-            {
-               delete i->pcond1;
-            }
-            if(i->pcond2)
-            {
-               delete i->pcond2;
-            }
             mFilterOperators.erase(i);
          }
          else
@@ -233,6 +193,7 @@ FilterStore::eraseFilter(const resip::Data& key)
             it++;
          }
       }
+      rebuildPlan();
    }
    mCursor = mFilterOperators.begin();  // reset the cursor since it may have been on deleted filter
 }
@@ -326,6 +287,12 @@ FilterStore::getFilterRecord(const resip::Data& key)
 
 void
 FilterStore::getHeaderFromSipMessage(const SipMessage& msg, const Data& headerName, list<Data>& headerList)
+{
+   getHeaderFromSipMessage(msg, headerName, Headers::getType(headerName.c_str(), headerName.size()), headerList);
+}
+
+void
+FilterStore::getHeaderFromSipMessage(const SipMessage& msg, const Data& headerName, Headers::Type headerType, list<Data>& headerList)
 {
    // First see if header string is "request-line"
    if(isEqualNoCase(headerName, "request-line"))
@@ -335,15 +302,17 @@ FilterStore::getHeaderFromSipMessage(const SipMessage& msg, const Data& headerNa
    }
   
    // Next check to see if it is a standard header
-   Headers::Type headerType = Headers::getType(headerName.c_str(), headerName.size());
    if(headerType != Headers::UNKNOWN)
    {
       Data headerData;
       const HeaderFieldValueList* hfv = msg.getRawHeader(headerType);
-      for(HeaderFieldValueList::const_iterator it = hfv->begin(); it != hfv->end(); it++)
+      if(hfv)  // null if the request does not have the header
       {
-         it->toShareData(headerData);
-         headerList.push_back(headerData);
+         for(HeaderFieldValueList::const_iterator it = hfv->begin(); it != hfv->end(); it++)
+         {
+            it->toShareData(headerData);
+            headerList.push_back(headerData);
+         }
       }
    }
    else // Check if custom header
@@ -361,7 +330,7 @@ FilterStore::getHeaderFromSipMessage(const SipMessage& msg, const Data& headerNa
 }
 
 bool 
-FilterStore::applyRegex(int conditionNum, const Data& header, const Data& match, std::regex *_regex, Data& rewrite)
+FilterStore::applyRegex(int conditionNum, const Data& header, const Data& match, const std::regex& _regex, Data& rewrite)
 {
    resip_assert(conditionNum < 10);
    
@@ -369,7 +338,7 @@ FilterStore::applyRegex(int conditionNum, const Data& header, const Data& match,
 
    // Note:  Using regex_search instead of regex_match, so that we don't need to fully match 
    //        the string, this is backwards compatible with the previous regexec PCRE implementation
-   if(!std::regex_search(header.c_str(), matches, *_regex))
+   if(!std::regex_search(header.c_str(), matches, _regex))
    {
       // did not match 
       return false;
@@ -418,82 +387,10 @@ FilterStore::process(const SipMessage& request,
                      short& action,
                      Data& actionData)
 {
-   if(mFilterOperators.empty()) return false;  // If there are no filters bail early to save a few cycles (size check is atomic enough, we don't need a lock)
-
-   ReadLock lock(mMutex);
-
-   Data method(request.methodStr());
-   Data event(request.exists(h_Event) ? request.header(h_Event).value() : Data::Empty);
-
-   for (FilterOpList::iterator it = mFilterOperators.begin();
-        it != mFilterOperators.end(); it++)
-   {
-      const AbstractDb::FilterRecord& rec = it->filterRecord;
-
-      if(!rec.mMethod.empty())
-      {
-         if(!isEqualNoCase(rec.mMethod, method))
-         {
-            DebugLog( << "  Skipped - method did not match" );
-            continue;
-         }
-      }
-      if(!rec.mEvent.empty())
-      {
-         if(!isEqualNoCase(rec.mEvent,event)) 
-         {
-            DebugLog( << "  Skipped - event did not match" );
-            continue;
-         }
-      }
-
-      // Get requests SIP headers from SipMessage
-      list<Data> condition1Headers;
-      list<Data> condition2Headers;
-      actionData = rec.mActionData;
-      if(!rec.mCondition1Header.empty() && it->pcond1)
-      {
-         getHeaderFromSipMessage(request, rec.mCondition1Header, condition1Headers);
-
-         // Check condition 1 regex
-         list<Data>::iterator hit = condition1Headers.begin();
-         bool match = false;
-         for(; hit != condition1Headers.end() && match == false; hit++)
-         {
-            match = applyRegex(1, *hit, rec.mCondition1Regex, it->pcond1, actionData);
-            DebugLog( << "  Cond1 HeaderName=" << rec.mCondition1Header << ", Value=" << *hit << ", Regex=" << rec.mCondition1Regex << ", match=" << match);
-         }
-         if(!match)
-         {
-            DebugLog( << "  Skipped - request did not match first condition: " << request.brief());
-            continue;
-         }
-      }
-      if(!rec.mCondition2Header.empty() && it->pcond2)
-      {
-         getHeaderFromSipMessage(request, rec.mCondition2Header, condition2Headers);
-
-         // Check condition 2 regex
-         list<Data>::iterator hit = condition2Headers.begin();
-         bool match = false;
-         for(; hit != condition2Headers.end() && match == false; hit++)
-         {
-            match = applyRegex(2, *hit, rec.mCondition2Regex, it->pcond2, actionData);
-            DebugLog( << "  Cond2 HeaderName=" << rec.mCondition2Header << ", Value=" << *hit << ", Regex=" << rec.mCondition2Regex << ", match=" << match);
-         }
-         if(!match)
-         {
-            DebugLog( << "  Skipped - request did not match second condition: " << request.brief());
-            continue;
-         }
-      }
-      // If we make it here Method, Event and both conditions matched - return configured action
-      action = rec.mAction;
-      return true;
-   }
+   std::shared_ptr<const FilterPlan> plan = std::atomic_load(&mPlan);
+   if(plan->empty()) return false;  // If there are no filters bail early to save a few cycles
 
-   // If we make it here, then none of the conditions matched - return false
-   return false;
+   return plan->process(request, action, actionData);
 }
 
 bool 
@@ -513,7 +410,7 @@ FilterStore::test(const resip::Data& cond1Header,
       // Check condition 1 regex
       if(!rec.mCondition1Header.empty() && it->pcond1)
       {
-         if(!applyRegex(1, cond1Header, rec.mCondition1Regex, it->pcond1, actionData))
+         if(!applyRegex(1, cond1Header, rec.mCondition1Regex, *it->pcond1, actionData))
          {
             continue;
          }
@@ -522,7 +419,7 @@ FilterStore::test(const resip::Data& cond1Header,
       // Check condition 2 regex
       if(!rec.mCondition2Header.empty() && it->pcond2)
       {
-         if(!applyRegex(2, cond2Header, rec.mCondition2Regex, it->pcond2, actionData))
+         if(!applyRegex(2, cond2Header, rec.mCondition2Regex, *it->pcond2, actionData))
          {
             continue;
          }
@@ -551,6 +448,163 @@ FilterStore::buildKey(const resip::Data& cond1Header,
    return pKey;
 }
 
+void
+FilterStore::rebuildPlan()
+{
+   std::shared_ptr<const FilterPlan> plan = std::make_shared<FilterPlan>(mFilterOperators);
+   std::atomic_store(&mPlan, plan);
+}
+
+FilterStore::FilterPlan::FilterPlan(const FilterOpList& filters) :
+   mStepsByMethod(MAX_METHODS)
+{
+   mSteps.reserve(filters.size());
+   for(FilterOpList::const_iterator it = filters.begin(); it != filters.end(); it++)
+   {
+      const AbstractDb::FilterRecord& rec = it->filterRecord;
+      Step step;
+      step.mMethod = rec.mMethod;
+      step.mEvent = rec.mEvent;
+      // a condition without a header, or whose regex did not compile, is
+      // left out, as it always has been
+      if(!rec.mCondition1Header.empty() && it->pcond1)
+      {
+         step.mConditions[0].mSlot = addSlot(rec.mCondition1Header);
+         step.mConditions[0].mRegexText = rec.mCondition1Regex;
+         step.mConditions[0].mRegex = it->pcond1;
+      }
+      if(!rec.mCondition2Header.empty() && it->pcond2)
+      {
+         step.mConditions[1].mSlot = addSlot(rec.mCondition2Header);
+         step.mConditions[1].mRegexText = rec.mCondition2Regex;
+         step.mConditions[1].mRegex = it->pcond2;
+      }
+      step.mAction = rec.mAction;
+      step.mActionData = rec.mActionData;
+
+      unsigned int index = (unsigned int)mSteps.size();
+      mSteps.push_back(step);
+      if(step.mMethod.empty())
+      {
+         for(int method = 0; method < MAX_METHODS; method++)
+         {
+            mStepsByMethod[method].push_back(index);
+         }
+      }
+      else
+      {
+         // methods are compared without regard to case
+         Data method(step.mMethod);
+         method.uppercase();
+         MethodTypes type = getMethodType(method);
+         if(type != UNKNOWN)
+         {
+            mStepsByMethod[type].push_back(index);
+         }
+      }
+   }
+}
+
+int
+FilterStore::FilterPlan::addSlot(const Data& headerName)
+{
+   for(unsigned int i = 0; i < mSlots.size(); i++)
+   {
+      if(isEqualNoCase(mSlots[i].mName, headerName))
+      {
+         return (int)i;
+      }
+   }
+   HeaderSlot slot;
+   slot.mName = headerName;
+   slot.mType = Headers::getType(headerName.c_str(), headerName.size());
+   mSlots.push_back(slot);
+   return (int)mSlots.size() - 1;
+}
+
+bool
+FilterStore::FilterPlan::process(const SipMessage& request, short& action, Data& actionData) const
+{
+   std::vector<std::list<Data> > headers(mSlots.size());
+   std::vector<bool> extracted(mSlots.size(), false);
+   Data event(request.exists(h_Event) ? request.header(h_Event).value() : Data::Empty);
+
+   MethodTypes method = request.method();
+   if(method != UNKNOWN)
+   {
+      const std::vector<unsigned int>& steps = mStepsByMethod[method];
+      for(std::vector<unsigned int>::const_iterator it = steps.begin(); it != steps.end(); it++)
+      {
+         const Step& step = mSteps[*it];
+         if(!step.mEvent.empty() && !isEqualNoCase(step.mEvent, event))
+         {
+            continue;
+         }
+         if(matches(step, request, headers, extracted, actionData))
+         {
+            action = step.mAction;
+            return true;
+         }
+      }
+   }
+   else
+   {
+      // an extension method, only filters naming it (or no method) apply
+      Data methodStr(request.methodStr());
+      for(std::vector<Step>::const_iterator it = mSteps.begin(); it != mSteps.end(); it++)
+      {
+         if(!it->mMethod.empty() && !isEqualNoCase(it->mMethod, methodStr))
+         {
+            continue;
+         }
+         if(!it->mEvent.empty() && !isEqualNoCase(it->mEvent, event))
+         {
+            continue;
+         }
+         if(matches(*it, request, headers, extracted, actionData))
+         {
+            action = it->mAction;
+            return true;
+         }
+      }
+   }
+
+   // If we make it here, then none of the conditions matched - return false
+   return false;
+}
+
+bool
+FilterStore::FilterPlan::matches(const Step& step, const SipMessage& request, std::vector<std::list<Data> >& headers,
+                                 std::vector<bool>& extracted, Data& actionData) const
+{
+   actionData = step.mActionData;
+   for(int c = 0; c < 2; c++)
+   {
+      const Condition& condition = step.mConditions[c];
+      if(condition.mSlot < 0)
+      {
+         continue;
+      }
+      std::list<Data>& values = headers[condition.mSlot];
+      if(!extracted[condition.mSlot])
+      {
+         const HeaderSlot& slot = mSlots[condition.mSlot];
+         getHeaderFromSipMessage(request, slot.mName, slot.mType, values);
+         extracted[condition.mSlot] = true;
+      }
+      bool match = false;
+      for(std::list<Data>::const_iterator hit = values.begin(); hit != values.end() && !match; hit++)
+      {
+         match = applyRegex(c + 1, *hit, condition.mRegexText, *condition.mRegex, actionData);
+      }
+      if(!match)
+      {
+         return false;
+      }
+   }
+   return true;
+}
+
 
 /* ====================================================================
  * The Vovida Software License, Version 1.0 
@@ -1,13 +1,17 @@
 #if !defined(REPRO_FILTERSTORE_HXX)
 #define REPRO_FILTERSTORE_HXX
 
+#include <memory>
 #include <regex>
 
 #include <set>
 #include <list>
+#include <vector>
 
 #include "rutil/Data.hxx"
 #include "rutil/RWMutex.hxx"
+#include "resip/stack/HeaderTypes.hxx"
+#include "resip/stack/MethodTypes.hxx"
 
 #include "repro/AbstractDb.hxx"
 
@@ -87,14 +91,19 @@ class FilterStore
                    const resip::Data& method,
                    const resip::Data& event) const;
 
-      void getHeaderFromSipMessage(const resip::SipMessage& msg, 
-                                   const resip::Data& headerName, 
-                                   std::list<resip::Data>& headerList);
-      bool applyRegex(int conditionNum,
-                      const resip::Data& header, 
-                      const resip::Data& match, 
-                      std::regex *_regex,
-                      resip::Data& rewrite);
+      static void getHeaderFromSipMessage(const resip::SipMessage& msg, 
+                                          const resip::Data& headerName, 
+                                          std::list<resip::Data>& headerList);
+      static void getHeaderFromSipMessage(const resip::SipMessage& msg, 
+                                          const resip::Data& headerName, 
+                                          resip::Headers::Type headerType,
+                                          std::list<resip::Data>& headerList);
+      static bool applyRegex(int conditionNum,
+                             const resip::Data& header, 
+                             const resip::Data& match, 
+                             const std::regex& _regex,
+                             resip::Data& rewrite);
+      static std::shared_ptr<const std::regex> compileRegex(const resip::Data& regex, const resip::Data& actionData);
 
       AbstractDb& mDb;  
 
@@ -102,16 +111,67 @@ class FilterStore
       {
          public:
             Key key;
-            std::regex *pcond1;
-            std::regex *pcond2;
+            // shared with the FilterPlans built from this filter
+            std::shared_ptr<const std::regex> pcond1;
+            std::shared_ptr<const std::regex> pcond2;
             AbstractDb::FilterRecord filterRecord;
             bool operator<(const FilterOp&) const;
       };
-      
-      resip::RWMutex mMutex;
       typedef std::multiset<FilterOp> FilterOpList;
+
+      // The filters compiled for process(): header names are resolved and
+      // each header a request is tested on is pulled out of it at most
+      // once, whichever filters look at it.  Filters are grouped by method
+      // so a request only visits those that can apply to it.
+      class FilterPlan
+      {
+         public:
+            FilterPlan(const FilterOpList& filters);
+            bool empty() const { return mSteps.empty(); }
+            bool process(const resip::SipMessage& request, short& action, resip::Data& actionData) const;
+
+         private:
+            class HeaderSlot
+            {
+               public:
+                  resip::Data mName;
+                  resip::Headers::Type mType;  // UNKNOWN for request-line and extension headers
+            };
+            class Condition
+            {
+               public:
+                  Condition() : mSlot(-1) {}
+                  int mSlot;  // -1 if the filter has no such condition
+                  resip::Data mRegexText;
+                  std::shared_ptr<const std::regex> mRegex;
+            };
+            class Step
+            {
+               public:
+                  resip::Data mMethod;
+                  resip::Data mEvent;
+                  Condition mConditions[2];
+                  short mAction;
+                  resip::Data mActionData;
+            };
+            int addSlot(const resip::Data& headerName);
+            bool matches(const Step& step, const resip::SipMessage& request, std::vector<std::list<resip::Data> >& headers,
+                         std::vector<bool>& extracted, resip::Data& actionData) const;
+
+            std::vector<Step> mSteps;
+            std::vector<HeaderSlot> mSlots;
+            // indexes into mSteps, in order, of the filters that apply to
+            // each known method
+            std::vector<std::vector<unsigned int> > mStepsByMethod;
+      };
+      // Replaced as a whole whenever the filters change, so process() only
+      // needs to take a reference and never waits for mMutex
+      void rebuildPlan();
+
+      resip::RWMutex mMutex;
       FilterOpList mFilterOperators; 
       FilterOpList::iterator mCursor;
+      std::shared_ptr<const FilterPlan> mPlan;
 };
 
  }
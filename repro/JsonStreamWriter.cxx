@@ -0,0 +1,281 @@
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <cstring>
+#include <iomanip>
+#include <string>
+
+#include "repro/JsonStreamWriter.hxx"
+#include "rutil/ResipAssert.h"
+
+#include "rutil/WinLeakCheck.hxx"
+
+using namespace resip;
+using namespace repro;
+
+JsonStreamWriter::JsonStreamWriter() :
+   mJson(512, Data::Preallocate),
+   mStream(mJson)
+{
+   mLevels.push_back(Level(0, false /* isArray */, true /* written */));
+}
+
+JsonStreamWriter::~JsonStreamWriter()
+{
+}
+
+void
+JsonStreamWriter::member(const char* name, const Data& value)
+{
+   beginValue(name);
+   writeString(value.data(), value.size());
+}
+
+void
+JsonStreamWriter::member(const char* name, const char* value)
+{
+   beginValue(name);
+   writeString(value, strlen(value));
+}
+
+void
+JsonStreamWriter::member(const char* name, double value)
+{
+   beginValue(name);
+   mStream << std::dec << std::setprecision(20) << value;
+}
+
+void
+JsonStreamWriter::beginObject(const char* name)
+{
+   resip_assert(!mLevels.back().mIsArray);
+   mLevels.push_back(Level(name, false /* isArray */, false /* written */));
+}
+
+void
+JsonStreamWriter::endObject()
+{
+   resip_assert(mLevels.size() > 1 && !mLevels.back().mIsArray);
+   end();
+}
+
+void
+JsonStreamWriter::beginArray(const char* name)
+{
+   resip_assert(!mLevels.back().mIsArray);
+   mLevels.push_back(Level(name, true /* isArray */, false /* written */));
+}
+
+void
+JsonStreamWriter::element(const Data& value)
+{
+   resip_assert(mLevels.back().mIsArray);
+   beginValue(0);
+   writeString(value.data(), value.size());
+}
+
+void
+JsonStreamWriter::endArray()
+{
+   resip_assert(mLevels.size() > 1 && mLevels.back().mIsArray);
+   end();
+}
+
+Data&
+JsonStreamWriter::finish()
+{
+   while(!mLevels.empty())
+   {
+      end();
+   }
+   mStream.flush();
+   return mJson;
+}
+
+void
+JsonStreamWriter::beginValue(const char* name)
+{
+   size_t top = mLevels.size() - 1;
+   writeLevel(top);
+   writeSeparator(top);
+   if(name)
+   {
+      writeString(name, strlen(name));
+      mStream << " : ";
+   }
+}
+
+void
+JsonStreamWriter::writeLevel(size_t index)
+{
+   // Write out the names of the objects and arrays this value goes in, if
+   // this is the first thing in them
+   Level& level = mLevels[index];
+   if(!level.mWritten)
+   {
+      writeLevel(index - 1);
+      writeSeparator(index - 1);
+      writeString(level.mName, strlen(level.mName));
+      mStream << " : ";
+      level.mWritten = true;
+   }
+}
+
+void
+JsonStreamWriter::writeSeparator(size_t index)
+{
+   Level& level = mLevels[index];
+   if(level.mCount++ == 0)
+   {
+      mStream << (level.mIsArray ? '[' : '{') << '\n';
+   }
+   else
+   {
+      mStream << ",\n";
+   }
+   mStream << std::string(index + 1, '\t');
+}
+
+void
+JsonStreamWriter::end()
+{
+   Level level = mLevels.back();
+   mLevels.pop_back();
+   if(!level.mWritten)
+   {
+      return;
+   }
+   if(level.mCount == 0)
+   {
+      mStream << (level.mIsArray ? "[]" : "{}");
+   }
+   else
+   {
+      mStream << '\n' << std::string(mLevels.size(), '\t') << (level.mIsArray ? ']' : '}');
+   }
+}
+
+void
+JsonStreamWriter::writeString(const char* data, size_t size)
+{
+   // Same escaping as json::Writer, including its handling of UTF-8
+   mStream << '"';
+   const char* it = data;
+   const char* itEnd = data + size;
+   for (; it != itEnd; ++it)
+   {
+      unsigned char u = static_cast<unsigned char>(*it);
+      if (u & 0xc0)
+      {
+         if ((u & 0xe0) == 0xc0)
+         {
+            // two-character sequence
+            int x = (*it & 0x1f) << 6;
+            if ((it + 1) == itEnd)
+            {
+               mStream << *it;
+               continue;
+            }
+            u = static_cast<unsigned char>(*(it + 1));
+            if ((u & 0xc0) == 0x80)
+            {
+               x |= u & 0x3f;
+               mStream << "\\u" << std::hex << std::setfill('0') << std::setw(4) << x;
+               ++it;
+               continue;
+            }
+         }
+         else if ((u & 0xf0) == 0xe0)
+         {
+            // three-character sequence
+            int x = (u & 0x0f) << 12;
+            if ((it + 1) == itEnd)
+            {
+               mStream << *it;
+               continue;
+            }
+            u = static_cast<unsigned char>(*(it + 1));
+            if ((u & 0xc0) == 0x80)
+            {
+               x |= (u & 0x3f) << 6;
+               if ((it + 2) == itEnd)
+               {
+                  mStream << *it;
+                  continue;
+               }
+               u = static_cast<unsigned char>(*(it + 2));
+               if ((u & 0xc0) == 0x80)
+               {
+                  x |= u & 0x3f;
+                  mStream << "\\u" << std::hex << std::setfill('0') << std::setw(4) << x;
+                  it = it + 2;
+                  continue;
+               }
+            }
+         }
+      }
+      switch (*it)
+      {
+         case '"':   mStream << "\\\"";  break;
+         case '\\':  mStream << "\\\\";  break;
+         case '\b':  mStream << "\\b";   break;
+         case '\f':  mStream << "\\f";   break;
+         case '\n':  mStream << "\\n";   break;
+         case '\r':  mStream << "\\r";   break;
+         case '\t':  mStream << "\\t";   break;
+         default:    mStream << *it;     break;
+      }
+   }
+   mStream << '"';
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
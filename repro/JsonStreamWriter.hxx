@@ -0,0 +1,125 @@
+#if !defined(RESIP_JSONSTREAMWRITER_HXX)
+#define RESIP_JSONSTREAMWRITER_HXX
+
+#include <vector>
+#include "rutil/Data.hxx"
+#include "rutil/DataStream.hxx"
+
+namespace repro
+{
+
+// Writes a JSON object straight into a Data as it is built, without the
+// cajun DOM in between.  The output is byte for byte what cajun's
+// json::Writer produces for the equivalent json::Object, so consumers of
+// documents written with either see no difference.
+//
+// Nested objects and arrays are only written once something is added to
+// them, so an empty one is left out altogether, as callers building a DOM
+// would do by not creating it:
+//
+// JsonStreamWriter event;
+// event.member("EventId", 1);
+// event.beginObject("To");
+// event.member("Uri", "sip:bob@example.com");
+// event.endObject();
+// event.beginArray("Vias");  // not written, nothing is added to it
+// event.endArray();
+// Data& json = event.finish();
+class JsonStreamWriter
+{
+public:
+   JsonStreamWriter();
+   ~JsonStreamWriter();
+
+   void member(const char* name, const resip::Data& value);
+   void member(const char* name, const char* value);
+   void member(const char* name, double value);
+   void member(const char* name, int value) { member(name, (double)value); }
+   void member(const char* name, unsigned int value) { member(name, (double)value); }
+
+   void beginObject(const char* name);
+   void endObject();
+
+   void beginArray(const char* name);
+   void element(const resip::Data& value);
+   void endArray();
+
+   // closes the top level object and returns the document, which the
+   // caller may take the buffer of
+   resip::Data& finish();
+
+private:
+   class Level
+   {
+   public:
+      Level(const char* name, bool isArray, bool written) : mName(name), mIsArray(isArray), mWritten(written), mCount(0) {}
+      const char* mName;
+      bool mIsArray;
+      bool mWritten;    // our name, if any, has been written to the parent
+      unsigned int mCount;
+   };
+
+   void beginValue(const char* name);
+   void writeLevel(size_t index);
+   void writeSeparator(size_t index);
+   void writeString(const char* data, size_t size);
+   void end();
+
+   resip::Data mJson;
+   resip::DataStream mStream;
+   std::vector<Level> mLevels;
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -17,6 +17,7 @@
 #include "rutil/DataStream.hxx"
 #include "rutil/Logger.hxx"
 #include "rutil/ParseBuffer.hxx"
+#include "rutil/Timer.hxx"
 
 #include "repro/AbstractDb.hxx"
 #include "repro/MySqlDb.hxx"
@@ -67,6 +68,15 @@ class MySQLInitializer
 };
 static MySQLInitializer g_MySQLInitializer;
 
+MySqlDb::Connection::Connection() :
+   mConn(0)
+{
+   for (int i=0;i<MaxStatement;i++)
+   {
+      mStatements[i]=0;
+   }
+}
+
 MySqlDb::MySqlDb(const resip::ConfigParse& config,
                  const Data& server,
                  const Data& user, 
@@ -81,13 +91,32 @@ MySqlDb::MySqlDb(const resip::ConfigParse& config,
    mDBName(databaseName),
    mDBPort(port),
    mCustomUserAuthQuery(customUserAuthQuery),
-   mConn(0)
+   mConnections(getConnectionPoolSize())
 { 
-   InfoLog( << "Using MySQL DB with server=" << server << ", user=" << user << ", dbName=" << databaseName << ", port=" << port);
+   InfoLog( << "Using MySQL DB with server=" << server << ", user=" << user << ", dbName=" << databaseName << ", port=" << port
+            << ", connections=" << getConnectionPoolSize());
 
    for (int i=0;i<MaxTable;i++)
    {
       mResult[i]=0;
+      mNextRow[i]=0;
+   }
+
+   mStatementText[UserAuthInfoStatement] = "SELECT passwordHash FROM " + tableName(UserTable) + " WHERE user = ? AND domain = ?";
+   if(!mCustomUserAuthQuery.empty())
+   {
+      mStatementText[CustomUserAuthInfoStatement] = mStatementText[UserAuthInfoStatement] + " UNION " +
+         parameterizeUserAuthQuery(mCustomUserAuthQuery, false, 0, mCustomUserAuthDomainParams);
+   }
+   mStatementText[UserStatement] = "SELECT user, domain, realm, passwordHash, passwordHashAlt, name, email, forwardAddress FROM " + 
+      tableName(UserTable) + " WHERE user = ? AND domain = ?";
+   mStatementText[SiloRecordsStatement] = "SELECT value FROM " + tableName(SiloTable) + " WHERE attr2 = ?";
+   for (int i=0;i<MaxTable;i++)
+   {
+      if(i != UserTable && i != TlsPeerIdentityTable)
+      {
+         mStatementText[ReadRecordStatement + i] = "SELECT value FROM " + tableName((Table)i) + " WHERE attr = ?";
+      }
    }
 
    mysql_library_init(0, 0, 0);
@@ -97,7 +126,8 @@ MySqlDb::MySqlDb(const resip::ConfigParse& config,
    }
    else
    {
-      connectToDatabase();
+      // the others connect when first needed
+      connectToDatabase(mConnections[0]);
    }
 }
 
@@ -120,41 +150,57 @@ MySqlDb::initialize() const
 void
 MySqlDb::disconnectFromDatabase() const
 {
-   if(mConn)
+   for (int i=0;i<MaxTable;i++)
    {
-      for (int i=0;i<MaxTable;i++)
+      if (mResult[i])
+      {  
+         mysql_free_result(mResult[i]); 
+         mResult[i]=0;
+      }
+   }
+
+   for (std::vector<Connection>::iterator it = mConnections.begin(); it != mConnections.end(); it++)
+   {
+      disconnectFromDatabase(*it);
+   }
+}
+
+void
+MySqlDb::disconnectFromDatabase(Connection& connection) const
+{
+   if(connection.mConn)
+   {
+      for (int i=0;i<MaxStatement;i++)
       {
-         if (mResult[i])
-         {  
-            mysql_free_result(mResult[i]); 
-            mResult[i]=0;
+         if (connection.mStatements[i])
+         {
+            mysql_stmt_close(connection.mStatements[i]);
+            connection.mStatements[i]=0;
          }
       }
-   
-      mysql_close(mConn);
-      mConn = 0;
-      setConnected(false);
+
+      mysql_close(connection.mConn);
+      connection.mConn = 0;
    }
 }
 
 int 
-MySqlDb::connectToDatabase() const
+MySqlDb::connectToDatabase(Connection& connection) const
 {
    // Disconnect from database first (if required)
-   disconnectFromDatabase();
+   disconnectFromDatabase(connection);
 
    // Now try to connect
-   resip_assert(mConn == 0);
-   resip_assert(isConnected() == false);
+   resip_assert(connection.mConn == 0);
 
-   mConn = mysql_init(0);
-   if(mConn == 0)
+   connection.mConn = mysql_init(0);
+   if(connection.mConn == 0)
    {
       ErrLog( << "MySQL init failed: insufficient memory.");
       return CR_OUT_OF_MEMORY;
    }
 
-   MYSQL* ret = mysql_real_connect(mConn,
+   MYSQL* ret = mysql_real_connect(connection.mConn,
                                    mDBServer.c_str(),   // hostname
                                    mDBUser.c_str(),     // user
                                    mDBPassword.c_str(), // password
@@ -165,10 +211,10 @@ MySqlDb::connectToDatabase() const
 
    if (ret == 0)
    { 
-      int rc = mysql_errno(mConn);
-      ErrLog( << "MySQL connect failed: error=" << rc << ": " << mysql_error(mConn));
-      mysql_close(mConn); 
-      mConn = 0;
+      int rc = mysql_errno(connection.mConn);
+      ErrLog( << "MySQL connect failed: error=" << rc << ": " << mysql_error(connection.mConn));
+      mysql_close(connection.mConn); 
+      connection.mConn = 0;
       setConnected(false);
       return rc;
    }
@@ -188,37 +234,39 @@ MySqlDb::query(const Data& queryCommand, MYSQL_RES** result) const
 
    DebugLog( << "MySqlDb::query: executing query: " << queryCommand);
 
-   Lock lock(mMutex);
-   if(mConn == 0 || !isConnected())
+   uint64_t start = Timer::getTimeMicroSec();
+   ConnectionGuard guard(*this);
+   Connection& connection = mConnections[guard.index()];
+   if(connection.mConn == 0)
    {
-      rc = connectToDatabase();
+      rc = connectToDatabase(connection);
    }
    if(rc == 0)
    {
-      resip_assert(mConn!=0);
-      resip_assert(isConnected());
-      rc = mysql_query(mConn,queryCommand.c_str());
+      resip_assert(connection.mConn!=0);
+      rc = mysql_query(connection.mConn,queryCommand.c_str());
       if(rc != 0)
       {
-         rc = mysql_errno(mConn);
+         rc = mysql_errno(connection.mConn);
          if(rc == CR_SERVER_GONE_ERROR ||
             rc == CR_SERVER_LOST)
          {
             // First failure is a connection error - try to re-connect and then try again
-            rc = connectToDatabase();
+            rc = connectToDatabase(connection);
             if(rc == 0)
             {
                // OK - we reconnected - try query again
-               rc = mysql_query(mConn,queryCommand.c_str());
+               rc = mysql_query(connection.mConn,queryCommand.c_str());
                if( rc != 0)
                {
-                  ErrLog( << "MySQL query failed: error=" << mysql_errno(mConn) << ": " << mysql_error(mConn));
+                  rc = mysql_errno(connection.mConn);
+                  ErrLog( << "MySQL query failed: error=" << rc << ": " << mysql_error(connection.mConn));
                }
             }
          }
          else
          {
-            ErrLog( << "MySQL query failed: error=" << mysql_errno(mConn) << ": " << mysql_error(mConn));
+            ErrLog( << "MySQL query failed: error=" << rc << ": " << mysql_error(connection.mConn));
          }
       }
    }
@@ -226,16 +274,17 @@ MySqlDb::query(const Data& queryCommand, MYSQL_RES** result) const
    // Now store result - if pointer to result pointer was supplied and no errors
    if(rc == 0 && result)
    {
-      *result = mysql_store_result(mConn);
+      *result = mysql_store_result(connection.mConn);
       if(*result == 0)
       {
-         rc = mysql_errno(mConn);
+         rc = mysql_errno(connection.mConn);
          if(rc != 0)
          {
-            ErrLog( << "MySQL store result failed: error=" << rc << ": " << mysql_error(mConn));
+            ErrLog( << "MySQL store result failed: error=" << rc << ": " << mysql_error(connection.mConn));
          }
       }
    }
+   recordQuery(start);
 
    if(rc != 0)
    {
@@ -250,6 +299,155 @@ MySqlDb::query(const Data& queryCommand) const
    return query(queryCommand, 0);
 }
 
+int
+MySqlDb::preparedQuery(Statement statement, const std::vector<Data>& params, std::vector<Row>& rows) const
+{
+   int rc = 0;
+
+   initialize();
+
+   uint64_t start = Timer::getTimeMicroSec();
+   ConnectionGuard guard(*this);
+   Connection& connection = mConnections[guard.index()];
+   for(int attempt = 0; attempt < 2; attempt++)
+   {
+      if(connection.mConn == 0)
+      {
+         rc = connectToDatabase(connection);
+         if(rc != 0)
+         {
+            break;
+         }
+      }
+      MYSQL_STMT* stmt = prepareStatement(connection, statement, rc);
+      if(stmt)
+      {
+         rc = executeStatement(stmt, params, rows);
+      }
+      if(rc == CR_SERVER_GONE_ERROR ||
+         rc == CR_SERVER_LOST)
+      {
+         // First failure is a connection error - re-connect (preparing the
+         // statement again) and then try again
+         disconnectFromDatabase(connection);
+         rows.clear();
+         continue;
+      }
+      break;
+   }
+   recordQuery(start);
+
+   if(rc != 0)
+   {
+      ErrLog( << " SQL Command was: " << mStatementText[statement]) ;
+   }
+   return rc;
+}
+
+MYSQL_STMT*
+MySqlDb::prepareStatement(Connection& connection, Statement statement, int& rc) const
+{
+   MYSQL_STMT*& stmt = connection.mStatements[statement];
+   if(stmt == 0)
+   {
+      stmt = mysql_stmt_init(connection.mConn);
+      if(stmt == 0)
+      {
+         ErrLog( << "MySQL statement init failed: insufficient memory.");
+         rc = CR_OUT_OF_MEMORY;
+         return 0;
+      }
+      const Data& text = mStatementText[statement];
+      if(mysql_stmt_prepare(stmt, text.data(), text.size()) != 0)
+      {
+         rc = mysql_stmt_errno(stmt);
+         ErrLog( << "MySQL prepare failed: error=" << rc << ": " << mysql_stmt_error(stmt));
+         mysql_stmt_close(stmt);
+         stmt = 0;
+         return 0;
+      }
+   }
+   return stmt;
+}
+
+int
+MySqlDb::executeStatement(MYSQL_STMT* stmt, const std::vector<Data>& params, std::vector<Row>& rows) const
+{
+   std::vector<MYSQL_BIND> paramBinds(params.size());
+   std::vector<unsigned long> paramLengths(params.size());
+   for(std::vector<Data>::size_type i = 0; i < params.size(); i++)
+   {
+      memset(&paramBinds[i], 0, sizeof(MYSQL_BIND));
+      paramLengths[i] = params[i].size();
+      paramBinds[i].buffer_type = MYSQL_TYPE_STRING;
+      paramBinds[i].buffer = (void*)params[i].data();
+      paramBinds[i].buffer_length = params[i].size();
+      paramBinds[i].length = &paramLengths[i];
+   }
+   if((!paramBinds.empty() && mysql_stmt_bind_param(stmt, &paramBinds[0]) != 0) ||
+      mysql_stmt_execute(stmt) != 0 ||
+      mysql_stmt_store_result(stmt) != 0)
+   {
+      int rc = mysql_stmt_errno(stmt);
+      ErrLog( << "MySQL statement failed: error=" << rc << ": " << mysql_stmt_error(stmt));
+      return rc;
+   }
+
+   // No buffers are bound to the columns: each fetch only reports the
+   // lengths, then the columns are fetched into correctly sized Data
+   unsigned int columns = mysql_stmt_field_count(stmt);
+   std::vector<MYSQL_BIND> resultBinds(columns);
+   std::vector<unsigned long> lengths(columns);
+   for(unsigned int i = 0; i < columns; i++)
+   {
+      memset(&resultBinds[i], 0, sizeof(MYSQL_BIND));
+      resultBinds[i].buffer_type = MYSQL_TYPE_STRING;
+      resultBinds[i].length = &lengths[i];
+   }
+
+   int rc = 0;
+   if(columns > 0 && mysql_stmt_bind_result(stmt, &resultBinds[0]) != 0)
+   {
+      rc = mysql_stmt_errno(stmt);
+   }
+   while(rc == 0)
+   {
+      int status = mysql_stmt_fetch(stmt);
+      if(status == MYSQL_NO_DATA)
+      {
+         break;
+      }
+      if(status == 1)
+      {
+         rc = mysql_stmt_errno(stmt);
+         break;
+      }
+      rows.push_back(Row(columns));
+      Row& row = rows.back();
+      for(unsigned int i = 0; i < columns && rc == 0; i++)
+      {
+         if(lengths[i] > 0)
+         {
+            MYSQL_BIND column;
+            memset(&column, 0, sizeof(MYSQL_BIND));
+            column.buffer_type = MYSQL_TYPE_STRING;
+            column.buffer = row[i].getBuf((Data::size_type)lengths[i]);
+            column.buffer_length = lengths[i];
+            if(mysql_stmt_fetch_column(stmt, &column, i, 0) != 0)
+            {
+               rc = mysql_stmt_errno(stmt);
+            }
+         }
+      }
+   }
+   if(rc != 0)
+   {
+      ErrLog( << "MySQL fetch failed: error=" << rc << ": " << mysql_stmt_error(stmt));
+   }
+   mysql_stmt_free_result(stmt);
+   return rc;
+}
+
 int
 MySqlDb::singleResultQuery(const Data& queryCommand, std::vector<Data>& fields) const
 {
@@ -274,15 +472,7 @@ MySqlDb::singleResultQuery(const Data& queryCommand, std::vector<Data>& fields)
       }
       else
       {
-         rc = mysql_errno(mConn);
-         if(rc != 0)
-         {
-            ErrLog( << "MySQL fetch row failed: error=" << rc << ": " << mysql_error(mConn));
-         }
-         else
-         {
-            DebugLog(<<"singleResultQuery: no rows returned by query");
-         }
+         DebugLog(<<"singleResultQuery: no rows returned by query");
       }
       mysql_free_result(result);
    }
@@ -292,7 +482,15 @@ MySqlDb::singleResultQuery(const Data& queryCommand, std::vector<Data>& fields)
 resip::Data& 
 MySqlDb::escapeString(const resip::Data& str, resip::Data& escapedStr) const
 {
-   escapedStr.truncate2(mysql_real_escape_string(mConn, (char*)escapedStr.getBuf(str.size()*2+1), str.c_str(), str.size()));
+   // the connection provides the character set
+   ConnectionGuard guard(*this);
+   Connection& connection = mConnections[guard.index()];
+   if(connection.mConn == 0 && connectToDatabase(connection) != 0)
+   {
+      escapedStr.truncate2(mysql_escape_string((char*)escapedStr.getBuf(str.size()*2+1), str.c_str(), str.size()));
+      return escapedStr;
+   }
+   escapedStr.truncate2(mysql_real_escape_string(connection.mConn, (char*)escapedStr.getBuf(str.size()*2+1), str.c_str(), str.size()));
    return escapedStr;
 }
 
@@ -332,77 +530,85 @@ MySqlDb::getUser( const AbstractDb::Key& key ) const
 {
    AbstractDb::UserRecord  ret;
 
-   Data command;
-   {
-      DataStream ds(command);
-      ds << "SELECT user, domain, realm, passwordHash, passwordHashAlt, name, email, forwardAddress FROM " << tableName(UserTable) << " ";
-      userWhereClauseToDataStream(key, ds);
-   }
-   
-   MYSQL_RES* result=0;
-   if(query(command, &result) != 0)
-   {
-      return ret;
-   }
-   
-   if (result==0)
-   {
-      ErrLog( << "MySQL store result failed: error=" << mysql_errno(mConn) << ": " << mysql_error(mConn));
-      return ret;
-   }
+   std::vector<Data> params(2);
+   UserStore::getUserAndDomainFromKey(key, params[0], params[1]);
 
-   MYSQL_ROW row = mysql_fetch_row(result);
-   if (row)
+   std::vector<Row> rows;
+   if(preparedQuery(UserStatement, params, rows) != 0 || rows.empty())
    {
-      int col = 0;
-      ret.user            = Data(row[col++]);
-      ret.domain          = Data(row[col++]);
-      ret.realm           = Data(row[col++]);
-      ret.passwordHash    = Data(row[col++]);
-      ret.passwordHashAlt = Data(row[col++]);
-      ret.name            = Data(row[col++]);
-      ret.email           = Data(row[col++]);
-      ret.forwardAddress  = Data(row[col++]);
+      return ret;
    }
 
-   mysql_free_result(result);
+   const Row& row = rows.front();
+   int col = 0;
+   ret.user            = row[col++];
+   ret.domain          = row[col++];
+   ret.realm           = row[col++];
+   ret.passwordHash    = row[col++];
+   ret.passwordHashAlt = row[col++];
+   ret.name            = row[col++];
+   ret.email           = row[col++];
+   ret.forwardAddress  = row[col++];
 
    return ret;
 }
 
 
-resip::Data 
-MySqlDb::getUserAuthInfo(  const AbstractDb::Key& key ) const
-{ 
-   std::vector<Data> ret;
+void
+MySqlDb::userAuthInfoParams(const AbstractDb::Key& key, Statement& statement, std::vector<Data>& params) const
+{
+   Data user;
+   Data domain;
+   UserStore::getUserAndDomainFromKey(key, user, domain);
+   params.push_back(user);
+   params.push_back(domain);
 
-   Data command;
+   // Note: domain is empty when querying for HTTP admin user - for this special user, 
+   // we will only check the repro db, by not adding the UNION statement
+   if(!mCustomUserAuthQuery.empty() && !domain.empty())  
    {
-      DataStream ds(command);
-      Data user;
-      Data domain;
-      UserStore::getUserAndDomainFromKey(key, user, domain);
-      ds << "SELECT passwordHash FROM " << tableName(UserTable) << " WHERE user = '" << user << "' AND domain = '" << domain << "' ";
-   
-      // Note: domain is empty when querying for HTTP admin user - for this special user, 
-      // we will only check the repro db, by not adding the UNION statement below
-      if(!mCustomUserAuthQuery.empty() && !domain.empty())  
+      statement = CustomUserAuthInfoStatement;
+      for(std::vector<bool>::const_iterator it = mCustomUserAuthDomainParams.begin(); it != mCustomUserAuthDomainParams.end(); it++)
       {
-         ds << " UNION " << mCustomUserAuthQuery;
-         ds.flush();
-         command.replace("$user", user);
-         command.replace("$domain", domain);
+         params.push_back(*it ? domain : user);
       }
    }
+   else
+   {
+      statement = UserAuthInfoStatement;
+   }
+}
+
+resip::Data 
+MySqlDb::getUserAuthInfo(  const AbstractDb::Key& key ) const
+{ 
+   Data a1;
+   lookupUserAuthInfo(key, a1);
+   return a1;
+}
+
+
+AbstractDb::LookupResult
+MySqlDb::lookupUserAuthInfo(  const AbstractDb::Key& key, resip::Data& a1 ) const
+{ 
+   Statement statement;
+   std::vector<Data> params;
+   userAuthInfoParams(key, statement, params);
 
-   if(singleResultQuery(command, ret) != 0 || ret.size() == 0)
+   std::vector<Row> rows;
+   if(preparedQuery(statement, params, rows) != 0)
    {
-      return Data::Empty;
+      return LookupFailed;
+   }
+   if(rows.empty() || rows.front().empty())
+   {
+      return LookupNotFound;
    }
    
-   DebugLog( << "Auth password is " << ret.front());
+   DebugLog( << "Auth password is " << rows.front().front());
    
-   return ret.front();
+   a1 = rows.front().front();
+   return LookupFound;
 }
 
 
@@ -429,7 +635,7 @@ MySqlDb::firstUserKey()
 
    if(mResult[UserTable] == 0)
    {
-      ErrLog( << "MySQL store result failed: error=" << mysql_errno(mConn) << ": " << mysql_error(mConn));
+      ErrLog( << "MySQL query returned no result set");
       return Data::Empty;
    }
    
@@ -498,7 +704,7 @@ MySqlDb::getTlsPeerIdentity( const AbstractDb::Key& key ) const
 
    if (result==0)
    {
-      ErrLog( << "MySQL store result failed: error=" << mysql_errno(mConn) << ": " << mysql_error(mConn));
+      ErrLog( << "MySQL query returned no result set");
       return ret;
    }
 
@@ -539,7 +745,7 @@ MySqlDb::firstTlsPeerIdentityKey()
 
    if(mResult[TlsPeerIdentityTable] == 0)
    {
-      ErrLog( << "MySQL store result failed: error=" << mysql_errno(mConn) << ": " << mysql_error(mConn));
+      ErrLog( << "MySQL query returned no result set");
       return Data::Empty;
    }
 
@@ -608,38 +814,15 @@ MySqlDb::dbReadRecord(const Table table,
                       const resip::Data& pKey, 
                       resip::Data& pData) const
 { 
-   Data command;
-   Data escapedKey;
-   {
-      DataStream ds(command);
-      ds << "SELECT value FROM " << tableName(table) 
-         << " WHERE attr='" << escapeString(pKey, escapedKey)
-         << "'";
-   }
-
-   MYSQL_RES* result = 0;
-   if(query(command, &result) != 0)
+   std::vector<Data> params(1, pKey);
+   std::vector<Row> rows;
+   if(preparedQuery((Statement)(ReadRecordStatement + table), params, rows) != 0 || rows.empty())
    {
       return false;
    }
 
-   if (result == 0)
-   {
-      ErrLog( << "MySQL store result failed: error=" << mysql_errno(mConn) << ": " << mysql_error(mConn));
-      return false;
-   }
-   else
-   {
-      bool success = false;
-      MYSQL_ROW row=mysql_fetch_row(result);
-      if(row)
-      {
-         pData = Data(Data::Share, row[0], (Data::size_type)strlen(row[0])).base64decode();
-         success = true;
-      }
-      mysql_free_result(result);
-      return success;
-   }
+   pData = rows.front().front().base64decode();
+   return true;
 }
 
 
@@ -668,7 +851,7 @@ MySqlDb::dbNextKey(const Table table, bool first)
 
       if (mResult[table] == 0)
       {
-         ErrLog( << "MySQL store result failed: error=" << mysql_errno(mConn) << ": " << mysql_error(mConn));
+         ErrLog( << "MySQL query returned no result set");
          return Data::Empty;
       }
    }
@@ -707,6 +890,20 @@ MySqlDb::dbNextRecord(const Table table,
          mysql_free_result(mResult[table]); 
          mResult[table] = 0;
       }
+      mRows[table].clear();
+      mNextRow[table] = 0;
+
+      if(table == SiloTable && !key.empty() && !forUpdate)
+      {
+         // looked up for every registration
+         std::vector<Data> params(1, key);
+         if(preparedQuery(SiloRecordsStatement, params, mRows[table]) != 0)
+         {
+            mRows[table].clear();
+            return false;
+         }
+         return dbNextRecord(table, key, data, forUpdate, false);
+      }
       
       Data command;
       {
@@ -732,10 +929,18 @@ MySqlDb::dbNextRecord(const Table table,
 
       if (mResult[table] == 0)
       {
-         ErrLog( << "MySQL store result failed: error=" << mysql_errno(mConn) << ": " << mysql_error(mConn));
+         ErrLog( << "MySQL query returned no result set");
          return false;
       }
    }
+
+   if (mNextRow[table] < mRows[table].size())
+   {
+      data = mRows[table][mNextRow[table]++].front().base64decode();
+      return true;
+   }
+   mRows[table].clear();
+   mNextRow[table] = 0;
    
    if (mResult[table] == 0)
    { 
@@ -758,12 +963,17 @@ MySqlDb::dbNextRecord(const Table table,
 bool 
 MySqlDb::dbBeginTransaction(const Table table)
 {
+   pinConnection();
    Data command("SET SESSION TRANSACTION ISOLATION LEVEL REPEATABLE READ");
    if(query(command, 0) == 0)
    {
       command = "START TRANSACTION";
-      return query(command, 0) == 0;
+      if(query(command, 0) == 0)
+      {
+         return true;
+      }
    }
+   unpinConnection();
    return false;
 }
 
@@ -7,6 +7,8 @@
 #include <mysql/mysql.h>
 #endif
 
+#include <vector>
+
 #include "rutil/Data.hxx"
 #include "repro/SqlDb.hxx"
 
@@ -34,6 +36,7 @@ class MySqlDb: public SqlDb
       virtual bool addUser( const Key& key, const UserRecord& rec );
       virtual UserRecord getUser( const Key& key ) const;
       virtual resip::Data getUserAuthInfo(  const Key& key ) const;
+      virtual LookupResult lookupUserAuthInfo(  const Key& key, resip::Data& a1 ) const;
       virtual Key firstUserKey();// return empty if no more
       virtual Key nextUserKey(); // return empty if no more 
 
@@ -62,11 +65,37 @@ class MySqlDb: public SqlDb
                                 bool first=false);  // return false if no more
       virtual bool dbBeginTransaction(const Table table);
 
+      // The hot lookups run as server side prepared statements, prepared on
+      // each pooled connection the first time they are used there
+      enum Statement
+      {
+         UserAuthInfoStatement,
+         CustomUserAuthInfoStatement,
+         UserStatement,
+         SiloRecordsStatement,
+         ReadRecordStatement,    // one per table from here on
+         MaxStatement = ReadRecordStatement + MaxTable
+      };
+
+      struct Connection
+      {
+         Connection();
+         MYSQL* mConn;
+         MYSQL_STMT* mStatements[MaxStatement];
+      };
+      typedef std::vector<resip::Data> Row;
+
       void initialize() const;
       void disconnectFromDatabase() const;
-      int connectToDatabase() const;
+      void disconnectFromDatabase(Connection& connection) const;
+      int connectToDatabase(Connection& connection) const;
       int query(const resip::Data& queryCommand, MYSQL_RES** result) const;
       virtual int query(const resip::Data& queryCommand) const;
+      // Runs a prepared statement; every row returned is appended to rows
+      int preparedQuery(Statement statement, const std::vector<resip::Data>& params, std::vector<Row>& rows) const;
+      MYSQL_STMT* prepareStatement(Connection& connection, Statement statement, int& rc) const;
+      int executeStatement(MYSQL_STMT* stmt, const std::vector<resip::Data>& params, std::vector<Row>& rows) const;
+      void userAuthInfoParams(const Key& key, Statement& statement, std::vector<resip::Data>& params) const;
       resip::Data& escapeString(const resip::Data& str, resip::Data& escapedStr) const;
 
       resip::Data mDBServer;
@@ -76,8 +105,13 @@ class MySqlDb: public SqlDb
       unsigned int mDBPort;
       resip::Data mCustomUserAuthQuery;
 
-      mutable MYSQL* mConn;
+      mutable std::vector<Connection> mConnections;
       mutable MYSQL_RES* mResult[MaxTable];
+      std::vector<Row> mRows[MaxTable];       // results of prepared statements being iterated
+      std::vector<Row>::size_type mNextRow[MaxTable];
+
+      resip::Data mStatementText[MaxStatement];
+      std::vector<bool> mCustomUserAuthDomainParams;  // for each $user/$domain in mCustomUserAuthQuery, whether it is $domain
 
       void userWhereClauseToDataStream(const Key& key, resip::DataStream& ds) const;
       void tlsPeerIdentityWhereClauseToDataStream(const Key& key, resip::DataStream& ds) const;
@@ -231,6 +231,12 @@ PersistentMessageQueue::isRecoveryNeeded()
 
 bool 
 PersistentMessageEnqueue::push(const resip::Data& data)
+{
+   return push(std::vector<resip::Data>(1, data));
+}
+
+bool 
+PersistentMessageEnqueue::push(const std::vector<resip::Data>& data)
 {
 #ifndef DISABLE_BERKELEYDB_USE
    int res;
@@ -240,25 +246,25 @@ PersistentMessageEnqueue::push(const resip::Data& data)
       Transaction transaction;
       transaction.init(this);
 
-      db_recno_t recno; 
-      recno = 0;
-      Dbt val((void*)data.c_str(), data.size());
-      Dbt key((void*)&recno, sizeof(recno));
+      for(std::vector<resip::Data>::const_iterator it = data.begin(); it != data.end(); it++)
+      {
+         db_recno_t recno; 
+         recno = 0;
+         Dbt val((void*)it->c_str(), it->size());
+         Dbt key((void*)&recno, sizeof(recno));
 
-      key.set_ulen(sizeof(recno));
-      key.set_flags(DB_DBT_USERMEM);
+         key.set_ulen(sizeof(recno));
+         key.set_flags(DB_DBT_USERMEM);
 
-      res = mDb->put(transaction.mDbTxn, &key, &val, DB_APPEND);
-      if(res == 0)
-      {
-         transaction.commit();
-         return true;
-      } 
-      else
-      {
-         WarningLog( << "PersistentMessageEnqueue::push - put failed: " << db_strerror(res));
-         return false;
+         res = mDb->put(transaction.mDbTxn, &key, &val, DB_APPEND);
+         if(res != 0)
+         {
+            WarningLog( << "PersistentMessageEnqueue::push - put failed: " << db_strerror(res));
+            return false;  // transaction is aborted
+         }
       }
+      transaction.commit();
+      return true;
    } 
    catch(DbException& e)
    {
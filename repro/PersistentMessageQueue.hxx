@@ -151,6 +151,10 @@ public:
    // Note:  this has a potential to block if the a consumer crashes and leaves a lock open on the database (deadlock)
    // typically restarting the consumer will "recover" the "dead" lock and allow this call to unblock
    bool push(const resip::Data& data);
+
+   // Pushes all of the messages in a single transaction, so they are written
+   // to disk together; either all of them are queued or none are
+   bool push(const std::vector<resip::Data>& data);
 };  
 
 class PersistentMessageDequeue : public PersistentMessageQueue 
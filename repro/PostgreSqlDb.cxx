@@ -12,6 +12,7 @@
 #include "rutil/DataStream.hxx"
 #include "rutil/Logger.hxx"
 #include "rutil/ParseBuffer.hxx"
+#include "rutil/Timer.hxx"
 
 #include "repro/AbstractDb.hxx"
 #include "repro/PostgreSqlDb.hxx"
@@ -61,6 +62,15 @@ class PostgreSQLInitializer
 };
 static PostgreSQLInitializer g_PostgreSQLInitializer;
 
+PostgreSqlDb::Connection::Connection() :
+   mConn(0)
+{
+   for (int i=0;i<MaxStatement;i++)
+   {
+      mPrepared[i]=false;
+   }
+}
+
 PostgreSqlDb::PostgreSqlDb(const resip::ConfigParse& config,
                  const Data& connInfo,
                  const Data& server,
@@ -77,9 +87,10 @@ PostgreSqlDb::PostgreSqlDb(const resip::ConfigParse& config,
    mDBName(databaseName),
    mDBPort(port),
    mCustomUserAuthQuery(customUserAuthQuery),
-   mConn(0)
+   mConnections(getConnectionPoolSize())
 { 
-   InfoLog( << "Using PostgreSQL DB with server=" << server << ", user=" << user << ", dbName=" << databaseName << ", port=" << port);
+   InfoLog( << "Using PostgreSQL DB with server=" << server << ", user=" << user << ", dbName=" << databaseName << ", port=" << port
+            << ", connections=" << getConnectionPoolSize());
 
    for (int i=0;i<MaxTable;i++)
    {
@@ -87,13 +98,31 @@ PostgreSqlDb::PostgreSqlDb(const resip::ConfigParse& config,
       mRow[i]=0;
    }
 
+   mStatementText[UserAuthInfoStatement] = "SELECT passwordHash FROM " + tableName(UserTable) + " WHERE username = $1 AND domain = $2";
+   if(!mCustomUserAuthQuery.empty())
+   {
+      mStatementText[CustomUserAuthInfoStatement] = mStatementText[UserAuthInfoStatement] + " UNION " +
+         parameterizeUserAuthQuery(mCustomUserAuthQuery, true, 3, mCustomUserAuthDomainParams);
+   }
+   mStatementText[UserStatement] = "SELECT username, domain, realm, passwordHash, passwordHashAlt, name, email, forwardAddress FROM " + 
+      tableName(UserTable) + " WHERE username = $1 AND domain = $2";
+   mStatementText[SiloRecordsStatement] = "SELECT value FROM " + tableName(SiloTable) + " WHERE attr2 = $1";
+   for (int i=0;i<MaxTable;i++)
+   {
+      if(i != UserTable && i != TlsPeerIdentityTable)
+      {
+         mStatementText[ReadRecordStatement + i] = "SELECT value FROM " + tableName((Table)i) + " WHERE attr = $1";
+      }
+   }
+
    if(!PQisthreadsafe())
    {
       ErrLog( << "Repro uses PostgreSQL from multiple threads - you MUST link with a thread safe version of the PostgreSQL client library (libpq)!");
    }
    else
    {
-      connectToDatabase();
+      // the others connect when first needed
+      connectToDatabase(mConnections[0]);
    }
 }
 
@@ -116,33 +145,46 @@ PostgreSqlDb::initialize() const
 void
 PostgreSqlDb::disconnectFromDatabase() const
 {
-   if(mConn)
+   for (int i=0;i<MaxTable;i++)
+   {
+      if (mResult[i])
+      {  
+         PQclear(mResult[i]); 
+         mResult[i]=0;
+         mRow[i]=0;
+      }
+   }
+
+   for (std::vector<Connection>::iterator it = mConnections.begin(); it != mConnections.end(); it++)
+   {
+      disconnectFromDatabase(*it);
+   }
+}
+
+void
+PostgreSqlDb::disconnectFromDatabase(Connection& connection) const
+{
+   if(connection.mConn)
    {
-      for (int i=0;i<MaxTable;i++)
+      // prepared statements go away with the session
+      for (int i=0;i<MaxStatement;i++)
       {
-         if (mResult[i])
-         {  
-            PQclear(mResult[i]); 
-            mResult[i]=0;
-            mRow[i]=0;
-         }
+         connection.mPrepared[i]=false;
       }
-   
-      PQfinish(mConn);
-      mConn = 0;
-      setConnected(false);
+
+      PQfinish(connection.mConn);
+      connection.mConn = 0;
    }
 }
 
 int 
-PostgreSqlDb::connectToDatabase() const
+PostgreSqlDb::connectToDatabase(Connection& connection) const
 {
    // Disconnect from database first (if required)
-   disconnectFromDatabase();
+   disconnectFromDatabase(connection);
 
    // Now try to connect
-   resip_assert(mConn == 0);
-   resip_assert(isConnected() == false);
+   resip_assert(connection.mConn == 0);
 
    Data connInfo(mDBConnInfo);
    if(!mDBServer.empty())
@@ -169,18 +211,19 @@ PostgreSqlDb::connectToDatabase() const
    }
 
    DebugLog(<<"Trying to connect to PostgreSQL server with conninfo string: " << connInfoLogString);
-   mConn = PQconnectdb(connInfo.c_str());
+   PGconn* conn = PQconnectdb(connInfo.c_str());
 
-   int rc = PQstatus(mConn);
+   int rc = PQstatus(conn);
    if (rc != CONNECTION_OK)
    { 
-      ErrLog( << "PostgreSQL connect failed: " << PQerrorMessage(mConn));
-      mConn = 0;
+      ErrLog( << "PostgreSQL connect failed: " << PQerrorMessage(conn));
+      PQfinish(conn);
       setConnected(false);
       return -1;
    }
    else
    {
+      connection.mConn = conn;
       setConnected(true);
       return 0;
    }
@@ -196,53 +239,62 @@ int
 PostgreSqlDb::query(const Data& queryCommand, PGresult** result) const
 {
    int rc = 0;
-   PGresult *_result;
+   PGresult *_result = 0;
 
    initialize();
 
    DebugLog( << "PostgreSqlDb::query: executing query: " << queryCommand);
 
-   Lock lock(mMutex);
-   if(mConn == 0 || !isConnected())
+   uint64_t start = Timer::getTimeMicroSec();
+   ConnectionGuard guard(*this);
+   Connection& connection = mConnections[guard.index()];
+   if(connection.mConn == 0)
    {
-      rc = connectToDatabase();
+      rc = connectToDatabase(connection);
    }
    if(rc == 0)
    {
-      resip_assert(mConn!=0);
-      resip_assert(isConnected());
-      _result = PQexec(mConn, queryCommand.c_str());
+      resip_assert(connection.mConn!=0);
+      _result = PQexec(connection.mConn, queryCommand.c_str());
       rc = pqOK(_result);
       if(rc != 0)
       {
          PQclear(_result);
-         if(rc == PGRES_FATAL_ERROR)
+         _result = 0;
+         if(PQstatus(connection.mConn) == CONNECTION_BAD)
          {
-            // First failure may be a connection error - try to re-connect and then try again
-            rc = connectToDatabase();
+            // First failure is a connection error - try to re-connect and then try again
+            rc = connectToDatabase(connection);
             if(rc == 0)
             {
                // OK - we reconnected - try query again
-               _result = PQexec(mConn,queryCommand.c_str());
+               _result = PQexec(connection.mConn,queryCommand.c_str());
                rc = pqOK(_result);
                if( rc != 0)
                {
-                  ErrLog( << "PostgreSQL query failed (twice): " << PQerrorMessage(mConn));
+                  ErrLog( << "PostgreSQL query failed (twice): " << PQerrorMessage(connection.mConn));
+                  PQclear(_result);
+                  _result = 0;
                }
             }
          }
          else
          {
-            ErrLog( << "PostgreSQL query failed: " << PQerrorMessage(mConn));
+            ErrLog( << "PostgreSQL query failed: " << PQerrorMessage(connection.mConn));
          }
       }
    }
+   recordQuery(start);
 
    // Now store result - if pointer to result pointer was supplied and no errors
    if(rc == 0 && result)
    {
       *result = _result;
    }
+   else if(_result)
+   {
+      PQclear(_result);
+   }
 
    if(rc != 0)
    {
@@ -257,6 +309,82 @@ PostgreSqlDb::query(const Data& queryCommand) const
    return query(queryCommand, 0);
 }
 
+int
+PostgreSqlDb::preparedQuery(Statement statement, const std::vector<Data>& params, PGresult** result) const
+{
+   int rc = 0;
+   PGresult *_result = 0;
+
+   initialize();
+
+   uint64_t start = Timer::getTimeMicroSec();
+   ConnectionGuard guard(*this);
+   Connection& connection = mConnections[guard.index()];
+   for(int attempt = 0; attempt < 2; attempt++)
+   {
+      if(connection.mConn == 0)
+      {
+         rc = connectToDatabase(connection);
+         if(rc != 0)
+         {
+            break;
+         }
+      }
+      _result = executeStatement(connection, statement, params);
+      rc = pqOK(_result);
+      if(rc == 0)
+      {
+         break;
+      }
+      ErrLog( << "PostgreSQL query failed: " << PQerrorMessage(connection.mConn));
+      PQclear(_result);
+      _result = 0;
+      if(PQstatus(connection.mConn) != CONNECTION_BAD)
+      {
+         break;
+      }
+      // First failure is a connection error - re-connect (preparing the
+      // statement again) and then try again
+      disconnectFromDatabase(connection);
+   }
+   recordQuery(start);
+
+   if(rc == 0)
+   {
+      *result = _result;
+   }
+   else
+   {
+      ErrLog( << " SQL Command was: " << mStatementText[statement]) ;
+   }
+   return rc;
+}
+
+PGresult*
+PostgreSqlDb::executeStatement(Connection& connection, Statement statement, const std::vector<Data>& params) const
+{
+   char name[16];
+   snprintf(name, sizeof(name), "repro%d", (int)statement);
+   if(!connection.mPrepared[statement])
+   {
+      PGresult* prepared = PQprepare(connection.mConn, name, mStatementText[statement].c_str(), (int)params.size(), 0);
+      int rc = pqOK(prepared);
+      PQclear(prepared);
+      if(rc != 0)
+      {
+         return 0;
+      }
+      connection.mPrepared[statement] = true;
+   }
+
+   std::vector<const char*> values(params.size());
+   for(std::vector<Data>::size_type i = 0; i < params.size(); i++)
+   {
+      values[i] = params[i].c_str();
+   }
+   return PQexecPrepared(connection.mConn, name, (int)values.size(), values.empty() ? 0 : &values[0], 0, 0, 0);
+}
+
 int
 PostgreSqlDb::singleResultQuery(const Data& queryCommand, std::vector<Data>& fields) const
 {
@@ -291,11 +419,20 @@ PostgreSqlDb::singleResultQuery(const Data& queryCommand, std::vector<Data>& fie
 resip::Data& 
 PostgreSqlDb::escapeString(const resip::Data& str, resip::Data& escapedStr) const
 {
+   // the connection provides the character set
+   ConnectionGuard guard(*this);
+   Connection& connection = mConnections[guard.index()];
+   if(connection.mConn == 0 && connectToDatabase(connection) != 0)
+   {
+      escapedStr.truncate2(PQescapeString((char*)escapedStr.getBuf(str.size()*2+1), str.c_str(), str.size()));
+      return escapedStr;
+   }
+
    int rc = 0;
-   escapedStr.truncate2(PQescapeStringConn(mConn, (char*)escapedStr.getBuf(str.size()*2+1), str.c_str(), str.size(), &rc));
+   escapedStr.truncate2(PQescapeStringConn(connection.mConn, (char*)escapedStr.getBuf(str.size()*2+1), str.c_str(), str.size(), &rc));
    if(rc != 0)
    {
-      ErrLog(<< "PostgreSQL string escaping failed: " << PQerrorMessage(mConn));
+      ErrLog(<< "PostgreSQL string escaping failed: " << PQerrorMessage(connection.mConn));
       // FIXME - should probably throw here.  According to the docs, there is a value in
       // the output buffer even after failure so we'll try to use it and fail later.
    }
@@ -342,22 +479,18 @@ PostgreSqlDb::getUser( const AbstractDb::Key& key ) const
 {
    AbstractDb::UserRecord  ret;
 
-   Data command;
-   {
-      DataStream ds(command);
-      ds << "SELECT username, domain, realm, passwordHash, passwordHashAlt, name, email, forwardAddress FROM " << tableName(UserTable) << " ";
-      userWhereClauseToDataStream(key, ds);
-   }
+   std::vector<Data> params(2);
+   UserStore::getUserAndDomainFromKey(key, params[0], params[1]);
    
    PGresult* result=0;
-   if(query(command, &result) != 0)
+   if(preparedQuery(UserStatement, params, &result) != 0)
    {
       return ret;
    }
    
    if (result==0)
    {
-      ErrLog( << "PostgreSQL failed: " << PQerrorMessage(mConn));
+      ErrLog( << "PostgreSQL query returned no result");
       return ret;
    }
 
@@ -380,38 +513,68 @@ PostgreSqlDb::getUser( const AbstractDb::Key& key ) const
 }
 
 
+void
+PostgreSqlDb::userAuthInfoParams(const AbstractDb::Key& key, Statement& statement, std::vector<Data>& params) const
+{
+   Data user;
+   Data domain;
+   UserStore::getUserAndDomainFromKey(key, user, domain);
+   params.push_back(user);
+   params.push_back(domain);
+
+   // Note: domain is empty when querying for HTTP admin user - for this special user, 
+   // we will only check the repro db, by not adding the UNION statement
+   if(!mCustomUserAuthQuery.empty() && !domain.empty())  
+   {
+      statement = CustomUserAuthInfoStatement;
+      for(std::vector<bool>::const_iterator it = mCustomUserAuthDomainParams.begin(); it != mCustomUserAuthDomainParams.end(); it++)
+      {
+         params.push_back(*it ? domain : user);
+      }
+   }
+   else
+   {
+      statement = UserAuthInfoStatement;
+   }
+}
+
 resip::Data 
 PostgreSqlDb::getUserAuthInfo(  const AbstractDb::Key& key ) const
 { 
-   std::vector<Data> ret;
+   Data a1;
+   lookupUserAuthInfo(key, a1);
+   return a1;
+}
 
-   Data command;
+
+AbstractDb::LookupResult
+PostgreSqlDb::lookupUserAuthInfo(  const AbstractDb::Key& key, resip::Data& a1 ) const
+{ 
+   Statement statement;
+   std::vector<Data> params;
+   userAuthInfoParams(key, statement, params);
+
+   std::vector<Data> ret;
+   PGresult* result=0;
+   if(preparedQuery(statement, params, &result) != 0)
    {
-      DataStream ds(command);
-      Data user;
-      Data domain;
-      UserStore::getUserAndDomainFromKey(key, user, domain);
-      ds << "SELECT passwordHash FROM " << tableName(UserTable) << " WHERE username = '" << user << "' AND domain = '" << domain << "' ";
-   
-      // Note: domain is empty when querying for HTTP admin user - for this special user, 
-      // we will only check the repro db, by not adding the UNION statement below
-      if(!mCustomUserAuthQuery.empty() && !domain.empty())  
-      {
-         ds << " UNION " << mCustomUserAuthQuery;
-         ds.flush();
-         command.replace("$user", user);
-         command.replace("$domain", domain);
-      }
+      return LookupFailed;
    }
+   if(PQntuples(result) > 0)
+   {
+      ret.push_back(Data(PQgetvalue(result, 0, 0)));
+   }
+   PQclear(result);
 
-   if(singleResultQuery(command, ret) != 0 || ret.size() == 0)
+   if(ret.empty())
    {
-      return Data::Empty;
+      return LookupNotFound;
    }
    
    DebugLog( << "Auth password is " << ret.front());
    
-   return ret.front();
+   a1 = ret.front();
+   return LookupFound;
 }
 
 
@@ -439,7 +602,7 @@ PostgreSqlDb::firstUserKey()
 
    if(mResult[UserTable] == 0)
    {
-      ErrLog( << "PostgreSQL failed: " << PQerrorMessage(mConn));
+      ErrLog( << "PostgreSQL query returned no result");
       return Data::Empty;
    }
    
@@ -514,7 +677,7 @@ PostgreSqlDb::getTlsPeerIdentity( const AbstractDb::Key& key ) const
  
    if (result==0)
    {
-      ErrLog( << "PostgreSQL failed: " << PQerrorMessage(mConn));
+      ErrLog( << "PostgreSQL query returned no result");
       return ret;
    }
 
@@ -555,7 +718,7 @@ PostgreSqlDb::firstTlsPeerIdentityKey()
 
    if(mResult[TlsPeerIdentityTable] == 0)
    {
-      ErrLog( << "PostgreSQL failed: " << PQerrorMessage(mConn));
+      ErrLog( << "PostgreSQL query returned no result");
       return Data::Empty;
    }
 
@@ -634,24 +797,16 @@ PostgreSqlDb::dbReadRecord(const Table table,
                       const resip::Data& pKey, 
                       resip::Data& pData) const
 { 
-   Data command;
-   Data escapedKey;
-   {
-      DataStream ds(command);
-      ds << "SELECT value FROM " << tableName(table) 
-         << " WHERE attr='" << escapeString(pKey, escapedKey)
-         << "'";
-   }
-
+   std::vector<Data> params(1, pKey);
    PGresult* result = 0;
-   if(query(command, &result) != 0)
+   if(preparedQuery((Statement)(ReadRecordStatement + table), params, &result) != 0)
    {
       return false;
    }
 
    if (result == 0)
    {
-      ErrLog( << "PostgreSQL result failed: " << PQerrorMessage(mConn));
+      ErrLog( << "PostgreSQL query returned no result");
       return false;
    }
    else
@@ -696,7 +851,7 @@ PostgreSqlDb::dbNextKey(const Table table, bool first)
 
       if (mResult[table] == 0)
       {
-         ErrLog( << "PostgreSQL failed: " << PQerrorMessage(mConn));
+         ErrLog( << "PostgreSQL query returned no result");
          return Data::Empty;
       }
    }
@@ -736,6 +891,17 @@ PostgreSqlDb::dbNextRecord(const Table table,
          mResult[table] = 0;
          mRow[table] = 0;
       }
+
+      if(table == SiloTable && !key.empty() && !forUpdate)
+      {
+         // looked up for every registration
+         std::vector<Data> params(1, key);
+         if(preparedQuery(SiloRecordsStatement, params, &mResult[table]) != 0)
+         {
+            return false;
+         }
+         return dbNextRecord(table, key, data, forUpdate, false);
+      }
       
       Data command;
       {
@@ -761,7 +927,7 @@ PostgreSqlDb::dbNextRecord(const Table table,
 
       if (mResult[table] == 0)
       {
-         ErrLog( << "PostgreSQL failed: " << PQerrorMessage(mConn));
+         ErrLog( << "PostgreSQL query returned no result");
          return false;
       }
    }
@@ -788,12 +954,17 @@ PostgreSqlDb::dbNextRecord(const Table table,
 bool 
 PostgreSqlDb::dbBeginTransaction(const Table table)
 {
+   pinConnection();
    Data command("SET SESSION CHARACTERISTICS AS TRANSACTION ISOLATION LEVEL REPEATABLE READ");
-   if(query(command, 0))
+   if(query(command, 0) == 0)
    {
       command = "BEGIN";
-      return query(command, 0);
+      if(query(command, 0) == 0)
+      {
+         return true;
+      }
    }
+   unpinConnection();
    return false;
 }
 
@@ -3,6 +3,8 @@
 
 #include <libpq-fe.h>
 
+#include <vector>
+
 #include "rutil/Data.hxx"
 #include "repro/SqlDb.hxx"
 
@@ -31,6 +33,7 @@ class PostgreSqlDb: public SqlDb
       virtual bool addUser( const Key& key, const UserRecord& rec );
       virtual UserRecord getUser( const Key& key ) const;
       virtual resip::Data getUserAuthInfo(  const Key& key ) const;
+      virtual LookupResult lookupUserAuthInfo(  const Key& key, resip::Data& a1 ) const;
       virtual Key firstUserKey();// return empty if no more
       virtual Key nextUserKey(); // return empty if no more 
 
@@ -59,11 +62,34 @@ class PostgreSqlDb: public SqlDb
                                 bool first=false);  // return false if no more
       virtual bool dbBeginTransaction(const Table table);
 
+      // The hot lookups run as server side prepared statements, prepared on
+      // each pooled connection the first time they are used there
+      enum Statement
+      {
+         UserAuthInfoStatement,
+         CustomUserAuthInfoStatement,
+         UserStatement,
+         SiloRecordsStatement,
+         ReadRecordStatement,    // one per table from here on
+         MaxStatement = ReadRecordStatement + MaxTable
+      };
+
+      struct Connection
+      {
+         Connection();
+         PGconn* mConn;
+         bool mPrepared[MaxStatement];
+      };
+
       void initialize() const;
       void disconnectFromDatabase() const;
-      int connectToDatabase() const;
+      void disconnectFromDatabase(Connection& connection) const;
+      int connectToDatabase(Connection& connection) const;
       int query(const resip::Data& queryCommand, PGresult** result) const;
       virtual int query(const resip::Data& queryCommand) const;
+      int preparedQuery(Statement statement, const std::vector<resip::Data>& params, PGresult** result) const;
+      PGresult* executeStatement(Connection& connection, Statement statement, const std::vector<resip::Data>& params) const;
+      void userAuthInfoParams(const Key& key, Statement& statement, std::vector<resip::Data>& params) const;
       resip::Data& escapeString(const resip::Data& str, resip::Data& escapedStr) const;
 
       resip::Data mDBConnInfo;
@@ -74,10 +100,13 @@ class PostgreSqlDb: public SqlDb
       unsigned int mDBPort;
       resip::Data mCustomUserAuthQuery;
 
-      mutable PGconn* mConn;
+      mutable std::vector<Connection> mConnections;
       mutable PGresult* mResult[MaxTable];
       mutable int mRow[MaxTable];
 
+      resip::Data mStatementText[MaxStatement];
+      std::vector<bool> mCustomUserAuthDomainParams;  // for each $user/$domain in mCustomUserAuthQuery, whether it is $domain
+
       void userWhereClauseToDataStream(const Key& key, resip::DataStream& ds) const;
       void tlsPeerIdentityWhereClauseToDataStream(const Key& key, resip::DataStream& ds) const;
 };
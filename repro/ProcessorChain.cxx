@@ -162,6 +162,15 @@ ProcessorChain::onChainComplete()
       (*it)->pushAddress(mAddress);
    }
    mChainReady = true;
+
+   for(Chain::iterator it = mChain.begin() ; it != mChain.end(); it++)
+   {
+      ProcessorChain* chain = dynamic_cast<ProcessorChain*>(*it);
+      if(chain && !chain->mChainReady)
+      {
+         chain->onChainComplete();
+      }
+   }
 }
 
 EncodeStream &
@@ -42,11 +42,15 @@ class ProcessorChain : public Processor
       virtual void pushAddress(const std::vector<short>& address);
       virtual void pushAddress(const short address);
 
+      // Readies the chain, and any chains in it, for processing.  This is
+      // done on first use otherwise, which is only safe if the chain is
+      // used from a single thread.
+      void onChainComplete();
+
    private:
       Chain mChain;
 
       bool mChainReady;
-      void onChainComplete();
 
    friend EncodeStream &operator<<(EncodeStream &os, const repro::ProcessorChain &pc);
 };
@@ -101,7 +101,8 @@ Proxy::Proxy(SipStack& stack,
      mRequestContextFactory(new RequestContextFactory),
      mSessionAccountingEnabled(config.getConfigBool("SessionAccountingEnabled", false)),
      mRegistrationAccountingEnabled(config.getConfigBool("RegistrationAccountingEnabled", false)),
-     mAccountingCollector(0)
+     mAccountingCollector(0),
+     mNumWorkerThreads((unsigned int)config.getConfigUnsignedLong("NumProxyWorkerThreads", 0))
 {
    FlowTokenSalt = Random::getCryptoRandom(20);   // 20-octet Crypto Random Key for Salting Flow Token HMACs
 
@@ -112,6 +113,11 @@ Proxy::Proxy(SipStack& stack,
       addSupportedOption("outbound");
    }
 
+   for(unsigned int i = 0; i < resipMax(mNumWorkerThreads, 1u); i++)
+   {
+      mWorkers.push_back(new WorkerThread(*this, i));
+   }
+
    // Create Accounting Collector if enabled
    if(mSessionAccountingEnabled || mRegistrationAccountingEnabled)
    {
@@ -124,7 +130,15 @@ Proxy::~Proxy()
    shutdown();
    join();
    delete mAccountingCollector;
-   InfoLog (<< "Proxy::thread shutdown with " << mServerRequestContexts.size() << " ServerRequestContexts and " << mClientRequestContexts.size() << " ClientRequestContexts.");
+   size_t serverRequestContexts = 0;
+   size_t clientRequestContexts = 0;
+   for(std::vector<WorkerThread*>::iterator it = mWorkers.begin(); it != mWorkers.end(); it++)
+   {
+      serverRequestContexts += (*it)->mServerRequestContexts.size();
+      clientRequestContexts += (*it)->mClientRequestContexts.size();
+      delete *it;
+   }
+   InfoLog (<< "Proxy::thread shutdown with " << serverRequestContexts << " ServerRequestContexts and " << clientRequestContexts << " ClientRequestContexts.");
 }
 
 void 
@@ -156,6 +170,19 @@ Proxy::thread()
 {
    InfoLog (<< "Proxy::thread start");
 
+   if(mNumWorkerThreads > 0)
+   {
+      // Chains are readied on first use, which must not happen on several
+      // workers at once
+      mRequestProcessorChain.onChainComplete();
+      mResponseProcessorChain.onChainComplete();
+      mTargetProcessorChain.onChainComplete();
+      for(std::vector<WorkerThread*>::iterator it = mWorkers.begin(); it != mWorkers.end(); it++)
+      {
+         (*it)->run();
+      }
+   }
+
    while (!isShutdown())
    {
       Message* msg=0;
@@ -166,384 +193,531 @@ Proxy::thread()
          if ((msg = mFifo.getNext(100)) != 0)
          {
             DebugLog (<< "Got: " << *msg);
-         
-            SipMessage* sip = dynamic_cast<SipMessage*>(msg);
-            ApplicationMessage* app = dynamic_cast<ApplicationMessage*>(msg);
-            TransactionTerminated* term = dynamic_cast<TransactionTerminated*>(msg);
-         
-            if (sip)
+
+            if(mNumWorkerThreads == 0)
+            {
+               processMessage(*mWorkers.front(), msg);
+            }
+            else
             {
-               Data tid(sip->getTransactionId());
-               tid.lowercase();
-               if (sip->isRequest())
+               WorkerThread* worker = getWorker(*msg);
+               if(worker)
                {
-                  // Verify that the request has all the mandatory headers
-                  // (To, From, Call-ID, CSeq)  Via is already checked by stack.  
-                  // See RFC 3261 Section 16.3 Step 1
-                  if (!sip->exists(h_To)     ||
-                      !sip->exists(h_From)   ||
-                      !sip->exists(h_CallID) ||
-                      !sip->exists(h_CSeq)     )
-                  {
-                     // skip this message and move on to the next one
-                     delete sip;
-                     continue;  
-                  }
+                  worker->mFifo.add(msg);
+               }
+               else
+               {
+                  processUnknownMessage(msg);
+               }
+            }
+         }
+      }
+      catch (BaseException& e)
+      {
+         ErrLog (<< "Caught: " << e);
+      }
+      catch (...)
+      {
+         ErrLog (<< "Caught unknown exception");
+      }
+   }
 
-                  // The TU selector already checks the URI scheme for us (Sect 16.3, Step 2)
-                  if(sip->method()==OPTIONS && 
-                     isMyUri(sip->header(h_RequestLine).uri()))
-                  {
-                     if(mOptionsHandler)
-                     {
-                        std::unique_ptr<SipMessage> resp(new SipMessage);
-                        Helper::makeResponse(*resp,*sip,200);
-                        if(mOptionsHandler->onOptionsRequest(*sip, *resp))
-                        {
-                           mStack.send(*resp,this);
-                           delete sip;
-                           continue;
-                        }
-                     }
-                     else if(sip->header(h_RequestLine).uri().user().empty())
-                     {
-                        std::unique_ptr<SipMessage> resp(new SipMessage);
-                        Helper::makeResponse(*resp,*sip,200);
-
-                        if(resip::InteropHelper::getOutboundSupported())
-                        {
-                           resp->header(h_Supporteds).push_back(Token(Symbols::Outbound));
-                        }
-                        mStack.send(*resp,this);
-                        delete sip;
-                        continue;
-                     }
-                  }
+   if(mNumWorkerThreads > 0)
+   {
+      for(std::vector<WorkerThread*>::iterator it = mWorkers.begin(); it != mWorkers.end(); it++)
+      {
+         (*it)->shutdown();
+      }
+      for(std::vector<WorkerThread*>::iterator it = mWorkers.begin(); it != mWorkers.end(); it++)
+      {
+         (*it)->join();
+      }
+   }
+   InfoLog (<< "Proxy::thread exit");
+}
 
-                  // check the MaxForwards isn't too low
-                  if (!sip->exists(h_MaxForwards))
-                  {
-                     // .bwc. Add Max-Forwards header if not found.
-                     sip->header(h_MaxForwards).value()=20;
-                  }
-                  
-                  if(!sip->header(h_MaxForwards).isWellFormed())
-                  {
-                     //Malformed Max-Forwards! (Maybe we can be lenient and set
-                     // it to 70...)
-                     std::unique_ptr<SipMessage> response(Helper::makeResponse(*sip,400));
-                     response->header(h_StatusLine).reason()="Malformed Max-Forwards";
-                     mStack.send(*response,this);
-                     delete sip;
-                     continue;                     
-                  }
-                  
-                  // .bwc. Unacceptable values for Max-Forwards
-                  // !bwc! TODO make this ceiling configurable
-                  if(sip->header(h_MaxForwards).value() > 255)
-                  {
-                     sip->header(h_MaxForwards).value() = 20;                     
-                  }
-                  else if(sip->header(h_MaxForwards).value() <= 0)
-                  {
-                     if (sip->header(h_RequestLine).method() != OPTIONS)
-                     {
-                     std::unique_ptr<SipMessage> response(Helper::makeResponse(*sip, 483));
-                     mStack.send(*response, this);
-                     }
-                     else  // If the request is an OPTIONS, send an appropriate response
-                     {
-                        std::unique_ptr<SipMessage> response(Helper::makeResponse(*sip, 200));
-                        mStack.send(*response, this);                        
-                     }
-                     // in either case get rid of the request and process the next one
-                     delete sip;
-                     continue;
-                  }
+Proxy::WorkerThread::WorkerThread(Proxy& proxy, unsigned int index) :
+   mProxy(proxy),
+   mIndex(index)
+{
+   mFifo.setDescription("Proxy::WorkerThread::mFifo");
+}
 
-                  if(!sip->empty(h_ProxyRequires))
-                  {
-                     std::unique_ptr<SipMessage> response;
-
-                     for(Tokens::iterator i=sip->header(h_ProxyRequires).begin();
-                           i!=sip->header(h_ProxyRequires).end();
-                           ++i)
-                     {
-                        if(!i->isWellFormed() || 
-                           !mSupportedOptions.count(i->value()) )
-                        {
-                           if(!response)
-                           {
-                              response.reset(Helper::makeResponse(*sip, 420, "Bad extension"));
-                           }
-                           response->header(h_Unsupporteds).push_back(*i);
-                        }
-                     }
-
-                     if(response)
-                     {
-                        mStack.send(*response, this);
-                        delete sip;
-                        continue;
-                     }
-                  }
-                  
-                  
-                  if (sip->method() == CANCEL)
-                  {
-                     RequestContextMap::iterator i = mServerRequestContexts.find(tid);
-
-                     if(i == mServerRequestContexts.end())
-                     {
-                        SipMessage response;
-                        Helper::makeResponse(response,*sip,481);
-                        mStack.send(response,this);
-                        delete sip;
-                     }
-                     else
-                     {
-                        try
-                        {
-                           i->second->process(std::unique_ptr<resip::SipMessage>(sip));
-                        }
-                        catch(resip::BaseException& e)
-                        {
-                           // .bwc. Some sort of unhandled error in process.
-                           // This is very bad; we cannot form a response 
-                           // at this point because we do not know
-                           // whether the original request still exists.
-                           ErrLog(<<"Uncaught exception in process on a CANCEL "
-                                    "request: " << e);
-                           mStack.abandonServerTransaction(tid);
-                        }
-                     }
-                  }
-                  else if (sip->method() == ACK)
-                  {
-                     // .bwc. This is going to be treated as a new transaction.
-                     // The stack is maintaining no state whatsoever for this.
-                     // We should treat this exactly like a new transaction.
-                     if(sip->mIsBadAck200)
-                     {
-                        static Data ack("ack");
-                        tid+=ack;
-                     }
-                     
-                     RequestContext* context=0;
-                     RequestContextMap::iterator i = mServerRequestContexts.find(tid);
-                     
-                     // .bwc. This might be an ACK/200, or a stray ACK/failure
-                     if(i == mServerRequestContexts.end())
-                     {
-                        context = mRequestContextFactory->createRequestContext(*this, 
-                                                     mRequestProcessorChain, 
-                                                     mResponseProcessorChain, 
-                                                     mTargetProcessorChain);
-                        mServerRequestContexts[tid] = context;
-                     }
-                     else // .bwc. ACK/failure
-                     {
-                        context = i->second;
-                     }
-
-                     // The stack will send TransactionTerminated messages for
-                     // client and server transaction which will clean up this
-                     // RequestContext 
-                     try
-                     {
-                        context->process(std::unique_ptr<resip::SipMessage>(sip));
-                     }
-                     catch(resip::BaseException& e)
-                     {
-                        // .bwc. Some sort of unhandled error in process.
-                        ErrLog(<<"Uncaught exception in process on an ACK "
-                                 "request: " << e);
-                     }
-                  }
-                  else
-                  {
-                     // This is a new request, so create a Request Context for it
-                     InfoLog (<< "New RequestContext tid=" << tid << " : " << sip->brief());
-                     
-
-                     if(mServerRequestContexts.count(tid) == 0)
-                     {
-                        RequestContext* context = mRequestContextFactory->createRequestContext(*this,
-                                                                     mRequestProcessorChain, 
-                                                                     mResponseProcessorChain, 
-                                                                     mTargetProcessorChain);
-                        InfoLog (<< "Inserting new RequestContext tid=" << tid
-                                  << " -> " << *context);
-                        mServerRequestContexts[tid] = context;
-                        //DebugLog (<< "RequestContexts: " << InserterP(mServerRequestContexts));  For a busy proxy - this generates a HUGE log statement!
-                        try
-                        {
-                           context->process(std::unique_ptr<resip::SipMessage>(sip));
-                        }
-                        catch(resip::BaseException& e)
-                        {
-                           // .bwc. Some sort of unhandled error in process.
-                           // This is very bad; we cannot form a response 
-                           // at this point because we do not know
-                           // whether the original request still exists.
-                           ErrLog(<<"Uncaught exception in process on a new "
-                                    "request: " << e);
-                           mStack.abandonServerTransaction(tid);
-                        }
-                     }
-                     else
-                     {
-                        InfoLog(<<"Got a new non-ACK request "
-                        "with an already existing transaction ID. This can "
-                        "happen if a new request collides with a previously "
-                        "received ACK/200.");
-                        SipMessage response;
-                        Helper::makeResponse(response,*sip,400,"Transaction-id "
-                                                         "collision");
-                        mStack.send(response,this);
-                        delete sip;
-                     }
-                  }
+void
+Proxy::WorkerThread::thread()
+{
+   InfoLog (<< "Proxy::WorkerThread " << mIndex << " start");
+
+   while (!isShutdown())
+   {
+      try
+      {
+         Message* msg = mFifo.getNext(100);
+         if (msg)
+         {
+            mProxy.processMessage(*this, msg);
+         }
+      }
+      catch (BaseException& e)
+      {
+         ErrLog (<< "Caught: " << e);
+      }
+      catch (...)
+      {
+         ErrLog (<< "Caught unknown exception");
+      }
+   }
+   InfoLog (<< "Proxy::WorkerThread " << mIndex << " exit");
+}
+
+Proxy::WorkerThread*
+Proxy::getWorker(const Message& msg)
+{
+   const SipMessage* sip = dynamic_cast<const SipMessage*>(&msg);
+   const ApplicationMessage* app = dynamic_cast<const ApplicationMessage*>(&msg);
+   const TransactionTerminated* term = dynamic_cast<const TransactionTerminated*>(&msg);
+
+   if (sip)
+   {
+      Data tid(sip->getTransactionId());
+      tid.lowercase();
+      if (sip->isResponse())
+      {
+         return getClientTransactionWorker(tid);
+      }
+      if (sip->method() == ACK && sip->mIsBadAck200)
+      {
+         static Data ack("ack");
+         tid+=ack;
+      }
+      return getServerTransactionWorker(tid);
+   }
+   else if (app)
+   {
+      // timers and async results may be for either side
+      Data tid(app->getTransactionId());
+      tid.lowercase();
+      {
+         Lock lock(mClientTransactionWorkersMutex);
+         WorkerMap::iterator i = mClientTransactionWorkers.find(tid);
+         if (i != mClientTransactionWorkers.end())
+         {
+            return i->second;
+         }
+      }
+      return getServerTransactionWorker(tid);
+   }
+   else if (term)
+   {
+      Data tid(term->getTransactionId());
+      tid.lowercase();
+      if (term->isClientTransaction())
+      {
+         return getClientTransactionWorker(tid);
+      }
+      return getServerTransactionWorker(tid);
+   }
+   return 0;
+}
+
+Proxy::WorkerThread*
+Proxy::getServerTransactionWorker(const Data& tid)
+{
+   return mWorkers[tid.hash() % mWorkers.size()];
+}
+
+Proxy::WorkerThread*
+Proxy::getClientTransactionWorker(const Data& tid)
+{
+   Lock lock(mClientTransactionWorkersMutex);
+   WorkerMap::iterator i = mClientTransactionWorkers.find(tid);
+   if (i != mClientTransactionWorkers.end())
+   {
+      return i->second;
+   }
+   // Stray, any worker can throw it away
+   return mWorkers.front();
+}
+
+void
+Proxy::removeClientTransaction(WorkerThread& worker, RequestContextMap::iterator i)
+{
+   if (mNumWorkerThreads > 0)
+   {
+      Lock lock(mClientTransactionWorkersMutex);
+      mClientTransactionWorkers.erase(i->first);
+   }
+   worker.mClientRequestContexts.erase(i);
+}
+
+void
+Proxy::processMessage(WorkerThread& worker, Message* msg)
+{
+   SipMessage* sip = dynamic_cast<SipMessage*>(msg);
+   ApplicationMessage* app = dynamic_cast<ApplicationMessage*>(msg);
+   TransactionTerminated* term = dynamic_cast<TransactionTerminated*>(msg);
+
+   if (sip)
+   {
+      Data tid(sip->getTransactionId());
+      tid.lowercase();
+      if (sip->isRequest())
+      {
+         // Verify that the request has all the mandatory headers
+         // (To, From, Call-ID, CSeq)  Via is already checked by stack.  
+         // See RFC 3261 Section 16.3 Step 1
+         if (!sip->exists(h_To)     ||
+             !sip->exists(h_From)   ||
+             !sip->exists(h_CallID) ||
+             !sip->exists(h_CSeq)     )
+         {
+            // skip this message and move on to the next one
+            delete sip;
+            return;  
+         }
+
+         // The TU selector already checks the URI scheme for us (Sect 16.3, Step 2)
+         if(sip->method()==OPTIONS && 
+            isMyUri(sip->header(h_RequestLine).uri()))
+         {
+            if(mOptionsHandler)
+            {
+               std::unique_ptr<SipMessage> resp(new SipMessage);
+               Helper::makeResponse(*resp,*sip,200);
+               if(mOptionsHandler->onOptionsRequest(*sip, *resp))
+               {
+                  mStack.send(*resp,this);
+                  delete sip;
+                  return;
                }
-               else if (sip->isResponse())
+            }
+            else if(sip->header(h_RequestLine).uri().user().empty())
+            {
+               std::unique_ptr<SipMessage> resp(new SipMessage);
+               Helper::makeResponse(*resp,*sip,200);
+
+               if(resip::InteropHelper::getOutboundSupported())
                {
-                  InfoLog (<< "Looking up RequestContext tid=" << tid);
-               
-                  // TODO  is there a problem with a stray 200?
-                  RequestContextMap::iterator i = mClientRequestContexts.find(tid);
-                  if (i != mClientRequestContexts.end())
-                  {
-                     try
-                     {
-                        i->second->process(std::unique_ptr<resip::SipMessage>(sip));
-                     }
-                     catch(resip::BaseException& e)
-                     {
-                        // .bwc. Some sort of unhandled error in process.
-                        ErrLog(<<"Uncaught exception in process on a response: " << e);
-                     }
-                  }
-                  else
-                  {
-                     // throw away stray responses
-                     InfoLog (<< "Unmatched response (stray?) : " << endl << *msg);
-                     delete sip;  
-                  }
+                  resp->header(h_Supporteds).push_back(Token(Symbols::Outbound));
                }
+               mStack.send(*resp,this);
+               delete sip;
+               return;
+            }
+         }
+
+         // check the MaxForwards isn't too low
+         if (!sip->exists(h_MaxForwards))
+         {
+            // .bwc. Add Max-Forwards header if not found.
+            sip->header(h_MaxForwards).value()=20;
+         }
+
+         if(!sip->header(h_MaxForwards).isWellFormed())
+         {
+            //Malformed Max-Forwards! (Maybe we can be lenient and set
+            // it to 70...)
+            std::unique_ptr<SipMessage> response(Helper::makeResponse(*sip,400));
+            response->header(h_StatusLine).reason()="Malformed Max-Forwards";
+            mStack.send(*response,this);
+            delete sip;
+            return;                     
+         }
+
+         // .bwc. Unacceptable values for Max-Forwards
+         // !bwc! TODO make this ceiling configurable
+         if(sip->header(h_MaxForwards).value() > 255)
+         {
+            sip->header(h_MaxForwards).value() = 20;                     
+         }
+         else if(sip->header(h_MaxForwards).value() <= 0)
+         {
+            if (sip->header(h_RequestLine).method() != OPTIONS)
+            {
+            std::unique_ptr<SipMessage> response(Helper::makeResponse(*sip, 483));
+            mStack.send(*response, this);
+            }
+            else  // If the request is an OPTIONS, send an appropriate response
+            {
+               std::unique_ptr<SipMessage> response(Helper::makeResponse(*sip, 200));
+               mStack.send(*response, this);                        
             }
-            else if (app)
+            // in either case get rid of the request and process the next one
+            delete sip;
+            return;
+         }
+
+         if(!sip->empty(h_ProxyRequires))
+         {
+            std::unique_ptr<SipMessage> response;
+
+            for(Tokens::iterator i=sip->header(h_ProxyRequires).begin();
+                  i!=sip->header(h_ProxyRequires).end();
+                  ++i)
             {
-               Data tid(app->getTransactionId());
-               tid.lowercase();
-               DebugLog(<< "Trying to dispatch : " << *app );
-               RequestContextMap::iterator i = mServerRequestContexts.find(tid);
-               // the underlying RequestContext may not exist
-               if (i != mServerRequestContexts.end())
+               if(!i->isWellFormed() || 
+                  !mSupportedOptions.count(i->value()) )
                {
-                  DebugLog(<< "Sending " << *app << " to " << *(i->second));
-                  // This goes in as a Message and not an ApplicationMessage
-                  // so that we have one peice of code doing dispatch to Monkeys
-                  // (the intent is that Monkeys may eventually handle non-SIP
-                  //  application messages).
-                  bool eraseThisTid =  (dynamic_cast<Ack200DoneMessage*>(app)!=0);
-                  try
-                  {
-                     i->second->process(std::unique_ptr<resip::ApplicationMessage>(app));
-                  }
-                  catch(resip::BaseException& e)
-                  {
-                     ErrLog(<<"Uncaught exception in process: " << e);
-                  }
-                  
-                  if (eraseThisTid)
+                  if(!response)
                   {
-                     mServerRequestContexts.erase(i);
+                     response.reset(Helper::makeResponse(*sip, 420, "Bad extension"));
                   }
+                  response->header(h_Unsupporteds).push_back(*i);
                }
-               else
+            }
+
+            if(response)
+            {
+               mStack.send(*response, this);
+               delete sip;
+               return;
+            }
+         }
+
+
+         if (sip->method() == CANCEL)
+         {
+            RequestContextMap::iterator i = worker.mServerRequestContexts.find(tid);
+
+            if(i == worker.mServerRequestContexts.end())
+            {
+               SipMessage response;
+               Helper::makeResponse(response,*sip,481);
+               mStack.send(response,this);
+               delete sip;
+            }
+            else
+            {
+               try
+               {
+                  i->second->process(std::unique_ptr<resip::SipMessage>(sip));
+               }
+               catch(resip::BaseException& e)
                {
-                   RequestContextMap::iterator i = mClientRequestContexts.find(tid);
-                   if (i != mClientRequestContexts.end())
-                   {
-                       DebugLog(<< "Sending " << *app << " to " << *(i->second));
-                       try
-                       {
-                           i->second->process(std::unique_ptr<resip::ApplicationMessage>(app));
-                       }
-                       catch (resip::BaseException &e)
-                       {
-                           ErrLog(<< "Uncaught exception in process: " << e);
-                       }
-                   }
-                   else
-                   {
-                       InfoLog(<< "No matching request context...ignoring " << *app);
-                       delete app;
-                   }
+                  // .bwc. Some sort of unhandled error in process.
+                  // This is very bad; we cannot form a response 
+                  // at this point because we do not know
+                  // whether the original request still exists.
+                  ErrLog(<<"Uncaught exception in process on a CANCEL "
+                           "request: " << e);
+                  mStack.abandonServerTransaction(tid);
                }
             }
-            else if (term)
+         }
+         else if (sip->method() == ACK)
+         {
+            // .bwc. This is going to be treated as a new transaction.
+            // The stack is maintaining no state whatsoever for this.
+            // We should treat this exactly like a new transaction.
+            if(sip->mIsBadAck200)
+            {
+               static Data ack("ack");
+               tid+=ack;
+            }
+
+            RequestContext* context=0;
+            RequestContextMap::iterator i = worker.mServerRequestContexts.find(tid);
+
+            // .bwc. This might be an ACK/200, or a stray ACK/failure
+            if(i == worker.mServerRequestContexts.end())
+            {
+               context = mRequestContextFactory->createRequestContext(*this, 
+                                            mRequestProcessorChain, 
+                                            mResponseProcessorChain, 
+                                            mTargetProcessorChain);
+               worker.mServerRequestContexts[tid] = context;
+            }
+            else // .bwc. ACK/failure
+            {
+               context = i->second;
+            }
+
+            // The stack will send TransactionTerminated messages for
+            // client and server transaction which will clean up this
+            // RequestContext 
+            try
+            {
+               context->process(std::unique_ptr<resip::SipMessage>(sip));
+            }
+            catch(resip::BaseException& e)
+            {
+               // .bwc. Some sort of unhandled error in process.
+               ErrLog(<<"Uncaught exception in process on an ACK "
+                        "request: " << e);
+            }
+         }
+         else
+         {
+            // This is a new request, so create a Request Context for it
+            InfoLog (<< "New RequestContext tid=" << tid << " : " << sip->brief());
+
+
+            if(worker.mServerRequestContexts.count(tid) == 0)
             {
-               Data tid(term->getTransactionId());
-               tid.lowercase();
-               if (term->isClientTransaction())
+               RequestContext* context = mRequestContextFactory->createRequestContext(*this,
+                                                            mRequestProcessorChain, 
+                                                            mResponseProcessorChain, 
+                                                            mTargetProcessorChain);
+               InfoLog (<< "Inserting new RequestContext tid=" << tid
+                         << " -> " << *context);
+               worker.mServerRequestContexts[tid] = context;
+               //DebugLog (<< "RequestContexts: " << InserterP(worker.mServerRequestContexts));  For a busy proxy - this generates a HUGE log statement!
+               try
                {
-                  RequestContextMap::iterator i = mClientRequestContexts.find(tid);
-                  if (i != mClientRequestContexts.end())
-                  {
-                     try
-                     {
-                        i->second->process(*term);
-                     }
-                     catch(resip::BaseException& e)
-                     {
-                        ErrLog(<<"Uncaught exception in process: " << e);
-                     }
-                     mClientRequestContexts.erase(i);
-                  }
-                  else
-                  {
-                     InfoLog (<< "No matching request context...ignoring " << *term);
-                  }
+                  context->process(std::unique_ptr<resip::SipMessage>(sip));
                }
-               else 
+               catch(resip::BaseException& e)
                {
-                  RequestContextMap::iterator i = mServerRequestContexts.find(tid);
-                  if (i != mServerRequestContexts.end())
-                  {
-                     try
-                     {
-                        i->second->process(*term);
-                     }
-                     catch(resip::BaseException& e)
-                     {
-                        ErrLog(<<"Uncaught exception in process: " << e);
-                     }
-                     mServerRequestContexts.erase(i);
-                  }
-                  else
-                  {
-                     InfoLog (<< "No matching request context...ignoring " << *term);
-                  }
+                  // .bwc. Some sort of unhandled error in process.
+                  // This is very bad; we cannot form a response 
+                  // at this point because we do not know
+                  // whether the original request still exists.
+                  ErrLog(<<"Uncaught exception in process on a new "
+                           "request: " << e);
+                  mStack.abandonServerTransaction(tid);
                }
-               delete term;
             }
             else
             {
-               processUnknownMessage(msg);
+               InfoLog(<<"Got a new non-ACK request "
+               "with an already existing transaction ID. This can "
+               "happen if a new request collides with a previously "
+               "received ACK/200.");
+               SipMessage response;
+               Helper::makeResponse(response,*sip,400,"Transaction-id "
+                                                "collision");
+               mStack.send(response,this);
+               delete sip;
             }
          }
       }
-      catch (BaseException& e)
+      else if (sip->isResponse())
       {
-         ErrLog (<< "Caught: " << e);
+         InfoLog (<< "Looking up RequestContext tid=" << tid);
+
+         // TODO  is there a problem with a stray 200?
+         RequestContextMap::iterator i = worker.mClientRequestContexts.find(tid);
+         if (i != worker.mClientRequestContexts.end())
+         {
+            try
+            {
+               i->second->process(std::unique_ptr<resip::SipMessage>(sip));
+            }
+            catch(resip::BaseException& e)
+            {
+               // .bwc. Some sort of unhandled error in process.
+               ErrLog(<<"Uncaught exception in process on a response: " << e);
+            }
+         }
+         else
+         {
+            // throw away stray responses
+            InfoLog (<< "Unmatched response (stray?) : " << endl << *msg);
+            delete sip;  
+         }
       }
-      catch (...)
+   }
+   else if (app)
+   {
+      Data tid(app->getTransactionId());
+      tid.lowercase();
+      DebugLog(<< "Trying to dispatch : " << *app );
+      RequestContextMap::iterator i = worker.mServerRequestContexts.find(tid);
+      // the underlying RequestContext may not exist
+      if (i != worker.mServerRequestContexts.end())
       {
-         ErrLog (<< "Caught unknown exception");
+         DebugLog(<< "Sending " << *app << " to " << *(i->second));
+         // This goes in as a Message and not an ApplicationMessage
+         // so that we have one peice of code doing dispatch to Monkeys
+         // (the intent is that Monkeys may eventually handle non-SIP
+         //  application messages).
+         bool eraseThisTid =  (dynamic_cast<Ack200DoneMessage*>(app)!=0);
+         try
+         {
+            i->second->process(std::unique_ptr<resip::ApplicationMessage>(app));
+         }
+         catch(resip::BaseException& e)
+         {
+            ErrLog(<<"Uncaught exception in process: " << e);
+         }
+
+         if (eraseThisTid)
+         {
+            worker.mServerRequestContexts.erase(i);
+         }
+      }
+      else
+      {
+          RequestContextMap::iterator i = worker.mClientRequestContexts.find(tid);
+          if (i != worker.mClientRequestContexts.end())
+          {
+              DebugLog(<< "Sending " << *app << " to " << *(i->second));
+              try
+              {
+                  i->second->process(std::unique_ptr<resip::ApplicationMessage>(app));
+              }
+              catch (resip::BaseException &e)
+              {
+                  ErrLog(<< "Uncaught exception in process: " << e);
+              }
+          }
+          else
+          {
+              InfoLog(<< "No matching request context...ignoring " << *app);
+              delete app;
+          }
       }
    }
-   InfoLog (<< "Proxy::thread exit");
+   else if (term)
+   {
+      Data tid(term->getTransactionId());
+      tid.lowercase();
+      if (term->isClientTransaction())
+      {
+         RequestContextMap::iterator i = worker.mClientRequestContexts.find(tid);
+         if (i != worker.mClientRequestContexts.end())
+         {
+            try
+            {
+               i->second->process(*term);
+            }
+            catch(resip::BaseException& e)
+            {
+               ErrLog(<<"Uncaught exception in process: " << e);
+            }
+            removeClientTransaction(worker, i);
+         }
+         else
+         {
+            InfoLog (<< "No matching request context...ignoring " << *term);
+         }
+      }
+      else 
+      {
+         RequestContextMap::iterator i = worker.mServerRequestContexts.find(tid);
+         if (i != worker.mServerRequestContexts.end())
+         {
+            try
+            {
+               i->second->process(*term);
+            }
+            catch(resip::BaseException& e)
+            {
+               ErrLog(<<"Uncaught exception in process: " << e);
+            }
+            worker.mServerRequestContexts.erase(i);
+         }
+         else
+         {
+            InfoLog (<< "No matching request context...ignoring " << *term);
+         }
+      }
+      delete term;
+   }
+   else
+   {
+      processUnknownMessage(msg);
+   }
 }
 
 void
@@ -562,10 +736,24 @@ Proxy::send(const SipMessage& msg)
 void
 Proxy::addClientTransaction(const Data& transactionId, RequestContext* rc)
 {
-   if(mClientRequestContexts.count(transactionId) == 0)
+   // Called while processing rc, so from the worker that owns it
+   WorkerThread* worker = mWorkers.front();
+   if(mNumWorkerThreads > 0)
+   {
+      Data serverTid(rc->getTransactionId());
+      serverTid.lowercase();
+      worker = getServerTransactionWorker(serverTid);
+   }
+   if(worker->mClientRequestContexts.count(transactionId) == 0)
    {
       InfoLog (<< "add client transaction tid=" << transactionId << " " << rc);
-      mClientRequestContexts[transactionId] = rc;
+      worker->mClientRequestContexts[transactionId] = rc;
+      if(mNumWorkerThreads > 0)
+      {
+         // before the request is sent, so the response finds its way back
+         Lock lock(mClientTransactionWorkersMutex);
+         mClientTransactionWorkers[transactionId] = worker;
+      }
    }
    else
    {
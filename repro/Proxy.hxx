@@ -3,9 +3,11 @@
 
 #include <memory>
 #include <map>
+#include <vector>
 
 #include "resip/stack/SipMessage.hxx"
 #include "resip/stack/TransactionUser.hxx"
+#include "rutil/Fifo.hxx"
 #include "rutil/HashMap.hxx"
 #include "rutil/Mutex.hxx"
 #include "rutil/ThreadIf.hxx"
@@ -72,6 +74,10 @@ class Proxy : public resip::TransactionUser, public resip::ThreadIf
 
       virtual bool isShutDown() const;
       virtual void thread();
+
+      // Number of threads RequestContexts are processed on, set with
+      // NumProxyWorkerThreads; 0 if they are processed on the Proxy thread
+      unsigned int getNumWorkerThreads() const { return mNumWorkerThreads; }
       
       virtual bool isMyUri(const resip::Uri& uri) const;
       void addTransportRecordRoute(unsigned int transportKey, const resip::NameAddr& recordRoute);
@@ -110,6 +116,41 @@ class Proxy : public resip::TransactionUser, public resip::ThreadIf
       virtual void processUnknownMessage(resip::Message* msg);
 
    protected:
+      typedef HashMap<resip::Data, RequestContext*> RequestContextMap;
+
+      /** With NumProxyWorkerThreads set, RequestContexts are processed on a
+          pool of these instead of on the Proxy thread, which only hands
+          messages out.  A RequestContext belongs to the worker its server
+          transaction id hashes to, and every message for it (requests,
+          responses, timers and TransactionTerminated) goes to that worker,
+          so a RequestContext and its maps are only used from one thread.
+          Processors, on the other hand, are called from all of them.
+      */
+      class WorkerThread : public resip::ThreadIf
+      {
+         public:
+            WorkerThread(Proxy& proxy, unsigned int index);
+            virtual void thread();
+
+            Proxy& mProxy;
+            unsigned int mIndex;
+            resip::Fifo<resip::Message> mFifo;
+
+            /** a map from transaction id to RequestContext. Store the server
+                transaction and client transactions in this map. The
+                TransactionTerminated events from the stack will be passed to the
+                RequestContext
+            */
+            RequestContextMap mClientRequestContexts;
+            RequestContextMap mServerRequestContexts;
+      };
+
+      void processMessage(WorkerThread& worker, resip::Message* msg);
+      WorkerThread* getWorker(const resip::Message& msg);
+      WorkerThread* getServerTransactionWorker(const resip::Data& tid);
+      WorkerThread* getClientTransactionWorker(const resip::Data& tid);
+      void removeClientTransaction(WorkerThread& worker, RequestContextMap::iterator i);
+
       virtual const resip::Data& name() const;
 
       resip::SipStack& mStack;
@@ -131,15 +172,6 @@ class Proxy : public resip::TransactionUser, public resip::ThreadIf
       ProcessorChain& mResponseProcessorChain;
       ProcessorChain& mTargetProcessorChain;
       
-      /** a map from transaction id to RequestContext. Store the server
-          transaction and client transactions in this map. The
-          TransactionTerminated events from the stack will be passed to the
-          RequestContext
-      */
-      typedef HashMap<resip::Data, RequestContext*> RequestContextMap;
-      RequestContextMap mClientRequestContexts;
-      RequestContextMap mServerRequestContexts;
-      
       UserStore &mUserStore;
       std::set<resip::Data> mSupportedOptions;
       OptionsHandler* mOptionsHandler;
@@ -149,6 +181,17 @@ class Proxy : public resip::TransactionUser, public resip::ThreadIf
       bool mRegistrationAccountingEnabled;
       AccountingCollector* mAccountingCollector;
 
+      // mWorkers always has at least one entry; with no worker threads
+      // its maps are used from the Proxy thread and it is never run
+      unsigned int mNumWorkerThreads;
+      std::vector<WorkerThread*> mWorkers;
+
+      // which worker owns each client transaction, for handing out
+      // responses to it (only kept with worker threads)
+      typedef HashMap<resip::Data, WorkerThread*> WorkerMap;
+      WorkerMap mClientTransactionWorkers;
+      resip::Mutex mClientTransactionWorkersMutex;
+
       // disabled
       Proxy();
 };
@@ -29,7 +29,8 @@ RegSyncClient::RegSyncClient(InMemorySyncRegDb* regDb,
    mPubDb(pubDb),
    mAddress(address),
    mPort(port),
-   mSocketDesc(0)
+   mSocketDesc(0),
+   mBinaryEncoding(true)
 {
     resip_assert(mRegDb);
 }
@@ -124,9 +125,20 @@ RegSyncClient::thread()
       Data request(
          "<InitialSync>\r\n"
          "  <Request>\r\n"
-         "     <Version>" + Data(REGSYNC_VERSION) + "</Version>\r\n"   // For use in detecting if client/server are a compatible version
-         "  </Request>\r\n"
-         "</InitialSync>\r\n");   
+         "     <Version>" + Data(REGSYNC_VERSION) + "</Version>\r\n");   // For use in detecting if client/server are a compatible version
+      if(mBinaryEncoding)
+      {
+         // Older servers ignore these and carry on with XML
+         request += "     <Encoding>binary</Encoding>\r\n";
+         if(mDeltaDecoder.getInstanceId() != 0)
+         {
+            // Reconnecting - the server sends only what we missed, if it still can
+            request += "     <Instance>" + Data(mDeltaDecoder.getInstanceId()) + "</Instance>\r\n"
+                       "     <Sequence>" + Data(mDeltaDecoder.getLastSequence()) + "</Sequence>\r\n";
+         }
+      }
+      request += "  </Request>\r\n"
+                 "</InitialSync>\r\n";
       rc = ::send(mSocketDesc, request.c_str(), (int)request.size(), 0);
       if(rc < 0) 
       {
@@ -225,12 +237,21 @@ RegSyncClient::tryParse()
       if(!pb.eof())
       {
          initialTag = pb.data(anchor);
+         const char* content = pb.position() + 1;
          // Find end of initial tag
          pb.skipToChars("</" + initialTag + ">");
          if (!pb.eof())
          {
-            pb.skipN((int)initialTag.size() + 3);  // Skip past </InitialTag>            
-            handleXml(pb.data(start));
+            if(isEqualNoCase(initialTag, RegSyncDelta::BatchTag))
+            {
+               handleDeltaBatch(pb.data(content).base64decode());
+               pb.skipN((int)initialTag.size() + 3);  // Skip past </InitialTag>
+            }
+            else
+            {
+               pb.skipN((int)initialTag.size() + 3);  // Skip past </InitialTag>            
+               handleXml(pb.data(start));
+            }
 
             // Remove processed data from RxBuffer
             pb.skipWhitespace();
@@ -299,6 +320,23 @@ RegSyncClient::handleXml(const Data& xmlData)
    }
 }
 
+void
+RegSyncClient::handleDeltaBatch(const Data& batch)
+{
+   std::vector<RegSyncDeltaDecoder::Change> changes;
+   if(!mDeltaDecoder.decodeBatch(batch, changes))
+   {
+      WarningLog(<< "RegSyncClient::handleDeltaBatch: Ignoring batch that could not be decoded, size=" << batch.size());
+   }
+   // Whatever was decoded before an error is still good
+   for(std::vector<RegSyncDeltaDecoder::Change>::const_iterator it = changes.begin(); it != changes.end(); it++)
+   {
+      ContactList contacts;
+      contacts.push_back(it->mContact);
+      processModify(it->mAor, contacts);
+   }
+}
+
 void 
 RegSyncClient::handleRegInfoEvent(resip::XMLCursor& xml)
 {
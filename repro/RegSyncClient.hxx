@@ -6,6 +6,7 @@
 #include <resip/dum/InMemorySyncRegDb.hxx>
 #include <resip/dum/InMemorySyncPubDb.hxx>
 #include <rutil/ThreadIf.hxx>
+#include "repro/RegSyncDelta.hxx"
 
 namespace repro
 {
@@ -21,10 +22,15 @@ public:
    virtual void thread();
    virtual void shutdown();
 
+   // Ask the server for the RegSyncDelta binary encoding (default); servers
+   // that do not support it ignore the request and send XML.  Call before run().
+   void setBinaryEncoding(bool enabled) { mBinaryEncoding = enabled; }
+
 private: 
    void delaySeconds(unsigned int seconds);
    bool tryParse();  // returns true if we processed something and there is more data in the buffer
    void handleXml(const resip::Data& xmlData);
+   void handleDeltaBatch(const resip::Data& batch);
    void handleRegInfoEvent(resip::XMLCursor& xml);
    void handlePubInfoEvent(resip::XMLCursor& xml);
    void processModify(const resip::Uri& aor, resip::ContactList& syncContacts);
@@ -36,6 +42,8 @@ private:
    char mRxBuffer[8000];
    resip::Data mRxDataBuffer;
    int mSocketDesc;
+   bool mBinaryEncoding;
+   RegSyncDeltaDecoder mDeltaDecoder;
 };
 
 }
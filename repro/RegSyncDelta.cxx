@@ -0,0 +1,545 @@
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <resip/stack/NameAddr.hxx>
+#include <resip/stack/Symbols.hxx>
+#include <resip/stack/Tuple.hxx>
+#include <rutil/DataStream.hxx>
+#include <rutil/Logger.hxx>
+#include <rutil/ParseException.hxx>
+#include <rutil/Timer.hxx>
+
+#include "repro/RegSyncDelta.hxx"
+
+using namespace repro;
+using namespace resip;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::REPRO
+
+const Data RegSyncDelta::BatchTag("regsyncbatch");
+
+// Integers are written as LEB128 varints, strings as a varint length
+// followed by the bytes.
+static void
+encodeVarint(Data& out, uint64_t value)
+{
+   char buf[10];
+   int len = 0;
+   do
+   {
+      unsigned char byte = (unsigned char)(value & 0x7f);
+      value >>= 7;
+      if(value)
+      {
+         byte |= 0x80;
+      }
+      buf[len++] = (char)byte;
+   } while(value);
+   out.append(buf, len);
+}
+
+static void
+encodeString(Data& out, const Data& value)
+{
+   encodeVarint(out, value.size());
+   out.append(value.data(), value.size());
+}
+
+class OpDecoder
+{
+public:
+   OpDecoder(const Data& data) : mPos(data.data()), mEnd(data.data() + data.size()), mOk(true) {}
+
+   uint64_t getVarint()
+   {
+      uint64_t value = 0;
+      for(int shift = 0; shift < 64; shift += 7)
+      {
+         if(mPos == mEnd)
+         {
+            mOk = false;
+            return 0;
+         }
+         unsigned char byte = (unsigned char)*mPos++;
+         value |= (uint64_t)(byte & 0x7f) << shift;
+         if(!(byte & 0x80))
+         {
+            return value;
+         }
+      }
+      mOk = false;
+      return 0;
+   }
+   Data getString()
+   {
+      uint64_t size = getVarint();
+      if(!mOk || size > (uint64_t)(mEnd - mPos))
+      {
+         mOk = false;
+         return Data::Empty;
+      }
+      Data value(mPos, (Data::size_type)size);
+      mPos += size;
+      return value;
+   }
+   unsigned char getByte()
+   {
+      if(mPos == mEnd)
+      {
+         mOk = false;
+         return 0;
+      }
+      return (unsigned char)*mPos++;
+   }
+   bool good() const { return mOk; }
+   bool atEnd() const { return mPos == mEnd; }
+
+private:
+   const char* mPos;
+   const char* mEnd;
+   bool mOk;
+};
+
+// How ContactInstanceRecord::operator== tells contacts apart
+static Data
+contactIdentity(const ContactInstanceRecord& rec)
+{
+   if(!rec.mInstance.empty())
+   {
+      if(rec.mRegId != 0)
+      {
+         return rec.mInstance + ";" + Data(rec.mRegId);
+      }
+      return rec.mInstance;
+   }
+   return "<" + Data::from(rec.mContact.uri());
+}
+
+static size_t
+contactDetailHash(const ContactInstanceRecord& rec)
+{
+   Data details;
+   {
+      DataStream ds(details);
+      ds << rec.mContact << '|' << rec.mReceivedFrom << '|' << rec.mPublicAddress << '|' << rec.mUserAgent;
+      for(NameAddrs::const_iterator it = rec.mSipPath.begin(); it != rec.mSipPath.end(); it++)
+      {
+         ds << '|' << *it;
+      }
+   }
+   return details.hash();
+}
+
+static uint64_t
+expiresIn(const ContactInstanceRecord& rec, uint64_t now)
+{
+   // If contact is expired or removed, then pass expires time as 0
+   return (rec.mRegExpires == 0 || rec.mRegExpires <= now) ? 0 : rec.mRegExpires - now;
+}
+
+static uint64_t
+age(const ContactInstanceRecord& rec, uint64_t now)
+{
+   return rec.mLastUpdated < now ? now - rec.mLastUpdated : 0;
+}
+
+static void
+encodeAdded(Data& ops, uint32_t id, const Data& aor, const ContactInstanceRecord& rec, uint64_t now)
+{
+   encodeVarint(ops, RegSyncDelta::Added);
+   encodeVarint(ops, id);
+   encodeString(ops, aor);
+   encodeString(ops, Data::from(rec.mContact));
+   encodeVarint(ops, expiresIn(rec, now));
+   encodeVarint(ops, age(rec, now));
+   Data token;
+   if(rec.mReceivedFrom.getPort() != 0)
+   {
+      Tuple::writeBinaryToken(rec.mReceivedFrom, token);
+   }
+   encodeString(ops, token);
+   token.clear();
+   if(rec.mPublicAddress.getType() != UNKNOWN_TRANSPORT)
+   {
+      Tuple::writeBinaryToken(rec.mPublicAddress, token);
+   }
+   encodeString(ops, token);
+   encodeVarint(ops, rec.mSipPath.size());
+   for(NameAddrs::const_iterator it = rec.mSipPath.begin(); it != rec.mSipPath.end(); it++)
+   {
+      encodeString(ops, Data::from(*it));
+   }
+   encodeString(ops, rec.mInstance);
+   encodeVarint(ops, rec.mRegId);
+   encodeString(ops, rec.mUserAgent);
+}
+
+Data
+RegSyncDelta::makeEvent(const Data& batch)
+{
+   return "<" + BatchTag + ">" + batch.base64encode() + "</" + BatchTag + ">" + Symbols::CRLF;
+}
+
+bool
+RegSyncDelta::isSyncable(const ContactInstanceRecord& rec)
+{
+   // Don't sync over static registrations
+   return !rec.mReceivedFrom.onlyUseExistingConnection && rec.mRegExpires != NeverExpire;
+}
+
+RegSyncDeltaEncoder::RegSyncDeltaEncoder(uint64_t instanceId) :
+   mInstanceId(instanceId),
+   mNextId(1)
+{
+}
+
+RegSyncDeltaEncoder::SentContact&
+RegSyncDeltaEncoder::findOrAssign(SentContactList& sent, const ContactInstanceRecord& rec, bool& created)
+{
+   Data identity = contactIdentity(rec);
+   for(SentContactList::iterator it = sent.begin(); it != sent.end(); it++)
+   {
+      if(it->mIdentity == identity)
+      {
+         created = false;
+         return *it;
+      }
+   }
+   SentContact contact;
+   contact.mId = mNextId++;
+   contact.mIdentity = identity;
+   contact.mDetailHash = 0;
+   contact.mRegExpires = 0;
+   contact.mLastUpdated = 0;
+   contact.mBroadcast = false;
+   sent.push_back(contact);
+   created = true;
+   return sent.back();
+}
+
+unsigned int
+RegSyncDeltaEncoder::encodeChange(Data& ops, const Uri& aor, const ContactList& contacts)
+{
+   uint64_t now = Timer::getTimeSecs();
+   unsigned int numOps = 0;
+   SentMap::iterator it = mSent.find(aor);
+   if(it == mSent.end())
+   {
+      if(contacts.empty())
+      {
+         return 0;
+      }
+      it = mSent.insert(SentMap::value_type(aor, SentContactList())).first;
+   }
+   SentContactList& sent = it->second;
+   Data aorData;
+
+   SentContactList current;
+   current.reserve(contacts.size());
+   std::vector<bool> listed(sent.size(), false);
+   for(ContactList::const_iterator rec = contacts.begin(); rec != contacts.end(); rec++)
+   {
+      if(!RegSyncDelta::isSyncable(*rec))
+      {
+         continue;
+      }
+      Data identity = contactIdentity(*rec);
+      SentContact contact;
+      bool found = false;
+      for(SentContactList::size_type i = 0; i < sent.size(); i++)
+      {
+         if(!listed[i] && sent[i].mIdentity == identity)
+         {
+            listed[i] = true;
+            contact = sent[i];
+            found = true;
+            break;
+         }
+      }
+      if(!found)
+      {
+         contact.mId = mNextId++;
+         contact.mIdentity = identity;
+         contact.mBroadcast = false;
+      }
+
+      size_t detailHash = contactDetailHash(*rec);
+      if(!contact.mBroadcast || contact.mDetailHash != detailHash)
+      {
+         if(aorData.empty())
+         {
+            aorData = Data::from(aor);
+         }
+         encodeAdded(ops, contact.mId, aorData, *rec, now);
+         numOps++;
+      }
+      else if(contact.mRegExpires != rec->mRegExpires || contact.mLastUpdated != rec->mLastUpdated)
+      {
+         encodeVarint(ops, RegSyncDelta::Refreshed);
+         encodeVarint(ops, contact.mId);
+         encodeVarint(ops, expiresIn(*rec, now));
+         encodeVarint(ops, age(*rec, now));
+         numOps++;
+      }
+      contact.mDetailHash = detailHash;
+      contact.mRegExpires = rec->mRegExpires;
+      contact.mLastUpdated = rec->mLastUpdated;
+      contact.mBroadcast = true;
+      current.push_back(contact);
+   }
+
+   for(SentContactList::size_type i = 0; i < sent.size(); i++)
+   {
+      if(!listed[i])
+      {
+         encodeVarint(ops, RegSyncDelta::Removed);
+         encodeVarint(ops, sent[i].mId);
+         numOps++;
+      }
+   }
+
+   if(current.empty())
+   {
+      mSent.erase(it);
+   }
+   else
+   {
+      sent.swap(current);
+   }
+   return numOps;
+}
+
+unsigned int
+RegSyncDeltaEncoder::encodeFull(Data& ops, const Uri& aor, const ContactList& contacts)
+{
+   if(contacts.empty())
+   {
+      return 0;
+   }
+   uint64_t now = Timer::getTimeSecs();
+   SentContactList& sent = mSent[aor];
+   Data aorData = Data::from(aor);
+   unsigned int numOps = 0;
+   for(ContactList::const_iterator rec = contacts.begin(); rec != contacts.end(); rec++)
+   {
+      if(!RegSyncDelta::isSyncable(*rec))
+      {
+         continue;
+      }
+      // Reuse the id changes are sent under, so later Refreshed operations
+      // mean something to this client.  What changes are worked out against
+      // is left alone: other clients have not seen this.
+      bool created;
+      SentContact& contact = findOrAssign(sent, *rec, created);
+      encodeAdded(ops, contact.mId, aorData, *rec, now);
+      numOps++;
+   }
+   if(sent.empty())
+   {
+      mSent.erase(aor);
+   }
+   return numOps;
+}
+
+Data
+RegSyncDeltaEncoder::makeBatch(unsigned char flags, uint64_t sequence, const Data& ops, unsigned int numOps) const
+{
+   Data batch(ops.size() + 32, Data::Preallocate);
+   unsigned char header[2] = { RegSyncDelta::FormatVersion, flags };
+   batch.append((const char*)header, sizeof(header));
+   encodeVarint(batch, mInstanceId);
+   encodeVarint(batch, sequence);
+   encodeVarint(batch, numOps);
+   batch.append(ops.data(), ops.size());
+   return batch;
+}
+
+RegSyncDeltaDecoder::RegSyncDeltaDecoder() :
+   mInstanceId(0),
+   mLastSequence(0)
+{
+}
+
+bool
+RegSyncDeltaDecoder::decodeBatch(const Data& batch, std::vector<Change>& changes)
+{
+   uint64_t now = Timer::getTimeSecs();
+   OpDecoder decoder(batch);
+   changes.clear();
+
+   if(decoder.getByte() != RegSyncDelta::FormatVersion)
+   {
+      WarningLog(<< "RegSyncDeltaDecoder::decodeBatch: unsupported format version");
+      return false;
+   }
+   unsigned char flags = decoder.getByte();
+   uint64_t instanceId = decoder.getVarint();
+   uint64_t sequence = decoder.getVarint();
+   uint64_t numOps = decoder.getVarint();
+   if(!decoder.good())
+   {
+      return false;
+   }
+
+   if(instanceId != mInstanceId)
+   {
+      // a different server instance - ids we knew mean nothing any more
+      mContacts.clear();
+      mInstanceId = instanceId;
+      mLastSequence = 0;
+   }
+   if(flags & RegSyncDelta::InitialSyncBatch)
+   {
+      mLastSequence = sequence;
+   }
+   else
+   {
+      if(sequence <= mLastSequence)
+      {
+         DebugLog(<< "RegSyncDeltaDecoder::decodeBatch: ignoring batch " << sequence << ", already have up to " << mLastSequence);
+         return true;
+      }
+      if(mLastSequence != 0 && sequence != mLastSequence + 1)
+      {
+         WarningLog(<< "RegSyncDeltaDecoder::decodeBatch: batches " << mLastSequence + 1 << " to " << sequence - 1 << " were missed");
+      }
+      mLastSequence = sequence;
+   }
+
+   try
+   {
+      for(uint64_t i = 0; i < numOps && decoder.good(); i++)
+      {
+         uint64_t type = decoder.getVarint();
+         uint32_t id = (uint32_t)decoder.getVarint();
+         if(type == RegSyncDelta::Added)
+         {
+            Change change;
+            change.mAor = Uri(decoder.getString());
+            ContactInstanceRecord& rec = change.mContact;
+            rec.mContact = NameAddr(decoder.getString());
+            uint64_t expires = decoder.getVarint();
+            rec.mRegExpires = (expires == 0 ? 0 : now + expires);
+            rec.mLastUpdated = now - resipMin(now, decoder.getVarint());
+            Data token = decoder.getString();
+            if(!token.empty())
+            {
+               rec.mReceivedFrom = Tuple::makeTupleFromBinaryToken(token);
+            }
+            token = decoder.getString();
+            if(!token.empty())
+            {
+               rec.mPublicAddress = Tuple::makeTupleFromBinaryToken(token);
+            }
+            uint64_t paths = decoder.getVarint();
+            for(uint64_t p = 0; p < paths && decoder.good(); p++)
+            {
+               rec.mSipPath.push_back(NameAddr(decoder.getString()));
+            }
+            rec.mInstance = decoder.getString();
+            rec.mRegId = (uint32_t)decoder.getVarint();
+            rec.mUserAgent = decoder.getString();
+            rec.mSyncContact = true;  // This ContactInstanceRecord came from registration sync process
+            if(decoder.good())
+            {
+               mContacts[id] = change;
+               changes.push_back(change);
+            }
+         }
+         else if(type == RegSyncDelta::Refreshed || type == RegSyncDelta::Removed)
+         {
+            uint64_t expires = 0;
+            uint64_t lastUpdated = now;  // no longer listed at all; as far as we are concerned it is removed now
+            if(type == RegSyncDelta::Refreshed)
+            {
+               expires = decoder.getVarint();
+               lastUpdated = now - resipMin(now, decoder.getVarint());
+            }
+            if(!decoder.good())
+            {
+               break;
+            }
+            std::map<uint32_t, Change>::iterator it = mContacts.find(id);
+            if(it == mContacts.end())
+            {
+               DebugLog(<< "RegSyncDeltaDecoder::decodeBatch: ignoring operation for unknown contact " << id);
+               continue;
+            }
+            ContactInstanceRecord& rec = it->second.mContact;
+            rec.mRegExpires = (expires == 0 ? 0 : now + expires);
+            rec.mLastUpdated = lastUpdated;
+            changes.push_back(it->second);
+            if(type == RegSyncDelta::Removed)
+            {
+               mContacts.erase(it);
+            }
+         }
+         else
+         {
+            WarningLog(<< "RegSyncDeltaDecoder::decodeBatch: unknown operation " << type);
+            return false;
+         }
+      }
+   }
+   catch(BaseException& e)
+   {
+      WarningLog(<< "RegSyncDeltaDecoder::decodeBatch: exception: " << e);
+      return false;
+   }
+   return decoder.good() && decoder.atEnd();
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * Copyright (c) 2015 SIP Spectrum, Inc.  All rights reserved.
+ * Copyright (c) 2022 Daniel Pocock https://danielpocock.com
+ * Copyright (c) 2022 Software Freedom Institute SA https://softwarefreedom.institute
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
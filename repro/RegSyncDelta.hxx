@@ -0,0 +1,180 @@
+#if !defined(RegSyncDelta_hxx)
+#define RegSyncDelta_hxx
+
+#include <map>
+#include <vector>
+
+#include <rutil/Data.hxx>
+#include <resip/stack/Uri.hxx>
+#include <resip/dum/ContactInstanceRecord.hxx>
+
+namespace repro
+{
+
+/**
+  Compact binary encoding of registration changes for RegSync, used
+  instead of <reginfo> XML when both ends support it.
+
+  Rather than an AOR's whole contact list, a change is sent as one
+  operation per contact that changed since the AOR was last sent:
+     Added     - the full contact, under a numeric id the server assigns
+     Refreshed - only the id, expires and last update time
+     Removed   - only the id, for a contact that is no longer listed
+  Operations are sent in batches, each carrying the server's instance id
+  and a sequence number, so that a client that reconnects to the same
+  server instance can ask to resume where it left off.  Initial sync
+  batches carry only Added operations and the sequence number they are
+  current as of.
+
+  Batches are base64 encoded into a <regsyncbatch> element, so they
+  travel over the same loosely framed XML connection as everything else.
+*/
+class RegSyncDelta
+{
+public:
+   enum { FormatVersion = 1 };
+   enum OpType
+   {
+      Added = 1,
+      Refreshed = 2,
+      Removed = 3
+   };
+   enum BatchFlags
+   {
+      InitialSyncBatch = 0x01
+   };
+
+   static const resip::Data BatchTag;
+
+   /// wraps a batch into the event sent to RegSync clients
+   static resip::Data makeEvent(const resip::Data& batch);
+   /// contacts that are never synced: static registrations and flow-bound ones
+   static bool isSyncable(const resip::ContactInstanceRecord& rec);
+};
+
+/// Server side: remembers what was last sent for each AOR to work out deltas.  Not thread safe.
+class RegSyncDeltaEncoder
+{
+public:
+   RegSyncDeltaEncoder(uint64_t instanceId);
+
+   uint64_t getInstanceId() const { return mInstanceId; }
+
+   /// appends the operations that take an AOR from what was last encoded
+   /// for it to contacts; returns the number of operations appended.
+   /// Contacts that are not syncable are skipped, here and in encodeFull.
+   unsigned int encodeChange(resip::Data& ops, const resip::Uri& aor, const resip::ContactList& contacts);
+
+   /// appends an Added operation for each contact, for an initial sync;
+   /// returns the number of operations appended
+   unsigned int encodeFull(resip::Data& ops, const resip::Uri& aor, const resip::ContactList& contacts);
+
+   resip::Data makeBatch(unsigned char flags, uint64_t sequence, const resip::Data& ops, unsigned int numOps) const;
+
+   size_t getNumAors() const { return mSent.size(); }
+
+private:
+   class SentContact
+   {
+   public:
+      uint32_t mId;
+      resip::Data mIdentity;
+      size_t mDetailHash;
+      uint64_t mRegExpires;
+      uint64_t mLastUpdated;
+      bool mBroadcast;  // false if only an initial sync has sent it so far
+   };
+   typedef std::vector<SentContact> SentContactList;
+   typedef std::map<resip::Uri, SentContactList> SentMap;
+
+   SentContact& findOrAssign(SentContactList& sent, const resip::ContactInstanceRecord& rec, bool& created);
+
+   uint64_t mInstanceId;
+   uint32_t mNextId;
+   SentMap mSent;
+};
+
+/// Client side: turns batches back into contact records.  Not thread safe.
+class RegSyncDeltaDecoder
+{
+public:
+   class Change
+   {
+   public:
+      resip::Uri mAor;
+      resip::ContactInstanceRecord mContact;
+   };
+
+   RegSyncDeltaDecoder();
+
+   /// decodes a batch; changes gets a record for every contact that was
+   /// added, refreshed or removed, in order.  Returns false if the batch
+   /// could not be decoded.
+   bool decodeBatch(const resip::Data& batch, std::vector<Change>& changes);
+
+   /// what to ask the server to resume from, 0 if we have nothing to resume
+   uint64_t getInstanceId() const { return mInstanceId; }
+   uint64_t getLastSequence() const { return mLastSequence; }
+
+private:
+   uint64_t mInstanceId;
+   uint64_t mLastSequence;
+   std::map<uint32_t, Change> mContacts;  // by id, as last added or refreshed
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * Copyright (c) 2015 SIP Spectrum, Inc.  All rights reserved.
+ * Copyright (c) 2022 Daniel Pocock https://danielpocock.com
+ * Copyright (c) 2022 Software Freedom Institute SA https://softwarefreedom.institute
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -2,6 +2,7 @@
 #include "config.h"
 #endif
 
+#include <climits>
 #include <sstream>
 
 #include <resip/stack/Symbols.hxx>
@@ -9,8 +10,10 @@
 #include <rutil/ResipAssert.h>
 #include <rutil/Data.hxx>
 #include <rutil/DnsUtil.hxx>
+#include <rutil/Lock.hxx>
 #include <rutil/Logger.hxx>
 #include <rutil/ParseBuffer.hxx>
+#include <rutil/Random.hxx>
 #include <rutil/Socket.hxx>
 #include <rutil/TransportType.hxx>
 #include <rutil/Timer.hxx>
@@ -25,6 +28,22 @@ using namespace std;
 
 #define RESIPROCATE_SUBSYSTEM Subsystem::REPRO
 
+// Binary batches are sent early once this big, initial sync is sent in
+// batches of this size
+static const size_t MaxBatchBytes = 64 * 1024;
+// How much recently sent binary data is kept for clients that reconnect
+static const size_t MaxBacklogBytes = 4 * 1024 * 1024;
+
+static uint64_t
+makeInstanceId()
+{
+   uint64_t id = 0;
+   while(id == 0)  // 0 means no instance to clients
+   {
+      id = ((uint64_t)(unsigned int)Random::getRandom() << 32) | (unsigned int)Random::getRandom();
+   }
+   return id;
+}
 
 RegSyncServer::RegSyncServer(resip::InMemorySyncRegDb* regDb,
                              int port, 
@@ -32,7 +51,17 @@ RegSyncServer::RegSyncServer(resip::InMemorySyncRegDb* regDb,
                              resip::InMemorySyncPubDb* pubDb) :
    XmlRpcHandler(std::unique_ptr<XmlRpcServerBase>(new XmlRpcSocketServer(*this, port, version))),
    mRegDb(regDb),
-   mPubDb(pubDb)
+   mPubDb(pubDb),
+   mBinaryEncoding(true),
+   mBatchWindowMs(50),
+   mDeltaEncoder(makeInstanceId()),
+   mPendingOpCount(0),
+   mPendingSince(0),
+   mSequence(0),
+   mBacklogBytes(0),
+   mInitialSyncConnectionId(0),
+   mInitialSyncSequence(0),
+   mInitialSyncOpCount(0)
 {
    if (mRegDb)
    {
@@ -50,7 +79,17 @@ RegSyncServer::RegSyncServer(resip::InMemorySyncRegDb* regDb,
                              resip::InMemorySyncPubDb* pubDb) :
    XmlRpcHandler(std::unique_ptr<XmlRpcProtonServer>(new XmlRpcProtonServer(*this, brokerQueue, true))),
    mRegDb(regDb),
-   mPubDb(pubDb)
+   mPubDb(pubDb),
+   mBinaryEncoding(true),
+   mBatchWindowMs(50),
+   mDeltaEncoder(makeInstanceId()),
+   mPendingOpCount(0),
+   mPendingSince(0),
+   mSequence(0),
+   mBacklogBytes(0),
+   mInitialSyncConnectionId(0),
+   mInitialSyncSequence(0),
+   mInitialSyncOpCount(0)
 {
    if (mRegDb)
    {
@@ -99,6 +138,16 @@ RegSyncServer::sendRegistrationModifiedEvent(unsigned int connectionId, const re
 
 void 
 RegSyncServer::sendRegistrationModifiedEvent(unsigned int connectionId, const resip::Uri& aor, const ContactList& contacts)
+{
+   Data event;
+   if(makeRegistrationModifiedEvent(aor, contacts, event))
+   {
+      mRpc->sendEvent(connectionId, event);
+   }
+}
+
+bool
+RegSyncServer::makeRegistrationModifiedEvent(const resip::Uri& aor, const ContactList& contacts, Data& event)
 {
    std::stringstream ss;
    bool infoFound = false;
@@ -109,8 +158,7 @@ RegSyncServer::sendRegistrationModifiedEvent(unsigned int connectionId, const re
    for(; cit != contacts.end(); cit++)
    {
       const ContactInstanceRecord& rec = *cit;
-      if(!rec.mReceivedFrom.onlyUseExistingConnection &&
-          rec.mRegExpires != NeverExpire)  // Don't sync over static registrations
+      if(RegSyncDelta::isSyncable(rec))
       {
           streamContactInstanceRecord(ss, rec);
           infoFound = true;
@@ -120,8 +168,9 @@ RegSyncServer::sendRegistrationModifiedEvent(unsigned int connectionId, const re
 
    if(infoFound)
    {
-      mRpc->sendEvent(connectionId, ss.str().c_str());
+      event = ss.str().c_str();
    }
+   return infoFound;
 }
 
 void 
@@ -253,22 +302,50 @@ RegSyncServer::handleInitialSyncRequest(unsigned int connectionId, unsigned int
 {
    InfoLog(<< "RegSyncServer::handleInitialSyncRequest");
 
-   // Check for correct Version
+   // Check for correct Version, and whether the client understands the
+   // binary encoding (older clients only send the version)
    unsigned int version = 0;
+   bool binary = false;
+   uint64_t resumeInstanceId = 0;
+   uint64_t resumeSequence = 0;
    if(xml.firstChild())
    {
       if(isEqualNoCase(xml.getTag(), "request"))
       {
          if(xml.firstChild())
          {
-            if(isEqualNoCase(xml.getTag(), "version"))
+            do
             {
-               if(xml.firstChild())
+               if(!xml.firstChild())
+               {
+                  continue;
+               }
+               xml.parent();
+               if(isEqualNoCase(xml.getTag(), "version"))
                {
+                  xml.firstChild();
                   version = xml.getValue().convertUnsignedLong();
                   xml.parent();
                }
-            }
+               else if(isEqualNoCase(xml.getTag(), "encoding"))
+               {
+                  xml.firstChild();
+                  binary = isEqualNoCase(xml.getValue(), "binary");
+                  xml.parent();
+               }
+               else if(isEqualNoCase(xml.getTag(), "instance"))
+               {
+                  xml.firstChild();
+                  resumeInstanceId = xml.getValue().convertUInt64();
+                  xml.parent();
+               }
+               else if(isEqualNoCase(xml.getTag(), "sequence"))
+               {
+                  xml.firstChild();
+                  resumeSequence = xml.getValue().convertUInt64();
+                  xml.parent();
+               }
+            } while(xml.nextSibling());
             xml.parent();
          }
       }
@@ -277,15 +354,31 @@ RegSyncServer::handleInitialSyncRequest(unsigned int connectionId, unsigned int
 
    if(version == REGSYNC_VERSION)
    {
+      bool resumed = false;
       if (mRegDb)
       {
-         mRegDb->initialSync(connectionId);
+         if(binary && mBinaryEncoding)
+         {
+            resumed = resumeBinarySync(connectionId, resumeInstanceId, resumeSequence);
+            if(!resumed)
+            {
+               binaryInitialSync(connectionId);
+            }
+         }
+         else
+         {
+            {
+               Lock lock(mDeltaMutex);
+               mXmlConnections.insert(connectionId);
+            }
+            mRegDb->initialSync(connectionId);
+         }
       }
       if (mPubDb)
       {
          mPubDb->initialSync(connectionId);
       }
-      sendResponse(connectionId, requestId, Data::Empty, 200, "Initial Sync Completed.");
+      sendResponse(connectionId, requestId, Data::Empty, 200, resumed ? "Initial Sync Resumed." : "Initial Sync Completed.");
    }
    else
    {
@@ -335,16 +428,207 @@ RegSyncServer::streamContactInstanceRecord(std::stringstream& ss, const ContactI
     ss << "   </contactinfo>" << Symbols::CRLF;
 }
 
+bool
+RegSyncServer::resumeBinarySync(unsigned int connectionId, uint64_t instanceId, uint64_t sequence)
+{
+   Lock lock(mDeltaMutex);
+
+   // Resumable if the client was synced with this instance and we still
+   // have every batch it has missed since
+   if(instanceId != mDeltaEncoder.getInstanceId() || sequence > mSequence ||
+      (sequence < mSequence && (mBacklog.empty() || mBacklog.front().first > sequence + 1)))
+   {
+      return false;
+   }
+
+   unsigned int resent = 0;
+   for(std::deque<std::pair<uint64_t, Data> >::const_iterator it = mBacklog.begin(); it != mBacklog.end(); it++)
+   {
+      if(it->first > sequence)
+      {
+         mRpc->sendEvent(connectionId, it->second);
+         resent++;
+      }
+   }
+   mXmlConnections.erase(connectionId);
+   mBinaryConnections.insert(connectionId);
+   InfoLog(<< "RegSyncServer::resumeBinarySync: connectionId=" << connectionId << " resumed from sequence " << sequence << ", " << resent << " batch(es) resent");
+   return true;
+}
+
+void
+RegSyncServer::binaryInitialSync(unsigned int connectionId)
+{
+   {
+      Lock lock(mDeltaMutex);
+      mXmlConnections.erase(connectionId);
+      // Changes not sent yet go out later, in a batch with a higher sequence
+      mInitialSyncSequence = mSequence;
+      mInitialSyncConnectionId = connectionId;
+   }
+
+   mRegDb->initialSync(connectionId);
+
+   Lock lock(mDeltaMutex);
+   flushInitialSync(true /* force */);  // so the client learns our instance and sequence, even if there is nothing to sync
+
+   // Batches sent while the sync ran were held back from this client, so
+   // they could not overtake the contacts they change
+   if(mSequence > mInitialSyncSequence &&
+      (mBacklog.empty() || mBacklog.front().first > mInitialSyncSequence + 1))
+   {
+      WarningLog(<< "RegSyncServer::binaryInitialSync: batches sent during initial sync of connectionId=" << connectionId << " are no longer in the backlog, some changes will not reach it");
+   }
+   for(std::deque<std::pair<uint64_t, Data> >::const_iterator it = mBacklog.begin(); it != mBacklog.end(); it++)
+   {
+      if(it->first > mInitialSyncSequence)
+      {
+         mRpc->sendEvent(connectionId, it->second);
+      }
+   }
+   mBinaryConnections.insert(connectionId);
+   mInitialSyncConnectionId = 0;
+}
+
+void
+RegSyncServer::flushInitialSync(bool force)
+{
+   if(mInitialSyncOpCount > 0 || force)
+   {
+      Data batch = mDeltaEncoder.makeBatch(RegSyncDelta::InitialSyncBatch, mInitialSyncSequence, mInitialSyncOps, mInitialSyncOpCount);
+      mRpc->sendEvent(mInitialSyncConnectionId, RegSyncDelta::makeEvent(batch));
+      mInitialSyncOps.clear();
+      mInitialSyncOpCount = 0;
+   }
+}
+
+void
+RegSyncServer::flushBatch()
+{
+   if(mPendingOpCount == 0)
+   {
+      return;
+   }
+   Data event = RegSyncDelta::makeEvent(mDeltaEncoder.makeBatch(0, ++mSequence, mPendingOps, mPendingOpCount));
+   mPendingOps.clear();
+   mPendingOpCount = 0;
+
+   for(std::set<unsigned int>::const_iterator it = mBinaryConnections.begin(); it != mBinaryConnections.end(); it++)
+   {
+      mRpc->sendEvent(*it, event);
+   }
+
+   mBacklogBytes += event.size();
+   mBacklog.push_back(std::make_pair(mSequence, event));
+   while(mBacklogBytes > MaxBacklogBytes && mBacklog.size() > 1)
+   {
+      mBacklogBytes -= mBacklog.front().second.size();
+      mBacklog.pop_front();
+   }
+}
+
+unsigned int
+RegSyncServer::processDeltas()
+{
+   Lock lock(mDeltaMutex);
+
+   // Forget connections that have gone, this runs on the thread that closes them
+   for(std::set<unsigned int>::iterator it = mBinaryConnections.begin(); it != mBinaryConnections.end();)
+   {
+      if(mRpc->mConnections.find(*it) == mRpc->mConnections.end())
+      {
+         mBinaryConnections.erase(it++);
+      }
+      else
+      {
+         it++;
+      }
+   }
+   for(std::set<unsigned int>::iterator it = mXmlConnections.begin(); it != mXmlConnections.end();)
+   {
+      if(mRpc->mConnections.find(*it) == mRpc->mConnections.end())
+      {
+         mXmlConnections.erase(it++);
+      }
+      else
+      {
+         it++;
+      }
+   }
+
+   if(mPendingOpCount == 0)
+   {
+      return UINT_MAX;
+   }
+   uint64_t elapsed = Timer::getTimeMs() - mPendingSince;
+   if(elapsed >= mBatchWindowMs || mPendingOps.size() >= MaxBatchBytes || mBinaryConnections.empty())
+   {
+      flushBatch();
+      return UINT_MAX;
+   }
+   return (unsigned int)(mBatchWindowMs - elapsed);
+}
+
 void 
 RegSyncServer::onAorModified(const resip::Uri& aor, const ContactList& contacts)
 {
-   sendRegistrationModifiedEvent(0, aor, contacts);
+   std::vector<unsigned int> xmlConnections;
+   {
+      Lock lock(mDeltaMutex);
+      if(mBinaryConnections.empty() && mInitialSyncConnectionId == 0)
+      {
+         // Nothing to work out deltas for, every client gets <reginfo>
+         lock.unlock();
+         sendRegistrationModifiedEvent(0, aor, contacts);
+         return;
+      }
+
+      bool wasEmpty = mPendingOpCount == 0;
+      mPendingOpCount += mDeltaEncoder.encodeChange(mPendingOps, aor, contacts);
+      if(mPendingOpCount > 0)
+      {
+         if(mBatchWindowMs == 0)
+         {
+            flushBatch();
+         }
+         else if(wasEmpty || mPendingOps.size() >= MaxBatchBytes)
+         {
+            mPendingSince = wasEmpty ? Timer::getTimeMs() : mPendingSince;
+            mRpc->mSelectInterruptor.interrupt();  // so the server thread picks up the new deadline
+         }
+      }
+      xmlConnections.assign(mXmlConnections.begin(), mXmlConnections.end());
+   }
+
+   if(!xmlConnections.empty())
+   {
+      Data event;
+      if(makeRegistrationModifiedEvent(aor, contacts, event))
+      {
+         for(std::vector<unsigned int>::const_iterator it = xmlConnections.begin(); it != xmlConnections.end(); it++)
+         {
+            mRpc->sendEvent(*it, event);
+         }
+      }
+   }
 }
 
 void 
 RegSyncServer::onInitialSyncAor(unsigned int connectionId, const resip::Uri& aor, const ContactList& contacts)
 {
-   sendRegistrationModifiedEvent(connectionId, aor, contacts);
+   if(connectionId != 0 && connectionId == mInitialSyncConnectionId)
+   {
+      Lock lock(mDeltaMutex);
+      mInitialSyncOpCount += mDeltaEncoder.encodeFull(mInitialSyncOps, aor, contacts);
+      if(mInitialSyncOps.size() >= MaxBatchBytes)
+      {
+         flushInitialSync(false);
+      }
+   }
+   else
+   {
+      sendRegistrationModifiedEvent(connectionId, aor, contacts);
+   }
 }
 
 void 
@@ -1,12 +1,17 @@
 #if !defined(RegSyncServer_hxx)
 #define RegSyncServer_hxx 
 
+#include <deque>
+#include <set>
+
 #include <rutil/Data.hxx>
+#include <rutil/Mutex.hxx>
 #include <rutil/TransportType.hxx>
 #include <rutil/XMLCursor.hxx>
 #include <resip/dum/InMemorySyncRegDb.hxx>
 #include <resip/dum/InMemorySyncPubDb.hxx>
 #include "repro/XmlRpcServerBase.hxx"
+#include "repro/RegSyncDelta.hxx"
 
 #define REGSYNC_VERSION 4
 
@@ -30,6 +35,17 @@ public:
 #endif
    virtual ~RegSyncServer();
 
+   // Registration changes are sent in the RegSyncDelta binary encoding to
+   // clients that ask for it, unless disabled here.  Changes are batched
+   // for up to batchWindowMs before being sent; 0 sends every change as
+   // it happens.  Call before the server thread is started.
+   void setBinaryEncoding(bool enabled) { mBinaryEncoding = enabled; }
+   void setBatchWindow(unsigned int batchWindowMs) { mBatchWindowMs = batchWindowMs; }
+
+   // Sends any binary batch that is due; returns how long until the next
+   // one will be, for the server thread's select timeout
+   unsigned int processDeltas();
+
    // thread safe
    virtual void sendResponse(unsigned int connectionId, 
                              unsigned int requestId, 
@@ -58,9 +74,38 @@ protected:
 private: 
    void handleInitialSyncRequest(unsigned int connectionId, unsigned int requestId, resip::XMLCursor& xml);
    void streamContactInstanceRecord(std::stringstream& ss, const resip::ContactInstanceRecord& rec);
+   bool makeRegistrationModifiedEvent(const resip::Uri& aor, const resip::ContactList& contacts, resip::Data& event);
+
+   // binary encoding
+   bool resumeBinarySync(unsigned int connectionId, uint64_t instanceId, uint64_t sequence);
+   void binaryInitialSync(unsigned int connectionId);
+   void flushInitialSync(bool force);  // mDeltaMutex must be held
+   void flushBatch();  // mDeltaMutex must be held
 
    resip::InMemorySyncRegDb* mRegDb;
    resip::InMemorySyncPubDb* mPubDb;
+
+   bool mBinaryEncoding;
+   unsigned int mBatchWindowMs;
+
+   resip::Mutex mDeltaMutex;  // protects everything below
+   RegSyncDeltaEncoder mDeltaEncoder;
+   std::set<unsigned int> mBinaryConnections;
+   std::set<unsigned int> mXmlConnections;
+   resip::Data mPendingOps;
+   unsigned int mPendingOpCount;
+   uint64_t mPendingSince;
+   uint64_t mSequence;
+   // recently sent batches, by sequence, so a reconnecting client can resume
+   std::deque<std::pair<uint64_t, resip::Data> > mBacklog;
+   size_t mBacklogBytes;
+
+   // binary initial sync in progress on the server thread, changes made
+   // meanwhile are held back from it
+   unsigned int mInitialSyncConnectionId;
+   uint64_t mInitialSyncSequence;
+   resip::Data mInitialSyncOps;
+   unsigned int mInitialSyncOpCount;
 };
 
 }
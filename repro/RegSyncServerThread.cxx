@@ -23,13 +23,15 @@ RegSyncServerThread::thread()
       try
       {
            FdSet fdset; 
+           unsigned int waitMs = 2*1000;
      
            std::list<RegSyncServer*>::iterator it = mRegSyncServerList.begin();
            for(;it!=mRegSyncServerList.end();it++)
            {
+              waitMs = resipMin(waitMs, (*it)->processDeltas());
               (*it)->buildFdSet(fdset);
            }
-           fdset.selectMilliSeconds( 2*1000 );
+           fdset.selectMilliSeconds( waitMs );
            
            it = mRegSyncServerList.begin();
            for(;it!=mRegSyncServerList.end();it++)
@@ -30,6 +30,7 @@
 #include "resip/stack/WsCookieContextFactory.hxx"
 
 #include "resip/dum/InMemorySyncRegDb.hxx"
+#include "resip/dum/InMemorySyncRegDbPersister.hxx"
 #include "resip/dum/InMemorySyncPubDb.hxx"
 #include "resip/dum/MasterProfile.hxx"
 #include "resip/dum/DialogUsageManager.hxx"
@@ -42,6 +43,7 @@
 #include "repro/Proxy.hxx"
 #include "repro/ProxyConfig.hxx"
 #include "repro/BerkeleyDb.hxx"
+#include "repro/SqlDb.hxx"
 #include "resip/stack/Dispatcher.hxx"
 #include "repro/UserAuthGrabber.hxx"
 #include "repro/ProcessorChain.hxx"
@@ -229,6 +231,7 @@ ReproRunner::ReproRunner()
    , mAbstractDb(0)
    , mRuntimeAbstractDb(0)
    , mRegistrationPersistenceManager(0)
+   , mRegistrationPersister(0)
    , mPublicationPersistenceManager(0)
    , mAuthFactory(0)
    , mAsyncProcessorDispatcher(0)
@@ -376,6 +379,13 @@ ReproRunner::run(int argc, char** argv)
    mThreadedStack = mProxyConfig->getConfigBool("ThreadedStack", true);
    if(mThreadedStack)
    {
+      // Split the transaction layer across several threads, if configured
+      unsigned int transactionShards = mProxyConfig->getConfigUnsignedLong("TransactionShards", 1);
+      if(transactionShards > 1)
+      {
+         mSipStack->setTransactionShards(transactionShards);
+      }
+
       // If configured, then start the sub-threads within the stack
       mSipStack->run();
    }
@@ -548,6 +558,12 @@ ReproRunner::cleanupObjects()
    if(!mRestarting) 
    {
       // If we are restarting then leave the In Memory Registration and Publication database intact
+      if(mRegistrationPersister)
+      {
+         // Stops the persister thread, once the last changes are written to the log
+         dynamic_cast<InMemorySyncRegDb*>(mRegistrationPersistenceManager)->removeHandler(mRegistrationPersister);
+         delete mRegistrationPersister; mRegistrationPersister = 0;
+      }
       delete mRegistrationPersistenceManager; mRegistrationPersistenceManager = 0;
       delete mPublicationPersistenceManager; mPublicationPersistenceManager = 0;
    }
@@ -727,6 +743,13 @@ ReproRunner::createSipStack()
       mSipStack->setEnumDomains(enumDomains);
    }
 
+   // Refresh hot DNS cache entries before they expire, and optionally keep
+   // answering from expired ones while they are refreshed
+   mSipStack->getDnsStub().setDnsCachePrefetch(mProxyConfig->getConfigUnsignedLong("DNSCachePrefetchHits", 0),
+                                               mProxyConfig->getConfigInt("DNSCachePrefetchWindow", 10));
+   mSipStack->getDnsStub().setDnsCacheStaleGrace(mProxyConfig->getConfigInt("DNSCacheStaleGrace", 0));
+   mSipStack->getDnsStub().setDnsCacheRefreshRetry(mProxyConfig->getConfigInt("DNSCacheRefreshRetry", 10));
+
    // Add External Stats handler
    mSipStack->setExternalStatsHandler(this);
 
@@ -938,6 +961,9 @@ ReproRunner::createDatastore()
       return false;
    }
    mProxyConfig->createDataStore(mAbstractDb, mRuntimeAbstractDb);
+   mProxyConfig->getDataStore()->mUserStore.setAuthCache(mProxyConfig->getConfigUnsignedLong("UserAuthCacheSize", 0),
+                                                         mProxyConfig->getConfigUnsignedLong("UserAuthCacheTTL", 300),
+                                                         mProxyConfig->getConfigUnsignedLong("UserAuthCacheNegativeTTL", 30));
 
    // Create ImMemory Registration Database
    mRegSyncPort = mProxyConfig->getConfigInt("RegSyncPort", 0);
@@ -946,6 +972,20 @@ ReproRunner::createDatastore()
    {
       resip_assert(!mRegistrationPersistenceManager);
       mRegistrationPersistenceManager = new InMemorySyncRegDb(mRegSyncPort ? 86400 /* 24 hours */ : 0 /* removeLingerSecs */);  // !slg! could make linger time a setting
+
+      // Reload registrations saved before we were last stopped, then keep saving them
+      Data persistenceFile = mProxyConfig->getConfigData("RegistrationPersistenceFile", "", true);
+      if(!persistenceFile.empty())
+      {
+         InMemorySyncRegDb* regDb = dynamic_cast<InMemorySyncRegDb*>(mRegistrationPersistenceManager);
+         mRegistrationPersister = new InMemorySyncRegDbPersister(*regDb, persistenceFile,
+                                                                 mProxyConfig->getConfigUnsignedLong("RegistrationSnapshotInterval", 300),
+                                                                 mProxyConfig->getConfigUnsignedLong("RegistrationSnapshotLogRecords", 100000));
+         mRegistrationPersister->load();
+         regDb->addHandler(mRegistrationPersister);
+         mRegistrationPersister->run();
+      }
+
       resip_assert(!mPublicationPersistenceManager);
       mPublicationPersistenceManager = new InMemorySyncPubDb((mRegSyncPort && mProxyConfig->getConfigBool("EnablePublicationReplication", false)) ? true : false);
    }
@@ -1375,6 +1415,13 @@ ReproRunner::createRegSync()
                                               enablePublicationReplication ? dynamic_cast<InMemorySyncPubDb*>(mPublicationPersistenceManager) : 0);
          regSyncServerList.push_back(mRegSyncServerV6);
       }
+      bool regSyncBinaryEncoding = mProxyConfig->getConfigBool("RegSyncBinaryEncoding", true);
+      unsigned int regSyncBatchWindow = mProxyConfig->getConfigUnsignedLong("RegSyncBatchWindow", 50);
+      for(std::list<RegSyncServer*>::iterator it = regSyncServerList.begin(); it != regSyncServerList.end(); it++)
+      {
+         (*it)->setBinaryEncoding(regSyncBinaryEncoding);
+         (*it)->setBatchWindow(regSyncBatchWindow);
+      }
       if(!regSyncServerList.empty())
       {
          mRegSyncServerThread = new RegSyncServerThread(regSyncServerList);
@@ -1392,6 +1439,7 @@ ReproRunner::createRegSync()
             mRegSyncClient = new RegSyncClient(dynamic_cast<InMemorySyncRegDb*>(mRegistrationPersistenceManager),
                                                regSyncPeerAddress, remoteRegSyncPort,
                                                enablePublicationReplication ? dynamic_cast<InMemorySyncPubDb*>(mPublicationPersistenceManager) : 0);
+            mRegSyncClient->setBinaryEncoding(regSyncBinaryEncoding);
          }
       }
    }
@@ -2016,6 +2064,18 @@ ReproRunner::operator()(resip::StatisticsMessage &statsMessage)
    {
        (*it)->handleStatisticsMessage(statsMessage);
    }
+
+   // SQL connection pool usage is logged alongside the stack statistics
+   SqlDb* sqlDb = dynamic_cast<SqlDb*>(mAbstractDb);
+   if(sqlDb)
+   {
+      sqlDb->logStatistics();
+   }
+   sqlDb = dynamic_cast<SqlDb*>(mRuntimeAbstractDb);
+   if(sqlDb && mRuntimeAbstractDb != mAbstractDb)
+   {
+      sqlDb->logStatistics();
+   }
    return true;
 }
 
@@ -18,6 +18,7 @@ namespace resip
    class SipStack;
    class Dispatcher;
    class RegistrationPersistenceManager;
+   class InMemorySyncRegDbPersister;
    class PublicationPersistenceManager;
    class FdPollGrp;
    class AsyncProcessHandler;
@@ -104,6 +105,7 @@ protected:
    AbstractDb* mAbstractDb;
    AbstractDb* mRuntimeAbstractDb;
    resip::RegistrationPersistenceManager* mRegistrationPersistenceManager;
+   resip::InMemorySyncRegDbPersister* mRegistrationPersister;
    resip::PublicationPersistenceManager* mPublicationPersistenceManager;
    AuthenticatorFactory* mAuthFactory;
    resip::Dispatcher* mAsyncProcessorDispatcher;
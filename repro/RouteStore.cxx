@@ -1,4 +1,8 @@
 
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
 #include "rutil/Logger.hxx"
 #include "rutil/ParseBuffer.hxx"
 #include "rutil/Lock.hxx"
@@ -25,38 +29,211 @@ bool RouteStore::RouteOp::operator<(const RouteOp& rhs) const
    return routeRecord.mOrder < rhs.routeRecord.mOrder;
 }
 
-RouteStore::RouteStore(AbstractDb& db):
-   mDb(db)
-{  
-   Key key = mDb.firstRouteKey();
-   while ( !key.empty() )
+// Splits pattern at its top level |, if it has any
+static void
+topLevelBranches(const Data& pattern, std::vector<Data>& branches)
+{
+   int depth = 0;
+   bool inClass = false;
+   Data::size_type start = 0;
+   for(Data::size_type i = 0; i < pattern.size(); i++)
    {
-      RouteOp route;
-      route.routeRecord = mDb.getRoute(key);
+      char c = pattern[i];
+      if(c == '\\')
+      {
+         i++;
+      }
+      else if(inClass)
+      {
+         inClass = (c != ']');
+      }
+      else if(c == '[')
+      {
+         inClass = true;
+      }
+      else if(c == '(')
+      {
+         depth++;
+      }
+      else if(c == ')')
+      {
+         depth--;
+      }
+      else if(c == '|' && depth == 0)
+      {
+         branches.push_back(pattern.substr(start, i - start));
+         start = i + 1;
+      }
+   }
+   branches.push_back(pattern.substr(start));
+}
 
-      route.key = key;
-      route.preq = 0;
-      
-      if(!route.routeRecord.mMatchingPattern.empty())
+// Returns the literal text the pattern continues with from position start on.
+// whole is set when that text makes up all the rest of the pattern.
+static Data
+leadingLiteral(const Data& pattern, Data::size_type start, bool& whole)
+{
+   Data literal;
+   Data::size_type i = start;
+   while(i < pattern.size())
+   {
+      char c = pattern[i];
+      Data::size_type next = i + 1;
+      if(c == '\\')
       {
-         std::regex_constants::syntax_option_type flags = DefaultFlags;
-         if(route.routeRecord.mRewriteExpression.find("$") == Data::npos)
+         // escaped punctuation stands for itself, \d, \w, \1 and friends don't
+         if(next >= pattern.size() || isalnum((unsigned char)pattern[next]))
          {
-            flags |= std::regex_constants::nosubs;
+            break;
          }
-         try
+         c = pattern[next++];
+      }
+      else if(strchr("^$.|?*+()[]{}", c))
+      {
+         break;
+      }
+      if(next < pattern.size() && strchr("?*+{", pattern[next]))
+      {
+         break;  // quantified, so it may not be there
+      }
+      literal += c;
+      i = next;
+   }
+   whole = (i == pattern.size());
+   return literal;
+}
+
+void
+RouteStore::compile(RouteOp& route)
+{
+   route.preq = 0;
+   route.literal = false;
+   if(!route.routeRecord.mMatchingPattern.empty())
+   {
+      const Data& pattern = route.routeRecord.mMatchingPattern;
+      std::regex_constants::syntax_option_type flags = DefaultFlags;
+      if(route.routeRecord.mRewriteExpression.find("$") == Data::npos)
+      {
+         flags |= std::regex_constants::nosubs;
+      }
+      try
+      {
+         route.preq = new std::regex(pattern.c_str(), flags);
+      }
+      catch (std::regex_error& e)
+      {
+         delete route.preq;
+         ErrLog(<< "Routing rule has invalid match expression: "
+                << pattern
+                << ", ex=" << e.what());
+         route.preq = 0;
+         return;
+      }
+
+      // Patterns whose branches are all anchored with ^ (the usual
+      // "^sip:\+1212..." dial plan entries) can only match URIs starting
+      // with the literal text after the ^
+      std::vector<Data> branches;
+      topLevelBranches(pattern, branches);
+      bool anchored = true;
+      for(std::vector<Data>::const_iterator it = branches.begin(); it != branches.end(); it++)
+      {
+         anchored = anchored && !it->empty() && (*it)[0] == '^';
+      }
+      bool whole = false;
+      if(anchored)
+      {
+         for(std::vector<Data>::const_iterator it = branches.begin(); it != branches.end(); it++)
          {
-            route.preq = new std::regex(route.routeRecord.mMatchingPattern.c_str(), flags);
+            route.prefixes.push_back(leadingLiteral(*it, 1, whole));
          }
-         catch (std::regex_error& e)
+         route.literal = (branches.size() == 1 && whole);
+      }
+      else if(branches.size() == 1)
+      {
+         // otherwise the URI has to contain the literal the pattern starts with
+         route.contains = leadingLiteral(pattern, 0, whole);
+         route.literal = whole;
+      }
+   }
+}
+
+void
+RouteStore::RouteIndex::build(const RouteOpList& routes)
+{
+   mRoutes.clear();
+   mNodes.assign(1, Node());
+   for(RouteOpList::const_iterator it = routes.begin(); it != routes.end(); it++)
+   {
+      if(!it->preq)
+      {
+         continue;  // can't match anything
+      }
+      unsigned int position = (unsigned int)mRoutes.size();
+      mRoutes.push_back(&*it);
+      if(it->prefixes.empty())
+      {
+         mNodes[0].mRoutes.push_back(position);
+         continue;
+      }
+      for(std::vector<Data>::const_iterator prefix = it->prefixes.begin(); prefix != it->prefixes.end(); prefix++)
+      {
+         unsigned int node = 0;
+         for(Data::size_type i = 0; i < prefix->size(); i++)
          {
-            delete route.preq;
-            ErrLog(<< "Routing rule has invalid match expression: "
-                   << route.routeRecord.mMatchingPattern
-                   << ", ex=" << e.what());
-            route.preq = 0;
+            std::map<char, unsigned int>::const_iterator child = mNodes[node].mChildren.find((*prefix)[i]);
+            if(child == mNodes[node].mChildren.end())
+            {
+               unsigned int added = (unsigned int)mNodes.size();
+               mNodes.push_back(Node());
+               mNodes[node].mChildren[(*prefix)[i]] = added;
+               node = added;
+            }
+            else
+            {
+               node = child->second;
+            }
          }
+         mNodes[node].mRoutes.push_back(position);
+      }
+   }
+}
+
+void
+RouteStore::RouteIndex::candidates(const Data& uri, std::vector<unsigned int>& result) const
+{
+   unsigned int node = 0;
+   Data::size_type i = 0;
+   while(true)
+   {
+      result.insert(result.end(), mNodes[node].mRoutes.begin(), mNodes[node].mRoutes.end());
+      if(i == uri.size())
+      {
+         break;
+      }
+      std::map<char, unsigned int>::const_iterator child = mNodes[node].mChildren.find(uri[i++]);
+      if(child == mNodes[node].mChildren.end())
+      {
+         break;
       }
+      node = child->second;
+   }
+   // a route with several branches can be reached more than once
+   std::sort(result.begin(), result.end());
+   result.erase(std::unique(result.begin(), result.end()), result.end());
+}
+
+RouteStore::RouteStore(AbstractDb& db):
+   mDb(db)
+{  
+   Key key = mDb.firstRouteKey();
+   while ( !key.empty() )
+   {
+      RouteOp route;
+      route.routeRecord = mDb.getRoute(key);
+
+      route.key = key;
+      compile(route);
 
       mRouteOperators.insert( route );
 
@@ -80,6 +257,8 @@ RouteStore::RouteStore(AbstractDb& db):
       }
    }
 
+   mIndex.build(mRouteOperators);
+
    // Initialize cursor to the start
    mCursor = mRouteOperators.begin();
 }
@@ -126,31 +305,12 @@ RouteStore::addRoute(const resip::Data& method,
    }
 
    route.key = key;
-   route.preq = 0;
-   if (!route.routeRecord.mMatchingPattern.empty())
-   {
-      std::regex_constants::syntax_option_type flags = DefaultFlags;
-      if (route.routeRecord.mRewriteExpression.find("$") == Data::npos)
-      {
-         flags |= std::regex_constants::nosubs;
-      }
-      try
-      {
-         route.preq = new std::regex(route.routeRecord.mMatchingPattern.c_str(), flags);
-      }
-      catch (std::regex_error& e)
-      {
-         delete route.preq;
-         ErrLog(<< "Routing rule has invalid match expression: "
-            << route.routeRecord.mMatchingPattern
-            << ", ex=" << e.what());
-         route.preq = 0;
-      }
-   }
+   compile(route);
 
    {
       WriteLock lock(mMutex);
       mRouteOperators.insert( route );
+      mIndex.build(mRouteOperators);
    }
    mCursor = mRouteOperators.begin(); 
 
@@ -212,6 +372,7 @@ RouteStore::eraseRoute(const resip::Data& key )
             it++;
          }
       }
+      mIndex.build(mRouteOperators);
    }
    mCursor = mRouteOperators.begin();  // reset the cursor since it may have been on deleted route
 }
@@ -311,15 +472,19 @@ RouteStore::process(const resip::Uri& ruri,
 
    ReadLock lock(mMutex);
 
-   for (RouteOpList::iterator it = mRouteOperators.begin();
-        it != mRouteOperators.end(); it++)
+   std::vector<unsigned int> candidates;
+   mIndex.candidates(uri, candidates);
+   for (std::vector<unsigned int>::const_iterator it = candidates.begin();
+        it != candidates.end(); it++)
    {
+      const RouteOp& route = mIndex.route(*it);
+
       DebugLog( << "Consider route " // << *it
                 << " reqUri=" << ruri
                 << " method=" << method 
                 << " event=" << event );
 
-      const AbstractDb::RouteRecord& rec = it->routeRecord;
+      const AbstractDb::RouteRecord& rec = route.routeRecord;
       
       if(!rec.mMethod.empty())
       {
@@ -340,77 +505,79 @@ RouteStore::process(const resip::Uri& ruri,
       }
       const Data& rewrite = rec.mRewriteExpression;
       const Data& match = rec.mMatchingPattern;
-      if ( it->preq ) 
+      if(!route.contains.empty() && uri.find(route.contains) == Data::npos)
       {
-         std::cmatch matches;
+         DebugLog( << "  Skipped - request URI "<< uri << " did not match " << match );
+         continue;
+      }
+      std::cmatch matches;
 
-         // Note:  Using regex_search instead of regex_match, so that we don't need to fully match 
-         //        the string, this is backwards compatible with the previous regexec PCRE implementation
-         if(!std::regex_search(uri.c_str(), matches, *it->preq))
-         {
-            // did not match 
-            DebugLog( << "  Skipped - request URI "<< uri << " did not match " << match );
-            continue;
-         }
+      // Note:  Using regex_search instead of regex_match, so that we don't need to fully match 
+      //        the string, this is backwards compatible with the previous regexec PCRE implementation
+      if(!route.literal && !std::regex_search(uri.c_str(), matches, *route.preq))
+      {
+         // did not match 
+         DebugLog( << "  Skipped - request URI "<< uri << " did not match " << match );
+         continue;
+      }
 
-         DebugLog( << "  Route matched" );
-         Data target = rewrite;
-         
-         if ( rewrite.find("$") != Data::npos )
+      DebugLog( << "  Route matched" );
+      Data target = rewrite;
+      
+      if ( rewrite.find("$") != Data::npos )
+      {
+         for ( int i=1; i<matches.size(); i++)
          {
-            for ( int i=1; i<matches.size(); i++)
+            Data subExp(matches[i]);
+            DebugLog( << "  subExpression[" <<i <<"]="<< subExp );
+
+            Data result;
             {
-               Data subExp(matches[i]);
-               DebugLog( << "  subExpression[" <<i <<"]="<< subExp );
+               DataStream s(result);
 
-               Data result;
+               ParseBuffer pb(target);
+                  
+               while (true)
                {
-                  DataStream s(result);
-
-                  ParseBuffer pb(target);
-                     
-                  while (true)
+                  const char* a = pb.position();
+                  pb.skipToChars( Data("$") + char('0'+i) );
+                  if ( pb.eof() )
+                  {
+                     s << pb.data(a);
+                     break;
+                  }
+                  else
                   {
-                     const char* a = pb.position();
-                     pb.skipToChars( Data("$") + char('0'+i) );
-                     if ( pb.eof() )
-                     {
-                        s << pb.data(a);
-                        break;
-                     }
-                     else
-                     {
-                        s << pb.data(a);
-                        pb.skipN(2);
-                        s <<  subExp;
-                     }
+                     s << pb.data(a);
+                     pb.skipN(2);
+                     s <<  subExp;
                   }
-                  s.flush();
                }
-               target = result;
+               s.flush();
             }
+            target = result;
          }
-         
-         Uri targetUri;
+      }
+      
+      Uri targetUri;
+      try
+      {
+         targetUri = Uri(target);
+      }
+      catch( BaseException& )
+      {
+         ErrLog( << "Routing rule transform " << rewrite << " gave invalid URI " << target );
          try
          {
-            targetUri = Uri(target);
+            targetUri = Uri( Data("sip:")+target);
          }
          catch( BaseException& )
          {
-            ErrLog( << "Routing rule transform " << rewrite << " gave invalid URI " << target );
-            try
-            {
-               targetUri = Uri( Data("sip:")+target);
-            }
-            catch( BaseException& )
-            {
-               ErrLog( << "Routing rule transform " << rewrite << " gave invalid URI sip:" << target );
-               continue;
-            }
+            ErrLog( << "Routing rule transform " << rewrite << " gave invalid URI sip:" << target );
+            continue;
          }
-         targetSet.push_back( targetUri );
       }
+      targetSet.push_back( targetUri );
    }
 
    return targetSet;
@@ -1,9 +1,11 @@
 #if !defined(REPRO_ROUTESTORE_HXX)
 #define REPRO_ROUTESTORE_HXX
 
+#include <map>
 #include <regex>
 
 #include <set>
+#include <vector>
 
 #include "rutil/Data.hxx"
 #include "rutil/RWMutex.hxx"
@@ -68,14 +70,45 @@ class RouteStore
          public:
             Key key;
             std::regex *preq;
+            // literal text a matching URI starts with, one per branch of the
+            // pattern; empty when the pattern is not anchored with ^
+            std::vector<resip::Data> prefixes;
+            // otherwise, literal text a matching URI contains
+            resip::Data contains;
+            // the pattern is nothing but that literal text, no regex needs to run
+            bool literal;
             AbstractDb::RouteRecord routeRecord;
             bool operator<(const RouteOp&) const;
       };
+      static void compile(RouteOp& route);
       
       resip::RWMutex mMutex;
       typedef std::multiset<RouteOp> RouteOpList;
       RouteOpList mRouteOperators; 
       RouteOpList::iterator mCursor;
+
+      // Trie of the literal prefixes of the routes, so that process() only
+      // looks at the routes that can possibly match.
+      // Rebuilt (under the write lock) whenever mRouteOperators changes.
+      class RouteIndex
+      {
+         public:
+            void build(const RouteOpList& routes);
+            // positions of the routes that may match uri, in route order
+            void candidates(const resip::Data& uri, std::vector<unsigned int>& result) const;
+            const RouteOp& route(unsigned int position) const { return *mRoutes[position]; }
+
+         private:
+            class Node
+            {
+               public:
+                  std::map<char, unsigned int> mChildren;
+                  std::vector<unsigned int> mRoutes;  // routes whose prefix ends here
+            };
+            std::vector<const RouteOp*> mRoutes;
+            std::vector<Node> mNodes;  // [0] is the root, holding routes without a prefix
+      };
+      RouteIndex mIndex;
 };
 
  }
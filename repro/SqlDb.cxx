@@ -10,6 +10,7 @@
 #include "rutil/DataStream.hxx"
 #include "rutil/Logger.hxx"
 #include "rutil/ParseBuffer.hxx"
+#include "rutil/Timer.hxx"
 
 #include "repro/AbstractDb.hxx"
 #include "repro/SqlDb.hxx"
@@ -21,10 +22,157 @@ using namespace std;
 
 #define RESIPROCATE_SUBSYSTEM Subsystem::REPRO
 
-SqlDb::SqlDb(const resip::ConfigParse& config) : mConnected(false)
+SqlDb::SqlDb(const resip::ConfigParse& config) : 
+   mConnected(false),
+   mConnectionPoolSize(1),
+   mQueries(0),
+   mQueryTime(0),
+   mPoolWaits(0),
+   mPoolWaitTime(0)
 {
    mTlsPeerAuthorizationQuery = config.getConfigData("CustomTlsAuthQuery", "");
    mTableNamePrefix = config.getConfigData("TableNamePrefix", "");
+   int poolSize = config.getConfigInt("ConnectionPoolSize", 1);
+   if(poolSize > 1)
+   {
+      mConnectionPoolSize = (unsigned int)poolSize;
+   }
+   // hand out the lowest numbered connections first
+   for(unsigned int i = mConnectionPoolSize; i > 0; i--)
+   {
+      mFreeConnections.push_back(i - 1);
+   }
+}
+
+unsigned int
+SqlDb::acquireConnection() const
+{
+   Lock lock(mPoolMutex);
+   if(!mPinnedConnections.empty())
+   {
+      PinnedConnectionMap::const_iterator it = mPinnedConnections.find(ThreadIf::selfId());
+      if(it != mPinnedConnections.end())
+      {
+         return it->second;
+      }
+   }
+   if(mFreeConnections.empty())
+   {
+      uint64_t start = Timer::getTimeMicroSec();
+      while(mFreeConnections.empty())
+      {
+         mPoolCondition.wait(lock);
+      }
+      ++mPoolWaits;
+      mPoolWaitTime += Timer::getTimeMicroSec() - start;
+   }
+   unsigned int index = mFreeConnections.back();
+   mFreeConnections.pop_back();
+   return index;
+}
+
+void
+SqlDb::releaseConnection(unsigned int index) const
+{
+   Lock lock(mPoolMutex);
+   for(PinnedConnectionMap::const_iterator it = mPinnedConnections.begin(); it != mPinnedConnections.end(); it++)
+   {
+      if(it->second == index)
+      {
+         return;  // stays with its transaction
+      }
+   }
+   mFreeConnections.push_back(index);
+   mPoolCondition.notify_one();
+}
+
+void
+SqlDb::pinConnection() const
+{
+   unsigned int index = acquireConnection();
+   Lock lock(mPoolMutex);
+   mPinnedConnections[ThreadIf::selfId()] = index;
+}
+
+void
+SqlDb::unpinConnection() const
+{
+   Lock lock(mPoolMutex);
+   PinnedConnectionMap::iterator it = mPinnedConnections.find(ThreadIf::selfId());
+   if(it != mPinnedConnections.end())
+   {
+      mFreeConnections.push_back(it->second);
+      mPinnedConnections.erase(it);
+      mPoolCondition.notify_one();
+   }
+}
+
+void
+SqlDb::recordQuery(uint64_t startMicroSec) const
+{
+   ++mQueries;
+   mQueryTime += Timer::getTimeMicroSec() - startMicroSec;
+}
+
+Data
+SqlDb::parameterizeUserAuthQuery(const Data& query, bool numbered, unsigned int firstParam, std::vector<bool>& domainParams)
+{
+   static const Data userVariable("$user");
+   static const Data domainVariable("$domain");
+
+   Data result;
+   {
+      DataStream ds(result);
+      Data::size_type i = 0;
+      while(i < query.size())
+      {
+         bool quoted = query[i] == '\'';
+         Data::size_type start = quoted ? i + 1 : i;
+         Data::size_type length = 0;
+         bool isDomain = false;
+         if(query.find(userVariable, start) == start)
+         {
+            length = userVariable.size();
+         }
+         else if(query.find(domainVariable, start) == start)
+         {
+            length = domainVariable.size();
+            isDomain = true;
+         }
+         Data::size_type end = start + length;
+         if(length > 0 && quoted && (end >= query.size() || query[end] != '\''))
+         {
+            length = 0;  // only the variable is replaced, the quote stays
+         }
+         if(length == 0)
+         {
+            ds << query[i++];
+            continue;
+         }
+
+         if(numbered)
+         {
+            ds << '$' << (firstParam + (unsigned int)domainParams.size());
+         }
+         else
+         {
+            ds << '?';
+         }
+         domainParams.push_back(isDomain);
+         i = quoted ? end + 1 : end;
+      }
+   }
+   return result;
+}
+
+void
+SqlDb::logStatistics() const
+{
+   uint64_t queries = mQueries;
+   uint64_t waits = mPoolWaits;
+   InfoLog(<< "Database pool of " << mConnectionPoolSize << " connections: "
+           << queries << " queries, avg " << (queries ? mQueryTime / queries : 0) << "us; "
+           << waits << " waited for a connection, avg " << (waits ? mPoolWaitTime / waits : 0) << "us");
 }
 
 void 
@@ -138,14 +286,18 @@ bool
 SqlDb::dbCommitTransaction(const Table table)
 {
    Data command("COMMIT");
-   return query(command) == 0;
+   bool success = query(command) == 0;
+   unpinConnection();
+   return success;
 }
 
 bool 
 SqlDb::dbRollbackTransaction(const Table table)
 {
    Data command("ROLLBACK");
-   return query(command) == 0;
+   bool success = query(command) == 0;
+   unpinConnection();
+   return success;
 }
 
 static const char userTable[] = "users";
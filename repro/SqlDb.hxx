@@ -1,8 +1,15 @@
 #if !defined(RESIP_SQLDB_HXX)
 #define RESIP_SQLDB_HXX 
 
+#include <atomic>
+#include <map>
+#include <vector>
+
+#include "rutil/Condition.hxx"
 #include "rutil/ConfigParse.hxx"
 #include "rutil/Data.hxx"
+#include "rutil/Mutex.hxx"
+#include "rutil/ThreadIf.hxx"
 #include "repro/AbstractDb.hxx"
 
 namespace resip
@@ -28,16 +35,53 @@ class SqlDb: public AbstractDb
       // Perform a query that expects a single result/row - returns all column/field data in a vector
       virtual int singleResultQuery(const resip::Data& queryCommand, std::vector<resip::Data>& fields) const = 0;
 
+      // Connection pool statistics; times are in microseconds
+      uint64_t getNumQueries() const { return mQueries; }
+      uint64_t getQueryTime() const { return mQueryTime; }
+      uint64_t getNumPoolWaits() const { return mPoolWaits; }
+      uint64_t getPoolWaitTime() const { return mPoolWaitTime; }
+      void logStatistics() const;
+
    protected:
       virtual void setConnected(bool connected) const { mConnected = connected; }
       virtual bool isConnected() const { return mConnected; }
 
       void setToData(const std::set<resip::Data>& items, resip::Data& result, const resip::Data& sep = ",", const char quote = '\'') const;
 
-      // when multiple threads are in use with the same connection, you need to
-      // mutex calls to mysql_query and mysql_store_result:
-      // http://dev.mysql.com/doc/refman/5.1/en/threaded-clients.html
-      mutable resip::Mutex mMutex;
+      // Each query borrows one of getConnectionPoolSize() connections for its
+      // duration, so that worker threads don't serialize on one connection
+      // (a connection must never be used by two threads at once:
+      // http://dev.mysql.com/doc/refman/5.1/en/threaded-clients.html).
+      // Backends keep their per connection state in a vector indexed by the
+      // number handed out here.
+      unsigned int getConnectionPoolSize() const { return mConnectionPoolSize; }
+      unsigned int acquireConnection() const;
+      void releaseConnection(unsigned int index) const;
+
+      class ConnectionGuard
+      {
+         public:
+            ConnectionGuard(const SqlDb& db) : mDb(db), mIndex(db.acquireConnection()) {}
+            ~ConnectionGuard() { mDb.releaseConnection(mIndex); }
+            unsigned int index() const { return mIndex; }
+         private:
+            const SqlDb& mDb;
+            unsigned int mIndex;
+      };
+
+      // A transaction keeps its connection for the calling thread until it is
+      // committed or rolled back
+      void pinConnection() const;
+      void unpinConnection() const;
+
+      // to be called when a query started at startMicroSec has completed
+      void recordQuery(uint64_t startMicroSec) const;
+
+      // Rewrites the $user and $domain variables of a custom query, quoted or
+      // not, into parameter markers: '?', or $n numbered from firstParam when
+      // numbered is set. domainParams gets one entry per marker, telling
+      // whether it takes the domain rather than the user.
+      static resip::Data parameterizeUserAuthQuery(const resip::Data& query, bool numbered, unsigned int firstParam, std::vector<bool>& domainParams);
 
       resip::Data tableName( Table table ) const;
 
@@ -54,6 +98,18 @@ class SqlDb: public AbstractDb
       virtual resip::Data& escapeString(const resip::Data& str, resip::Data& escapedStr) const = 0;
 
       mutable volatile bool mConnected;
+      unsigned int mConnectionPoolSize;
+
+      mutable resip::Mutex mPoolMutex;
+      mutable resip::Condition mPoolCondition;
+      mutable std::vector<unsigned int> mFreeConnections;
+      typedef std::map<resip::ThreadIf::Id, unsigned int> PinnedConnectionMap;
+      mutable PinnedConnectionMap mPinnedConnections;
+
+      mutable std::atomic<uint64_t> mQueries;
+      mutable std::atomic<uint64_t> mQueryTime;
+      mutable std::atomic<uint64_t> mPoolWaits;
+      mutable std::atomic<uint64_t> mPoolWaitTime;
       resip::Data mTlsPeerAuthorizationQuery;
       resip::Data mTableNamePrefix;
 
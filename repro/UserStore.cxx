@@ -7,6 +7,8 @@
 #include "rutil/DataStream.hxx"
 #include "resip/stack/Symbols.hxx"
 #include "rutil/Logger.hxx"
+#include "rutil/Lock.hxx"
+#include "rutil/Timer.hxx"
 #include "resip/stack/TransactionUser.hxx"
 #include "resip/dum/UserAuthInfo.hxx"
 
@@ -23,7 +25,12 @@ using namespace std;
 
 const resip::Data UserStore::SEPARATOR("@");
 
-UserStore::UserStore(AbstractDb& db ) : mDb(db)
+UserStore::UserStore(AbstractDb& db ) : 
+   mDb(db),
+   mAuthCacheMaxEntries(0),
+   mAuthCacheTtl(0),
+   mAuthCacheNegativeTtl(0),
+   mAuthCacheGeneration(0)
 { 
 }
 
@@ -42,7 +49,112 @@ UserStore::getUserAuthInfo(  const resip::Data& user,
                              const resip::Data& realm ) const
 {
    Key key =  buildKey(user, realm);
-   return mDb.getUserAuthInfo( key );
+   unsigned int generation = 0;
+   if(mAuthCacheMaxEntries > 0)
+   {
+      Lock lock(mAuthCacheMutex);
+      AuthCache::iterator it = mAuthCache.find(key);
+      if(it != mAuthCache.end())
+      {
+         if(it->second.mExpires > Timer::getTimeMs())
+         {
+            mAuthCacheLru.splice(mAuthCacheLru.begin(), mAuthCacheLru, it->second.mLru);
+            if(it->second.mA1.empty())
+            {
+               mAuthCacheStats.mNegativeHits++;
+            }
+            else
+            {
+               mAuthCacheStats.mHits++;
+            }
+            return it->second.mA1;
+         }
+         mAuthCacheLru.erase(it->second.mLru);
+         mAuthCache.erase(it);
+      }
+      mAuthCacheStats.mMisses++;
+      generation = mAuthCacheGeneration;
+   }
+
+   Data a1;
+   AbstractDb::LookupResult result = mDb.lookupUserAuthInfo( key, a1 );
+
+   if(mAuthCacheMaxEntries > 0)
+   {
+      Lock lock(mAuthCacheMutex);
+      // a failed lookup is not cached, so that a database outage does not
+      // lock users out for negativeTtl after it is over
+      unsigned int ttl = 0;
+      if(result == AbstractDb::LookupFound)
+      {
+         ttl = mAuthCacheTtl;
+      }
+      else if(result == AbstractDb::LookupNotFound)
+      {
+         ttl = mAuthCacheNegativeTtl;
+      }
+      if(ttl > 0 && generation == mAuthCacheGeneration && mAuthCache.find(key) == mAuthCache.end())
+      {
+         if(mAuthCache.size() >= mAuthCacheMaxEntries)
+         {
+            mAuthCache.erase(mAuthCacheLru.back());
+            mAuthCacheLru.pop_back();
+            mAuthCacheStats.mEvictions++;
+         }
+         mAuthCacheLru.push_front(key);
+         AuthCacheEntry& entry = mAuthCache[key];
+         entry.mA1 = a1;
+         entry.mExpires = Timer::getTimeMs() + ttl * 1000;
+         entry.mLru = mAuthCacheLru.begin();
+      }
+   }
+   return a1;
+}
+
+void
+UserStore::setAuthCache(unsigned int maxEntries, unsigned int ttl, unsigned int negativeTtl)
+{
+   Lock lock(mAuthCacheMutex);
+   mAuthCacheMaxEntries = maxEntries;
+   mAuthCacheTtl = ttl;
+   mAuthCacheNegativeTtl = negativeTtl;
+   mAuthCache.clear();
+   mAuthCacheLru.clear();
+   mAuthCacheGeneration++;
+}
+
+void
+UserStore::clearAuthCache()
+{
+   Lock lock(mAuthCacheMutex);
+   mAuthCache.clear();
+   mAuthCacheLru.clear();
+   mAuthCacheGeneration++;
+}
+
+UserStore::AuthCacheStats
+UserStore::getAuthCacheStats() const
+{
+   Lock lock(mAuthCacheMutex);
+   AuthCacheStats stats = mAuthCacheStats;
+   stats.mEntries = (unsigned long)mAuthCache.size();
+   return stats;
+}
+
+void
+UserStore::invalidateAuthCache(const Data& user)
+{
+   // the cache is keyed by user and realm, which need not be the domain
+   // the user was stored under - so drop the user from every realm
+   Lock lock(mAuthCacheMutex);
+   Data prefix(user + SEPARATOR);
+   AuthCache::iterator it = mAuthCache.lower_bound(prefix);
+   while(it != mAuthCache.end() && it->first.prefix(prefix))
+   {
+      mAuthCacheLru.erase(it->second.mLru);
+      mAuthCache.erase(it++);
+   }
+   mAuthCacheGeneration++;
 }
 
 bool 
@@ -91,13 +203,20 @@ UserStore::addUser( const Data& username,
    rec.email = emailAddress;
    rec.forwardAddress = Data::Empty;
 
-   return mDb.addUser( buildKey(username,domain), rec);
+   bool ret = mDb.addUser( buildKey(username,domain), rec);
+   invalidateAuthCache(username);
+   return ret;
 }
 
 void 
 UserStore::eraseUser( const Key& key )
 { 
    mDb.eraseUser( key );
+
+   Data user;
+   Data domain;
+   getUserAndDomainFromKey(key, user, domain);
+   invalidateAuthCache(user);
 }
 
 bool
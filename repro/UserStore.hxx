@@ -1,8 +1,12 @@
 #if !defined(REPRO_USERSTORE_HXX)
 #define REPRO_USERSTORE_HXX
 
+#include <list>
+#include <map>
+
 #include "rutil/Data.hxx"
 #include "rutil/Fifo.hxx"
+#include "rutil/Mutex.hxx"
 #include "resip/stack/Message.hxx"
 
 #include "repro/AbstractDb.hxx"
@@ -58,10 +62,53 @@ class UserStore
       static Key buildKey(const resip::Data& user, const resip::Data& domain);
       static void getUserAndDomainFromKey(const AbstractDb::Key& key, resip::Data& user, resip::Data& domain);
 
+      // Keeps the results of getUserAuthInfo() for ttl seconds, and those for
+      // unknown users for negativeTtl seconds (failed database lookups are
+      // not cached), holding at most maxEntries
+      // (least recently used go first).  maxEntries 0 disables the cache.
+      // Users added, updated or erased through this store are dropped from
+      // it; changes made directly in the database are picked up after the
+      // ttl, or by clearAuthCache().
+      void setAuthCache(unsigned int maxEntries, unsigned int ttl, unsigned int negativeTtl);
+      void clearAuthCache();
+
+      class AuthCacheStats
+      {
+         public:
+            AuthCacheStats() : mEntries(0), mHits(0), mNegativeHits(0), mMisses(0), mEvictions(0) {}
+            unsigned long mEntries;
+            unsigned long mHits;
+            unsigned long mNegativeHits;  // answered "unknown user" from the cache
+            unsigned long mMisses;        // went to the database
+            unsigned long mEvictions;
+      };
+      AuthCacheStats getAuthCacheStats() const;
+
    private:
+      void invalidateAuthCache(const resip::Data& user);
 
       AbstractDb& mDb;
       static const resip::Data SEPARATOR;
+
+      class AuthCacheEntry
+      {
+         public:
+            resip::Data mA1;  // empty for an unknown user
+            uint64_t mExpires;
+            std::list<Key>::iterator mLru;
+      };
+      typedef std::map<Key, AuthCacheEntry> AuthCache;
+
+      unsigned int mAuthCacheMaxEntries;
+      unsigned int mAuthCacheTtl;
+      unsigned int mAuthCacheNegativeTtl;
+      mutable resip::Mutex mAuthCacheMutex;
+      mutable AuthCache mAuthCache;
+      mutable std::list<Key> mAuthCacheLru;  // most recently used first
+      // bumped on every invalidation, so a lookup that raced with one
+      // doesn't put the old value back
+      mutable unsigned int mAuthCacheGeneration;
+      mutable AuthCacheStats mAuthCacheStats;
 };
 
  }
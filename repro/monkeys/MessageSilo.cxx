@@ -233,10 +233,11 @@ MessageSilo::asyncProcess(AsyncProcessorMessage* msg)
       // as 0, then records never expire, so no need to peform the cleanup.
       // Note: addToSilo->mOriginalSendTime is always now - so no need to requery current time
       // Run cleanup before adding new records to save iterating through 1 extra item
-      if(mExpirationTime > 0 && (addToSilo->mOriginalSendTime - mLastSiloCleanupTime) > SILO_CLEANUP_PERIOD)
+      // Only the thread that manages to reset the stored cleanup time runs the cleanup
+      time_t lastCleanupTime = mLastSiloCleanupTime.load();
+      if(mExpirationTime > 0 && (addToSilo->mOriginalSendTime - lastCleanupTime) > SILO_CLEANUP_PERIOD &&
+         mLastSiloCleanupTime.compare_exchange_strong(lastCleanupTime, addToSilo->mOriginalSendTime))
       {
-         mLastSiloCleanupTime = addToSilo->mOriginalSendTime;  // reset stored silo cleanup time
-
          mSiloStore.cleanupExpiredSiloRecords(addToSilo->mOriginalSendTime, mExpirationTime);
       }
 
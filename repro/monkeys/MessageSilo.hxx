@@ -1,6 +1,7 @@
 #if !defined(RESIP_MESSAGESILO_REQUEST_PROCESSOR_HXX)
 #define RESIP_MESSAGESILO_REQUEST_PROCESSOR_HXX 
 
+#include <atomic>
 #include <regex>
 
 #include "repro/AsyncProcessor.hxx"
@@ -37,7 +38,8 @@ private:
    unsigned short mSuccessStatusCode;
    unsigned short mFilteredMimeTypeStatusCode;
    unsigned short mFailureStatusCode;
-   time_t mLastSiloCleanupTime;
+   // asyncProcess() runs on every async worker thread at once
+   std::atomic<time_t> mLastSiloCleanupTime;
 };
 
 }
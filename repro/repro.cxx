@@ -102,6 +102,8 @@ main(int argc, char** argv)
    repro.mainLoop();
 
    repro.shutdown();
+   // write out anything still queued by asynchronous logging
+   Log::stopAsync();
 
 #if defined(WIN32) && defined(_DEBUG) && defined(LEAK_CHECK) 
    }
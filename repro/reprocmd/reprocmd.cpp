@@ -45,6 +45,8 @@ main (int argc, char** argv)
       cerr << "  /LogDnsCache - causes the DNS cache contents to be written to the resip logs" << endl;
       cerr << "  /ClearDnsCache - empties the stacks DNS cache" << endl;
       cerr << "  /GetDnsCache - retrieves the DNS cache contents" << endl;
+      cerr << "  /GetUserAuthCacheStats - retrieves the hit/miss counters of the user auth cache" << endl;
+      cerr << "  /ClearUserAuthCache - empties the user auth cache, eg. after editing users in the database" << endl;
       cerr << "  /GetCongestionStats - retrieves the stacks congestion manager stats and state" << endl;
       cerr << "  /SetCongestionTolerance metric=<SIZE|WAIT_TIME|TIME_DEPTH> maxTolerance=<value>" << endl;
       cerr << "                          [fifoDescription=<desc>] - sets congestion tolerances" << endl;
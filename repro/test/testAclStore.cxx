@@ -0,0 +1,288 @@
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "rutil/Data.hxx"
+#include "rutil/DnsUtil.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/Timer.hxx"
+#include "resip/stack/Tuple.hxx"
+#include "repro/AclStore.hxx"
+#include "repro/test/MemoryDb.hxx"
+
+using namespace repro;
+using namespace resip;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TEST
+
+// deterministic, so a failure can be reproduced
+static unsigned int
+nextRandom()
+{
+   static unsigned int state = 12345;
+   state = state * 1103515245 + 12345;
+   return (state >> 8) & 0xffff;
+}
+
+class Subnet
+{
+   public:
+      bool v6;
+      unsigned char address[16];
+      short mask;
+      short port;
+      TransportType transport;
+};
+
+static Tuple
+makeTuple(bool v6, const unsigned char* address, int port, TransportType transport)
+{
+   if(v6)
+   {
+      in6_addr in6;
+      memcpy(&in6, address, 16);
+      return Tuple(in6, port, transport);
+   }
+   in_addr in4;
+   memcpy(&in4, address, 4);
+   return Tuple(in4, port, transport);
+}
+
+static Data
+printable(const Subnet& subnet)
+{
+   Tuple tuple = makeTuple(subnet.v6, subnet.address, subnet.port, subnet.transport);
+   return tuple.presentationFormat();
+}
+
+// carrier and customer subnets, some restricted to a port, over UDP or TCP
+static void
+makeSubnets(vector<Subnet>& subnets, unsigned int count)
+{
+   for(unsigned int i = 0; i < count; i++)
+   {
+      Subnet subnet;
+      subnet.v6 = (i % 4 == 3);
+      memset(subnet.address, 0, sizeof(subnet.address));
+      int bytes = subnet.v6 ? 16 : 4;
+      // keep them clustered, so that prefixes are shared and nested
+      subnet.address[0] = subnet.v6 ? 0x20 : 10 + (nextRandom() % 4);
+      for(int b = 1; b < bytes; b++)
+      {
+         subnet.address[b] = (unsigned char)(b < 3 ? nextRandom() % 8 : nextRandom());
+      }
+      subnet.mask = subnet.v6 ? (short)(64 + nextRandom() % 65) : (short)(8 + nextRandom() % 25);
+      subnet.port = (i % 3 == 0) ? 5060 : 0;
+      subnet.transport = (i % 2 == 0) ? UDP : TCP;
+      subnets.push_back(subnet);
+   }
+}
+
+// addresses inside, next to and far from the subnets
+static void
+makeSources(const vector<Subnet>& subnets, vector<Tuple>& sources, unsigned int count)
+{
+   static const int ports[] = { 5060, 5061, 40000 };
+   static const TransportType transports[] = { UDP, TCP, TLS };
+   for(unsigned int i = 0; i < count; i++)
+   {
+      const Subnet& subnet = subnets[nextRandom() % subnets.size()];
+      unsigned char address[16];
+      memcpy(address, subnet.address, sizeof(address));
+      int bits = subnet.v6 ? 128 : 32;
+      switch(i % 3)
+      {
+         case 0:
+            // inside: vary the host part
+            for(int b = subnet.mask; b < bits; b++)
+            {
+               if(nextRandom() & 1)
+               {
+                  address[b / 8] ^= (unsigned char)(0x80 >> (b % 8));
+               }
+            }
+            break;
+         case 1:
+            // flip one bit somewhere
+            {
+               int b = nextRandom() % bits;
+               address[b / 8] ^= (unsigned char)(0x80 >> (b % 8));
+            }
+            break;
+         default:
+            address[0] = (unsigned char)nextRandom();
+            break;
+      }
+      sources.push_back(makeTuple(subnet.v6, address, ports[nextRandom() % 3], transports[nextRandom() % 3]));
+   }
+}
+
+class AddressAcl
+{
+   public:
+      AddressAcl(const Tuple& address, short mask) : mAddress(address), mMask(mask) {}
+      Tuple mAddress;
+      short mMask;
+};
+
+static void
+getAddressAcls(AclStore& store, vector<AddressAcl>& acls)
+{
+   for(AclStore::Key key = store.getFirstAddressKey(); !key.empty(); key = store.getNextAddressKey(key))
+   {
+      acls.push_back(AddressAcl(store.getAddressTuple(key), store.getAddressMask(key)));
+   }
+}
+
+// What isAddressTrusted() did before the index: compare the address with
+// every address ACL in turn
+static bool
+isAddressTrustedLinear(const vector<AddressAcl>& acls, const Tuple& address)
+{
+   for(vector<AddressAcl>::const_iterator i = acls.begin(); i != acls.end(); i++)
+   {
+      if(i->mAddress.isEqualWithMask(address, i->mMask, i->mAddress.getPort() == 0))
+      {
+         return true;
+      }
+   }
+   return false;
+}
+
+static unsigned int
+compare(AclStore& store, const vector<Tuple>& sources)
+{
+   vector<AddressAcl> acls;
+   getAddressAcls(store, acls);
+   unsigned int trusted = 0;
+   for(vector<Tuple>::const_iterator it = sources.begin(); it != sources.end(); it++)
+   {
+      bool indexed = store.isAddressTrusted(*it);
+      assert(indexed == isAddressTrustedLinear(acls, *it));
+      trusted += indexed ? 1 : 0;
+   }
+   return trusted;
+}
+
+int
+main(int argc, char* argv[])
+{
+   Log::initialize(Log::Cout, argc > 1 ? Log::toLevel(argv[1]) : Log::Warning, argv[0]);
+
+   const unsigned int numSubnets = 3000;
+   vector<Subnet> subnets;
+   makeSubnets(subnets, numSubnets);
+   vector<Tuple> sources;
+   makeSources(subnets, sources, 20000);
+
+   MemoryDb db;
+   AclStore store(db);
+   assert(!store.isAddressTrusted(sources.front()));
+
+   // the basics
+   {
+      bool added = store.addAcl("192.168.1.0/24", 0, UDP);
+      assert(added);
+      added = store.addAcl(Data::Empty, "172.16.0.1", 32, 5062, V4, TCP);
+      assert(added);
+      assert(store.isAddressTrusted(Tuple("192.168.1.77", 5060, UDP)));
+      assert(!store.isAddressTrusted(Tuple("192.168.2.77", 5060, UDP)));
+      assert(!store.isAddressTrusted(Tuple("192.168.1.77", 5060, TCP)));
+      assert(store.isAddressTrusted(Tuple("172.16.0.1", 5062, TCP)));
+      assert(!store.isAddressTrusted(Tuple("172.16.0.1", 5060, TCP)));
+      assert(!store.isAddressTrusted(Tuple("172.16.0.2", 5062, TCP)));
+      added = store.addAcl("[2001:db8::]/64", 0, TCP);
+      assert(added);
+      assert(store.isAddressTrusted(Tuple("2001:db8::5", 5060, TCP)));
+      assert(!store.isAddressTrusted(Tuple("2001:db8:0:1::5", 5060, TCP)));
+      store.eraseAcl(Data::Empty, "192.168.1.0", 24, 0, V4, UDP);
+      assert(!store.isAddressTrusted(Tuple("192.168.1.77", 5060, UDP)));
+   }
+
+   for(vector<Subnet>::const_iterator it = subnets.begin(); it != subnets.end(); it++)
+   {
+      store.addAcl(Data::Empty, printable(*it), it->mask, it->port, it->v6 ? V6 : V4, it->transport);
+   }
+
+   // the index agrees with the linear search, before and after erasing
+   unsigned int trusted = compare(store, sources);
+   assert(trusted > sources.size() / 10 && trusted < sources.size());
+   for(unsigned int i = 0; i < subnets.size(); i += 2)
+   {
+      const Subnet& subnet = subnets[i];
+      store.eraseAcl(Data::Empty, printable(subnet), subnet.mask, subnet.port, subnet.v6 ? V6 : V4, subnet.transport);
+   }
+   assert(compare(store, sources) < trusted);
+
+   // the index is built when the store is loaded, too
+   {
+      AclStore loaded(db);
+      compare(loaded, sources);
+   }
+
+   vector<AddressAcl> acls;
+   getAddressAcls(store, acls);
+   uint64_t start = Timer::getTimeMicroSec();
+   for(vector<Tuple>::const_iterator it = sources.begin(); it != sources.end(); it++)
+   {
+      isAddressTrustedLinear(acls, *it);
+   }
+   uint64_t linear = Timer::getTimeMicroSec() - start;
+   start = Timer::getTimeMicroSec();
+   for(vector<Tuple>::const_iterator it = sources.begin(); it != sources.end(); it++)
+   {
+      store.isAddressTrusted(*it);
+   }
+   uint64_t indexed = Timer::getTimeMicroSec() - start;
+   cerr << numSubnets / 2 << " address ACLs: " << (double)linear / sources.size() << " us per lookup searching every ACL, "
+        << (double)indexed / sources.size() << " us per lookup with the index" << endl;
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ */
@@ -0,0 +1,436 @@
+#include <cassert>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <regex>
+#include <vector>
+
+#include "rutil/Data.hxx"
+#include "rutil/DataStream.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/ParseBuffer.hxx"
+#include "rutil/Timer.hxx"
+#include "resip/stack/ExtensionHeader.hxx"
+#include "resip/stack/SipMessage.hxx"
+#include "repro/FilterStore.hxx"
+#include "repro/test/MemoryDb.hxx"
+
+using namespace repro;
+using namespace resip;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TEST
+
+// deterministic, so a failure can be reproduced
+static unsigned int
+nextRandom()
+{
+   static unsigned int state = 12345;
+   state = state * 1103515245 + 12345;
+   return (state >> 8) & 0xffff;
+}
+
+static const char* methods[] = { "", "", "INVITE", "invite", "REGISTER", "SUBSCRIBE", "MESSAGE", "FOO" };
+static const char* events[] = { "", "", "", "presence", "dialog" };
+static const char* headers[] = { "From", "To", "request-line", "User-Agent", "X-Tenant", "Route" };
+
+// a pattern for the header, with a group the action data can refer to
+static Data
+makeRegex(const Data& header, unsigned int i)
+{
+   if(header == "User-Agent")
+   {
+      return "^Phone/(" + Data(i % 4) + ")";
+   }
+   if(header == "X-Tenant")
+   {
+      return "tenant-(" + Data(i % 6) + ")$";
+   }
+   if(header == "request-line")
+   {
+      return "^(INVITE|MESSAGE|FOO) sip:(\\+1555" + Data(i % 10) + ")";
+   }
+   return "sip:(user" + Data(i % 20) + ")@";
+}
+
+static void
+addRandomFilter(FilterStore& store, unsigned int i)
+{
+   Data cond1Header(headers[nextRandom() % (sizeof(headers) / sizeof(headers[0]))]);
+   Data cond2Header(nextRandom() % 3 == 0 ? headers[nextRandom() % (sizeof(headers) / sizeof(headers[0]))] : "");
+   Data cond1Regex(cond1Header.empty() ? Data::Empty : makeRegex(cond1Header, nextRandom()));
+   Data cond2Regex(cond2Header.empty() ? Data::Empty : makeRegex(cond2Header, nextRandom()));
+   Data actionData;
+   switch(nextRandom() % 3)
+   {
+      case 0:
+         actionData = "403, Blocked " + Data(i);
+         break;
+      case 1:
+         actionData = "403, Blocked $11 " + Data(i);
+         break;
+      default:
+         actionData = "480, $21 $12 " + Data(i);
+         break;
+   }
+   store.addFilter(cond1Header, cond1Regex, cond2Header, cond2Regex,
+                   methods[nextRandom() % (sizeof(methods) / sizeof(methods[0]))],
+                   events[nextRandom() % (sizeof(events) / sizeof(events[0]))],
+                   (short)(nextRandom() % 3), actionData, (short)(nextRandom() % 50));
+}
+
+static SipMessage*
+makeRequest(unsigned int i)
+{
+   const char* method[] = { "INVITE", "REGISTER", "SUBSCRIBE", "MESSAGE", "FOO", "OPTIONS" };
+   Data m(method[i % (sizeof(method) / sizeof(method[0]))]);
+   Data txt(m + " sip:+1555" + Data(nextRandom() % 12) + "@example.com SIP/2.0\r\n"
+            "Via: SIP/2.0/UDP 192.0.2.1:5060;branch=z9hG4bK-filter-" + Data(i) + "\r\n"
+            "Max-Forwards: 70\r\n"
+            "To: <sip:user" + Data(nextRandom() % 25) + "@example.com>\r\n"
+            "From: <sip:user" + Data(nextRandom() % 25) + "@example.com>;tag=" + Data(i) + "\r\n"
+            "Call-ID: filter-" + Data(i) + "@192.0.2.1\r\n"
+            "CSeq: 1 " + m + "\r\n");
+   if(nextRandom() % 2)
+   {
+      txt += "User-Agent: Phone/" + Data(nextRandom() % 5) + "\r\n";
+   }
+   if(nextRandom() % 2)
+   {
+      txt += "X-Tenant: tenant-" + Data(nextRandom() % 8) + "\r\n";
+      txt += "X-Tenant: tenant-" + Data(nextRandom() % 8) + "\r\n";
+   }
+   if(m == "SUBSCRIBE")
+   {
+      txt += nextRandom() % 2 ? "Event: presence\r\n" : "Event: dialog;id=1\r\n";
+   }
+   txt += "Content-Length: 0\r\n\r\n";
+   return SipMessage::make(txt);
+}
+
+// What FilterStore::process() did before the filters were compiled into a
+// plan: walk every filter in order, pulling the headers out of the request
+// and running the regexes for each one
+class LinearFilters
+{
+   public:
+      LinearFilters(FilterStore& store)
+      {
+         for(Data key = store.getFirstKey(); !key.empty(); key = store.getNextKey(key))
+         {
+            Filter filter;
+            filter.mRecord = store.getFilterRecord(key);
+            filter.mCond1 = compile(filter.mRecord.mCondition1Regex, filter.mRecord.mActionData);
+            filter.mCond2 = compile(filter.mRecord.mCondition2Regex, filter.mRecord.mActionData);
+            mFilters.push_back(filter);
+         }
+      }
+
+      bool process(const SipMessage& request, short& action, Data& actionData) const
+      {
+         Data method(request.methodStr());
+         Data event(request.exists(h_Event) ? request.header(h_Event).value() : Data::Empty);
+         for(vector<Filter>::const_iterator it = mFilters.begin(); it != mFilters.end(); it++)
+         {
+            const AbstractDb::FilterRecord& rec = it->mRecord;
+            if(!rec.mMethod.empty() && !isEqualNoCase(rec.mMethod, method))
+            {
+               continue;
+            }
+            if(!rec.mEvent.empty() && !isEqualNoCase(rec.mEvent, event))
+            {
+               continue;
+            }
+            actionData = rec.mActionData;
+            if(!rec.mCondition1Header.empty() && it->mCond1 &&
+               !matches(request, 1, rec.mCondition1Header, *it->mCond1, actionData))
+            {
+               continue;
+            }
+            if(!rec.mCondition2Header.empty() && it->mCond2 &&
+               !matches(request, 2, rec.mCondition2Header, *it->mCond2, actionData))
+            {
+               continue;
+            }
+            action = rec.mAction;
+            return true;
+         }
+         return false;
+      }
+
+   private:
+      class Filter
+      {
+         public:
+            AbstractDb::FilterRecord mRecord;
+            shared_ptr<regex> mCond1;  // null if empty or invalid
+            shared_ptr<regex> mCond2;
+      };
+
+      static shared_ptr<regex> compile(const Data& pattern, const Data& actionData)
+      {
+         if(pattern.empty())
+         {
+            return shared_ptr<regex>();
+         }
+         regex_constants::syntax_option_type flags = regex_constants::ECMAScript;
+         if(actionData.find("$") == Data::npos)
+         {
+            flags |= regex_constants::nosubs;
+         }
+         try
+         {
+            return make_shared<regex>(pattern.c_str(), flags);
+         }
+         catch(regex_error&)
+         {
+            return shared_ptr<regex>();
+         }
+      }
+
+      static void getHeaders(const SipMessage& request, const Data& name, list<Data>& values)
+      {
+         if(isEqualNoCase(name, "request-line"))
+         {
+            values.push_back(Data::from(request.header(h_RequestLine)));
+            return;
+         }
+         Headers::Type type = Headers::getType(name.c_str(), name.size());
+         if(type != Headers::UNKNOWN)
+         {
+            const HeaderFieldValueList* hfv = request.getRawHeader(type);
+            if(hfv)
+            {
+               for(HeaderFieldValueList::const_iterator it = hfv->begin(); it != hfv->end(); it++)
+               {
+                  Data value;
+                  it->toShareData(value);
+                  values.push_back(value);
+               }
+            }
+            return;
+         }
+         ExtensionHeader exHeader(name);
+         if(request.exists(exHeader))
+         {
+            const StringCategories& exHeaders = request.header(exHeader);
+            for(StringCategories::const_iterator it = exHeaders.begin(); it != exHeaders.end(); it++)
+            {
+               values.push_back(it->value());
+            }
+         }
+      }
+
+      // the first header value the regex is found in wins; its groups
+      // replace $<condition><group> in the action data
+      static bool matches(const SipMessage& request, int condition, const Data& name, const regex& re, Data& actionData)
+      {
+         list<Data> values;
+         getHeaders(request, name, values);
+         for(list<Data>::const_iterator it = values.begin(); it != values.end(); it++)
+         {
+            cmatch groups;
+            if(!regex_search(it->c_str(), groups, re))
+            {
+               continue;
+            }
+            for(size_t i = 1; i < groups.size() && actionData.find("$") != Data::npos; i++)
+            {
+               Data group(groups[i]);
+               Data result;
+               {
+                  DataStream s(result);
+                  ParseBuffer pb(actionData);
+                  while(true)
+                  {
+                     const char* start = pb.position();
+                     pb.skipToChars(Data("$") + char('0' + condition) + char('0' + i));
+                     s << pb.data(start);
+                     if(pb.eof())
+                     {
+                        break;
+                     }
+                     pb.skipN(3);
+                     s << group;
+                  }
+               }
+               actionData = result;
+            }
+            return true;
+         }
+         return false;
+      }
+
+      vector<Filter> mFilters;
+};
+
+static unsigned int
+checkSame(FilterStore& store, const vector<SipMessage*>& requests)
+{
+   LinearFilters linear(store);
+   unsigned int matched = 0;
+   for(vector<SipMessage*>::const_iterator it = requests.begin(); it != requests.end(); it++)
+   {
+      short action = -1;
+      short linearAction = -1;
+      Data actionData;
+      Data linearActionData;
+      bool match = store.process(**it, action, actionData);
+      bool linearMatch = linear.process(**it, linearAction, linearActionData);
+      if(match != linearMatch || action != linearAction || actionData != linearActionData)
+      {
+         cerr << "process: " << match << " " << action << " " << actionData << endl
+              << "linear: " << linearMatch << " " << linearAction << " " << linearActionData << endl
+              << **it << endl;
+      }
+      assert(match == linearMatch);
+      if(match)
+      {
+         assert(action == linearAction);
+         assert(actionData == linearActionData);
+         matched++;
+      }
+   }
+   return matched;
+}
+
+int
+main(int argc, char* argv[])
+{
+   Log::initialize(Log::Cout, argc > 1 ? Log::toLevel(argv[1]) : Log::Warning, argv[0]);
+
+   vector<SipMessage*> requests;
+   for(unsigned int i = 0; i < 2000; i++)
+   {
+      requests.push_back(makeRequest(i));
+   }
+
+   MemoryDb db;
+   FilterStore store(db);
+
+   // nothing to match
+   {
+      short action;
+      Data actionData;
+      bool matched = store.process(*requests.front(), action, actionData);
+      assert(!matched);
+   }
+
+   // the first filter in order wins, and the groups rewrite the action data
+   {
+      store.addFilter("From", "sip:(user1)@", "request-line", "^INVITE sip:(\\+1555)", "INVITE", "", 1, "403, $11 calling $21", 2);
+      store.addFilter("From", "sip:user1@", "", "", "", "", 0, "", 5);
+      SipMessage* invite = SipMessage::make("INVITE sip:+15551@example.com SIP/2.0\r\n"
+                                            "Via: SIP/2.0/UDP 192.0.2.1:5060;branch=z9hG4bK-order\r\n"
+                                            "To: <sip:user2@example.com>\r\n"
+                                            "From: <sip:user1@example.com>;tag=1\r\n"
+                                            "Call-ID: order@192.0.2.1\r\n"
+                                            "CSeq: 1 INVITE\r\n"
+                                            "Content-Length: 0\r\n\r\n");
+      short action = -1;
+      Data actionData;
+      bool matched = store.process(*invite, action, actionData);
+      assert(matched);
+      assert(action == 1);
+      assert(actionData == "403, user1 calling +1555");
+      delete invite;
+   }
+
+   // an invalid regex leaves its condition out, as it always has
+   store.addFilter("To", "sip:(user3@", "", "", "MESSAGE", "", 1, "400, bad", 1);
+   assert(checkSame(store, requests) > 0);
+
+   for(unsigned int i = 0; i < 500; i++)
+   {
+      addRandomFilter(store, i);
+   }
+   unsigned int matched = checkSame(store, requests);
+   assert(matched > 0);
+
+   // removing filters replaces the plan
+   {
+      vector<Data> keys;
+      for(Data key = store.getFirstKey(); !key.empty(); key = store.getNextKey(key))
+      {
+         keys.push_back(key);
+      }
+      for(unsigned int i = 0; i < keys.size(); i += 2)
+      {
+         store.eraseFilter(keys[i]);
+      }
+      checkSame(store, requests);
+   }
+
+   // compare with walking every filter for every request
+   {
+      LinearFilters linearFilters(store);
+      short action;
+      Data actionData;
+      uint64_t start = Timer::getTimeMicroSec();
+      for(vector<SipMessage*>::const_iterator it = requests.begin(); it != requests.end(); it++)
+      {
+         linearFilters.process(**it, action, actionData);
+      }
+      uint64_t linear = Timer::getTimeMicroSec() - start;
+      start = Timer::getTimeMicroSec();
+      for(vector<SipMessage*>::const_iterator it = requests.begin(); it != requests.end(); it++)
+      {
+         store.process(**it, action, actionData);
+      }
+      uint64_t planned = Timer::getTimeMicroSec() - start;
+      cerr << requests.size() << " requests: " << (double)linear / requests.size() << " us per request walking the filters, "
+           << (double)planned / requests.size() << " us per request with the plan" << endl;
+   }
+
+   for(vector<SipMessage*>::iterator it = requests.begin(); it != requests.end(); it++)
+   {
+      delete *it;
+   }
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ */
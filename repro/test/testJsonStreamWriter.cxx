@@ -0,0 +1,198 @@
+#include <cassert>
+#include <iostream>
+#include <sstream>
+
+#include "cajun/json/elements.h"
+#include "cajun/json/writer.h"
+
+#include "rutil/Data.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/Timer.hxx"
+#include "repro/JsonStreamWriter.hxx"
+
+using namespace repro;
+using namespace resip;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TEST
+
+static Data
+write(const json::Object& object)
+{
+   Data out;
+   {
+      DataStream ds(out);
+      json::Writer::Write(object, ds);
+   }
+   return out;
+}
+
+// A session event the shape of the ones AccountingCollector writes, built
+// either way
+static void
+buildSessionEvent(unsigned int i, json::Object* object, JsonStreamWriter* writer, bool withVias)
+{
+   Data callId("a84b4c76e66710-" + Data(i) + "@pc33.example.com");
+   Data uri("sip:+1555" + Data(1000000 + i) + "@example.com;user=phone");
+   // UTF-8, escapes and a truncated sequence
+   const char* displayName = "Zo\xc3\xab \"the\" \xe2\x82\xac\\\tB\xc3";
+
+   if(object)
+   {
+      (*object)["EventId"] = json::Number(1);
+      (*object)["EventName"] = json::String("Session Created");
+      (*object)["Datetime"] = json::String("Fri, 16 Oct 2026 09:00:00 GMT");
+      (*object)["CallId"] = json::String(callId.c_str());
+      (*object)["To"]["DisplayName"] = json::String(displayName);
+      (*object)["To"]["Uri"] = json::String(uri.c_str());
+      if(withVias)
+      {
+         json::Array vias;
+         for(unsigned int v = 0; v < 3; v++)
+         {
+            vias.Insert(json::String(Data("SIP/2.0/UDP 192.0.2." + Data(v) + ":5060;branch=z9hG4bK" + Data(i)).c_str()));
+         }
+         (*object)["Vias"] = vias;
+      }
+      (*object)["ClientPublicAddress"]["Transport"] = json::String("UDP");
+      (*object)["ClientPublicAddress"]["Port"] = json::Number(5060 + i);
+      (*object)["Expires"] = json::Number(3600u);
+   }
+
+   if(writer)
+   {
+      writer->member("EventId", 1);
+      writer->member("EventName", "Session Created");
+      writer->member("Datetime", Data("Fri, 16 Oct 2026 09:00:00 GMT"));
+      writer->member("CallId", callId);
+      writer->beginObject("To");
+      writer->member("DisplayName", displayName);
+      writer->member("Uri", uri);
+      writer->endObject();
+      writer->beginArray("Vias");  // left out when there is nothing in it
+      for(unsigned int v = 0; withVias && v < 3; v++)
+      {
+         writer->element("SIP/2.0/UDP 192.0.2." + Data(v) + ":5060;branch=z9hG4bK" + Data(i));
+      }
+      writer->endArray();
+      writer->beginObject("ClientPublicAddress");
+      writer->member("Transport", "UDP");
+      writer->member("Port", 5060 + i);
+      writer->endObject();
+      writer->member("Expires", 3600u);
+   }
+}
+
+int
+main(int argc, char* argv[])
+{
+   Log::initialize(Log::Cout, argc > 1 ? Log::toLevel(argv[1]) : Log::Warning, argv[0]);
+
+   // an empty object
+   {
+      JsonStreamWriter writer;
+      assert(writer.finish() == write(json::Object()));
+   }
+
+   // the same bytes as json::Writer
+   for(unsigned int i = 0; i < 2; i++)
+   {
+      json::Object object;
+      JsonStreamWriter writer;
+      buildSessionEvent(i, &object, &writer, i == 1);
+      Data streamed = writer.finish();
+      Data dom = write(object);
+      if(streamed != dom)
+      {
+         cerr << "streamed:" << endl << streamed << endl << "json::Writer:" << endl << dom << endl;
+      }
+      assert(streamed == dom);
+      assert((streamed.find("Vias") != Data::npos) == (i == 1));
+   }
+
+   // nested objects in arrays are not needed by accounting events, but
+   // objects in objects are
+   {
+      json::Object object;
+      object["A"]["B"]["C"] = json::String("deep");
+      object["D"] = json::Number(-1.5);
+      JsonStreamWriter writer;
+      writer.beginObject("A");
+      writer.beginObject("B");
+      writer.member("C", "deep");
+      writer.endObject();
+      writer.beginObject("Unused");
+      writer.endObject();
+      writer.endObject();
+      writer.member("D", -1.5);
+      assert(writer.finish() == write(object));
+   }
+
+   // compare with building the DOM for every event
+   const unsigned int events = 20000;
+   uint64_t start = Timer::getTimeMicroSec();
+   for(unsigned int i = 0; i < events; i++)
+   {
+      json::Object object;
+      buildSessionEvent(i, &object, 0, true);
+      write(object);
+   }
+   uint64_t dom = Timer::getTimeMicroSec() - start;
+   start = Timer::getTimeMicroSec();
+   for(unsigned int i = 0; i < events; i++)
+   {
+      JsonStreamWriter writer;
+      buildSessionEvent(i, 0, &writer, true);
+      writer.finish();
+   }
+   uint64_t streamed = Timer::getTimeMicroSec() - start;
+   cerr << events << " session events: " << (double)dom / events << " us per event with json::Object, "
+        << (double)streamed / events << " us per event with JsonStreamWriter" << endl;
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ */
@@ -0,0 +1,319 @@
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <map>
+#include <set>
+#include <thread>
+
+#include "rutil/Data.hxx"
+#include "rutil/Lock.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/Mutex.hxx"
+#include "rutil/Timer.hxx"
+#include "resip/stack/Helper.hxx"
+#include "resip/stack/SipMessage.hxx"
+#include "resip/stack/SipStack.hxx"
+#include "resip/stack/TransactionTerminated.hxx"
+#include "resip/dum/InMemorySyncRegDb.hxx"
+#include "repro/ProcessorChain.hxx"
+#include "repro/ProcessorMessage.hxx"
+#include "repro/Proxy.hxx"
+#include "repro/ProxyConfig.hxx"
+#include "repro/RequestContext.hxx"
+#include "repro/monkeys/AmIResponsible.hxx"
+#include "repro/monkeys/IsTrustedNode.hxx"
+#include "repro/monkeys/LocationServer.hxx"
+#include "repro/monkeys/OutboundTargetHandler.hxx"
+#include "repro/monkeys/QValueTargetHandler.hxx"
+#include "repro/monkeys/SimpleTargetHandler.hxx"
+#include "repro/monkeys/StaticRoute.hxx"
+#include "repro/monkeys/StrictRouteFixup.hxx"
+#include "repro/test/MemoryDb.hxx"
+
+using namespace repro;
+using namespace resip;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TEST
+
+static atomic<unsigned int> contextsDeleted(0);
+
+class CountingRequestContext : public RequestContext
+{
+   public:
+      CountingRequestContext(Proxy& proxy, ProcessorChain& requestP, ProcessorChain& responseP, ProcessorChain& targetP) :
+         RequestContext(proxy, requestP, responseP, targetP) {}
+      virtual ~CountingRequestContext() { contextsDeleted++; }
+};
+
+class CountingRequestContextFactory : public RequestContextFactory
+{
+   public:
+      virtual RequestContext* createRequestContext(Proxy& proxy, ProcessorChain& requestP, ProcessorChain& responseP, ProcessorChain& targetP)
+      {
+         return new CountingRequestContext(proxy, requestP, responseP, targetP);
+      }
+};
+
+class WorkMessage : public ProcessorMessage
+{
+   public:
+      WorkMessage(const Processor& proc, const Data& tid, TransactionUser* tu) : ProcessorMessage(proc, tid, tu) {}
+      virtual Message* clone() const { return new WorkMessage(*this); }
+      virtual EncodeStream& encode(EncodeStream& strm) const { strm << "WorkMessage(tid=" << mTid << ")"; return strm; }
+      virtual EncodeStream& encodeBrief(EncodeStream& strm) const { return encode(strm); }
+};
+
+// Goes async once, the way AsyncProcessors do, then does some work and
+// answers the request.  Checks that both halves run on the same thread.
+class BusyMonkey : public Processor
+{
+   public:
+      BusyMonkey() : Processor("BusyMonkey"), mDone(0), mWrongThread(0) {}
+
+      virtual processor_action_t process(RequestContext& context)
+      {
+         Data tid(context.getTransactionId());
+         if(!dynamic_cast<WorkMessage*>(context.getCurrentEvent()))
+         {
+            {
+               Lock lock(mMutex);
+               mThreads[tid] = this_thread::get_id();
+            }
+            context.getProxy().post(new WorkMessage(*this, tid, &context.getProxy()));
+            return WaitingForEvent;
+         }
+
+         {
+            Lock lock(mMutex);
+            if(mThreads[tid] != this_thread::get_id())
+            {
+               mWrongThread++;
+            }
+            mThreadsUsed.insert(this_thread::get_id());
+            mThreads.erase(tid);
+         }
+
+         // stand in for digest checks, routing lookups and the like
+         Data work(Data::from(context.getOriginalRequest()));
+         for(int i = 0; i < 50; i++)
+         {
+            work = work.md5() + work;
+            work.truncate(1024);
+         }
+
+         SipMessage response;
+         Helper::makeResponse(response, context.getOriginalRequest(), 200);
+         context.sendResponse(response);
+         // there is no transaction in the stack to tell us it is over
+         context.getProxy().post(new TransactionTerminated(tid, false /* isClient */, &context.getProxy()));
+         mDone++;
+         return SkipAllChains;
+      }
+
+      atomic<unsigned int> mDone;
+      atomic<unsigned int> mWrongThread;
+      Mutex mMutex;
+      map<Data, thread::id> mThreads;
+      set<thread::id> mThreadsUsed;
+};
+
+static SipMessage*
+makeInvite(unsigned int i, const Data& user = "bob")
+{
+   Data txt("INVITE sip:" + user + "@example.com SIP/2.0\r\n"
+            "Via: SIP/2.0/UDP 192.0.2.1:5060;branch=z9hG4bK-load-" + Data(i) + "\r\n"
+            "Max-Forwards: 70\r\n"
+            "To: <sip:" + user + "@example.com>\r\n"
+            "From: <sip:alice@example.com>;tag=" + Data(i) + "\r\n"
+            "Call-ID: load-" + Data(i) + "@192.0.2.1\r\n"
+            "CSeq: 1 INVITE\r\n"
+            "Contact: <sip:alice@192.0.2.1:5060>\r\n"
+            "Content-Length: 0\r\n"
+            "\r\n");
+   return SipMessage::make(txt);
+}
+
+// Runs the requests through a Proxy with the given number of worker
+// threads, returning the time taken in ms
+static uint64_t
+runLoad(unsigned int numWorkerThreads, unsigned int numRequests)
+{
+   MemoryDb db;
+   ProxyConfig config;
+   config.insertConfigValue("NumProxyWorkerThreads", Data(numWorkerThreads));
+   config.createDataStore(&db);
+
+   // the stack is never processed; the proxy's responses just queue up in it
+   SipStack stack;
+   ProcessorChain requestChain(Processor::REQUEST_CHAIN);
+   ProcessorChain responseChain(Processor::RESPONSE_CHAIN);
+   ProcessorChain targetChain(Processor::TARGET_CHAIN);
+   BusyMonkey* monkey = new BusyMonkey;
+   requestChain.addProcessor(std::unique_ptr<Processor>(monkey));
+
+   contextsDeleted = 0;
+   uint64_t elapsed;
+   {
+      Proxy proxy(stack, config, requestChain, responseChain, targetChain);
+      proxy.setRequestContextFactory(std::unique_ptr<RequestContextFactory>(new CountingRequestContextFactory));
+      assert(proxy.getNumWorkerThreads() == numWorkerThreads);
+      proxy.run();
+
+      uint64_t start = Timer::getTimeMs();
+      for(unsigned int i = 0; i < numRequests; i++)
+      {
+         proxy.post(makeInvite(i));
+      }
+      while(contextsDeleted < numRequests && Timer::getTimeMs() - start < 60000)
+      {
+         this_thread::sleep_for(chrono::milliseconds(1));
+      }
+      elapsed = Timer::getTimeMs() - start;
+   }
+
+   assert(monkey->mDone == numRequests);
+   assert(contextsDeleted == numRequests);
+   assert(monkey->mWrongThread == 0);
+   assert(monkey->mThreads.empty());
+   assert(monkey->mThreadsUsed.size() == resipMax(numWorkerThreads, 1u));
+   return elapsed;
+}
+
+// Runs requests through the processors ReproRunner puts in the chains by
+// default.  They are for users whose only contact has expired, so the
+// LocationServers on all the workers remove contacts from the one
+// registration database, and every request is answered with a 480.
+static void
+runDefaultChains(unsigned int numWorkerThreads, unsigned int numRequests)
+{
+   MemoryDb db;
+   ProxyConfig config;
+   config.insertConfigValue("NumProxyWorkerThreads", Data(numWorkerThreads));
+   // there is no digest authenticator in these chains
+   config.insertConfigValue("DisableAuth", "true");
+   config.createDataStore(&db);
+
+   InMemorySyncRegDb regDb;
+   const unsigned int numUsers = 50;
+   for(unsigned int i = 0; i < numUsers; i++)
+   {
+      ContactInstanceRecord contact;
+      contact.mContact = NameAddr("<sip:user" + Data(i) + "@192.0.2.2:5060>");
+      contact.mRegExpires = 0;
+      ContactList contacts;
+      contacts.push_back(contact);
+      regDb.addAor(Uri("sip:user" + Data(i) + "@example.com"), contacts);
+   }
+
+   SipStack stack;
+   ProcessorChain requestChain(Processor::REQUEST_CHAIN);
+   ProcessorChain responseChain(Processor::RESPONSE_CHAIN);
+   ProcessorChain targetChain(Processor::TARGET_CHAIN);
+   requestChain.addProcessor(std::unique_ptr<Processor>(new StrictRouteFixup));
+   requestChain.addProcessor(std::unique_ptr<Processor>(new IsTrustedNode(config)));
+   requestChain.addProcessor(std::unique_ptr<Processor>(new AmIResponsible(false)));
+   requestChain.addProcessor(std::unique_ptr<Processor>(new StaticRoute(config)));
+   requestChain.addProcessor(std::unique_ptr<Processor>(new LocationServer(config, regDb, 0)));
+   responseChain.addProcessor(std::unique_ptr<Processor>(new OutboundTargetHandler(regDb)));
+   targetChain.addProcessor(std::unique_ptr<Processor>(new QValueTargetHandler(config)));
+   targetChain.addProcessor(std::unique_ptr<Processor>(new SimpleTargetHandler));
+
+   contextsDeleted = 0;
+   {
+      Proxy proxy(stack, config, requestChain, responseChain, targetChain);
+      proxy.addDomain("example.com");
+      proxy.setRequestContextFactory(std::unique_ptr<RequestContextFactory>(new CountingRequestContextFactory));
+      proxy.run();
+
+      uint64_t start = Timer::getTimeMs();
+      for(unsigned int i = 0; i < numRequests; i++)
+      {
+         SipMessage* invite = makeInvite(i, "user" + Data(i % numUsers));
+         Data tid(invite->getTransactionId());
+         proxy.post(invite);
+         // there is no transaction in the stack to tell us it is over; this
+         // reaches the same worker after the request
+         proxy.post(new TransactionTerminated(tid, false /* isClient */, &proxy));
+      }
+      while(contextsDeleted < numRequests && Timer::getTimeMs() - start < 60000)
+      {
+         this_thread::sleep_for(chrono::milliseconds(1));
+      }
+   }
+
+   assert(contextsDeleted == numRequests);
+   for(unsigned int i = 0; i < numUsers; i++)
+   {
+      ContactList contacts;
+      regDb.getContacts(Uri("sip:user" + Data(i) + "@example.com"), contacts);
+      assert(contacts.empty());
+   }
+}
+
+int
+main(int argc, char* argv[])
+{
+   Log::initialize(Log::Cout, argc > 1 ? Log::toLevel(argv[1]) : Log::Warning, argv[0]);
+
+   const unsigned int numRequests = 2000;
+   uint64_t single = runLoad(0, numRequests);
+   cerr << numRequests << " requests on the Proxy thread: " << single << "ms" << endl;
+   for(unsigned int workers = 1; workers <= 4; workers *= 2)
+   {
+      uint64_t elapsed = runLoad(workers, numRequests);
+      cerr << numRequests << " requests on " << workers << " worker thread(s): " << elapsed << "ms ("
+           << thread::hardware_concurrency() << " cores)" << endl;
+   }
+
+   runDefaultChains(0, numRequests);
+   runDefaultChains(4, numRequests);
+   cerr << "default chains on 0 and 4 worker threads" << endl;
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ */
@@ -0,0 +1,312 @@
+#include <cassert>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "rutil/Data.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/Timer.hxx"
+#include "resip/stack/Tuple.hxx"
+#include "resip/stack/Uri.hxx"
+#include "resip/dum/ContactInstanceRecord.hxx"
+#include "repro/RegSyncDelta.hxx"
+
+using namespace repro;
+using namespace resip;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TEST
+
+static ContactInstanceRecord
+makeContact(unsigned int i, uint64_t now)
+{
+   ContactInstanceRecord rec;
+   rec.mContact = NameAddr("<sip:user" + Data(i) + "@192.0.2." + Data(i % 250 + 1) + ":5060;transport=tcp;ob>");
+   rec.mRegExpires = now + 3600;
+   rec.mLastUpdated = now - 10;
+   rec.mReceivedFrom = Tuple("192.0.2." + Data(i % 250 + 1), 40000 + i % 20000, V4, TCP);
+   rec.mReceivedFrom.mFlowKey = 7;
+   rec.mPublicAddress = Tuple("203.0.113.9", 5060, V4, UDP);
+   rec.mSipPath.push_back(NameAddr("<sip:edge.example.com;lr;ob>"));
+   rec.mInstance = "<urn:uuid:00000000-0000-1000-8000-" + Data((uint64_t)(100000000000ULL + i)) + ">";
+   rec.mRegId = 1;
+   rec.mUserAgent = "Example Phone/1.2.3";
+   return rec;
+}
+
+static void
+checkSame(const ContactInstanceRecord& got, const ContactInstanceRecord& expected)
+{
+   assert(got.mContact.uri() == expected.mContact.uri());
+   assert(got.mContact.uri().exists(p_ob));
+   // relative times are sent, allow for a second passing
+   assert(got.mRegExpires + 1 >= expected.mRegExpires && got.mRegExpires <= expected.mRegExpires + 1);
+   assert(got.mLastUpdated + 1 >= expected.mLastUpdated && got.mLastUpdated <= expected.mLastUpdated + 1);
+   assert(got.mReceivedFrom == expected.mReceivedFrom);
+   assert(got.mReceivedFrom.mFlowKey == expected.mReceivedFrom.mFlowKey);
+   assert(got.mPublicAddress == expected.mPublicAddress);
+   assert(got.mSipPath.size() == expected.mSipPath.size());
+   assert(got.mInstance == expected.mInstance);
+   assert(got.mRegId == expected.mRegId);
+   assert(got.mUserAgent == expected.mUserAgent);
+   assert(got.mSyncContact);
+}
+
+// Roughly what RegSyncServer sends for a contact as <reginfo>
+static size_t
+xmlSize(const Uri& aor, const ContactInstanceRecord& rec, uint64_t now)
+{
+   Data token;
+   Tuple::writeBinaryToken(rec.mReceivedFrom, token);
+   Data publicToken;
+   Tuple::writeBinaryToken(rec.mPublicAddress, publicToken);
+   stringstream ss;
+   ss << "<reginfo>\r\n   <aor>" << Data::from(aor).xmlCharDataEncode() << "</aor>\r\n"
+      << "   <contactinfo>\r\n"
+      << "      <contacturi>" << Data::from(rec.mContact).xmlCharDataEncode() << "</contacturi>\r\n"
+      << "      <expires>" << rec.mRegExpires - now << "</expires>\r\n"
+      << "      <lastupdate>" << now - rec.mLastUpdated << "</lastupdate>\r\n"
+      << "      <receivedfrom>" << token.base64encode() << "</receivedfrom>\r\n"
+      << "      <publicaddress>" << publicToken.base64encode() << "</publicaddress>\r\n"
+      << "      <sippath>" << Data::from(rec.mSipPath.front().uri()).xmlCharDataEncode() << "</sippath>\r\n"
+      << "      <instance>" << rec.mInstance.xmlCharDataEncode() << "</instance>\r\n"
+      << "      <regid>" << rec.mRegId << "</regid>\r\n"
+      << "      <useragent>" << rec.mUserAgent.xmlCharDataEncode() << "</useragent>\r\n"
+      << "   </contactinfo>\r\n</reginfo>\r\n";
+   return ss.str().size();
+}
+
+int
+main(int argc, char* argv[])
+{
+   Log::initialize(Log::Cout, argc > 1 ? Log::toLevel(argv[1]) : Log::Warning, argv[0]);
+
+   uint64_t now = Timer::getTimeSecs();
+   RegSyncDeltaEncoder encoder(0x1234567890ULL);
+   RegSyncDeltaDecoder decoder;
+   vector<RegSyncDeltaDecoder::Change> changes;
+   uint64_t sequence = 0;
+   bool ok;
+
+   Uri aor("sip:alice@example.com");
+   ContactList contacts;
+   contacts.push_back(makeContact(1, now));
+   contacts.push_back(makeContact(2, now));
+
+   // new contacts are sent in full
+   {
+      Data ops;
+      unsigned int numOps = encoder.encodeChange(ops, aor, contacts);
+      assert(numOps == 2);
+      ok = decoder.decodeBatch(encoder.makeBatch(0, ++sequence, ops, numOps), changes);
+      assert(ok);
+      assert(changes.size() == 2);
+      assert(changes[0].mAor == aor);
+      checkSame(changes[0].mContact, contacts.front());
+      checkSame(changes[1].mContact, contacts.back());
+      assert(decoder.getInstanceId() == encoder.getInstanceId());
+      assert(decoder.getLastSequence() == sequence);
+   }
+
+   // nothing changed, nothing to send
+   {
+      Data ops;
+      ok = encoder.encodeChange(ops, aor, contacts) == 0;
+      assert(ok);
+      assert(ops.empty());
+   }
+
+   // a refresh only sends the times, the decoder fills in the rest
+   size_t refreshSize;
+   {
+      contacts.front().mRegExpires = now + 7200;
+      contacts.front().mLastUpdated = now;
+      Data ops;
+      unsigned int numOps = encoder.encodeChange(ops, aor, contacts);
+      assert(numOps == 1);
+      refreshSize = ops.size();
+      changes.clear();
+      ok = decoder.decodeBatch(encoder.makeBatch(0, ++sequence, ops, numOps), changes);
+      assert(ok);
+      assert(changes.size() == 1);
+      checkSame(changes[0].mContact, contacts.front());
+   }
+
+   // changed details send the contact again
+   {
+      contacts.back().mUserAgent = "Example Phone/1.2.4";
+      Data ops;
+      unsigned int numOps = encoder.encodeChange(ops, aor, contacts);
+      assert(numOps == 1);
+      changes.clear();
+      ok = decoder.decodeBatch(encoder.makeBatch(0, ++sequence, ops, numOps), changes);
+      assert(ok);
+      assert(changes.size() == 1);
+      checkSame(changes[0].mContact, contacts.back());
+   }
+
+   // a contact that is no longer listed is removed, as expired
+   {
+      ContactInstanceRecord removed = contacts.front();
+      contacts.pop_front();
+      Data ops;
+      unsigned int numOps = encoder.encodeChange(ops, aor, contacts);
+      assert(numOps == 1);
+      changes.clear();
+      ok = decoder.decodeBatch(encoder.makeBatch(0, ++sequence, ops, numOps), changes);
+      assert(ok);
+      assert(changes.size() == 1);
+      assert(changes[0].mContact.mContact.uri() == removed.mContact.uri());
+      assert(changes[0].mContact.mRegExpires == 0);
+      assert(changes[0].mContact.mLastUpdated >= now);
+   }
+
+   // static registrations are not synced
+   {
+      ContactList statics;
+      ContactInstanceRecord rec = makeContact(3, now);
+      rec.mRegExpires = NeverExpire;
+      statics.push_back(rec);
+      Data ops;
+      ok = encoder.encodeChange(ops, Uri("sip:static@example.com"), statics) == 0;
+      assert(ok);
+      assert(encoder.getNumAors() == 1);
+   }
+
+   // batches already seen are ignored, and a batch from another instance
+   // starts over
+   {
+      Data ops;
+      contacts.front().mLastUpdated = now - 4;
+      unsigned int numOps = encoder.encodeChange(ops, aor, contacts);
+      Data batch = encoder.makeBatch(0, ++sequence, ops, numOps);
+      changes.clear();
+      ok = decoder.decodeBatch(batch, changes);
+      assert(ok);
+      assert(changes.size() == 1);
+      changes.clear();
+      ok = decoder.decodeBatch(batch, changes);
+      assert(ok);
+      assert(changes.empty());
+
+      RegSyncDeltaEncoder restarted(0x999);
+      Data full;
+      numOps = restarted.encodeFull(full, aor, contacts);
+      assert(numOps == 1);
+      ok = decoder.decodeBatch(restarted.makeBatch(RegSyncDelta::InitialSyncBatch, 0, full, numOps), changes);
+      assert(ok);
+      assert(changes.size() == 1);
+      assert(decoder.getInstanceId() == 0x999);
+      assert(decoder.getLastSequence() == 0);
+   }
+
+   // an initial sync reuses the ids broadcast changes are sent under, so a
+   // client that synced later understands refreshes
+   {
+      RegSyncDeltaDecoder late;
+      Data full;
+      unsigned int numOps = encoder.encodeFull(full, aor, contacts);
+      assert(numOps == 1);
+      changes.clear();
+      ok = late.decodeBatch(encoder.makeBatch(RegSyncDelta::InitialSyncBatch, sequence, full, numOps), changes);
+      assert(ok);
+      assert(changes.size() == 1);
+      assert(late.getLastSequence() == sequence);
+
+      contacts.front().mLastUpdated = now - 2;
+      Data ops;
+      numOps = encoder.encodeChange(ops, aor, contacts);
+      assert(numOps == 1);
+      changes.clear();
+      ok = late.decodeBatch(encoder.makeBatch(0, ++sequence, ops, numOps), changes);
+      assert(ok);
+      assert(changes.size() == 1);
+      checkSame(changes[0].mContact, contacts.front());
+   }
+
+   // truncated batches are rejected, without crashing
+   {
+      Data ops;
+      ContactList one;
+      one.push_back(makeContact(4, now));
+      unsigned int numOps = encoder.encodeChange(ops, Uri("sip:bob@example.com"), one);
+      Data batch = encoder.makeBatch(0, ++sequence, ops, numOps);
+      for(size_t len = 0; len < batch.size(); len += 7)
+      {
+         RegSyncDeltaDecoder fresh;
+         changes.clear();
+         ok = fresh.decodeBatch(Data(batch.data(), len), changes);
+         assert(!ok);
+         assert(changes.empty());
+      }
+   }
+
+   // compare with what the XML encoding sends
+   {
+      const unsigned int numAors = 1000;
+      RegSyncDeltaEncoder sizer(1);
+      size_t xmlBytes = 0;
+      Data ops;
+      unsigned int numOps = 0;
+      for(unsigned int i = 0; i < numAors; i++)
+      {
+         Uri user("sip:user" + Data(i) + "@example.com");
+         ContactList one;
+         one.push_back(makeContact(i, now));
+         numOps += sizer.encodeChange(ops, user, one);
+         xmlBytes += xmlSize(user, one.front(), now);
+      }
+      size_t batchBytes = RegSyncDelta::makeEvent(sizer.makeBatch(0, 1, ops, numOps)).size();
+      assert(batchBytes < xmlBytes);
+      cerr << numAors << " new registrations: " << xmlBytes << " bytes as XML, "
+           << batchBytes << " bytes as a binary batch; a refresh is "
+           << refreshSize << " bytes instead of " << xmlSize(aor, contacts.front(), now) << endl;
+   }
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ */
@@ -0,0 +1,240 @@
+#include <cassert>
+#include <iostream>
+#include <regex>
+#include <vector>
+
+#include "rutil/Data.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/Timer.hxx"
+#include "resip/stack/Uri.hxx"
+#include "repro/AbstractDb.hxx"
+#include "repro/RouteStore.hxx"
+#include "repro/test/MemoryDb.hxx"
+
+using namespace repro;
+using namespace resip;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TEST
+
+class Route
+{
+   public:
+      Data method;
+      Data pattern;
+      Data rewrite;
+      short order;
+      std::regex expression;
+};
+
+// What RouteStore::process() did before it had an index: every route's
+// expression is searched in order.  Only $1 is used by the dial plan below.
+static RouteStore::UriList
+linearProcess(const vector<Route>& routes, const Data& method, const Uri& ruri)
+{
+   RouteStore::UriList targetSet;
+   Data uri = Data::from(ruri);
+   for(vector<Route>::const_iterator it = routes.begin(); it != routes.end(); it++)
+   {
+      if(!it->method.empty() && !isEqualNoCase(it->method, method))
+      {
+         continue;
+      }
+      std::cmatch matches;
+      if(!std::regex_search(uri.c_str(), matches, it->expression))
+      {
+         continue;
+      }
+      Data target = it->rewrite;
+      if(matches.size() > 1)
+      {
+         target.replace("$1", Data(matches[1]));
+      }
+      targetSet.push_back(Uri(target));
+   }
+   return targetSet;
+}
+
+// A dial plan the shape of a carrier's: mostly anchored number ranges, with a
+// few unanchored and method specific routes mixed in
+static void
+makeDialPlan(vector<Route>& routes, unsigned int count)
+{
+   for(unsigned int i = 0; i < count; i++)
+   {
+      Route route;
+      route.order = (short)i;
+      Data range(1000 + i);
+      switch(i % 10)
+      {
+         case 0:
+            route.pattern = "@trunk" + Data(i) + "\\.example\\.net$";
+            route.rewrite = "sip:trunk" + Data(i) + "@gw.example.net";
+            break;
+         case 1:
+            route.pattern = "^sip:\\+1" + range;
+            route.rewrite = "sip:gw" + Data(i) + ".example.net";
+            break;
+         case 2:
+            route.method = "MESSAGE";
+            route.pattern = "^sip:\\+44" + range + "(\\d+)@";
+            route.rewrite = "sip:$1@sms.example.net";
+            break;
+         case 3:
+            route.pattern = "^sip:\\+49" + range + "|^sip:0049" + range;
+            route.rewrite = "sip:de.example.net";
+            break;
+         case 4:
+            // the optional s leaves only "sip" to index these by
+            route.pattern = Data(i % 50 == 4 ? "^sips?:" : "^sips:") + "\\+33" + range + "(\\d*)@";
+            route.rewrite = "sip:$1@fr.example.net";
+            break;
+         default:
+            route.pattern = "^sip:\\+1" + range + "(\\d{4})@";
+            route.rewrite = "sip:+1" + range + "$1@gw" + Data(i % 7) + ".example.net";
+            break;
+      }
+      route.expression = std::regex(route.pattern.c_str(), std::regex_constants::ECMAScript);
+      routes.push_back(route);
+   }
+}
+
+static void
+makeRequestUris(vector<Uri>& uris, unsigned int routes)
+{
+   for(unsigned int i = 0; i < routes; i += 29)
+   {
+      Data range(1000 + i);
+      uris.push_back(Uri("sip:+1" + range + "5550@example.com"));
+      uris.push_back(Uri("sip:+44" + range + "123@example.com"));
+      uris.push_back(Uri("sip:0049" + range + "@example.com"));
+      uris.push_back(Uri("sips:+33" + range + "77@example.com"));
+      uris.push_back(Uri("sip:alice@trunk" + Data(i) + ".example.net"));
+   }
+   uris.push_back(Uri("sip:nobody@example.com"));
+}
+
+int
+main(int argc, char* argv[])
+{
+   Log::initialize(Log::Cout, argc > 1 ? Log::toLevel(argv[1]) : Log::Warning, argv[0]);
+
+   const unsigned int numRoutes = 3000;
+   vector<Route> routes;
+   makeDialPlan(routes, numRoutes);
+   vector<Uri> uris;
+   makeRequestUris(uris, numRoutes);
+
+   MemoryDb db;
+   RouteStore store(db);
+   for(vector<Route>::const_iterator it = routes.begin(); it != routes.end(); it++)
+   {
+      bool added = store.addRoute(it->method, Data::Empty, it->pattern, it->rewrite, it->order);
+      assert(added);
+   }
+
+   // same targets, in the same order, as the linear search
+   static const char* methods[] = { "INVITE", "MESSAGE" };
+   unsigned int matched = 0;
+   for(vector<Uri>::const_iterator uri = uris.begin(); uri != uris.end(); uri++)
+   {
+      for(unsigned int m = 0; m < 2; m++)
+      {
+         RouteStore::UriList expected = linearProcess(routes, methods[m], *uri);
+         RouteStore::UriList targets = store.process(*uri, methods[m], Data::Empty);
+         assert(targets.size() == expected.size());
+         for(RouteStore::UriList::size_type i = 0; i < targets.size(); i++)
+         {
+            assert(Data::from(targets[i]) == Data::from(expected[i]));
+         }
+         matched += (unsigned int)targets.size();
+      }
+   }
+   assert(matched > uris.size() / 10);
+
+   // routes loaded from the database are indexed as well
+   {
+      RouteStore loaded(db);
+      RouteStore::UriList targets = loaded.process(uris.front(), "INVITE", Data::Empty);
+      assert(targets.size() == store.process(uris.front(), "INVITE", Data::Empty).size());
+   }
+
+   // erasing a route takes it out of the index
+   {
+      RouteStore::UriList before = store.process(Uri("sip:+110015550@example.com"), "INVITE", Data::Empty);
+      assert(before.size() == 1);
+      store.eraseRoute("", "", routes[1].pattern, routes[1].order);
+      assert(store.process(Uri("sip:+110015550@example.com"), "INVITE", Data::Empty).empty());
+   }
+
+   // replay the dial plan, against the linear search as well
+   const unsigned int rounds = 5;
+   uint64_t start = Timer::getTimeMicroSec();
+   for(unsigned int r = 0; r < rounds; r++)
+   {
+      for(vector<Uri>::const_iterator uri = uris.begin(); uri != uris.end(); uri++)
+      {
+         linearProcess(routes, "INVITE", *uri);
+      }
+   }
+   uint64_t linear = Timer::getTimeMicroSec() - start;
+   start = Timer::getTimeMicroSec();
+   for(unsigned int r = 0; r < rounds; r++)
+   {
+      for(vector<Uri>::const_iterator uri = uris.begin(); uri != uris.end(); uri++)
+      {
+         store.process(*uri, "INVITE", Data::Empty);
+      }
+   }
+   uint64_t indexed = Timer::getTimeMicroSec() - start;
+   cerr << numRoutes << " routes, " << uris.size() << " request URIs: "
+        << (double)linear / (rounds * uris.size()) << " us per URI searching every route, "
+        << (double)indexed / (rounds * uris.size()) << " us per URI with the index" << endl;
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ */
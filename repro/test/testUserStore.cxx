@@ -0,0 +1,152 @@
+#include <cassert>
+#include <iostream>
+
+#include "rutil/Data.hxx"
+#include "rutil/Logger.hxx"
+#include "repro/UserStore.hxx"
+#include "repro/test/MemoryDb.hxx"
+
+using namespace repro;
+using namespace resip;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TEST
+
+// counts the lookups that reach the database
+class CountingDb : public MemoryDb
+{
+   public:
+      CountingDb() : mAuthLookups(0) {}
+      virtual Data getUserAuthInfo(const Key& key) const
+      {
+         mAuthLookups++;
+         return MemoryDb::getUserAuthInfo(key);
+      }
+      mutable unsigned int mAuthLookups;
+};
+
+// as if the database could not be reached
+class FailingDb : public CountingDb
+{
+   public:
+      virtual LookupResult lookupUserAuthInfo(const Key& key, Data& a1) const
+      {
+         mAuthLookups++;
+         return LookupFailed;
+      }
+};
+
+int
+main(int argc, char* argv[])
+{
+   Log::initialize(Log::Cout, argc > 1 ? Log::toLevel(argv[1]) : Log::Warning, argv[0]);
+
+   CountingDb db;
+   UserStore store(db);
+   bool ok = store.addUser("alice", "example.com", "example.com", "secret", true, "Alice", "alice@example.com");
+   assert(ok);
+   Data a1 = store.getUserAuthInfo("alice", "example.com");
+   assert(!a1.empty());
+
+   // without the cache every lookup goes to the database
+   store.getUserAuthInfo("alice", "example.com");
+   assert(db.mAuthLookups == 2);
+
+   store.setAuthCache(2, 60, 60);
+   db.mAuthLookups = 0;
+   assert(store.getUserAuthInfo("alice", "example.com") == a1);
+   assert(store.getUserAuthInfo("alice", "example.com") == a1);
+   assert(db.mAuthLookups == 1);
+
+   // unknown users are cached as well
+   assert(store.getUserAuthInfo("scanner", "example.com").empty());
+   assert(store.getUserAuthInfo("scanner", "example.com").empty());
+   assert(db.mAuthLookups == 2);
+   UserStore::AuthCacheStats stats = store.getAuthCacheStats();
+   assert(stats.mEntries == 2 && stats.mHits == 1 && stats.mNegativeHits == 1 && stats.mMisses == 2);
+
+   // a password change is seen right away
+   ok = store.updateUser(UserStore::buildKey("alice", "example.com"), "alice", "example.com", "example.com",
+                         "other", true, "Alice", "alice@example.com");
+   assert(ok);
+   Data changed = store.getUserAuthInfo("alice", "example.com");
+   assert(changed != a1 && !changed.empty());
+   assert(db.mAuthLookups == 3);
+
+   // and so is a new user that was cached as unknown
+   ok = store.addUser("scanner", "example.com", "example.com", "pw", true, "", "");
+   assert(ok);
+   assert(!store.getUserAuthInfo("scanner", "example.com").empty());
+   store.eraseUser(UserStore::buildKey("scanner", "example.com"));
+   assert(store.getUserAuthInfo("scanner", "example.com").empty());
+
+   // the least recently used entry makes room
+   store.getUserAuthInfo("alice", "example.com");
+   store.getUserAuthInfo("bob", "example.com");
+   store.getUserAuthInfo("carol", "example.com");
+   assert(store.getAuthCacheStats().mEntries == 2);
+   assert(store.getAuthCacheStats().mEvictions > 0);
+   unsigned int lookups = db.mAuthLookups;
+   store.getUserAuthInfo("carol", "example.com");
+   assert(db.mAuthLookups == lookups);
+
+   store.clearAuthCache();
+   store.getUserAuthInfo("carol", "example.com");
+   assert(db.mAuthLookups == lookups + 1);
+
+   // failed lookups are not cached, unlike unknown users
+   FailingDb failingDb;
+   UserStore failingStore(failingDb);
+   failingStore.setAuthCache(2, 60, 60);
+   assert(failingStore.getUserAuthInfo("alice", "example.com").empty());
+   assert(failingStore.getUserAuthInfo("alice", "example.com").empty());
+   assert(failingDb.mAuthLookups == 2);
+   assert(failingStore.getAuthCacheStats().mEntries == 0);
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ */
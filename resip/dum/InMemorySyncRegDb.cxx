@@ -1,4 +1,5 @@
 #include "resip/dum/InMemorySyncRegDb.hxx"
+#include "rutil/DnsUtil.hxx"
 #include "rutil/Timer.hxx"
 #include "rutil/Logger.hxx"
 #include "rutil/WinLeakCheck.hxx"
@@ -53,19 +54,86 @@ contactsRemoveIfRequired(ContactList& contacts, uint64_t& now,
 #endif
 }
 
-InMemorySyncRegDb::InMemorySyncRegDb(unsigned int removeLingerSecs) : 
+InMemorySyncRegDb::InMemorySyncRegDb(unsigned int removeLingerSecs, unsigned int shards) : 
    mRemoveLingerSecs(removeLingerSecs)
 {
+   resip_assert(shards > 0);
+   mShards.reserve(shards);
+   for(unsigned int i = 0; i < shards; i++)
+   {
+      mShards.push_back(new Shard);
+   }
 }
 
 InMemorySyncRegDb::~InMemorySyncRegDb()
 {
-   for( database_map_t::const_iterator it = mDatabase.begin();
-        it != mDatabase.end(); it++)
+   for(std::vector<Shard*>::iterator shard = mShards.begin(); shard != mShards.end(); shard++)
    {
-      delete it->second;
+      for( database_map_t::const_iterator it = (*shard)->mDatabase.begin();
+           it != (*shard)->mDatabase.end(); it++)
+      {
+         delete it->second.mContacts;
+      }
+      delete *shard;
    }
-   mDatabase.clear();
+   mShards.clear();
+}
+
+size_t
+InMemorySyncRegDb::aorHash(const Uri& aor)
+{
+   size_t hash = aor.user().hash();
+   hash = hash * 31 + aor.userParameters().hash();
+   if(DnsUtil::isIpV6Address(aor.host()))
+   {
+      hash = hash * 31 + DnsUtil::canonicalizeIpV6Address(aor.host()).hash();
+   }
+   else
+   {
+      hash = hash * 31 + aor.host().caseInsensitivehash();
+   }
+   return hash * 31 + (size_t)aor.port();
+}
+
+InMemorySyncRegDb::Record*
+InMemorySyncRegDb::findRecord(Shard& shard, size_t hash, const Uri& aor)
+{
+   std::pair<database_map_t::iterator, database_map_t::iterator> range = shard.mDatabase.equal_range(hash);
+   for(database_map_t::iterator it = range.first; it != range.second; it++)
+   {
+      if(!(it->second.mAor < aor) && !(aor < it->second.mAor))
+      {
+         return &it->second;
+      }
+   }
+   return 0;
+}
+
+InMemorySyncRegDb::Record&
+InMemorySyncRegDb::findOrCreateRecord(Shard& shard, size_t hash, const Uri& aor)
+{
+   Record* record = findRecord(shard, hash, aor);
+   if(record)
+   {
+      return *record;
+   }
+   return shard.mDatabase.insert(database_map_t::value_type(hash, Record(aor)))->second;
+}
+
+void
+InMemorySyncRegDb::eraseRecord(Shard& shard, size_t hash, const Record& record)
+{
+   std::pair<database_map_t::iterator, database_map_t::iterator> range = shard.mDatabase.equal_range(hash);
+   for(database_map_t::iterator it = range.first; it != range.second; it++)
+   {
+      if(&it->second == &record)
+      {
+         delete it->second.mContacts;
+         shard.mDatabase.erase(it);
+         return;
+      }
+   }
+   resip_assert(0);
 }
 
 void 
@@ -120,18 +188,23 @@ InMemorySyncRegDb::invokeOnInitialSyncAor(unsigned int connectionId, const resip
 void 
 InMemorySyncRegDb::initialSync(unsigned int connectionId)
 {
-   Lock g(mDatabaseMutex);
    uint64_t now = Timer::getTimeSecs();
-   for(database_map_t::iterator it = mDatabase.begin(); it != mDatabase.end(); it++)
+   // Shards are synced one at a time; anything modified in a shard after it
+   // has been walked is sent through onAorModified as usual.
+   for(std::vector<Shard*>::iterator shard = mShards.begin(); shard != mShards.end(); shard++)
    {
-      if(it->second)
+      Lock g((*shard)->mMutex);
+      for(database_map_t::iterator it = (*shard)->mDatabase.begin(); it != (*shard)->mDatabase.end(); it++)
       {
-         ContactList& contacts = *(it->second);
-         if(mRemoveLingerSecs > 0) 
+         if(it->second.mContacts)
          {
-            contactsRemoveIfRequired(contacts, now, mRemoveLingerSecs);
+            ContactList& contacts = *(it->second.mContacts);
+            if(mRemoveLingerSecs > 0) 
+            {
+               contactsRemoveIfRequired(contacts, now, mRemoveLingerSecs);
+            }
+            invokeOnInitialSyncAor(connectionId, it->second.mAor, contacts);
          }
-         invokeOnInitialSyncAor(connectionId, it->first, contacts);
       }
    }
 }
@@ -140,22 +213,17 @@ void
 InMemorySyncRegDb::addAor(const Uri& aor,
                           const ContactList& contacts)
 {
-   Lock g(mDatabaseMutex);
-   database_map_t::iterator it = mDatabase.find(aor);
-   if(it != mDatabase.end())
+   size_t hash = aorHash(aor);
+   Shard& shard = getShard(hash);
+   Lock g(shard.mMutex);
+   Record& record = findOrCreateRecord(shard, hash, aor);
+   if(record.mContacts)
    {
-       if(it->second)
-       {
-           *(it->second) = contacts;
-       }
-       else
-       {
-           it->second = new ContactList(contacts);
-       }
+       *(record.mContacts) = contacts;
    }
    else
    {
-       mDatabase[aor] = new ContactList(contacts);
+       record.mContacts = new ContactList(contacts);
    }
    invokeOnAorModified(true /* sync? */, aor, contacts);
 }
@@ -163,49 +231,60 @@ InMemorySyncRegDb::addAor(const Uri& aor,
 void 
 InMemorySyncRegDb::removeAor(const Uri& aor)
 {
-  database_map_t::iterator i;
-
-  Lock g(mDatabaseMutex);
-  i = mDatabase.find(aor);
-  //DebugLog (<< "Removing registration bindings " << aor);
-  if (i != mDatabase.end())
-  {
-     if (i->second)
-     {
-        if(mRemoveLingerSecs > 0)
-        {
-           ContactList& contacts = *(i->second);
-           uint64_t now = Timer::getTimeSecs();
-           for(ContactList::iterator it = contacts.begin(); it != contacts.end(); it++)
-           {
-              // Don't delete record - set expires to 0
-              it->mRegExpires = 0;
-              it->mLastUpdated = now;
-           }
-           invokeOnAorModified(true /* sync? */, aor, contacts);
-        }
-        else
-        {
-           delete i->second;
-           // Setting this to 0 causes it to be removed when we unlock the AOR.
-           i->second = 0;
-           ContactList emptyList;
-           invokeOnAorModified(true /* sync? */, aor, emptyList);
-        }
-     }
-  }
+   size_t hash = aorHash(aor);
+   Shard& shard = getShard(hash);
+   Lock g(shard.mMutex);
+   Record* record = findRecord(shard, hash, aor);
+   //DebugLog (<< "Removing registration bindings " << aor);
+   if (record)
+   {
+      clearRecord(*record);
+   }
+}
+
+void
+InMemorySyncRegDb::clearRecord(Record& record)
+{
+   if (record.mContacts)
+   {
+      if(mRemoveLingerSecs > 0)
+      {
+         ContactList& contacts = *(record.mContacts);
+         uint64_t now = Timer::getTimeSecs();
+         for(ContactList::iterator it = contacts.begin(); it != contacts.end(); it++)
+         {
+            // Don't delete record - set expires to 0
+            it->mRegExpires = 0;
+            it->mLastUpdated = now;
+         }
+         invokeOnAorModified(true /* sync? */, record.mAor, contacts);
+      }
+      else
+      {
+         delete record.mContacts;
+         // Setting this to 0 causes it to be removed when we unlock the AOR.
+         record.mContacts = 0;
+         ContactList emptyList;
+         invokeOnAorModified(true /* sync? */, record.mAor, emptyList);
+      }
+   }
 }
 
 void
 InMemorySyncRegDb::getAors(InMemorySyncRegDb::UriList& container)
 {
    container.clear();
-   Lock g(mDatabaseMutex);
-   for( database_map_t::const_iterator it = mDatabase.begin();
-        it != mDatabase.end(); it++)
+   for(std::vector<Shard*>::iterator shard = mShards.begin(); shard != mShards.end(); shard++)
    {
-      container.push_back(it->first);
+      Lock g((*shard)->mMutex);
+      for( database_map_t::const_iterator it = (*shard)->mDatabase.begin();
+           it != (*shard)->mDatabase.end(); it++)
+      {
+         container.push_back(it->second.mAor);
+      }
    }
+   // callers have always had them in order
+   container.sort();
 }
 
 bool
@@ -217,14 +296,16 @@ InMemorySyncRegDb::aorIsRegistered(const Uri& aor)
 bool 
 InMemorySyncRegDb::aorIsRegistered(const Uri& aor, uint64_t* maxExpires)
 {
-   Lock g(mDatabaseMutex);
+   size_t hash = aorHash(aor);
+   Shard& shard = getShard(hash);
+   Lock g(shard.mMutex);
    bool registered = false;
-   database_map_t::iterator i = mDatabase.find(aor);
-   if (i != mDatabase.end() && i->second != 0)
+   Record* record = findRecord(shard, hash, aor);
+   if (record && record->mContacts != 0)
    {
       if (mRemoveLingerSecs > 0 || maxExpires)
       {
-         ContactList& contacts = *(i->second);
+         ContactList& contacts = *(record->mContacts);
          uint64_t now = Timer::getTimeSecs();
          for(ContactList::iterator it = contacts.begin(); it != contacts.end(); it++)
          {
@@ -253,72 +334,64 @@ InMemorySyncRegDb::aorIsRegistered(const Uri& aor, uint64_t* maxExpires)
 void
 InMemorySyncRegDb::lockRecord(const Uri& aor)
 {
-   Lock g2(mLockedRecordsMutex);
+   size_t hash = aorHash(aor);
+   Shard& shard = getShard(hash);
+   Lock g(shard.mMutex);
 
    DebugLog(<< "InMemorySyncRegDb::lockRecord:  aor=" << aor << " threadid=" << ThreadIf::selfId());
 
+   // This forces insertion if the record does not yet exist.  A record with
+   // waiters is never erased, so the reference stays good while we wait.
+   Record& record = findOrCreateRecord(shard, hash, aor);
+   record.mWaiters++;
+   while (record.mLocked)
    {
-      Lock g1(mDatabaseMutex);
-      // This forces insertion if the record does not yet exist.
-      mDatabase[aor];
+      shard.mRecordUnlocked.wait(g);
    }
-
-   while (mLockedRecords.count(aor))
-   {
-      mRecordUnlocked.wait(g2);
-   }
-
-   mLockedRecords.insert(aor);
+   record.mWaiters--;
+   record.mLocked = true;
 }
 
 void
 InMemorySyncRegDb::unlockRecord(const Uri& aor)
 {
-   Lock g2(mLockedRecordsMutex);
+   size_t hash = aorHash(aor);
+   Shard& shard = getShard(hash);
+   Lock g(shard.mMutex);
 
    DebugLog(<< "InMemorySyncRegDb::unlockRecord:  aor=" << aor << " threadid=" << ThreadIf::selfId());
 
-   {
-      Lock g1(mDatabaseMutex);
-      // If the pointer is null, we remove the record from the map.
-      database_map_t::iterator i = mDatabase.find(aor);
+   Record* record = findRecord(shard, hash, aor);
 
-      // The record must have been inserted when we locked it in the first place
-      resip_assert (i != mDatabase.end());
+   // The record must have been inserted when we locked it in the first place
+   resip_assert (record);
 
-      if (i->second == 0)
-      {
-         mDatabase.erase(i);
-      }
+   record->mLocked = false;
+   if (record->mWaiters > 0)
+   {
+      shard.mRecordUnlocked.notify_all();
+   }
+   else if (record->mContacts == 0)
+   {
+      // If the pointer is null, we remove the record from the map.
+      eraseRecord(shard, hash, *record);
    }
-
-   mLockedRecords.erase(aor);
-   mRecordUnlocked.notify_all();
 }
 
 RegistrationPersistenceManager::update_status_t 
 InMemorySyncRegDb::updateContact(const resip::Uri& aor, 
                                  const ContactInstanceRecord& rec) 
 {
-   ContactList *contactList = 0;
+   size_t hash = aorHash(aor);
+   Shard& shard = getShard(hash);
+   Lock g(shard.mMutex);
 
+   Record& record = findOrCreateRecord(shard, hash, aor);
+   if (record.mContacts == 0)
    {
-      Lock g(mDatabaseMutex);
-
-      database_map_t::iterator i;
-      i = mDatabase.find(aor);
-      if (i == mDatabase.end() || i->second == 0)
-      {
-         contactList = new ContactList();
-         mDatabase[aor] = contactList;
-      }
-      else
-      {
-         contactList = i->second;
-      }
+      record.mContacts = new ContactList();
    }
-   
-   resip_assert(contactList);
+   ContactList* contactList = record.mContacts;
 
    ContactList::iterator j;
 
@@ -354,19 +427,16 @@ void
 InMemorySyncRegDb::removeContact(const Uri& aor, 
                                  const ContactInstanceRecord& rec)
 {
-   ContactList *contactList = 0;
+   size_t hash = aorHash(aor);
+   Shard& shard = getShard(hash);
+   Lock g(shard.mMutex);
 
+   Record* record = findRecord(shard, hash, aor);
+   if (record == 0 || record->mContacts == 0)
    {
-      Lock g(mDatabaseMutex);
-
-      database_map_t::iterator i;
-      i = mDatabase.find(aor);
-      if (i == mDatabase.end() || i->second == 0)
-      {
-         return;
-      }
-      contactList = i->second;
+      return;
    }
+   ContactList* contactList = record->mContacts;
 
    ContactList::iterator j;
 
@@ -387,7 +457,7 @@ InMemorySyncRegDb::removeContact(const Uri& aor,
             contactList->erase(j);
             if (contactList->empty())
             {
-               removeAor(aor);
+               clearRecord(*record);
             }
             else
             {
@@ -403,16 +473,18 @@ InMemorySyncRegDb::removeContact(const Uri& aor,
 void
 InMemorySyncRegDb::getContacts(const Uri& aor, ContactList& container)
 {
-   Lock g(mDatabaseMutex);
-   database_map_t::iterator i = mDatabase.find(aor);
-   if (i == mDatabase.end() || i->second == 0)
+   size_t hash = aorHash(aor);
+   Shard& shard = getShard(hash);
+   Lock g(shard.mMutex);
+   Record* record = findRecord(shard, hash, aor);
+   if (record == 0 || record->mContacts == 0)
    {
       container.clear();
       return;
    }
    if(mRemoveLingerSecs > 0)
    {
-      ContactList& contacts = *(i->second);
+      ContactList& contacts = *(record->mContacts);
       uint64_t now = Timer::getTimeSecs();
       contactsRemoveIfRequired(contacts, now, mRemoveLingerSecs);
       container.clear();
@@ -426,21 +498,23 @@ InMemorySyncRegDb::getContacts(const Uri& aor, ContactList& container)
    }
    else
    {
-      container = *(i->second);
+      container = *(record->mContacts);
    }
 }
 
 void
 InMemorySyncRegDb::getContactsFull(const Uri& aor, ContactList& container)
 {
-   Lock g(mDatabaseMutex);
-   database_map_t::iterator i = mDatabase.find(aor);
-   if (i == mDatabase.end() || i->second == 0)
+   size_t hash = aorHash(aor);
+   Shard& shard = getShard(hash);
+   Lock g(shard.mMutex);
+   Record* record = findRecord(shard, hash, aor);
+   if (record == 0 || record->mContacts == 0)
    {
       container.clear();
       return;
    }
-   ContactList& contacts = *(i->second);
+   ContactList& contacts = *(record->mContacts);
    if(mRemoveLingerSecs > 0)
    {
       uint64_t now = Timer::getTimeSecs();
@@ -1,9 +1,9 @@
 #if !defined(RESIP_INMEMORYSYNCREGDB_HXX)
 #define RESIP_INMEMORYSYNCREGDB_HXX
 
-#include <map>
-#include <set>
 #include <list>
+#include <unordered_map>
+#include <vector>
 
 #include "resip/dum/RegistrationPersistenceManager.hxx"
 #include "rutil/Mutex.hxx"
@@ -44,6 +44,13 @@ protected:
   memory immediately and this class behaves very similar to the 
   InMemoryRegistrationDatabase class.
 
+  AORs are spread over a number of shards by a hash of the AOR, each
+  with its own mutex, so that registrations for different AORs rarely
+  contend with each other.  The hash is computed once per call and is
+  also the key of the shard's hash table, so lookups do not walk a tree
+  of Uri comparisons.  Record locks are kept on the AOR's entry in its
+  shard.  The number of shards is passed into the constructor.
+
   The InMemorySyncRegDbHandler can be used by an external mechanism to 
   transport registration bindings to a remote peer for replication.
   See the RegSyncClient and RegSyncServer implementations in the repro
@@ -53,7 +60,9 @@ class InMemorySyncRegDb : public RegistrationPersistenceManager
 {
    public:
 
-      InMemorySyncRegDb(unsigned int removeLingerSecs = 0);
+      enum { DefaultShards = 64 };
+
+      InMemorySyncRegDb(unsigned int removeLingerSecs = 0, unsigned int shards = DefaultShards);
       virtual ~InMemorySyncRegDb();
       
       virtual void addHandler(InMemorySyncRegDbHandler* handler);
@@ -81,13 +90,35 @@ class InMemorySyncRegDb : public RegistrationPersistenceManager
       virtual void getAors(UriList& container);
       
    protected:
-      typedef std::map<Uri,ContactList *> database_map_t;
-      database_map_t mDatabase;
-      Mutex mDatabaseMutex;
-
-      std::set<Uri> mLockedRecords;
-      Mutex mLockedRecordsMutex;
-      Condition mRecordUnlocked;
+      class Record
+      {
+         public:
+            Record(const Uri& aor) : mAor(aor), mContacts(0), mLocked(false), mWaiters(0) {}
+            Uri mAor;
+            ContactList* mContacts;   // 0 until contacts are added, or once the AOR is removed
+            bool mLocked;
+            unsigned int mWaiters;    // threads waiting in lockRecord for this AOR
+      };
+      // keyed by aorHash(), collisions are told apart by comparing mAor
+      typedef std::unordered_multimap<size_t, Record> database_map_t;
+
+      class Shard
+      {
+         public:
+            database_map_t mDatabase;
+            Mutex mMutex;
+            Condition mRecordUnlocked;
+      };
+      std::vector<Shard*> mShards;
+
+      /** Hash agreeing with Uri::operator<, which is how AORs have always
+          been told apart here: user, user parameters, canonical host and port. */
+      static size_t aorHash(const Uri& aor);
+      Shard& getShard(size_t hash) { return *mShards[hash % mShards.size()]; }
+      static Record* findRecord(Shard& shard, size_t hash, const Uri& aor);
+      static Record& findOrCreateRecord(Shard& shard, size_t hash, const Uri& aor);
+      static void eraseRecord(Shard& shard, size_t hash, const Record& record);
+      void clearRecord(Record& record);  // shard must be locked
 
       void invokeOnAorModified(bool sync, const resip::Uri& aor, const ContactList& contacts);
       void invokeOnInitialSyncAor(unsigned int connectionId, const resip::Uri& aor, const ContactList& contacts);
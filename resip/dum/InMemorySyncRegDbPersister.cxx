@@ -0,0 +1,580 @@
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+#include "resip/dum/InMemorySyncRegDbPersister.hxx"
+#include "resip/stack/Tuple.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/ParseException.hxx"
+#include "rutil/Timer.hxx"
+#include "rutil/WinLeakCheck.hxx"
+
+using namespace resip;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::DUM
+
+// Both files start with a 4 byte magic, a 32 bit format version and the
+// 64 bit generation, followed by records: a 32 bit length and an encoded
+// AOR.  All integers are little endian.
+static const char SnapshotMagic[] = "RRS1";
+static const char LogMagic[] = "RRL1";
+static const uint32_t FormatVersion = 1;
+static const uint32_t MaxRecordSize = 64*1024*1024;
+
+static const unsigned char SyncContactFlag = 0x01;
+static const unsigned char UseFlowRoutingFlag = 0x02;
+static const unsigned char UserDataFlag = 0x04;
+
+static void
+encodeUInt32(Data& out, uint32_t value)
+{
+   char buf[4];
+   for(int i = 0; i < 4; i++)
+   {
+      buf[i] = (char)(value >> (8 * i));
+   }
+   out.append(buf, sizeof(buf));
+}
+
+static void
+encodeUInt64(Data& out, uint64_t value)
+{
+   char buf[8];
+   for(int i = 0; i < 8; i++)
+   {
+      buf[i] = (char)(value >> (8 * i));
+   }
+   out.append(buf, sizeof(buf));
+}
+
+static void
+encodeData(Data& out, const Data& value)
+{
+   encodeUInt32(out, (uint32_t)value.size());
+   out.append(value.data(), value.size());
+}
+
+class RecordDecoder
+{
+   public:
+      RecordDecoder(const Data& record) : mPos(record.data()), mEnd(record.data() + record.size()), mOk(true) {}
+
+      uint32_t getUInt32()
+      {
+         uint32_t value = 0;
+         if(need(4))
+         {
+            for(int i = 0; i < 4; i++)
+            {
+               value |= (uint32_t)(unsigned char)mPos[i] << (8 * i);
+            }
+            mPos += 4;
+         }
+         return value;
+      }
+      uint64_t getUInt64()
+      {
+         uint64_t value = 0;
+         if(need(8))
+         {
+            for(int i = 0; i < 8; i++)
+            {
+               value |= (uint64_t)(unsigned char)mPos[i] << (8 * i);
+            }
+            mPos += 8;
+         }
+         return value;
+      }
+      unsigned char getByte()
+      {
+         unsigned char value = 0;
+         if(need(1))
+         {
+            value = (unsigned char)*mPos++;
+         }
+         return value;
+      }
+      Data getData()
+      {
+         uint32_t size = getUInt32();
+         if(!need(size))
+         {
+            return Data::Empty;
+         }
+         Data value(mPos, size);
+         mPos += size;
+         return value;
+      }
+      // nothing was read past the end
+      bool good() const { return mOk; }
+      // and everything was read
+      bool ok() const { return mOk && mPos == mEnd; }
+
+   private:
+      bool need(size_t size)
+      {
+         if(mOk && (size_t)(mEnd - mPos) >= size)
+         {
+            return true;
+         }
+         mOk = false;
+         return false;
+      }
+      const char* mPos;
+      const char* mEnd;
+      bool mOk;
+};
+
+// Registration times are kept relative to Timer::getTimeSecs(), which need
+// not be the wall clock; they are converted to and from wall clock time
+// so they still mean something after a reboot.
+static uint64_t
+toWallClock(uint64_t when, uint64_t now, uint64_t wallNow)
+{
+   if(when >= now)
+   {
+      return wallNow + (when - now);
+   }
+   return (now - when) < wallNow ? wallNow - (now - when) : 1;
+}
+
+static uint64_t
+fromWallClock(uint64_t wallWhen, uint64_t now, uint64_t wallNow)
+{
+   if(wallWhen >= wallNow)
+   {
+      return now + (wallWhen - wallNow);
+   }
+   return (wallNow - wallWhen) < now ? now - (wallNow - wallWhen) : 1;
+}
+
+static void
+writeHeader(std::ostream& out, const char* magic, uint64_t generation)
+{
+   Data header;
+   header.append(magic, 4);
+   encodeUInt32(header, FormatVersion);
+   encodeUInt64(header, generation);
+   out.write(header.data(), header.size());
+}
+
+static void
+writeRecord(std::ostream& out, const Data& record)
+{
+   Data length;
+   encodeUInt32(length, (uint32_t)record.size());
+   out.write(length.data(), length.size());
+   out.write(record.data(), record.size());
+}
+
+InMemorySyncRegDbPersister::InMemorySyncRegDbPersister(InMemorySyncRegDb& regDb,
+                                                       const Data& fileName,
+                                                       unsigned int snapshotIntervalSecs,
+                                                       unsigned int snapshotLogRecords) :
+   InMemorySyncRegDbHandler(AllChanges),
+   mRegDb(regDb),
+   mSnapshotFileName(fileName + ".snapshot"),
+   mLogFileName(fileName + ".log"),
+   mSnapshotIntervalSecs(snapshotIntervalSecs),
+   mSnapshotLogRecords(snapshotLogRecords),
+   mSnapshotRequested(false),
+   mGeneration(0),
+   mLogRecords(0)
+{
+}
+
+InMemorySyncRegDbPersister::~InMemorySyncRegDbPersister()
+{
+   shutdown();
+   join();
+}
+
+void
+InMemorySyncRegDbPersister::encodeAor(Data& record, const Uri& aor, const ContactList& contacts)
+{
+   uint64_t now = Timer::getTimeSecs();
+   uint64_t wallNow = (uint64_t)time(0);
+
+   encodeData(record, Data::from(aor));
+   encodeUInt32(record, (uint32_t)contacts.size());
+   for(ContactList::const_iterator it = contacts.begin(); it != contacts.end(); it++)
+   {
+      encodeData(record, Data::from(it->mContact));
+      // an expiry of 0 marks a removed contact
+      encodeUInt64(record, it->mRegExpires == 0 ? 0 : toWallClock(it->mRegExpires, now, wallNow));
+      encodeUInt64(record, toWallClock(it->mLastUpdated, now, wallNow));
+      Data token;
+      if(it->mReceivedFrom.getPort() != 0)
+      {
+         Tuple::writeBinaryToken(it->mReceivedFrom, token);
+      }
+      encodeData(record, token);
+      token.clear();
+      if(it->mPublicAddress.getType() != UNKNOWN_TRANSPORT)
+      {
+         Tuple::writeBinaryToken(it->mPublicAddress, token);
+      }
+      encodeData(record, token);
+      encodeUInt32(record, (uint32_t)it->mSipPath.size());
+      for(NameAddrs::const_iterator path = it->mSipPath.begin(); path != it->mSipPath.end(); path++)
+      {
+         encodeData(record, Data::from(*path));
+      }
+      encodeData(record, it->mInstance);
+      encodeUInt32(record, it->mRegId);
+      encodeData(record, it->mUserAgent);
+      unsigned char flags = (it->mSyncContact ? SyncContactFlag : 0) |
+                            (it->mUseFlowRouting ? UseFlowRoutingFlag : 0) |
+                            (it->mUserData ? UserDataFlag : 0);
+      record.append((const char*)&flags, 1);
+      if(it->mUserData)
+      {
+         encodeData(record, *it->mUserData);
+      }
+   }
+}
+
+bool
+InMemorySyncRegDbPersister::decodeAor(const Data& record, Uri& aor, ContactList& contacts)
+{
+   uint64_t now = Timer::getTimeSecs();
+   uint64_t wallNow = (uint64_t)time(0);
+   RecordDecoder decoder(record);
+
+   contacts.clear();
+   try
+   {
+      aor = Uri(decoder.getData());
+      uint32_t count = decoder.getUInt32();
+      for(uint32_t i = 0; i < count && decoder.good(); i++)
+      {
+         ContactInstanceRecord rec;
+         rec.mContact = NameAddr(decoder.getData());
+         uint64_t expires = decoder.getUInt64();
+         rec.mRegExpires = expires == 0 ? 0 : fromWallClock(expires, now, wallNow);
+         rec.mLastUpdated = fromWallClock(decoder.getUInt64(), now, wallNow);
+         Data token = decoder.getData();
+         if(!token.empty())
+         {
+            rec.mReceivedFrom = Tuple::makeTupleFromBinaryToken(token);
+         }
+         token = decoder.getData();
+         if(!token.empty())
+         {
+            rec.mPublicAddress = Tuple::makeTupleFromBinaryToken(token);
+         }
+         uint32_t paths = decoder.getUInt32();
+         for(uint32_t p = 0; p < paths && decoder.good(); p++)
+         {
+            rec.mSipPath.push_back(NameAddr(decoder.getData()));
+         }
+         rec.mInstance = decoder.getData();
+         rec.mRegId = decoder.getUInt32();
+         rec.mUserAgent = decoder.getData();
+         unsigned char flags = decoder.getByte();
+         rec.mSyncContact = (flags & SyncContactFlag) != 0;
+         rec.mUseFlowRouting = (flags & UseFlowRoutingFlag) != 0;
+         if(flags & UserDataFlag)
+         {
+            rec.mUserData = new Data(decoder.getData());
+         }
+         contacts.push_back(rec);
+      }
+   }
+   catch(BaseException& e)
+   {
+      DebugLog(<< "InMemorySyncRegDbPersister: unable to decode registration record: " << e);
+      return false;
+   }
+   return decoder.ok();
+}
+
+bool
+InMemorySyncRegDbPersister::replayFile(const Data& fileName, uint64_t& generation, bool checkGeneration, unsigned int& aors)
+{
+   std::ifstream in(fileName.c_str(), std::ios::binary);
+   if(!in)
+   {
+      return false;
+   }
+
+   char buf[16];
+   in.read(buf, sizeof(buf));
+   if(in.gcount() != (std::streamsize)sizeof(buf))
+   {
+      WarningLog(<< "InMemorySyncRegDbPersister: " << fileName << " is too short, ignoring it");
+      return false;
+   }
+   const char* magic = checkGeneration ? LogMagic : SnapshotMagic;
+   Data header(Data::Share, buf + 4, sizeof(buf) - 4);
+   RecordDecoder decoder(header);
+   uint32_t version = decoder.getUInt32();
+   uint64_t fileGeneration = decoder.getUInt64();
+   if(memcmp(buf, magic, 4) != 0 || version != FormatVersion)
+   {
+      WarningLog(<< "InMemorySyncRegDbPersister: " << fileName << " is not a registration file we can read, ignoring it");
+      return false;
+   }
+   if(checkGeneration && fileGeneration != generation)
+   {
+      // left behind by a snapshot that was written but whose log was never started
+      InfoLog(<< "InMemorySyncRegDbPersister: " << fileName << " is generation " << fileGeneration
+              << ", snapshot is generation " << generation << ", ignoring it");
+      return false;
+   }
+   generation = fileGeneration;
+
+   std::vector<char> payload;
+   Uri aor;
+   ContactList contacts;
+   for(;;)
+   {
+      in.read(buf, 4);
+      if(in.gcount() == 0)
+      {
+         break;
+      }
+      uint32_t size = 0;
+      if(in.gcount() == 4)
+      {
+         Data length(Data::Share, buf, 4);
+         size = RecordDecoder(length).getUInt32();
+      }
+      if(size == 0 || size > MaxRecordSize)
+      {
+         WarningLog(<< "InMemorySyncRegDbPersister: " << fileName << " ends with a partial record, ignoring it");
+         break;
+      }
+      payload.resize(size);
+      in.read(payload.data(), size);
+      if((uint32_t)in.gcount() != size)
+      {
+         // the write was cut short when we went down
+         WarningLog(<< "InMemorySyncRegDbPersister: " << fileName << " ends with a partial record, ignoring it");
+         break;
+      }
+      Data record(Data::Share, payload.data(), size);
+      if(!decodeAor(record, aor, contacts))
+      {
+         WarningLog(<< "InMemorySyncRegDbPersister: " << fileName << " has a corrupt record, skipping it");
+         continue;
+      }
+      if(contacts.empty())
+      {
+         // the AOR was removed outright, which is how removals are logged when contacts do not linger
+         mRegDb.lockRecord(aor);
+         mRegDb.removeAor(aor);
+         mRegDb.unlockRecord(aor);
+      }
+      else
+      {
+         mRegDb.addAor(aor, contacts);
+      }
+      aors++;
+   }
+   return true;
+}
+
+unsigned int
+InMemorySyncRegDbPersister::load()
+{
+   unsigned int aors = 0;
+   uint64_t generation = 0;
+   uint64_t start = Timer::getTimeMs();
+   replayFile(mSnapshotFileName, generation, false, aors);
+   replayFile(mLogFileName, generation, true, aors);
+   mGeneration = generation;
+   InfoLog(<< "InMemorySyncRegDbPersister: loaded " << aors << " AOR records from generation " << generation
+           << " in " << Timer::getTimeMs() - start << "ms");
+   return aors;
+}
+
+void
+InMemorySyncRegDbPersister::onAorModified(const resip::Uri& aor, const ContactList& contacts)
+{
+   // Called with the AOR locked in the database, so records for an AOR
+   // are queued in the order the changes were made.
+   Data* record = new Data;
+   encodeAor(*record, aor, contacts);
+   mFifo.add(record);
+}
+
+void
+InMemorySyncRegDbPersister::writeLogRecord(const Data& record)
+{
+   if(mLog.is_open())
+   {
+      writeRecord(mLog, record);
+      mLogRecords++;
+   }
+}
+
+bool
+InMemorySyncRegDbPersister::writeSnapshot()
+{
+   // Changes made while the snapshot is written are still queued, and go
+   // into the log of the new generation.  Each record is an AOR's whole
+   // contact list, so replaying one the snapshot already has is harmless.
+   uint64_t start = Timer::getTimeMs();
+   uint64_t generation = mGeneration + 1;
+   Data tmpFileName = mSnapshotFileName + ".tmp";
+   unsigned int aors = 0;
+   {
+      std::ofstream out(tmpFileName.c_str(), std::ios::binary | std::ios::trunc);
+      if(!out)
+      {
+         ErrLog(<< "InMemorySyncRegDbPersister: unable to open " << tmpFileName);
+         return false;
+      }
+      writeHeader(out, SnapshotMagic, generation);
+
+      RegistrationPersistenceManager::UriList aorList;
+      mRegDb.getAors(aorList);
+      ContactList contacts;
+      Data record;
+      for(RegistrationPersistenceManager::UriList::const_iterator it = aorList.begin(); it != aorList.end(); it++)
+      {
+         mRegDb.getContactsFull(*it, contacts);
+         if(contacts.empty())
+         {
+            continue;
+         }
+         record.clear();
+         encodeAor(record, *it, contacts);
+         writeRecord(out, record);
+         aors++;
+      }
+      out.close();
+      if(!out)
+      {
+         ErrLog(<< "InMemorySyncRegDbPersister: unable to write " << tmpFileName);
+         remove(tmpFileName.c_str());
+         return false;
+      }
+   }
+#ifdef WIN32
+   remove(mSnapshotFileName.c_str());
+#endif
+   if(rename(tmpFileName.c_str(), mSnapshotFileName.c_str()) != 0)
+   {
+      ErrLog(<< "InMemorySyncRegDbPersister: unable to rename " << tmpFileName << " to " << mSnapshotFileName);
+      return false;
+   }
+   mGeneration = generation;
+
+   if(mLog.is_open())
+   {
+      mLog.close();
+   }
+   mLog.clear();
+   mLog.open(mLogFileName.c_str(), std::ios::binary | std::ios::trunc);
+   if(!mLog)
+   {
+      ErrLog(<< "InMemorySyncRegDbPersister: unable to open " << mLogFileName);
+      mLog.close();
+      return false;
+   }
+   writeHeader(mLog, LogMagic, generation);
+   mLog.flush();
+   mLogRecords = 0;
+
+   InfoLog(<< "InMemorySyncRegDbPersister: wrote generation " << generation << " snapshot of " << aors
+           << " AORs in " << Timer::getTimeMs() - start << "ms");
+   return true;
+}
+
+void
+InMemorySyncRegDbPersister::thread()
+{
+   // The log of the generation we loaded is never appended to, since it
+   // may end in a partial record, so we start with a snapshot.  If one
+   // fails, it is retried after SnapshotRetrySecs.
+   const uint64_t SnapshotRetrySecs = 30;
+   uint64_t lastSnapshot = Timer::getTimeSecs();
+   bool snapshotNeeded = !writeSnapshot();
+   while(!isShutdown())
+   {
+      uint64_t now = Timer::getTimeSecs();
+      if((snapshotNeeded && now - lastSnapshot >= SnapshotRetrySecs) || mSnapshotRequested ||
+         (mSnapshotLogRecords > 0 && mLogRecords >= mSnapshotLogRecords) ||
+         (mSnapshotIntervalSecs > 0 && now - lastSnapshot >= mSnapshotIntervalSecs && mLogRecords > 0))
+      {
+         mSnapshotRequested = false;
+         snapshotNeeded = !writeSnapshot();
+         lastSnapshot = now;
+      }
+
+      Data* record = mFifo.getNext(1000);  // Only need to wake up to see if we are shutdown or due a snapshot
+      if(record)
+      {
+         // write out everything queued before flushing, so a burst of
+         // registrations costs one flush
+         do
+         {
+            writeLogRecord(*record);
+            delete record;
+            record = mFifo.size() > 0 ? mFifo.getNext() : 0;
+         } while(record);
+         mLog.flush();
+      }
+   }
+
+   while(mFifo.size() > 0)
+   {
+      Data* record = mFifo.getNext();
+      writeLogRecord(*record);
+      delete record;
+   }
+   mLog.flush();
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,126 @@
+#if !defined(RESIP_INMEMORYSYNCREGDBPERSISTER_HXX)
+#define RESIP_INMEMORYSYNCREGDBPERSISTER_HXX
+
+#include <fstream>
+
+#include "resip/dum/InMemorySyncRegDb.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/Fifo.hxx"
+#include "rutil/ThreadIf.hxx"
+
+namespace resip
+{
+
+/**
+  Keeps the contents of an InMemorySyncRegDb on disk, so that a restarted
+  process comes back up with its registrations instead of waiting for
+  every endpoint to re-register.
+
+  Every change to an AOR is appended, as the AOR's full contact list, to
+  a binary write-ahead log (<fileName>.log).  Every snapshotIntervalSecs,
+  or once snapshotLogRecords changes have been logged, the whole database
+  is written to <fileName>.snapshot and the log is started over.  Both
+  files carry a generation number, and a log is only replayed on top of
+  the snapshot of the same generation.
+
+  Usage: construct, call load() to fill the database from disk, then add
+  this as a handler of the database and run() it.  load() must be called
+  before any other handler is added, so that the loaded registrations are
+  not replicated as if they were new.  Log writes happen on this thread;
+  onAorModified only encodes the change and queues it.
+
+  Expiry and last update times are stored as wall clock times, so that
+  they survive a reboot of the machine as well as a restart.
+*/
+class InMemorySyncRegDbPersister : public InMemorySyncRegDbHandler, public ThreadIf
+{
+   public:
+      InMemorySyncRegDbPersister(InMemorySyncRegDb& regDb,
+                                 const Data& fileName,
+                                 unsigned int snapshotIntervalSecs = 300,
+                                 unsigned int snapshotLogRecords = 100000);
+      virtual ~InMemorySyncRegDbPersister();
+
+      /// returns the number of AORs loaded from the snapshot and the log
+      unsigned int load();
+
+      /// asks the thread to write a snapshot the next time it wakes up
+      void requestSnapshot() { mSnapshotRequested = true; }
+
+      virtual void onAorModified(const resip::Uri& aor, const ContactList& contacts);
+      virtual void thread();
+
+      static void encodeAor(Data& record, const Uri& aor, const ContactList& contacts);
+      static bool decodeAor(const Data& record, Uri& aor, ContactList& contacts);
+
+   private:
+      bool writeSnapshot();
+      void writeLogRecord(const Data& record);
+      bool replayFile(const Data& fileName, uint64_t& generation, bool checkGeneration, unsigned int& aors);
+
+      InMemorySyncRegDb& mRegDb;
+      Data mSnapshotFileName;
+      Data mLogFileName;
+      unsigned int mSnapshotIntervalSecs;
+      unsigned int mSnapshotLogRecords;
+      volatile bool mSnapshotRequested;
+
+      Fifo<Data> mFifo;
+      std::ofstream mLog;
+      uint64_t mGeneration;
+      unsigned int mLogRecords;
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,286 @@
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+#include "resip/dum/InMemorySyncRegDb.hxx"
+#include "resip/stack/NameAddr.hxx"
+#include "resip/stack/Uri.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/ThreadIf.hxx"
+#include "rutil/Timer.hxx"
+
+using namespace resip;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TEST
+
+class CountingHandler : public InMemorySyncRegDbHandler
+{
+   public:
+      CountingHandler() : InMemorySyncRegDbHandler(AllChanges), mModified(0) {}
+      virtual void onAorModified(const resip::Uri& aor, const ContactList& contacts) { mModified++; }
+      int mModified;
+};
+
+static ContactInstanceRecord
+makeContact(const Data& contact, uint64_t expires)
+{
+   ContactInstanceRecord rec;
+   rec.mContact = NameAddr(contact);
+   rec.mRegExpires = expires;
+   rec.mLastUpdated = Timer::getTimeSecs();
+   return rec;
+}
+
+static void
+testBasics(unsigned int shards)
+{
+   InMemorySyncRegDb db(0, shards);
+   CountingHandler handler;
+   db.addHandler(&handler);
+   uint64_t expires = Timer::getTimeSecs() + 3600;
+
+   Uri alice("sip:alice@example.com");
+   assert(!db.aorIsRegistered(alice));
+   RegistrationPersistenceManager::update_status_t status;
+   status = db.updateContact(alice, makeContact("sip:alice@10.0.0.1", expires));
+   assert(status == RegistrationPersistenceManager::CONTACT_CREATED);
+   status = db.updateContact(alice, makeContact("sip:alice@10.0.0.1", expires));
+   assert(status == RegistrationPersistenceManager::CONTACT_UPDATED);
+   status = db.updateContact(alice, makeContact("sip:alice@10.0.0.2", expires));
+   assert(status == RegistrationPersistenceManager::CONTACT_CREATED);
+   assert(handler.mModified == 3);
+
+   // the same AOR as far as Uri::operator< is concerned
+   ContactList contacts;
+   db.getContacts(Uri("sip:alice@EXAMPLE.com"), contacts);
+   assert(contacts.size() == 2);
+   db.getContacts(Uri("sips:alice@example.com"), contacts);
+   assert(contacts.size() == 2);
+   db.getContacts(Uri("sip:Alice@example.com"), contacts);
+   assert(contacts.empty());
+   db.getContacts(Uri("sip:alice@example.com:5070"), contacts);
+   assert(contacts.empty());
+
+   Uri bob("sip:bob@[2001:db8::1]");
+   db.updateContact(bob, makeContact("sip:bob@10.0.0.3", expires));
+   assert(db.aorIsRegistered(Uri("sip:bob@[2001:0db8:0:0::1]")));
+
+   uint64_t maxExpires = 0;
+   assert(db.aorIsRegistered(alice, &maxExpires));
+   assert(maxExpires == expires);
+
+   // getAors() comes back in order, whichever shards the AORs are in
+   for(int i = 0; i < 100; i++)
+   {
+      ContactList list;
+      list.push_back(makeContact("sip:user" + Data(i) + "@10.0.1.1", expires));
+      db.addAor(Uri("sip:user" + Data(i) + "@example.com"), list);
+   }
+   RegistrationPersistenceManager::UriList aors;
+   db.getAors(aors);
+   assert(aors.size() == 102);
+   for(RegistrationPersistenceManager::UriList::iterator it = aors.begin(), prev = it++; it != aors.end(); prev = it++)
+   {
+      assert(*prev < *it);
+   }
+
+   // removing the last contact removes the AOR
+   db.removeContact(alice, makeContact("sip:alice@10.0.0.1", expires));
+   assert(db.aorIsRegistered(alice));
+   db.removeContact(alice, makeContact("sip:alice@10.0.0.2", expires));
+   assert(!db.aorIsRegistered(alice));
+
+   // a locked record that ends up with no contacts is dropped on unlock
+   Uri carol("sip:carol@example.com");
+   db.lockRecord(carol);
+   db.getAors(aors);
+   assert(aors.size() == 103);
+   db.unlockRecord(carol);
+   db.getAors(aors);
+   assert(aors.size() == 102);
+
+   db.lockRecord(carol);
+   db.updateContact(carol, makeContact("sip:carol@10.0.0.4", expires));
+   db.unlockRecord(carol);
+   db.lockRecord(carol);
+   db.removeAor(carol);
+   db.unlockRecord(carol);
+   assert(!db.aorIsRegistered(carol));
+   db.getAors(aors);
+   assert(aors.size() == 102);
+   db.removeHandler(&handler);
+}
+
+static void
+testLinger()
+{
+   InMemorySyncRegDb db(3600, 8);
+   uint64_t expires = Timer::getTimeSecs() + 3600;
+   Uri alice("sip:alice@example.com");
+   db.updateContact(alice, makeContact("sip:alice@10.0.0.1", expires));
+   db.removeAor(alice);
+
+   // removed contacts linger with an expiry of 0
+   ContactList contacts;
+   assert(!db.aorIsRegistered(alice));
+   db.getContacts(alice, contacts);
+   assert(contacts.empty());
+   db.getContactsFull(alice, contacts);
+   assert(contacts.size() == 1);
+   assert(contacts.front().mRegExpires == 0);
+
+   // and are re-created by a new registration
+   RegistrationPersistenceManager::update_status_t status = db.updateContact(alice, makeContact("sip:alice@10.0.0.1", expires));
+   assert(status == RegistrationPersistenceManager::CONTACT_CREATED);
+   assert(db.aorIsRegistered(alice));
+}
+
+// What a registrar and a location server do to the database: lock an AOR,
+// refresh one of its contacts and unlock it, then look the AOR up.
+class RegistrarThread : public ThreadIf
+{
+   public:
+      RegistrarThread(InMemorySyncRegDb& db, const vector<Uri>& aors, unsigned int rounds, unsigned int& inside)
+         : mDb(db), mAors(aors), mRounds(rounds), mInside(inside), mOverlaps(0) {}
+      virtual void thread()
+      {
+         uint64_t expires = Timer::getTimeSecs() + 3600;
+         ContactInstanceRecord rec = makeContact("sip:contact@10.0.0.1", expires);
+         ContactList contacts;
+         for(unsigned int r = 0; r < mRounds; r++)
+         {
+            for(vector<Uri>::const_iterator aor = mAors.begin(); aor != mAors.end(); aor++)
+            {
+               mDb.lockRecord(*aor);
+               if(aor == mAors.begin() && mInside++ != 0)
+               {
+                  mOverlaps++;
+               }
+               mDb.updateContact(*aor, rec);
+               if(aor == mAors.begin())
+               {
+                  mInside--;
+               }
+               mDb.unlockRecord(*aor);
+               mDb.getContacts(*aor, contacts);
+               assert(contacts.size() == 1);
+            }
+         }
+      }
+      InMemorySyncRegDb& mDb;
+      const vector<Uri>& mAors;
+      unsigned int mRounds;
+      unsigned int& mInside;
+      unsigned int mOverlaps;
+};
+
+static uint64_t
+runRegistrars(unsigned int shards, unsigned int numThreads, const vector<vector<Uri> >& aors, unsigned int rounds)
+{
+   InMemorySyncRegDb db(0, shards);
+   unsigned int inside = 0;
+   vector<RegistrarThread*> threads;
+   for(unsigned int i = 0; i < numThreads; i++)
+   {
+      threads.push_back(new RegistrarThread(db, aors[i], rounds, inside));
+   }
+   uint64_t start = Timer::getTimeMicroSec();
+   for(unsigned int i = 0; i < numThreads; i++)
+   {
+      threads[i]->run();
+   }
+   for(unsigned int i = 0; i < numThreads; i++)
+   {
+      threads[i]->join();
+      // every thread starts with the same AOR, which the record lock keeps to one thread at a time
+      assert(threads[i]->mOverlaps == 0);
+      delete threads[i];
+   }
+   uint64_t elapsed = Timer::getTimeMicroSec() - start;
+
+   RegistrationPersistenceManager::UriList all;
+   db.getAors(all);
+   assert(all.size() == numThreads * (aors[0].size() - 1) + 1);
+   return elapsed;
+}
+
+int
+main(int argc, char* argv[])
+{
+   Log::initialize(Log::Cout, argc > 1 ? Log::toLevel(argv[1]) : Log::Warning, argv[0]);
+
+   testBasics(1);
+   testBasics(InMemorySyncRegDb::DefaultShards);
+   testLinger();
+
+   // each thread registers its own AORs, plus one AOR shared by all of them
+   const unsigned int numThreads = 4;
+   const unsigned int aorsPerThread = 5000;
+   const unsigned int rounds = 4;
+   vector<vector<Uri> > aors(numThreads);
+   for(unsigned int t = 0; t < numThreads; t++)
+   {
+      aors[t].push_back(Uri("sip:shared@example.com"));
+      for(unsigned int i = 1; i < aorsPerThread; i++)
+      {
+         aors[t].push_back(Uri("sip:" + Data(t * aorsPerThread + i) + "@example.com"));
+      }
+   }
+
+   uint64_t single = runRegistrars(1, numThreads, aors, rounds);
+   uint64_t sharded = runRegistrars(InMemorySyncRegDb::DefaultShards, numThreads, aors, rounds);
+   double ops = (double)numThreads * aorsPerThread * rounds;
+   cerr << numThreads << " threads, " << numThreads * aorsPerThread << " AORs: "
+        << single * 1000.0 / ops << " ns per registration with one shard, "
+        << sharded * 1000.0 / ops << " ns per registration with "
+        << InMemorySyncRegDb::DefaultShards << " shards" << endl;
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ */
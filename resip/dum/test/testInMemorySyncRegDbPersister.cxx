@@ -0,0 +1,316 @@
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#include "resip/dum/InMemorySyncRegDb.hxx"
+#include "resip/dum/InMemorySyncRegDbPersister.hxx"
+#include "resip/stack/NameAddr.hxx"
+#include "resip/stack/Tuple.hxx"
+#include "resip/stack/Uri.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/Time.hxx"
+#include "rutil/Timer.hxx"
+
+using namespace resip;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TEST
+
+static const Data fileName("testInMemorySyncRegDbPersister");
+
+static void
+removeFiles()
+{
+   remove((fileName + ".snapshot").c_str());
+   remove((fileName + ".snapshot.tmp").c_str());
+   remove((fileName + ".log").c_str());
+}
+
+static ContactInstanceRecord
+makeContact(const Data& contact, uint64_t expires)
+{
+   ContactInstanceRecord rec;
+   rec.mContact = NameAddr(contact);
+   rec.mRegExpires = expires;
+   rec.mLastUpdated = Timer::getTimeSecs() - 10;
+   return rec;
+}
+
+static void
+assertSameContacts(InMemorySyncRegDb& a, InMemorySyncRegDb& b)
+{
+   RegistrationPersistenceManager::UriList aorsA, aorsB;
+   a.getAors(aorsA);
+   b.getAors(aorsB);
+   assert(aorsA.size() == aorsB.size());
+   for(RegistrationPersistenceManager::UriList::iterator it = aorsA.begin(); it != aorsA.end(); it++)
+   {
+      ContactList contactsA, contactsB;
+      a.getContactsFull(*it, contactsA);
+      b.getContactsFull(*it, contactsB);
+      assert(contactsA.size() == contactsB.size());
+      for(ContactList::iterator ca = contactsA.begin(), cb = contactsB.begin(); ca != contactsA.end(); ca++, cb++)
+      {
+         assert(Data::from(ca->mContact) == Data::from(cb->mContact));
+         // wall clock conversion may be a second out either way
+         assert(ca->mRegExpires == 0 ? cb->mRegExpires == 0 : (ca->mRegExpires + 1 >= cb->mRegExpires && cb->mRegExpires + 1 >= ca->mRegExpires));
+         assert(ca->mLastUpdated + 1 >= cb->mLastUpdated && cb->mLastUpdated + 1 >= ca->mLastUpdated);
+         assert(ca->mReceivedFrom == cb->mReceivedFrom);
+         assert(ca->mPublicAddress == cb->mPublicAddress);
+         assert(ca->mSipPath.size() == cb->mSipPath.size());
+         assert(ca->mInstance == cb->mInstance);
+         assert(ca->mRegId == cb->mRegId);
+         assert(ca->mUserAgent == cb->mUserAgent);
+         assert(ca->mSyncContact == cb->mSyncContact);
+         assert((ca->mUserData == 0) == (cb->mUserData == 0));
+         assert(ca->mUserData == 0 || *ca->mUserData == *cb->mUserData);
+      }
+   }
+}
+
+static void
+testEncoding()
+{
+   uint64_t now = Timer::getTimeSecs();
+   ContactList contacts;
+   ContactInstanceRecord rec = makeContact("<sip:alice@10.0.0.1:5060;transport=tcp>;+sip.instance=\"<urn:uuid:1>\"", now + 3600);
+   rec.mReceivedFrom = Tuple("192.168.1.1", 5060, TCP);
+   rec.mPublicAddress = Tuple("2001:db8::1", 5061, TLS);
+   rec.mSipPath.push_back(NameAddr("<sip:edge.example.com;lr>"));
+   rec.mInstance = "<urn:uuid:1>";
+   rec.mRegId = 1;
+   rec.mUserAgent = "TestUA";
+   rec.mUserData = new Data("userdata");
+   contacts.push_back(rec);
+   contacts.push_back(makeContact("sip:alice@10.0.0.2", 0));
+
+   Data record;
+   InMemorySyncRegDbPersister::encodeAor(record, Uri("sip:alice@example.com"), contacts);
+   Uri aor;
+   ContactList decoded;
+   assert(InMemorySyncRegDbPersister::decodeAor(record, aor, decoded));
+   assert(aor == Uri("sip:alice@example.com"));
+   assert(decoded.size() == 2);
+   assert(decoded.front().mReceivedFrom == rec.mReceivedFrom);
+   assert(decoded.front().mReceivedFrom.getType() == TCP);
+   assert(decoded.front().mPublicAddress == rec.mPublicAddress);
+   assert(decoded.front().mSipPath.front().uri() == rec.mSipPath.front().uri());
+   assert(decoded.front().mInstance == rec.mInstance);
+   assert(*decoded.front().mUserData == "userdata");
+   assert(decoded.back().mRegExpires == 0);
+
+   // anything cut short is rejected rather than half decoded
+   for(Data::size_type size = 0; size < record.size(); size += 7)
+   {
+      assert(!InMemorySyncRegDbPersister::decodeAor(record.substr(0, size), aor, decoded));
+   }
+}
+
+static void
+testRestart()
+{
+   removeFiles();
+   uint64_t expires = Timer::getTimeSecs() + 3600;
+   InMemorySyncRegDb db(86400);
+   {
+      InMemorySyncRegDbPersister persister(db, fileName);
+      unsigned int loaded = persister.load();
+      assert(loaded == 0);
+      db.addHandler(&persister);
+      persister.run();
+
+      for(int i = 0; i < 200; i++)
+      {
+         Uri aor("sip:user" + Data(i) + "@example.com");
+         db.lockRecord(aor);
+         db.updateContact(aor, makeContact("sip:user" + Data(i) + "@10.0.0.1", expires));
+         db.updateContact(aor, makeContact("sip:user" + Data(i) + "@10.0.0.2", expires));
+         db.unlockRecord(aor);
+      }
+      // some changes go into the snapshot, the rest into the log after it
+      persister.requestSnapshot();
+      sleepSeconds(2);
+      for(int i = 0; i < 200; i += 3)
+      {
+         Uri aor("sip:user" + Data(i) + "@example.com");
+         db.lockRecord(aor);
+         db.removeContact(aor, makeContact("sip:user" + Data(i) + "@10.0.0.1", expires));
+         db.unlockRecord(aor);
+      }
+      db.removeAor(Uri("sip:user1@example.com"));
+
+      persister.shutdown();
+      persister.join();
+      db.removeHandler(&persister);
+   }
+
+   // a restart brings back the same registrations
+   {
+      InMemorySyncRegDb restarted(86400);
+      InMemorySyncRegDbPersister persister(restarted, fileName);
+      unsigned int loaded = persister.load();
+      assert(loaded > 200);
+      assertSameContacts(db, restarted);
+      assert(!restarted.aorIsRegistered(Uri("sip:user1@example.com")));
+      assert(restarted.aorIsRegistered(Uri("sip:user2@example.com")));
+   }
+
+   // a log cut short by a crash is replayed up to where it ends
+   {
+      Data log = Data::fromFile(fileName + ".log");
+      assert(log.size() > 100);
+      std::ofstream out((fileName + ".log").c_str(), std::ios::binary | std::ios::trunc);
+      out.write(log.data(), log.size() - 5);
+      out.close();
+
+      InMemorySyncRegDb restarted(86400);
+      InMemorySyncRegDbPersister persister(restarted, fileName);
+      unsigned int loaded = persister.load();
+      assert(loaded > 200);
+   }
+   removeFiles();
+}
+
+static void
+testStaleLog()
+{
+   removeFiles();
+   uint64_t expires = Timer::getTimeSecs() + 3600;
+   Uri alice("sip:alice@example.com");
+   {
+      InMemorySyncRegDb db;
+      InMemorySyncRegDbPersister persister(db, fileName);
+      persister.load();
+      db.addHandler(&persister);
+      persister.run();
+      db.updateContact(alice, makeContact("sip:alice@10.0.0.1", expires));
+      persister.shutdown();
+      persister.join();
+      db.removeHandler(&persister);
+   }
+   Data oldLog = Data::fromFile(fileName + ".log");
+   {
+      // restarting starts a new generation; alice goes away in it
+      InMemorySyncRegDb db;
+      InMemorySyncRegDbPersister persister(db, fileName);
+      unsigned int loaded = persister.load();
+      assert(loaded >= 1);
+      assert(db.aorIsRegistered(alice));
+      db.addHandler(&persister);
+      persister.run();
+      db.lockRecord(alice);
+      db.removeAor(alice);
+      db.unlockRecord(alice);
+      persister.shutdown();
+      persister.join();
+      db.removeHandler(&persister);
+   }
+   {
+      InMemorySyncRegDb db;
+      InMemorySyncRegDbPersister persister(db, fileName);
+      persister.load();
+      assert(!db.aorIsRegistered(alice));
+   }
+   {
+      // the log of an older generation is not replayed over a newer snapshot
+      std::ofstream out((fileName + ".log").c_str(), std::ios::binary | std::ios::trunc);
+      out.write(oldLog.data(), oldLog.size());
+      out.close();
+      InMemorySyncRegDb db;
+      InMemorySyncRegDbPersister persister(db, fileName);
+      persister.load();
+      assert(!db.aorIsRegistered(alice));
+   }
+   removeFiles();
+}
+
+int
+main(int argc, char* argv[])
+{
+   Log::initialize(Log::Cout, argc > 1 ? Log::toLevel(argv[1]) : Log::Warning, argv[0]);
+
+   testEncoding();
+   testRestart();
+   testStaleLog();
+
+   // how long a restart takes to load a large registrar back
+   removeFiles();
+   const unsigned int numAors = 100000;
+   {
+      uint64_t expires = Timer::getTimeSecs() + 3600;
+      InMemorySyncRegDb db;
+      for(unsigned int i = 0; i < numAors; i++)
+      {
+         ContactList contacts;
+         ContactInstanceRecord rec = makeContact("<sip:" + Data(i) + "@192.168.0.1:5060;transport=udp>", expires);
+         rec.mReceivedFrom = Tuple("192.168.0.1", 5060, UDP);
+         rec.mUserAgent = "TestUA/1.0";
+         contacts.push_back(rec);
+         db.addAor(Uri("sip:" + Data(i) + "@example.com"), contacts);
+      }
+      InMemorySyncRegDbPersister persister(db, fileName);
+      uint64_t start = Timer::getTimeMs();
+      persister.run();
+      persister.shutdown();
+      persister.join();
+      uint64_t saved = Timer::getTimeMs() - start;
+
+      InMemorySyncRegDb restarted;
+      InMemorySyncRegDbPersister loader(restarted, fileName);
+      start = Timer::getTimeMs();
+      unsigned int loaded = loader.load();
+      assert(loaded == numAors);
+      cerr << numAors << " AORs: snapshot written in " << saved << "ms, loaded in "
+           << Timer::getTimeMs() - start << "ms" << endl;
+   }
+   removeFiles();
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ */
@@ -28,6 +28,9 @@
 using namespace resip;
 
 volatile bool Connection::mEnablePostConnectSocketFuncCall = false;
+volatile bool Connection::GatherWrites = true;
+std::atomic<uint64_t> Connection::sWriteCalls(0);
+std::atomic<uint64_t> Connection::sBytesWritten(0);
 
 #define RESIPROCATE_SUBSYSTEM Subsystem::TRANSPORT
 
@@ -79,8 +82,7 @@ Connection::requestWrite(SendData* sendData)
 void 
 Connection::removeFrontOutstandingSend()
 {
-   delete mOutstandingSends.front();
-   mOutstandingSends.pop_front();
+   delete mOutstandingSends.pop_front();
 
    if (mOutstandingSends.empty())
    {
@@ -211,7 +213,7 @@ Connection::performWrite()
       }
 
       memcpy(uBuffer, dataRaw.data(), dataRaw.size());
-      mOutstandingSends.front() = dataWs;
+      mOutstandingSends.replace_front(dataWs);
       dataWs = 0;
       delete oldSd;
    }
@@ -237,7 +239,7 @@ Connection::performWrite()
                                      oldSd->transactionId,
                                      oldSd->sigcompId,
                                      true);
-      mOutstandingSends.front() = newSd;
+      mOutstandingSends.replace_front(newSd);
       delete oldSd;
       delete sm;
    }
@@ -249,9 +251,9 @@ Connection::performWrite()
       mFirstWriteAfterConnectedPending = false;  // reset
 
       // Notify all outstanding sends that we are now connected - stops the TCP Connection timer for all transactions
-      for (std::list<SendData*>::iterator it = mOutstandingSends.begin(); it != mOutstandingSends.end(); it++)
+      for (SendData* sd = mOutstandingSends.front(); sd; sd = sd->next())
       {
-         mTransport->setTcpConnectState((*it)->transactionId, TcpConnectState::Connected);
+         mTransport->setTcpConnectState(sd->transactionId, TcpConnectState::Connected);
       }
       if (mEnablePostConnectSocketFuncCall)
       {
@@ -259,8 +261,43 @@ Connection::performWrite()
       }
    }
 
-   const Data& data = mOutstandingSends.front()->data;
-   int nBytes = write(data.data() + mSendPos,int(data.size() - mSendPos));
+   int nBytes;
+   if (GatherWrites && mSendingTransmissionFormat == Uncompressed)
+   {
+      // Plain messages go out as they are, so everything queued behind the
+      // front one (up to the next command) can share the write call.
+      WriteSegment segments[MaxWriteSegments];
+      int count = 0;
+      for (const SendData* sd = mOutstandingSends.front();
+           sd && count < MaxWriteSegments;
+           sd = sd->next())
+      {
+         if (count > 0 && sd->command != SendData::NoCommand)
+         {
+            break;
+         }
+         const Data::size_type skip = (count == 0) ? mSendPos : 0;
+         if (sd->data.size() > skip)
+         {
+            segments[count].buffer = sd->data.data() + skip;
+            segments[count].count = int(sd->data.size() - skip);
+            ++count;
+         }
+      }
+      if (count == 0)
+      {
+         // nothing but an empty message at the front
+         mSendPos = 0;
+         removeFrontOutstandingSend();
+         return 0;
+      }
+      nBytes = gatherWrite(segments, count);
+   }
+   else
+   {
+      const Data& data = mOutstandingSends.front()->data;
+      nBytes = write(data.data() + mSendPos,int(data.size() - mSendPos));
+   }
 
    //DebugLog (<< "Tried to send " << data.size() - mSendPos << " bytes, sent " << nBytes << " bytes");
 
@@ -280,9 +317,22 @@ Connection::performWrite()
    {
       // Safe because of the conditional above ( < 0 ).
       Data::size_type bytesWritten = static_cast<Data::size_type>(nBytes);
-      mSendPos += bytesWritten;
-      if (mSendPos == data.size())
+      ++sWriteCalls;
+      sBytesWritten += bytesWritten;
+
+      // retire every message the write completed; the last one may have
+      // gone out only in part
+      Data::size_type remaining = bytesWritten;
+      while (remaining > 0)
       {
+         resip_assert(!mOutstandingSends.empty());
+         const Data::size_type left = mOutstandingSends.front()->data.size() - mSendPos;
+         if (remaining < left)
+         {
+            mSendPos += remaining;
+            break;
+         }
+         remaining -= left;
          mSendPos = 0;
          removeFrontOutstandingSend();
       }
@@ -291,6 +341,13 @@ Connection::performWrite()
 }
 
 
+int
+Connection::gatherWrite(const WriteSegment* segments, int count)
+{
+   resip_assert(count > 0);
+   return write(segments[0].buffer, segments[0].count);
+}
+
 bool 
 Connection::performWrites(unsigned int max)
 {
@@ -1,6 +1,7 @@
 #ifndef RESIP_Connection_hxx
 #define RESIP_Connection_hxx
 
+#include <atomic>
 #include <list>
 
 #include "resip/stack/ConnectionBase.hxx"
@@ -104,11 +105,37 @@ class Connection : public ConnectionBase,
       static volatile bool mEnablePostConnectSocketFuncCall;
       static void setEnablePostConnectSocketFuncCall(bool enabled = true) { mEnablePostConnectSocketFuncCall = enabled; }
       bool isServer()const;
+
+      /** When true (the default), performWrite() hands all queued plain
+          messages, up to MaxWriteSegments of them, to the transport in a
+          single gatherWrite() call instead of writing one per call. */
+      static volatile bool GatherWrites;
+      static const int MaxWriteSegments = 64;
+
+      /// process wide count of successful stream write calls and the bytes
+      /// they carried; the ratio is reported in the stack statistics
+      static uint64_t getNumWriteCalls() { return sWriteCalls; }
+      static uint64_t getNumBytesWritten() { return sBytesWritten; }
+
    protected:
+      /// one buffer of a gathered write
+      struct WriteSegment
+      {
+         const char* buffer;
+         int count;
+      };
+
       /// pure virtual, but need concrete Connection for book-ends of lists
       virtual int read(char* /* buffer */, const int /* count */) { return 0; }
       /// pure virtual, but need concrete Connection for book-ends of lists
       virtual int write(const char* /* buffer */, const int /* count */) { return 0; }
+      /** Writes the segments, in order, with as few calls into the socket
+          (or TLS library) as possible. Same return convention as write():
+          bytes written, 0 if nothing could be written right now, negative on
+          error. A short write may end in the middle of any segment. The
+          default writes only the first segment.
+      */
+      virtual int gatherWrite(const WriteSegment* segments, int count);
       virtual void onDoubleCRLF();
       virtual void onSingleCRLF();
 
@@ -131,6 +158,9 @@ class Connection : public ConnectionBase,
       Connection(const Connection&);
       Connection& operator=(const Connection&);
       bool mIsServer;
+
+      static std::atomic<uint64_t> sWriteCalls;
+      static std::atomic<uint64_t> sBytesWritten;
 };
 
 EncodeStream& 
@@ -98,12 +98,11 @@ ConnectionBase::~ConnectionBase()
 
    while (!mOutstandingSends.empty())
    {
-      SendData* sendData = mOutstandingSends.front();
+      SendData* sendData = mOutstandingSends.pop_front();
       mTransport->fail(sendData->transactionId,
          mFailureReason ? mFailureReason : TransportFailure::ConnectionUnknown,
          mFailureSubCode);
       delete sendData;
-      mOutstandingSends.pop_front();
    }
    delete [] mBuffer;
    delete mMessage;
@@ -89,7 +89,7 @@ class ConnectionBase
       void setBuffer(char* bytes, int count);
 
       Data::size_type mSendPos;
-      std::list<SendData*> mOutstandingSends; // !jacob! intrusive queue?
+      SendDataQueue mOutstandingSends;
 
       void setFailureReason(TransportFailure::FailureReason failReason, int subCode);
 
@@ -5,9 +5,25 @@
 #include <ctype.h>
 #include <limits.h>
 #include <stdio.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RESIP_MSG_HEADER_SCANNER_SSE2
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+// AVX2 code is compiled with a function level target attribute, so that the
+// rest of the library does not depend on it and the CPU is asked at runtime.
+#if defined(__GNUC__) && defined(__x86_64__) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define RESIP_MSG_HEADER_SCANNER_AVX2
+#include <immintrin.h>
+#endif
+#endif
 #include "resip/stack/HeaderTypes.hxx"
 #include "resip/stack/SipMessage.hxx"
 #include "resip/stack/MsgHeaderScanner.hxx"
+#include "rutil/ResipAssert.h"
 #include "rutil/WinLeakCheck.hxx"
 
 namespace resip 
@@ -412,6 +428,172 @@ static void initStateMachine()
                   sMsgStart); // Arbitrary but possibly handy.
 }
 
+///////////////////////////////////////////////////////////////////////////////
+//   Runs.  In some states (status line, values, quoted strings, ...) every
+//   ordinary character just keeps the scanner where it is, and only a few
+//   special characters matter.  There, the vector code below skips ahead to
+//   the next special character 16 or 32 characters at a time, and the state
+//   machine takes over again at that character.
+
+struct RunInfo
+{
+      bool skippable;
+      // the special characters that end a run in this state
+      unsigned char numStopChars;
+      char stopChars[16];
+};
+
+static RunInfo runInfoArray[numStates];
+
+// Characters that carry text properties, which are still collected for the
+// characters that are skipped.
+static const char textPropChars[] = { ' ', '\t', '\\', '%', ';', '(', ')', '\r', '\n' };
+enum { numTextPropChars = sizeof(textPropChars) };
+
+static inline bool isSelfTransition(int state, CharCategory charCategory)
+{
+   return stateMachine[state][c2i(charCategory)].action == taNone &&
+      stateMachine[state][c2i(charCategory)].nextState == state;
+}
+
+static void initRunInfoArray()
+{
+   for (int state = 0; state < numStates; ++state)
+   {
+      RunInfo& run = runInfoArray[state];
+      // Only ccOther and ccFieldName have characters outside the special
+      // ones, and the vector code can not tell those two apart.
+      run.skippable = isSelfTransition(state, ccOther) &&
+         isSelfTransition(state, ccFieldName);
+      run.numStopChars = 0;
+      for (unsigned int charIndex = 0; charIndex <= UCHAR_MAX; ++charIndex)
+      {
+         CharCategory charCategory = charInfoArray[charIndex].category;
+         if (charCategory != ccOther && charCategory != ccFieldName &&
+             !isSelfTransition(state, charCategory))
+         {
+            resip_assert(run.numStopChars < sizeof(run.stopChars));
+            run.stopChars[run.numStopChars++] = (char)charIndex;
+         }
+      }
+   }
+}
+
+#if defined(RESIP_MSG_HEADER_SCANNER_SSE2)
+
+static inline unsigned int countTrailingZeros(unsigned int bits)
+{
+#if defined(_MSC_VER)
+   unsigned long index;
+   _BitScanForward(&index, bits);
+   return (unsigned int)index;
+#else
+   return (unsigned int)__builtin_ctz(bits);
+#endif
+}
+
+// Returns the first stop character at or after "charPtr", or the first
+// character of the first block that would reach beyond "blockLimit".
+static char *
+skipRunSse2(char *charPtr,
+            const char *blockLimit,
+            const RunInfo& run,
+            MsgHeaderScanner::TextPropBitMask& textPropBitMask)
+{
+   while (charPtr + 16 <= blockLimit)
+   {
+      __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(charPtr));
+      __m128i stop = _mm_setzero_si128();
+      for (unsigned int i = 0; i < run.numStopChars; ++i)
+      {
+         stop = _mm_or_si128(stop, _mm_cmpeq_epi8(block, _mm_set1_epi8(run.stopChars[i])));
+      }
+      unsigned int stopBits = (unsigned int)_mm_movemask_epi8(stop);
+      unsigned int skipBits = stopBits ? (stopBits & (0u - stopBits)) - 1 : 0xffffu;
+      for (unsigned int i = 0; i < numTextPropChars && skipBits; ++i)
+      {
+         const char c = textPropChars[i];
+         if ((textPropBitMask & charInfoArray[c2i(c)].textPropBitMask) == 0 &&
+             ((unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8(c))) & skipBits))
+         {
+            textPropBitMask |= charInfoArray[c2i(c)].textPropBitMask;
+         }
+      }
+      if (stopBits)
+      {
+         return charPtr + countTrailingZeros(stopBits);
+      }
+      charPtr += 16;
+   }
+   return charPtr;
+}
+
+#if defined(RESIP_MSG_HEADER_SCANNER_AVX2)
+
+__attribute__((target("avx2")))
+static char *
+skipRunAvx2(char *charPtr,
+            const char *blockLimit,
+            const RunInfo& run,
+            MsgHeaderScanner::TextPropBitMask& textPropBitMask)
+{
+   while (charPtr + 32 <= blockLimit)
+   {
+      __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(charPtr));
+      __m256i stop = _mm256_setzero_si256();
+      for (unsigned int i = 0; i < run.numStopChars; ++i)
+      {
+         stop = _mm256_or_si256(stop, _mm256_cmpeq_epi8(block, _mm256_set1_epi8(run.stopChars[i])));
+      }
+      unsigned int stopBits = (unsigned int)_mm256_movemask_epi8(stop);
+      unsigned int skipBits = stopBits ? (stopBits & (0u - stopBits)) - 1 : 0xffffffffu;
+      for (unsigned int i = 0; i < numTextPropChars && skipBits; ++i)
+      {
+         const char c = textPropChars[i];
+         if ((textPropBitMask & charInfoArray[c2i(c)].textPropBitMask) == 0 &&
+             ((unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, _mm256_set1_epi8(c))) & skipBits))
+         {
+            textPropBitMask |= charInfoArray[c2i(c)].textPropBitMask;
+         }
+      }
+      if (stopBits)
+      {
+         return charPtr + countTrailingZeros(stopBits);
+      }
+      charPtr += 32;
+   }
+   // Finish off with 16 character blocks
+   return skipRunSse2(charPtr, blockLimit, run, textPropBitMask);
+}
+
+#endif // RESIP_MSG_HEADER_SCANNER_AVX2
+#endif // RESIP_MSG_HEADER_SCANNER_SSE2
+
+static MsgHeaderScanner::SimdLevel supportedSimdLevel()
+{
+#if defined(RESIP_MSG_HEADER_SCANNER_AVX2)
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx2"))
+   {
+      return MsgHeaderScanner::simdAvx2;
+   }
+#endif
+#if defined(RESIP_MSG_HEADER_SCANNER_SSE2)
+   return MsgHeaderScanner::simdSse2;
+#else
+   return MsgHeaderScanner::simdNone;
+#endif
+}
+
+typedef char * (*SkipRunFunction)(char *,
+                                  const char *,
+                                  const RunInfo&,
+                                  MsgHeaderScanner::TextPropBitMask&);
+
+// Set along with simdLevel; 0 for the scalar scanner.
+static SkipRunFunction skipRunFunction = 0;
+static int simdLevel = -1;
+
 // Debug follows
 #if defined(RESIP_MSG_HEADER_SCANNER_DEBUG)  
 
@@ -875,7 +1057,47 @@ processMsgHeaderFieldNameAndValue(SipMessage * msg,
 
 bool MsgHeaderScanner::mInitialized = false;
 
-MsgHeaderScanner::MsgHeaderScanner()
+MsgHeaderScanner::SimdLevel
+MsgHeaderScanner::getSimdLevel()
+{
+   if (simdLevel < 0)
+   {
+      setSimdLevel(simdAvx2);
+   }
+   return (SimdLevel)simdLevel;
+}
+
+MsgHeaderScanner::SimdLevel
+MsgHeaderScanner::setSimdLevel(SimdLevel level)
+{
+   SimdLevel supported = supportedSimdLevel();
+   if (level > supported)
+   {
+      level = supported;
+   }
+   switch (level)
+   {
+#if defined(RESIP_MSG_HEADER_SCANNER_AVX2)
+      case simdAvx2:
+         skipRunFunction = skipRunAvx2;
+         break;
+#endif
+#if defined(RESIP_MSG_HEADER_SCANNER_SSE2)
+      case simdSse2:
+         skipRunFunction = skipRunSse2;
+         break;
+#endif
+      default:
+         skipRunFunction = 0;
+         break;
+   }
+   simdLevel = level;
+   return level;
+}
+
+MsgHeaderScanner::MsgHeaderScanner() :
+   mFieldObserver(0),
+   mFieldObserverContext(0)
 {
    if (!mInitialized)
    {
@@ -884,6 +1106,13 @@ MsgHeaderScanner::MsgHeaderScanner()
    }
 }
 
+void
+MsgHeaderScanner::setFieldObserver(FieldObserver observer, void* context)
+{
+   mFieldObserver = observer;
+   mFieldObserverContext = context;
+}
+
 void
 MsgHeaderScanner::prepareForMessage(SipMessage *  msg)
 {
@@ -924,6 +1153,10 @@ MsgHeaderScanner::scanChunk(char * chunk,
    *termCharPtr = chunkTermSentinelChar;
    char *textStartCharPtr;
    MsgHeaderScanner::TextPropBitMask localTextPropBitMask = mTextPropBitMask;
+   // Vector loads stay within the chunk, sentinel included
+   SkipRunFunction localSkipRunFunction = skipRunFunction;
+   RunInfo *localRunInfoArray = runInfoArray;
+   const char *blockLimit = termCharPtr + 1;
    if (mPrevScanChunkNumSavedTextChars == 0)
    {
       textStartCharPtr = 0;
@@ -939,6 +1172,13 @@ MsgHeaderScanner::scanChunk(char * chunk,
       // The code in this block is executed once per message header character.
       // This entire file is designed specifically to minimize this block's size.
       ++charPtr;
+      if (localRunInfoArray[(unsigned)localState].skippable && localSkipRunFunction)
+      {
+         charPtr = localSkipRunFunction(charPtr,
+                                        blockLimit,
+                                        localRunInfoArray[(unsigned)localState],
+                                        localTextPropBitMask);
+      }
       CharInfo *charInfo = &localCharInfoArray[((unsigned char) (*charPtr))];
       CharCategory charCategory = charInfo->category;
       localTextPropBitMask |= charInfo->textPropBitMask;
@@ -956,6 +1196,13 @@ MsgHeaderScanner::scanChunk(char * chunk,
       switch (transitionAction)
       {
          case taTermStatusLine:
+            if (mFieldObserver)
+            {
+               mFieldObserver(mFieldObserverContext, 0, 0, 0,
+                              textStartCharPtr,
+                              (unsigned int)(charPtr - textStartCharPtr),
+                              localTextPropBitMask);
+            }
             if (!processMsgHeaderStatusLine(mMsg,
                                             textStartCharPtr,
                                             (unsigned int)(charPtr - textStartCharPtr),
@@ -977,6 +1224,7 @@ MsgHeaderScanner::scanChunk(char * chunk,
                                      &mFieldKind,
                                      &isMultiValueAllowed);
             mFieldName = textStartCharPtr;
+            mFieldNameTextPropBitMask = localTextPropBitMask;
             textStartCharPtr = 0;
             if (isMultiValueAllowed) 
             {
@@ -985,6 +1233,11 @@ MsgHeaderScanner::scanChunk(char * chunk,
          }
          break;
          case taBeyondEmptyValue:
+            if (mFieldObserver)
+            {
+               mFieldObserver(mFieldObserverContext, mFieldName, mFieldNameLength,
+                              mFieldNameTextPropBitMask, 0, 0, 0);
+            }
             processMsgHeaderFieldNameAndValue(mMsg,
                                               mFieldKind,
                                               mFieldName,
@@ -995,6 +1248,13 @@ MsgHeaderScanner::scanChunk(char * chunk,
             ++mNumHeaders;
             goto performStartTextAction;
          case taTermValueAfterLineBreak:
+            if (mFieldObserver)
+            {
+               mFieldObserver(mFieldObserverContext, mFieldName, mFieldNameLength,
+                              mFieldNameTextPropBitMask, textStartCharPtr,
+                              (unsigned int)((charPtr - textStartCharPtr) - 2),
+                              localTextPropBitMask);
+            }
             processMsgHeaderFieldNameAndValue(mMsg,
                                               mFieldKind,
                                               mFieldName,
@@ -1005,6 +1265,13 @@ MsgHeaderScanner::scanChunk(char * chunk,
             ++mNumHeaders;
             goto performStartTextAction;
          case taTermValue:
+            if (mFieldObserver)
+            {
+               mFieldObserver(mFieldObserverContext, mFieldName, mFieldNameLength,
+                              mFieldNameTextPropBitMask, textStartCharPtr,
+                              (unsigned int)(charPtr - textStartCharPtr),
+                              localTextPropBitMask);
+            }
             processMsgHeaderFieldNameAndValue(mMsg,
                                               mFieldKind,
                                               mFieldName,
@@ -1067,6 +1334,8 @@ MsgHeaderScanner::initialize()
 {
    initCharInfoArray();
    initStateMachine();
+   initRunInfoArray();
+   getSimdLevel();
    return true;
 }
 
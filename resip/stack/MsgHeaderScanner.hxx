@@ -65,9 +65,37 @@ class MsgHeaderScanner
          tpbmContainsParen      = 1 << 5      // '(' or ')', possibly mismatched
       };
       typedef unsigned char TextPropBitMask;
+
+      // Vector instructions used to skip over the ordinary characters of
+      // values and status lines.  The best one the CPU supports is picked
+      // when the first scanner is created; simdNone is the plain scalar
+      // scanner.
+      enum SimdLevel
+      {
+         simdNone,
+         simdSse2,
+         simdAvx2
+      };
+      static SimdLevel getSimdLevel();
+      // Levels the CPU (or build) does not support are lowered; returns the
+      // level actually in use.  Not thread safe, so only meant to be used
+      // before any scanning starts (or in benchmarks).
+      static SimdLevel setSimdLevel(SimdLevel level);
     
       inline unsigned int getHeaderCount() const { return mNumHeaders;} 
 
+      // Called with the start line (name 0) and with each field value as
+      // they are handed to the SipMessage, along with the text properties
+      // found in them.  Meant for tests comparing the scanning paths.
+      typedef void (*FieldObserver)(void* context,
+                                    const char* name,
+                                    unsigned int nameLength,
+                                    TextPropBitMask nameTextPropBitMask,
+                                    const char* value,
+                                    unsigned int valueLength,
+                                    TextPropBitMask valueTextPropBitMask);
+      void setFieldObserver(FieldObserver observer, void* context);
+
    private:
     
       // Fields:
@@ -78,14 +106,18 @@ class MsgHeaderScanner
       MsgHeaderScanner::TextPropBitMask  mTextPropBitMask;
       const char *                       mFieldName;
       unsigned int                       mFieldNameLength;
+      MsgHeaderScanner::TextPropBitMask  mFieldNameTextPropBitMask;
       int                                mFieldKind;
+      FieldObserver                      mFieldObserver;
+      void *                             mFieldObserverContext;
       /*
         "mState" and "mPrevScanChunkNumSavedTextChars" are meaningful only between
         input chunks.
         "mTextPropBitMask" is meaningful only between input chunks and only when
         scanning a field name or value.
-        "mFieldName", "mFieldNameLength", and "mFieldKind" are meaningful only
-        between terminating a field name and finding the termination of its value.
+        "mFieldName", "mFieldNameLength", "mFieldNameTextPropBitMask", and
+        "mFieldKind" are meaningful only between terminating a field name and
+        finding the termination of its value.
       */
     
    public:
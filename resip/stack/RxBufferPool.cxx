@@ -0,0 +1,164 @@
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include "resip/stack/RxBufferPool.hxx"
+#include "rutil/ResipAssert.h"
+#include "rutil/WinLeakCheck.hxx"
+
+using namespace resip;
+
+std::atomic<size_t> RxBufferPool::sInUse(0);
+std::atomic<size_t> RxBufferPool::sFree(0);
+
+RxBufferPool::RxBufferPool(size_t bufferSize, size_t maxFree) :
+   mBufferSize(bufferSize),
+   mMaxFree(maxFree),
+   mFree(0),
+   mNumFree(0),
+   mRefs(1),
+   mShutdown(false)
+{
+}
+
+RxBufferPool::~RxBufferPool()
+{
+   // buffers released after shutdown() may still have been pushed
+   sFree -= mNumFree.load();
+   Header* header = mFree.load();
+   while (header)
+   {
+      Header* next = header->mNext;
+      delete [] reinterpret_cast<char*>(header);
+      header = next;
+   }
+}
+
+void
+RxBufferPool::shutdown()
+{
+   bool wasShutdown = mShutdown.exchange(true);
+   resip_assert(!wasShutdown);
+   // the last release() deletes us if buffers are still out
+   unref();
+}
+
+void
+RxBufferPool::unref()
+{
+   if (mRefs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+   {
+      delete this;
+   }
+}
+
+char*
+RxBufferPool::acquire()
+{
+   resip_assert(!mShutdown.load(std::memory_order_relaxed));
+   mRefs.fetch_add(1, std::memory_order_relaxed);
+
+   Header* header = mFree.load(std::memory_order_acquire);
+   while (header &&
+          !mFree.compare_exchange_weak(header, header->mNext,
+                                       std::memory_order_acquire,
+                                       std::memory_order_acquire))
+   {
+   }
+   if (header)
+   {
+      --mNumFree;
+      --sFree;
+   }
+   else
+   {
+      header = reinterpret_cast<Header*>(new char[sizeof(Header) + mBufferSize]);
+      header->mPool = this;
+   }
+   ++sInUse;
+   return reinterpret_cast<char*>(header + 1);
+}
+
+void
+RxBufferPool::release(char* buffer)
+{
+   Header* header = reinterpret_cast<Header*>(buffer) - 1;
+   RxBufferPool* pool = header->mPool;
+   --sInUse;
+   bool kept = false;
+   if (!pool->mShutdown.load(std::memory_order_relaxed))
+   {
+      if (pool->mNumFree.fetch_add(1) < pool->mMaxFree)
+      {
+         ++sFree;
+         header->mNext = pool->mFree.load(std::memory_order_relaxed);
+         while (!pool->mFree.compare_exchange_weak(header->mNext, header,
+                                                   std::memory_order_release,
+                                                   std::memory_order_relaxed))
+         {
+         }
+         kept = true;
+      }
+      else
+      {
+         --pool->mNumFree;
+      }
+   }
+   if (!kept)
+   {
+      delete [] reinterpret_cast<char*>(header);
+   }
+   // the buffer is back before our reference goes, so that the pool
+   // cannot be deleted under the push
+   pool->unref();
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,130 @@
+#if !defined(RESIP_RXBUFFERPOOL_HXX)
+#define RESIP_RXBUFFERPOOL_HXX
+
+#include <atomic>
+#include <cstddef>
+
+namespace resip
+{
+
+/**
+   @brief Pool of fixed size receive buffers for datagram transports.
+
+   A datagram is received straight into a buffer from acquire(), and if it
+   turns out to be a SIP message the SipMessage adopts the buffer (see
+   SipMessage::addPooledBuffer()) and parses it in place. When the message is
+   deleted, the buffer goes back to its pool through release(), which may
+   happen on any thread.
+
+   The pool is reference counted by its outstanding buffers: the owner calls
+   shutdown() instead of deleting it, and the pool goes away once the last
+   buffer has been released.
+
+   The free list is a lock-free stack. release() pushes from any thread, but
+   only the owner pops, so acquire() must not be called from more than one
+   thread at a time; with a single popper a node cannot be popped and pushed
+   back between the read of the head and the exchange, so the stack is free
+   of ABA.
+*/
+class RxBufferPool
+{
+   public:
+      /// @param bufferSize usable bytes in each buffer
+      /// @param maxFree buffers kept for reuse; any beyond that are freed
+      RxBufferPool(size_t bufferSize, size_t maxFree);
+
+      void shutdown();
+
+      char* acquire();
+      static void release(char* buffer);
+
+      size_t getBufferSize() const { return mBufferSize; }
+
+      /// Buffers currently held by SipMessages (or transports), over all pools
+      static size_t getNumInUse() { return sInUse; }
+      /// Buffers kept for reuse, over all pools
+      static size_t getNumFree() { return sFree; }
+
+   private:
+      ~RxBufferPool();
+
+      // Stored in front of each buffer, so that release() can find the pool
+      struct alignas(std::max_align_t) Header
+      {
+         RxBufferPool* mPool;
+         Header* mNext; // while on the free list
+      };
+
+      void unref();
+
+      const size_t mBufferSize;
+      const size_t mMaxFree;
+
+      std::atomic<Header*> mFree;
+      // may briefly exceed mMaxFree while release()s race
+      std::atomic<size_t> mNumFree;
+      // outstanding buffers, plus one until shutdown()
+      std::atomic<size_t> mRefs;
+      std::atomic<bool> mShutdown;
+
+      static std::atomic<size_t> sInUse;
+      static std::atomic<size_t> sFree;
+
+      // disabled
+      RxBufferPool(const RxBufferPool&);
+      RxBufferPool& operator=(const RxBufferPool&);
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -20,7 +20,7 @@ class SendData
          EnableFlowTimer
       };
 
-      SendData() : isAlreadyCompressed(false), command(NoCommand)
+      SendData() : isAlreadyCompressed(false), command(NoCommand), mNext(0)
       {}
 
       SendData(const Tuple& dest,
@@ -33,7 +33,8 @@ class SendData
          transactionId(tid),
          sigcompId(scid),
          isAlreadyCompressed(isCompressed),
-         command(NoCommand)
+         command(NoCommand),
+         mNext(0)
       {
       }
 
@@ -44,13 +45,16 @@ class SendData
          transactionId(Data::Empty),
          sigcompId(Data::Empty),
          isAlreadyCompressed(false),
-         command(NoCommand)
+         command(NoCommand),
+         mNext(0)
       {
       }
 
       SendData* clone() const
       {
-         return new SendData(*this);
+         SendData* copy = new SendData(*this);
+         copy->mNext = 0;
+         return copy;
       }
 
       void clear()
@@ -71,6 +75,98 @@ class SendData
 
       // .bwc. Used for special commands: ie. to close connections, and enable flow timers
       SendDataCommand command;
+
+      /// next element while queued in a SendDataQueue
+      SendData* next() const { return mNext; }
+
+   private:
+      friend class SendDataQueue;
+      SendData* mNext;
+};
+
+/**
+   @internal
+   FIFO of SendData linked through SendData::mNext, so queueing a message
+   on a connection does not allocate. A SendData can be in at most one
+   queue at a time. The queue owns its elements only in the sense that
+   clear() deletes them.
+*/
+class SendDataQueue
+{
+   public:
+      SendDataQueue() : mHead(0), mTail(0), mSize(0)
+      {}
+
+      ~SendDataQueue()
+      {
+         clear();
+      }
+
+      bool empty() const { return mHead == 0; }
+      size_t size() const { return mSize; }
+      SendData* front() const { return mHead; }
+      SendData* back() const { return mTail; }
+
+      void push_back(SendData* sendData)
+      {
+         sendData->mNext = 0;
+         if (mTail)
+         {
+            mTail->mNext = sendData;
+         }
+         else
+         {
+            mHead = sendData;
+         }
+         mTail = sendData;
+         ++mSize;
+      }
+
+      /// unlinks and returns the front element; the caller takes ownership
+      SendData* pop_front()
+      {
+         SendData* sendData = mHead;
+         mHead = sendData->mNext;
+         if (mHead == 0)
+         {
+            mTail = 0;
+         }
+         sendData->mNext = 0;
+         --mSize;
+         return sendData;
+      }
+
+      /// puts replacement in the place of the front element, which is
+      /// unlinked and returned to the caller
+      SendData* replace_front(SendData* replacement)
+      {
+         SendData* old = mHead;
+         replacement->mNext = old->mNext;
+         if (mTail == old)
+         {
+            mTail = replacement;
+         }
+         mHead = replacement;
+         old->mNext = 0;
+         return old;
+      }
+
+      void clear()
+      {
+         while (!empty())
+         {
+            delete pop_front();
+         }
+      }
+
+   private:
+      SendData* mHead;
+      SendData* mTail;
+      size_t mSize;
+
+      // no value semantics
+      SendDataQueue(const SendDataQueue&);
+      SendDataQueue& operator=(const SendDataQueue&);
 };
 
 }
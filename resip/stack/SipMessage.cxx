@@ -18,6 +18,7 @@
 #include "rutil/Random.hxx"
 #include "rutil/ParseBuffer.hxx"
 #include "resip/stack/MsgHeaderScanner.hxx"
+#include "resip/stack/RxBufferPool.hxx"
 //#include "rutil/WinLeakCheck.hxx"  // not compatible with placement new used below
 #include <utility>
 
@@ -111,6 +112,7 @@ SipMessage::clear(bool leaveResponseStuff)
       // !bwc! The "invalid" 0 index.
       mHeaders.push_back(getEmptyHfvl());
       mBufferList.clear();
+      mPooledBufferList.clear();
    }
 
    mUnknownHeaders.clear();
@@ -238,6 +240,11 @@ SipMessage::freeMem(bool leaveResponseStuff)
       {
          delete [] *i;
       }
+      for (vector<char*>::iterator i = mPooledBufferList.begin();
+           i != mPooledBufferList.end(); i++)
+      {
+         RxBufferPool::release(*i);
+      }
    }
 
    if(mStartLine)
@@ -866,6 +873,12 @@ SipMessage::addBuffer(char* buf)
    mBufferList.push_back(buf);
 }
 
+void
+SipMessage::addPooledBuffer(char* buf)
+{
+   mPooledBufferList.push_back(buf);
+}
+
 void 
 SipMessage::setStartLine(const char* st, int len)
 {
@@ -534,6 +534,9 @@ class SipMessage : public TransactionMessage
       Tuple& getDestination() { return mDestination; }
 
       void addBuffer(char* buf);
+      /// Like addBuffer(), for a buffer from an RxBufferPool; it is handed
+      /// back to its pool when the message goes away
+      void addPooledBuffer(char* buf);
 
       uint64_t getCreatedTimeMicroSec() const {return mCreatedTime;}
 
@@ -693,6 +696,8 @@ class SipMessage : public TransactionMessage
       
       // Raw buffers coming from the Transport. message manages the memory
       std::vector<char*> mBufferList;
+      // Same, for buffers that belong to an RxBufferPool
+      std::vector<char*> mPooledBufferList;
 
       // special case for the first line of message
       StartLine* mStartLine;
@@ -230,6 +230,11 @@ SipStack::~SipStack()
    mDnsThread=0;
    delete mTransactionControllerThread;
    mTransactionControllerThread=0;
+   for(std::vector<TransactionControllerThread*>::iterator it = mTransactionShardThreads.begin(); it != mTransactionShardThreads.end(); ++it)
+   {
+      delete *it;
+   }
+   mTransactionShardThreads.clear();
    delete mTransportSelectorThread;
    mTransportSelectorThread=0;
 
@@ -271,11 +276,30 @@ SipStack::run()
    mTransactionControllerThread=new TransactionControllerThread(*mTransactionController);
    mTransactionControllerThread->run();
 
+   for(std::vector<TransactionControllerThread*>::iterator it = mTransactionShardThreads.begin(); it != mTransactionShardThreads.end(); ++it)
+   {
+      delete *it;
+   }
+   mTransactionShardThreads.clear();
+   for(unsigned int i = 1; i < mTransactionController->getShardCount(); ++i)
+   {
+      TransactionControllerThread* thread = new TransactionControllerThread(mTransactionController->getShard(i));
+      thread->run();
+      mTransactionShardThreads.push_back(thread);
+   }
+
    delete mTransportSelectorThread;
    mTransportSelectorThread=new TransportSelectorThread(mTransactionController->transportSelector());
    mTransportSelectorThread->run();
 }
 
+void
+SipStack::setTransactionShards(unsigned int shards)
+{
+   resip_assert(!mInternalThreadsRunning);
+   mTransactionController->setShardCount(shards, mAsyncProcessHandler);
+}
+
 void
 SipStack::shutdown()
 {
@@ -305,6 +329,12 @@ SipStack::shutdownAndJoinThreads()
       mTransactionControllerThread->join();
    }
 
+   for(std::vector<TransactionControllerThread*>::iterator it = mTransactionShardThreads.begin(); it != mTransactionShardThreads.end(); ++it)
+   {
+      (*it)->shutdown();
+      (*it)->join();
+   }
+
    if(mTransportSelectorThread)
    {
       mTransportSelectorThread->shutdown();
@@ -357,7 +387,8 @@ SipStack::addTransport( TransportType protocol,
                         bool useEmailAsSIP,
                         std::shared_ptr<WsConnectionValidator> wsConnectionValidator,
                         std::shared_ptr<WsCookieContextFactory> wsCookieContextFactory,
-                        const Data& netNs)
+                        const Data& netNs,
+                        unsigned int shards)
 {
    resip_assert(!mShuttingDown);
 
@@ -394,6 +425,16 @@ SipStack::addTransport( TransportType protocol,
    }
 #endif
 
+   if(shards > 1)
+   {
+      if(protocol != UDP)
+      {
+         ErrLog(<< "Failed to create transport, sharding is currently only supported for UDP.");
+         throw Transport::Exception("sharding only supported for UDP", __FILE__,__LINE__);
+      }
+      transportFlags |= RESIP_TRANSPORT_FLAG_REUSEPORT | RESIP_TRANSPORT_FLAG_OWNTHREAD;
+   }
+
    InternalTransport* transport=0;
    Fifo<TransactionMessage>& stateMacFifo = mTransactionController->transportSelector().stateMacFifo();
    try
@@ -499,7 +540,38 @@ SipStack::addTransport( TransportType protocol,
              << ": " << e);
       throw;
    }
-   addTransport(std::unique_ptr<Transport>(transport));
+   std::unique_ptr<Transport> first(transport);
+
+   // Additional shards bind to the port the first one ended up with (it may
+   // have been 0).  They are all created before any is added, so that a shard
+   // that fails to bind does not leave part of the group registered.
+   std::vector<std::unique_ptr<UdpTransport> > extraShards;
+   for(unsigned int i = 1; i < shards; ++i)
+   {
+      try
+      {
+         extraShards.emplace_back(new UdpTransport(stateMacFifo, transport->port(), version, stun, ipInterface, mSocketFunc, *mCompression, transportFlags));
+      }
+      catch (BaseException& e)
+      {
+         ErrLog(<< "Failed to create SO_REUSEPORT shard " << i << " of " << shards
+                << " for " << transport->getTuple() << ": " << e);
+         throw;
+      }
+      // so that setRcvBufLen() on the returned transport sizes every shard
+      extraShards.back()->joinShardGroup(*static_cast<UdpTransport*>(transport));
+   }
+
+   addTransport(std::move(first));
+   for(std::vector<std::unique_ptr<UdpTransport> >::iterator it = extraShards.begin(); it != extraShards.end(); ++it)
+   {
+      (*it)->setShardGroupKey(transport->getKey());
+      addTransport(std::move(*it));
+   }
+   if(shards > 1)
+   {
+      InfoLog(<< "Added " << shards << " SO_REUSEPORT shards for " << transport->getTuple());
+   }
    return transport;
 }
 
@@ -513,7 +585,13 @@ SipStack::addTransport(std::unique_ptr<Transport> transport)
                transport->ipVersion(), transport->transport(),
                Data::Empty, // target domain
                transport->netNs());
-   if(!isSecure(transport->transport()))
+   if(transport->getShardGroupKey())
+   {
+      // Additional shard of an already added transport - it shares the tuple,
+      // aliases and port of the first shard, so it only needs a key of its own.
+      transport->setKey(mNextTransportKey++);
+   }
+   else if(!isSecure(transport->transport()))
    {
       if(mNonSecureTransports.count(tuple) == 0)
       {
@@ -550,7 +628,11 @@ SipStack::addTransport(std::unique_ptr<Transport> transport)
       }
    }
 
-   if (!transport->interfaceName().empty())
+   if (transport->getShardGroupKey())
+   {
+      // aliases and port already registered by the first shard
+   }
+   else if (!transport->interfaceName().empty())
    {
       addAlias(transport->interfaceName(), transport->port());
    }
@@ -571,6 +653,7 @@ SipStack::addTransport(std::unique_ptr<Transport> transport)
          ipIfs.pop_back();
       }
    }
+   if (!transport->getShardGroupKey())
    { 
       Lock lock(mPortsMutex);
       mPorts[transport->port()]++;  // add port / increment reference count
@@ -1102,6 +1185,10 @@ SipStack::processTimers()
    if(!mTransactionControllerThread)
    {
       mTransactionController->process();
+      for(unsigned int i = 1; i < mTransactionController->getShardCount(); ++i)
+      {
+         mTransactionController->getShard(i).process();
+      }
    }
 
    if(!mDnsThread)
@@ -1149,6 +1236,10 @@ SipStack::getTimeTillNextProcessMS()
                            INT_MAX : mDnsStub->getTimeTillNextProcessMS());
    unsigned int tcNextProcess = mTransactionControllerThread ? INT_MAX : 
                            mTransactionController->getTimeTillNextProcessMS();
+   for(unsigned int i = 1; !mTransactionControllerThread && i < mTransactionController->getShardCount(); ++i)
+   {
+      tcNextProcess = resipMin(tcNextProcess, mTransactionController->getShard(i).getTimeTillNextProcessMS());
+   }
    unsigned int tsNextProcess = mTransportSelectorThread ? INT_MAX : mTransactionController->transportSelector().getTimeTillNextProcessMS();
 
    return resipMin(Timer::getMaxSystemTimeWaitMs(),
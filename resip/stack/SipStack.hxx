@@ -25,6 +25,7 @@
 
 #include <memory>
 #include <utility>
+#include <vector>
 
 /**
     Let external applications know that this version of the stack
@@ -235,6 +236,17 @@ class SipStack : public FdSetIOObserver
       */
       void run();
 
+      /**
+         @brief Splits the transaction layer into the given number of shards.
+
+         Each shard keeps its own transactions and timers, and is serviced by
+         its own thread once run() is called (or inline by processTimers() if
+         the stack is not running its own threads). Transactions are assigned
+         to a shard by a hash of their branch parameter. Must be called before 
+         the stack is given any cycles.
+      */
+      void setTransactionShards(unsigned int shards);
+
       /** 
          @brief perform orderly shutdown
          @details Inform the transaction state machine processor that it should not
@@ -369,6 +381,13 @@ class SipStack : public FdSetIOObserver
          @param netNs                 Set the network namespace (netns) in which the Transport is
                                       to bind the the given address and port.
 
+         @param shards                Number of transports to open on the same address and port
+                                      (UDP only). When greater than 1, each shard is an SO_REUSEPORT
+                                      socket driven by its own thread, so inbound parsing is spread
+                                      across cores; the TransportSelector treats the group as one
+                                      logical transport and hashes outbound destinations to a shard.
+                                      The first shard is returned; removing it removes the group.
+
       */
       Transport* addTransport(TransportType protocol,
                               int port,
@@ -384,7 +403,8 @@ class SipStack : public FdSetIOObserver
                               bool useEmailAsSIP = false,
                               std::shared_ptr<WsConnectionValidator> = nullptr,
                               std::shared_ptr<WsCookieContextFactory> = nullptr,
-                              const Data& netNs = Data::Empty
+                              const Data& netNs = Data::Empty,
+                              unsigned int shards = 1
                              );
 
       /**
@@ -1013,7 +1033,7 @@ class SipStack : public FdSetIOObserver
       */
       void setFixBadDialogIdentifiers(bool pFixBadDialogIdentifiers) 
       {
-         mTransactionController->mFixBadDialogIdentifiers = pFixBadDialogIdentifiers;
+         mTransactionController->setFixBadDialogIdentifiers(pFixBadDialogIdentifiers);
       }
 
       inline bool getFixBadCSeqNumbers() const
@@ -1206,6 +1226,7 @@ class SipStack : public FdSetIOObserver
       TransactionController* mTransactionController;
 
       TransactionControllerThread* mTransactionControllerThread;
+      std::vector<TransactionControllerThread*> mTransactionShardThreads;
       TransportSelectorThread* mTransportSelectorThread;
       bool mInternalThreadsRunning;
       bool mProcessingHasStarted; 
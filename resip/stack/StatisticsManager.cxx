@@ -2,8 +2,11 @@
 #include "config.h"
 #endif
 
+#include "rutil/Lock.hxx"
 #include "rutil/Logger.hxx"
 #include "resip/stack/StatisticsManager.hxx"
+#include "resip/stack/RxBufferPool.hxx"
+#include "resip/stack/Connection.hxx"
 #include "resip/stack/SipMessage.hxx"
 #include "resip/stack/TransactionController.hxx"
 #include "resip/stack/SipStack.hxx"
@@ -19,7 +22,8 @@ StatisticsManager::StatisticsManager(SipStack& stack, unsigned long intervalSecs
      mInterval(intervalSecs*1000),
      mNextPoll(Timer::getTimeMs() + mInterval),
      mExternalHandler(NULL),
-     mPublicPayload(NULL)
+     mPublicPayload(NULL),
+     mShared(false)
 {}
 
 StatisticsManager::~StatisticsManager()
@@ -44,6 +48,10 @@ StatisticsManager::poll()
    activeTimers = mStack.mTransactionController->getTimerQueueSize();
    activeClientTransactions = mStack.mTransactionController->getNumClientTransactions();
    activeServerTransactions = mStack.mTransactionController->getNumServerTransactions();
+   rxBuffersInUse = (unsigned int)RxBufferPool::getNumInUse();
+   rxBuffersFree = (unsigned int)RxBufferPool::getNumFree();
+   streamWriteCalls = Connection::getNumWriteCalls();
+   streamBytesWritten = Connection::getNumBytesWritten();
 
    // .kw. At last check payload was > 146kB, which seems too large
    // to alloc on stack. Also, the post'd message has reference
@@ -54,7 +62,10 @@ StatisticsManager::poll()
        mPublicPayload = new StatisticsMessage::AtomicPayload;
        // re-used each time, free'd in destructor
    }
-   mPublicPayload->loadIn(*this);
+   {
+      PtrLock lock(mShared ? &mMutex : 0);
+      mPublicPayload->loadIn(*this);
+   }
 
    bool postToStack = true;
    StatisticsMessage msg(*mPublicPayload);
@@ -94,6 +105,7 @@ bool
 StatisticsManager::sent(SipMessage* msg)
 {
    MethodTypes met = msg->method();
+   PtrLock lock(mShared ? &mMutex : 0);
 
    if (msg->isRequest())
    {
@@ -121,6 +133,7 @@ StatisticsManager::retransmitted(MethodTypes met,
                                  bool request, 
                                  unsigned int code)
 {
+   PtrLock lock(mShared ? &mMutex : 0);
    if(request)
    {
       ++requestsRetransmitted;
@@ -135,10 +148,18 @@ StatisticsManager::retransmitted(MethodTypes met,
    return false;
 }
 
+void
+StatisticsManager::zeroOut()
+{
+   PtrLock lock(mShared ? &mMutex : 0);
+   StatisticsMessage::Payload::zeroOut();
+}
+
 bool
 StatisticsManager::received(SipMessage* msg)
 {
    MethodTypes met = msg->header(h_CSeq).method();
+   PtrLock lock(mShared ? &mMutex : 0);
 
    if (msg->isRequest())
    {
@@ -3,6 +3,7 @@
 
 #include "rutil/Timer.hxx"
 #include "rutil/Data.hxx"
+#include "rutil/Mutex.hxx"
 #include "resip/stack/StatisticsMessage.hxx"
 #include "resip/stack/StatisticsHandler.hxx"
 
@@ -52,12 +53,18 @@ class StatisticsManager : public StatisticsMessage::Payload
 
    private:
       friend class TransactionState;
+      friend class TransactionController;
       bool sent(SipMessage* msg);
       bool retransmitted(MethodTypes type, bool request, unsigned int code);
       bool received(SipMessage* msg);
+      void zeroOut();
 
       void poll(); // force an update
 
+      // Set when the transaction layer is split into shards, so that the
+      // counters are updated from more than one thread.
+      void setShared(bool shared) { mShared = shared; }
+
       SipStack& mStack;
       uint64_t mInterval;
       uint64_t mNextPoll;
@@ -69,6 +76,9 @@ class StatisticsManager : public StatisticsMessage::Payload
       // published thru both ExternalHandler and posted to stack as message.
       // This payload is mutex protected.
       StatisticsMessage::AtomicPayload *mPublicPayload;
+
+      bool mShared;
+      Mutex mMutex;
 };
 
 }
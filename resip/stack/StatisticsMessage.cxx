@@ -121,6 +121,10 @@ StatisticsMessage::Payload::zeroOut()
    activeClientTransactions = 0;
    activeServerTransactions = 0;
    pendingDnsQueries = 0;
+   rxBuffersInUse = 0;
+   rxBuffersFree = 0;
+   streamWriteCalls = 0;
+   streamBytesWritten = 0;
    requestsSent = 0;
    responsesSent = 0;
    requestsRetransmitted = 0;
@@ -153,6 +157,10 @@ StatisticsMessage::Payload::operator=(const StatisticsMessage::Payload& rhs)
       activeClientTransactions = rhs.activeClientTransactions;
       activeServerTransactions = rhs.activeServerTransactions;
       pendingDnsQueries = rhs.pendingDnsQueries;
+      rxBuffersInUse = rhs.rxBuffersInUse;
+      rxBuffersFree = rhs.rxBuffersFree;
+      streamWriteCalls = rhs.streamWriteCalls;
+      streamBytesWritten = rhs.streamBytesWritten;
 
       requestsSent = rhs.requestsSent;
       responsesSent = rhs.responsesSent;
@@ -220,6 +228,9 @@ resip::operator<<(EncodeStream& strm, const StatisticsMessage::Payload& stats)
         << " CLIENTTX " << stats.activeClientTransactions
         << " SERVERTX " << stats.activeServerTransactions
         << " TIMERS " << stats.activeTimers
+        << " RXBUF " << stats.rxBuffersInUse << "/" << stats.rxBuffersFree
+        << " STREAMTX " << stats.streamWriteCalls << " writes "
+        << (stats.streamWriteCalls ? stats.streamBytesWritten / stats.streamWriteCalls : 0) << " bytes/write"
         << std::endl
         << "Transaction summary: reqi " << stats.requestsReceived
         << " reqo " << stats.requestsSent
@@ -35,6 +35,10 @@ class StatisticsMessage : public ApplicationMessage
             unsigned int activeClientTransactions;
             unsigned int activeServerTransactions;
             unsigned int pendingDnsQueries; // .dlb. not implemented
+            unsigned int rxBuffersInUse; // pooled datagram buffers, process wide
+            unsigned int rxBuffersFree;
+            uint64_t streamWriteCalls; // TCP/TLS writes, process wide
+            uint64_t streamBytesWritten;
 
             unsigned int requestsSent; // includes retransmissions
             unsigned int responsesSent; // includes retransmissions
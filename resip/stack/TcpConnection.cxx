@@ -7,6 +7,10 @@
 #include "resip/stack/TcpConnection.hxx"
 #include "resip/stack/Tuple.hxx"
 
+#if !defined(WIN32)
+#include <sys/uio.h>
+#endif
+
 using namespace resip;
 
 #define RESIPROCATE_SUBSYSTEM Subsystem::TRANSPORT
@@ -108,6 +112,49 @@ TcpConnection::write( const char* buf, const int count )
    return bytesWritten;
 }
 
+int
+TcpConnection::gatherWrite(const WriteSegment* segments, int count)
+{
+   resip_assert(count > 0 && count <= MaxWriteSegments);
+   if (count == 1)
+   {
+      return write(segments[0].buffer, segments[0].count);
+   }
+
+#if defined(WIN32)
+   WSABUF wsaBufs[MaxWriteSegments];
+   for (int i = 0; i < count; ++i)
+   {
+      wsaBufs[i].buf = const_cast<char*>(segments[i].buffer);
+      wsaBufs[i].len = (ULONG)segments[i].count;
+   }
+   DWORD sent = 0;
+   int bytesWritten = (::WSASend(getSocket(), wsaBufs, (DWORD)count, &sent, 0, 0, 0) == 0) ? (int)sent : INVALID_SOCKET;
+#else
+   struct iovec iov[MaxWriteSegments];
+   for (int i = 0; i < count; ++i)
+   {
+      iov[i].iov_base = const_cast<char*>(segments[i].buffer);
+      iov[i].iov_len = (size_t)segments[i].count;
+   }
+   int bytesWritten = (int)::writev(getSocket(), iov, count);
+#endif
+
+   if (bytesWritten == INVALID_SOCKET)
+   {
+      int e = getErrno();
+      if (e == EAGAIN || e == EWOULDBLOCK)
+      {
+          return 0;
+      }
+      InfoLog (<< "Failed writev on " << getSocket() << " " << strerror(e));
+      Transport::error(e);
+      return -1;
+   }
+
+   return bytesWritten;
+}
+
 bool 
 TcpConnection::hasDataToRead()
 {
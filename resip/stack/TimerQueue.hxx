@@ -14,10 +14,7 @@
 #include "rutil/Fifo.hxx"
 #include "rutil/TimeLimitFifo.hxx"
 #include "rutil/Timer.hxx"
-
-// .dlb. 
-// to do: timer wheel for transaction-bound timers and a heap for
-// everything longer.
+#include "resip/stack/TimerWheel.hxx"
 
 namespace resip
 {
@@ -26,19 +23,42 @@ class Message;
 class TransactionMessage;
 class TuSelector;
 
+/**
+   @internal
+   @brief Settings shared by every TimerQueue.
+*/
+class TimerQueueBase
+{
+   public:
+      /// When true, TimerQueues constructed afterwards keep their timers in a
+      /// hierarchical timing wheel (O(1) add and cancel) rather than a binary
+      /// heap. Set this before creating the SipStack.
+      static bool UseTimerWheel;
+};
+
 /**
   * @internal
   * @brief This class takes a fifo as a place to where you can write your stuff.
   * When using this in the main loop, call process() on this.
   * During Transaction processing, TimerMessages and SIP messages are generated.
-  * 
-    @todo .dlb. timer wheel for transaction-bound timers and a heap for 
-      everything longer.
+  *
+  * Timers are kept either in a binary heap, or (if 
+  * TimerQueueBase::UseTimerWheel was set when the queue was created) in a
+  * TimerWheel. Only the wheel can cancel a timer; with the heap, cancel() is
+  * a no-op and the timer fires as usual.
   */
 template <class T>
-class TimerQueue
+class TimerQueue : public TimerQueueBase
 {
    public:
+      /// Handle returned when a timer is added; 0 is never a valid handle.
+      typedef typename TimerWheel<T>::Id Id;
+
+      TimerQueue() :
+         mWheel(UseTimerWheel ? new TimerWheel<T>(Timer::getTimeMs()) : 0)
+      {
+      }
+
       // This is the logic that runs when a timer goes off. This is the only
       // thing subclasses must implement.
       virtual void processTimer(const T& timer)=0;
@@ -52,6 +72,7 @@ class TimerQueue
          {
             mTimers.pop();
          }
+         delete mWheel;
       }
 
       /// @brief provides the time in milliseconds before the next timer will fire
@@ -61,9 +82,9 @@ class TimerQueue
       ///
       unsigned int msTillNextTimer()
       {
-         if (!mTimers.empty())
+         if (!empty())
          {
-            uint64_t next = mTimers.top().getWhen();
+            uint64_t next = nextWhen();
             uint64_t now = Timer::getTimeMs();
             if (now > next) 
             {
@@ -93,6 +114,20 @@ class TimerQueue
       /// machine fifo and application messages into the TU fifo
       virtual uint64_t process()
       {
+         if (mWheel)
+         {
+            if (!mWheel->empty())
+            {
+               mWheel->process(Timer::getTimeMs(), 
+                               [this](const T& timer) { processTimer(timer); });
+               if (!mWheel->empty())
+               {
+                  return mWheel->nextTick();
+               }
+            }
+            return 0;
+         }
+
          if (!mTimers.empty())
          {
             uint64_t now=Timer::getTimeMs();
@@ -110,22 +145,29 @@ class TimerQueue
          return 0;
       }
 
+      /// @brief removes a timer that has not fired yet
+      /// @retval true if the timer was removed; always false with the heap
+      bool cancel(Id id)
+      {
+         return mWheel ? mWheel->cancel(id) : false;
+      }
+
       int size() const
       {
-         return (int)mTimers.size();
+         return mWheel ? (int)mWheel->size() : (int)mTimers.size();
       }
 
       bool empty() const
       {
-         return mTimers.empty();
+         return mWheel ? mWheel->empty() : mTimers.empty();
       }
 
       std::ostream& encode(std::ostream& str) const
       {
-         if(mTimers.size() > 0)
+         if(size() > 0)
          {
-            return str << "TimerQueue[ size =" << mTimers.size() 
-                       << " top=" << mTimers.top() << "]" ;
+            return str << "TimerQueue[ size =" << size() 
+                       << " top=" << top() << "]" ;
          }
          else
          {
@@ -136,10 +178,10 @@ class TimerQueue
 #ifndef RESIP_USE_STL_STREAMS
       EncodeStream& encode(EncodeStream& str) const
       {
-         if(mTimers.size() > 0)
+         if(size() > 0)
          {
-            return str << "TimerQueue[ size =" << mTimers.size() 
-                       << " top=" << mTimers.top() << "]" ;
+            return str << "TimerQueue[ size =" << size() 
+                       << " top=" << top() << "]" ;
          }
          else
          {
@@ -149,8 +191,52 @@ class TimerQueue
 #endif
 
    protected:
+      /// @return handle that can be passed to cancel()
+      Id push(const T& timer)
+      {
+         if (mWheel)
+         {
+            return mWheel->add(timer);
+         }
+         mTimers.push(timer);
+         return 0;
+      }
+
+      /// @brief the timer that will fire next; the queue must not be empty
+      const T& top() const
+      {
+         return mWheel ? mWheel->next() : mTimers.top();
+      }
+
+      /// @brief absolute time of the next timer; the queue must not be empty
+      uint64_t nextWhen()
+      {
+         return mWheel ? mWheel->nextTick() : mTimers.top().getWhen();
+      }
+
+      /// @brief removes every pending timer, handing each one to discard first
+      template <class Discard>
+      void clear(Discard discard)
+      {
+         if (mWheel)
+         {
+            mWheel->clear(discard);
+         }
+         while (!mTimers.empty())
+         {
+            discard(mTimers.top());
+            mTimers.pop();
+         }
+      }
+
+   private:
       typedef std::vector<T, std::allocator<T> > TimerVector;
       std::priority_queue<T, TimerVector, std::greater<T> > mTimers;
+      TimerWheel<T>* mWheel;
+
+      // disabled
+      TimerQueue(const TimerQueue&);
+      TimerQueue& operator=(const TimerQueue&);
 };
 
 /**
@@ -160,7 +246,8 @@ class BaseTimeLimitTimerQueue : public TimerQueue<TimerWithPayload>
 {
    public:
       ~BaseTimeLimitTimerQueue();
-      uint64_t add(unsigned int timeMs,Message* payload);
+      /// @return handle that can be passed to cancel()
+      Id add(unsigned int timeMs,Message* payload);
       virtual void processTimer(const TimerWithPayload& timer);
    protected:
       virtual void addToFifo(Message*, TimeLimitFifo<Message>::DepthUsage)=0;      
@@ -189,7 +276,8 @@ class TuSelectorTimerQueue : public TimerQueue<TimerWithPayload>
    public:
       TuSelectorTimerQueue(TuSelector& sel);
       ~TuSelectorTimerQueue();
-      uint64_t add(unsigned int timeMs,Message* payload);
+      /// @return handle that can be passed to cancel()
+      Id add(unsigned int timeMs,Message* payload);
       virtual void processTimer(const TimerWithPayload& timer);
    private:
       TuSelector& mFifoSelector;
@@ -203,7 +291,8 @@ class TransactionTimerQueue : public TimerQueue<TransactionTimer>
 {
    public:
       TransactionTimerQueue(Fifo<TimerMessage>& fifo);
-      uint64_t add(Timer::Type type, const Data& transactionId, unsigned long msOffset);
+      /// @return handle that can be passed to cancel()
+      Id add(Timer::Type type, const Data& transactionId, unsigned long msOffset);
       virtual void processTimer(const TransactionTimer& timer);
    private:
       Fifo<TimerMessage>& mFifo;
@@ -221,7 +310,8 @@ class DtlsTimerQueue : public TimerQueue<TimerWithPayload>
    public:
       DtlsTimerQueue(Fifo<DtlsMessage>& fifo);
       ~DtlsTimerQueue();
-      uint64_t add(SSL *, unsigned long msOffset);
+      /// @return handle that can be passed to cancel()
+      Id add(SSL *, unsigned long msOffset);
       virtual void processTimer(const TimerWithPayload& timer) ;
       
    private:
@@ -0,0 +1,465 @@
+#if !defined(RESIP_TIMERWHEEL_HXX)
+#define RESIP_TIMERWHEEL_HXX
+
+#include <deque>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include "rutil/compat.hxx"
+#include "rutil/ResipAssert.h"
+
+namespace resip
+{
+
+/**
+  * @internal
+  * @brief Hierarchical timing wheel with a resolution of one millisecond.
+  *
+  * Level 0 has one slot per millisecond for the next 256ms; each of the four
+  * levels above it has 64 slots covering 64 times the range of the level below
+  * (so about 49 days in total; anything further out is parked in the last
+  * level and re-filed when that slot comes around). When level 0 wraps, the
+  * next slot of level 1 is redistributed into the lower levels, and so on up.
+  *
+  * Adding and cancelling a timer are O(1). Each add() returns an Id that stays
+  * unique for the life of the wheel; cancelling an Id whose timer has already
+  * fired (or been cancelled) is a harmless no-op.
+  *
+  * T must provide getWhen(), returning the absolute expiry in ms.
+  */
+template <class T>
+class TimerWheel
+{
+   public:
+      typedef uint64_t Id;
+
+      explicit TimerWheel(uint64_t now) :
+         mCurrent(now),
+         mCount(0),
+         mNextTick(0),
+         mNextTickValid(false)
+      {
+         for(unsigned int level = 0; level < Levels; ++level)
+         {
+            mLevelCount[level] = 0;
+            for(unsigned int slot = 0; slot < Level0Slots; ++slot)
+            {
+               mSlots[level][slot] = 0;
+            }
+         }
+      }
+
+      ~TimerWheel()
+      {
+         clear(&TimerWheel::ignore);
+      }
+
+      Id add(const T& timer)
+      {
+         Node* node = allocate();
+         new (&node->mStorage) T(timer);
+         // Timers that are already due fire on the next call to process()
+         node->mTick = timer.getWhen() < mCurrent ? mCurrent : timer.getWhen();
+         link(node);
+         ++mCount;
+         if(mNextTickValid && node->mTick < mNextTick)
+         {
+            mNextTick = node->mTick;
+         }
+         return (Id(node->mGeneration) << 32) | node->mIndex;
+      }
+
+      /// @retval true if the timer was pending, and has been removed
+      bool cancel(Id id)
+      {
+         Node* node = find(id);
+         if(!node || node->mLevel == Unlinked)
+         {
+            return false;
+         }
+         if(mNextTickValid && node->mTick == mNextTick)
+         {
+            mNextTickValid = false;
+         }
+         unlink(node);
+         --mCount;
+         release(node);
+         return true;
+      }
+
+      /// Fires (in order) every timer that is due at now.
+      template <class Expire>
+      void process(uint64_t now, Expire expire)
+      {
+         while(mCurrent <= now)
+         {
+            if(mCount == 0)
+            {
+               mCurrent = now + 1;
+               break;
+            }
+
+            unsigned int index = (unsigned int)(mCurrent & Level0Mask);
+            if(index == 0)
+            {
+               cascade();
+            }
+            else if(mLevelCount[0] == 0)
+            {
+               // Nothing can fire before the lowest non-empty level cascades
+               unsigned int level = 1;
+               while(mLevelCount[level] == 0)
+               {
+                  ++level;
+               }
+               uint64_t boundary = (mCurrent | ((uint64_t(1) << shift(level)) - 1)) + 1;
+               mCurrent = boundary > now ? now + 1 : boundary;
+               continue;
+            }
+
+            Node* node;
+            while((node = mSlots[0][index]) != 0)
+            {
+               resip_assert(node->mTick == mCurrent);
+               unlink(node);
+               --mCount;
+               mNextTickValid = false;
+               expire(node->timer());
+               release(node);
+            }
+            ++mCurrent;
+         }
+      }
+
+      /// @brief absolute time (ms) of the earliest timer; the wheel must not
+      /// be empty
+      uint64_t nextTick()
+      {
+         if(!mNextTickValid)
+         {
+            mNextTick = findNext()->mTick;
+            mNextTickValid = true;
+         }
+         return mNextTick;
+      }
+
+      /// @brief the earliest timer; the wheel must not be empty
+      const T& next() const
+      {
+         return findNext()->timer();
+      }
+
+      size_t size() const
+      {
+         return mCount;
+      }
+
+      bool empty() const
+      {
+         return mCount == 0;
+      }
+
+      /// Removes every pending timer, handing each one to discard first.
+      template <class Discard>
+      void clear(Discard discard)
+      {
+         for(unsigned int level = 0; level < Levels; ++level)
+         {
+            for(unsigned int slot = 0; slot < Level0Slots; ++slot)
+            {
+               Node* node;
+               while((node = mSlots[level][slot]) != 0)
+               {
+                  unlink(node);
+                  discard(node->timer());
+                  release(node);
+               }
+            }
+         }
+         mCount = 0;
+         mNextTickValid = false;
+      }
+
+   private:
+      static const unsigned int Levels = 5;
+      static const unsigned int Level0Bits = 8;
+      static const unsigned int LevelNBits = 6;
+      static const unsigned int Level0Slots = 1 << Level0Bits;
+      static const unsigned int LevelNSlots = 1 << LevelNBits;
+      static const uint64_t Level0Mask = Level0Slots - 1;
+      static const uint64_t LevelNMask = LevelNSlots - 1;
+      static const uint64_t MaxDelta = 0xffffffffULL;
+      static const unsigned char Unlinked = 0xff;
+
+      struct Node
+      {
+         Node() : mPrev(0), mNext(0), mTick(0), mGeneration(1), mIndex(0),
+                  mLevel(Unlinked), mSlot(0), mUsed(false) {}
+
+         T& timer() { return *reinterpret_cast<T*>(&mStorage); }
+         const T& timer() const { return *reinterpret_cast<const T*>(&mStorage); }
+
+         Node* mPrev;
+         Node* mNext;
+         uint64_t mTick;
+         uint32_t mGeneration;
+         uint32_t mIndex;
+         unsigned char mLevel;
+         unsigned char mSlot;
+         bool mUsed;
+         typename std::aligned_storage<sizeof(T), alignof(T)>::type mStorage;
+      };
+
+      static void ignore(const T&) {}
+
+      static unsigned int shift(unsigned int level)
+      {
+         return level == 0 ? 0 : Level0Bits + (level - 1) * LevelNBits;
+      }
+
+      static unsigned int slotIndex(unsigned int level, uint64_t tick)
+      {
+         return (unsigned int)((tick >> shift(level)) & (level == 0 ? Level0Mask : LevelNMask));
+      }
+
+      void link(Node* node)
+      {
+         uint64_t tick = node->mTick;
+         uint64_t delta = tick - mCurrent;
+         unsigned int level = 0;
+         while(level < Levels - 1 && delta >= (uint64_t(1) << shift(level + 1)))
+         {
+            ++level;
+         }
+         if(delta > MaxDelta)
+         {
+            // Park it in the last level; it is re-filed when that slot cascades
+            tick = mCurrent + MaxDelta;
+         }
+
+         unsigned int slot = slotIndex(level, tick);
+         node->mLevel = (unsigned char)level;
+         node->mSlot = (unsigned char)slot;
+         node->mPrev = 0;
+         node->mNext = mSlots[level][slot];
+         if(node->mNext)
+         {
+            node->mNext->mPrev = node;
+         }
+         mSlots[level][slot] = node;
+         ++mLevelCount[level];
+      }
+
+      void unlink(Node* node)
+      {
+         resip_assert(node->mLevel != Unlinked);
+         if(node->mPrev)
+         {
+            node->mPrev->mNext = node->mNext;
+         }
+         else
+         {
+            mSlots[node->mLevel][node->mSlot] = node->mNext;
+         }
+         if(node->mNext)
+         {
+            node->mNext->mPrev = node->mPrev;
+         }
+         --mLevelCount[node->mLevel];
+         node->mPrev = node->mNext = 0;
+         node->mLevel = Unlinked;
+      }
+
+      // Called when the level 0 index wraps to 0; files the timers of the
+      // slot that has just come due in each level that wrapped.
+      void cascade()
+      {
+         for(unsigned int level = 1; level < Levels; ++level)
+         {
+            unsigned int index = slotIndex(level, mCurrent);
+            Node* node = mSlots[level][index];
+            mSlots[level][index] = 0;
+            while(node)
+            {
+               Node* next = node->mNext;
+               --mLevelCount[level];
+               link(node);
+               node = next;
+            }
+            if(index != 0)
+            {
+               break;
+            }
+         }
+      }
+
+      const Node* findNext() const
+      {
+         resip_assert(mCount);
+         const Node* best = 0;
+         if(mLevelCount[0])
+         {
+            // Level 0 slots hold exactly one tick each
+            for(uint64_t tick = mCurrent; ; ++tick)
+            {
+               if(mSlots[0][tick & Level0Mask])
+               {
+                  best = mSlots[0][tick & Level0Mask];
+                  break;
+               }
+            }
+         }
+
+         // A higher level may still hold a timer that is due sooner, since
+         // timers are only re-filed when their slot cascades.
+         for(unsigned int level = 1; level < Levels; ++level)
+         {
+            if(mLevelCount[level] == 0)
+            {
+               continue;
+            }
+            // The current slot has normally been cascaded already, unless we
+            // are sitting right on its boundary.
+            unsigned int current = slotIndex(level, mCurrent);
+            unsigned int first = (mCurrent & ((uint64_t(1) << shift(level)) - 1)) == 0 ? 0 : 1;
+            for(unsigned int i = first; i <= LevelNSlots; ++i)
+            {
+               const Node* node = mSlots[level][(current + i) & LevelNMask];
+               if(node)
+               {
+                  for(; node; node = node->mNext)
+                  {
+                     if(!best || node->mTick < best->mTick)
+                     {
+                        best = node;
+                     }
+                  }
+                  // Parked timers may make a later slot of the last level
+                  // hold an earlier timer, so that one is scanned in full
+                  if(level < Levels - 1)
+                  {
+                     break;
+                  }
+               }
+            }
+         }
+         return best;
+      }
+
+      Node* allocate()
+      {
+         Node* node;
+         if(mFree.empty())
+         {
+            mNodes.emplace_back();
+            node = &mNodes.back();
+            node->mIndex = (uint32_t)(mNodes.size() - 1);
+         }
+         else
+         {
+            node = mFree.back();
+            mFree.pop_back();
+         }
+         node->mUsed = true;
+         return node;
+      }
+
+      void release(Node* node)
+      {
+         node->timer().~T();
+         node->mUsed = false;
+         if(++node->mGeneration == 0)
+         {
+            node->mGeneration = 1;
+         }
+         mFree.push_back(node);
+      }
+
+      Node* find(Id id)
+      {
+         uint32_t index = (uint32_t)(id & 0xffffffff);
+         if(index >= mNodes.size())
+         {
+            return 0;
+         }
+         Node* node = &mNodes[index];
+         if(!node->mUsed || node->mGeneration != (uint32_t)(id >> 32))
+         {
+            return 0;
+         }
+         return node;
+      }
+
+      // Every tick before this one has been processed
+      uint64_t mCurrent;
+      size_t mCount;
+      uint64_t mNextTick;
+      bool mNextTickValid;
+
+      // Level 0 uses all Level0Slots; the other levels only the first LevelNSlots
+      Node* mSlots[Levels][Level0Slots];
+      size_t mLevelCount[Levels];
+
+      // Node storage; a deque so nodes never move once allocated
+      std::deque<Node> mNodes;
+      std::vector<Node*> mFree;
+
+      // disabled
+      TimerWheel(const TimerWheel&);
+      TimerWheel& operator=(const TimerWheel&);
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
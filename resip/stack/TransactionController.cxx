@@ -11,6 +11,9 @@
 #include "resip/stack/TerminateFlow.hxx"
 #include "resip/stack/EnableFlowTimer.hxx"
 #include "resip/stack/InvokeAfterSocketCreationFunc.hxx"
+#include "resip/stack/KeepAliveMessage.hxx"
+#include "resip/stack/TcpConnectState.hxx"
+#include "resip/stack/TransportFailure.hxx"
 #include "resip/stack/ZeroOutStatistics.hxx"
 #include "resip/stack/PollStatistics.hxx"
 #include "resip/stack/ShutdownMessage.hxx"
@@ -48,25 +51,60 @@ TransactionController::TransactionController(SipStack& stack,
    mStateMacFifoOutBuffer(mStateMacFifo),
    mCongestionManager(0),
    mTuSelector(stack.mTuSelector),
-   mTransportSelector(mStateMacFifo,
-                      stack.getSecurity(),
-                      stack.getDnsStub(),
-                      stack.getCompression(),
-                      useDnsVip),
+   mOwnedTransportSelector(new TransportSelector(mStateMacFifo,
+                                                 stack.getSecurity(),
+                                                 stack.getDnsStub(),
+                                                 stack.getCompression(),
+                                                 useDnsVip)),
+   mTransportSelector(*mOwnedTransportSelector),
    mTimers(mTimerFifo),
    mShuttingDown(false),
    mStatsManager(stack.mStatsManager),
-   mHostname(DnsUtil::getLocalHostName())
+   mHostname(DnsUtil::getLocalHostName()),
+   mPrimary(0),
+   mClientTransactionCount(0),
+   mServerTransactionCount(0),
+   mTimerCount(0)
 {
    mStateMacFifo.setDescription("TransactionController::mStateMacFifo");
 }
 
+TransactionController::TransactionController(TransactionController& primary,
+                                             AsyncProcessHandler* handler) :
+   mStack(primary.mStack),
+   mDiscardStrayResponses(primary.mDiscardStrayResponses),
+   mFixBadDialogIdentifiers(primary.mFixBadDialogIdentifiers),
+   mFixBadCSeqNumbers(primary.mFixBadCSeqNumbers),
+   mStateMacFifo(handler),
+   mStateMacFifoOutBuffer(mStateMacFifo),
+   mCongestionManager(0),
+   mTuSelector(primary.mTuSelector),
+   mTransportSelector(primary.mTransportSelector),
+   mTimers(mTimerFifo),
+   mShuttingDown(false),
+   mStatsManager(primary.mStatsManager),
+   mHostname(primary.mHostname),
+   mPrimary(&primary),
+   mClientTransactionCount(0),
+   mServerTransactionCount(0),
+   mTimerCount(0)
+{
+   // Same description as shard 0, so that a CongestionManager treats every
+   // shard's fifo alike
+   mStateMacFifo.setDescription("TransactionController::mStateMacFifo");
+}
+
 #if defined(WIN32) && !defined(__GNUC__)
 #pragma warning( default : 4355 )
 #endif
 
 TransactionController::~TransactionController()
 {
+   for(std::vector<TransactionController*>::iterator it = mShards.begin(); it != mShards.end(); ++it)
+   {
+      delete *it;
+   }
+
    if(mClientTransactionMap.size())
    {
       WarningLog(<< "On shutdown, there are Client TransactionStates remaining!");
@@ -89,17 +127,158 @@ void
 TransactionController::shutdown()
 {
    mShuttingDown = true;
+   for(std::vector<TransactionController*>::iterator it = mShards.begin(); it != mShards.end(); ++it)
+   {
+      (*it)->mShuttingDown = true;
+   }
    mTransportSelector.shutdown();
 }
 
+void
+TransactionController::setShardCount(unsigned int count, AsyncProcessHandler* handler)
+{
+   resip_assert(!mPrimary);
+   resip_assert(mShards.empty());
+   if(count <= 1)
+   {
+      return;
+   }
+
+   for(unsigned int i = 1; i < count; ++i)
+   {
+      mShards.push_back(new TransactionController(*this, handler));
+      if(mCongestionManager)
+      {
+         mShards.back()->setCongestionManager(mCongestionManager);
+      }
+   }
+   mTransportSelector.setShared(true);
+   mStatsManager.setShared(true);
+   InfoLog(<< "Transaction layer split into " << count << " shards");
+}
+
+void
+TransactionController::setCongestionManager(CongestionManager* manager)
+{
+   if(!mPrimary)
+   {
+      // shared by all shards
+      mTransportSelector.setCongestionManager(manager);
+   }
+   if(mCongestionManager)
+   {
+      mCongestionManager->unregisterFifo(&mStateMacFifo);
+   }
+   mCongestionManager=manager;
+   if(mCongestionManager)
+   {
+      mCongestionManager->registerFifo(&mStateMacFifo);
+   }
+   for(std::vector<TransactionController*>::iterator it = mShards.begin(); it != mShards.end(); ++it)
+   {
+      (*it)->setCongestionManager(manager);
+   }
+}
+
+CongestionManager::RejectionBehavior
+TransactionController::getShardRejectionBehavior() const
+{
+   if(mCongestionManager)
+   {
+      return mCongestionManager->getRejectionBehavior(&mStateMacFifo);
+   }
+   return CongestionManager::NORMAL;
+}
+
+CongestionManager::RejectionBehavior
+TransactionController::getRejectionBehavior() const
+{
+   CongestionManager::RejectionBehavior behavior = getShardRejectionBehavior();
+   for(std::vector<TransactionController*>::const_iterator it = mShards.begin(); it != mShards.end(); ++it)
+   {
+      behavior = resipMax(behavior, (*it)->getShardRejectionBehavior());
+   }
+   return behavior;
+}
+
+TransactionController&
+TransactionController::getShard(unsigned int index)
+{
+   if(index == 0)
+   {
+      return *this;
+   }
+   resip_assert(index <= mShards.size());
+   return *mShards[index-1];
+}
+
+unsigned int
+TransactionController::shardIndex(const Data& tid) const
+{
+   // CANCEL transactions use the tid of the INVITE with "cancel" appended;
+   // strip it so that they end up in the same shard as the INVITE.
+   static const Data cancel("cancel");
+   Data::size_type size = tid.size();
+   while(size >= cancel.size() &&
+         isEqualNoCase(Data(Data::Share, tid.data() + size - cancel.size(), cancel.size()), cancel))
+   {
+      size -= cancel.size();
+   }
+   return (unsigned int)(Data(Data::Share, tid.data(), size).caseInsensitiveTokenHash() % (mShards.size() + 1));
+}
+
+unsigned int
+TransactionController::shardIndex(TransactionMessage* message) const
+{
+   // Only messages that belong to a transaction are handed off; transport
+   // management, statistics and keepalives stay in shard 0.
+   if(dynamic_cast<SipMessage*>(message))
+   {
+      if(dynamic_cast<KeepAliveMessage*>(message))
+      {
+         return 0;
+      }
+   }
+   else if(!dynamic_cast<TransportFailure*>(message) &&
+           !dynamic_cast<TcpConnectState*>(message) &&
+           !dynamic_cast<AbandonServerTransaction*>(message) &&
+           !dynamic_cast<CancelClientInviteTransaction*>(message))
+   {
+      return 0;
+   }
+
+   try
+   {
+      return shardIndex(message->getTransactionId());
+   }
+   catch(resip::BaseException&)
+   {
+      // Shard 0 will drop it
+      return 0;
+   }
+}
+
+void
+TransactionController::sendToShard(TransactionMessage* message, const Data& tid)
+{
+   if(mShards.empty())
+   {
+      mStateMacFifo.add(message);
+      return;
+   }
+   getShard(shardIndex(tid)).mStateMacFifo.add(message);
+}
+
 void
 TransactionController::process(int timeout)
 {
    if (mShuttingDown && 
+       !mPrimary &&
        //mTimers.empty() && 
        !mStateMacFifoOutBuffer.messageAvailable() && // !dcm! -- see below 
        !mStack.mTUFifo.messageAvailable() &&
-       mTransportSelector.isFinished())
+       mTransportSelector.isFinished() &&
+       getTransactionFifoSize() == mStateMacFifo.size()) // shards are idle
 // !dcm! -- why would one wait for the Tu's fifo to be empty before delivering a
 // shutdown message?
    {
@@ -118,7 +297,7 @@ TransactionController::process(int timeout)
 
       // Check if Statistics Manager needs to be polled - note:  all statistic manager polls should happen from the 
       // TransactionController thread / process loop
-      if(mStack.mStatisticsManagerEnabled)
+      if(!mPrimary && mStack.mStatisticsManagerEnabled)
       {
          mStatsManager.process();
       }
@@ -150,7 +329,16 @@ TransactionController::process(int timeout)
          int runs=16;
          while(message)
          {
-            TransactionState::process(*this, message);
+            unsigned int shard = mShards.empty() ? 0 : shardIndex(message);
+            if(shard == 0)
+            {
+               TransactionState::process(*this, message);
+            }
+            else
+            {
+               // Belongs to a transaction handled by another shard
+               mShards[shard-1]->mStateMacFifo.add(message);
+            }
             if(--runs==0)
             {
                break;
@@ -161,6 +349,13 @@ TransactionController::process(int timeout)
          mTransportSelector.poke();
       }
    }
+
+   if(mPrimary)
+   {
+      mClientTransactionCount.store(mClientTransactionMap.size(), std::memory_order_relaxed);
+      mServerTransactionCount.store(mServerTransactionMap.size(), std::memory_order_relaxed);
+      mTimerCount.store(mTimers.size(), std::memory_order_relaxed);
+   }
 }
 
 unsigned int 
@@ -176,19 +371,35 @@ TransactionController::getTimeTillNextProcessMS()
 void
 TransactionController::send(SipMessage* msg)
 {
+   // Hand the message straight to its shard, rather than bouncing it
+   // through shard 0; messages without a usable tid stay in shard 0, which
+   // drops them.
+   TransactionController* shard = this;
+   if(!mShards.empty())
+   {
+      try
+      {
+         shard = &getShard(shardIndex(msg->getTransactionId()));
+      }
+      catch(resip::BaseException&)
+      {
+      }
+   }
+
    if(msg->isRequest() && 
       msg->method() != ACK && 
-      getRejectionBehavior()!=CongestionManager::NORMAL)
+      shard->getShardRejectionBehavior()!=CongestionManager::NORMAL)
    {
       // Need to 503 this.
       SipMessage* resp(Helper::makeResponse(*msg, 503));
-      resp->header(h_RetryAfter).value()=(uint32_t)mStateMacFifo.expectedWaitTimeMilliSec()/1000;
+      resp->header(h_RetryAfter).value()=(uint32_t)shard->mStateMacFifo.expectedWaitTimeMilliSec()/1000;
       resp->setTransactionUser(msg->getTransactionUser());
       mTuSelector.add(resp, TimeLimitFifo<Message>::InternalElement);
       delete msg;
       return;
    }
-   mStateMacFifo.add(msg);
+
+   shard->mStateMacFifo.add(msg);
 }
 
 
@@ -209,25 +420,45 @@ TransactionController::getTransactionFifoSize() const
 {
    // Should we include the stuff in mStateMacFifoOutBuffer here too? This is
    // likely to be called from other threads...
-   return mStateMacFifo.size();
+   unsigned int size = mStateMacFifo.size();
+   for(std::vector<TransactionController*>::const_iterator it = mShards.begin(); it != mShards.end(); ++it)
+   {
+      size += (*it)->mStateMacFifo.size();
+   }
+   return size;
 }
 
 unsigned int 
 TransactionController::getNumClientTransactions() const
 {
-   return mClientTransactionMap.size();
+   unsigned int size = mClientTransactionMap.size();
+   for(std::vector<TransactionController*>::const_iterator it = mShards.begin(); it != mShards.end(); ++it)
+   {
+      size += (*it)->mClientTransactionCount.load(std::memory_order_relaxed);
+   }
+   return size;
 }
 
 unsigned int 
 TransactionController::getNumServerTransactions() const
 {
-   return mServerTransactionMap.size();
+   unsigned int size = mServerTransactionMap.size();
+   for(std::vector<TransactionController*>::const_iterator it = mShards.begin(); it != mShards.end(); ++it)
+   {
+      size += (*it)->mServerTransactionCount.load(std::memory_order_relaxed);
+   }
+   return size;
 }
 
 unsigned int 
 TransactionController::getTimerQueueSize() const
 {
-   return mTimers.size();
+   unsigned int size = mTimers.size();
+   for(std::vector<TransactionController*>::const_iterator it = mShards.begin(); it != mShards.end(); ++it)
+   {
+      size += (*it)->mTimerCount.load(std::memory_order_relaxed);
+   }
+   return size;
 }
 
 void 
@@ -256,13 +487,13 @@ void TransactionController::unregisterMarkListener(MarkListener* listener)
 void 
 TransactionController::abandonServerTransaction(const Data& tid)
 {
-   mStateMacFifo.add(new AbandonServerTransaction(tid));
+   sendToShard(new AbandonServerTransaction(tid), tid);
 }
 
 void 
 TransactionController::cancelClientInviteTransaction(const Data& tid, const resip::Tokens* reasons)
 {
-   mStateMacFifo.add(new CancelClientInviteTransaction(tid, reasons));
+   sendToShard(new CancelClientInviteTransaction(tid, reasons), tid);
 }
 
 void 
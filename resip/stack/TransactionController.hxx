@@ -9,6 +9,8 @@
 
 #include "rutil/ConsumerFifoBuffer.hxx"
 
+#include <atomic>
+
 namespace resip
 {
 
@@ -43,6 +45,8 @@ class TransactionController
       
       void send(SipMessage* msg);
 
+      // With several shards, the transaction and timer counts include the
+      // other shards as of their last process() call, so they are approximate.
       unsigned int getTuFifoSize() const;
       unsigned int sumTransportFifoSizes() const;
       unsigned int getTransactionFifoSize() const;
@@ -52,28 +56,12 @@ class TransactionController
       void zeroOutStatistics();
       void pollStatistics();
       
-      void setCongestionManager( CongestionManager *manager ) 
-      { 
-         mTransportSelector.setCongestionManager(manager);
-         if(mCongestionManager)
-         {
-            mCongestionManager->unregisterFifo(&mStateMacFifo);
-         }
-         mCongestionManager=manager;
-         if(mCongestionManager)
-         {
-            mCongestionManager->registerFifo(&mStateMacFifo);
-         }
-      }
+      // Registers the state machine fifo of every shard
+      void setCongestionManager( CongestionManager *manager );
 
-      CongestionManager::RejectionBehavior getRejectionBehavior() const
-      {
-         if(mCongestionManager)
-         {
-            return mCongestionManager->getRejectionBehavior(&mStateMacFifo);
-         }
-         return CongestionManager::NORMAL;
-      }
+      // The behaviour for this shard's fifo; on shard 0, the worst of all
+      // shards
+      CongestionManager::RejectionBehavior getRejectionBehavior() const;
 
       void registerMarkListener(MarkListener* listener);
       void unregisterMarkListener(MarkListener* listener);
@@ -86,12 +74,20 @@ class TransactionController
       inline void setFixBadDialogIdentifiers(bool pFixBadDialogIdentifiers) 
       {
          mFixBadDialogIdentifiers = pFixBadDialogIdentifiers;
+         for(std::vector<TransactionController*>::iterator it = mShards.begin(); it != mShards.end(); ++it)
+         {
+            (*it)->mFixBadDialogIdentifiers = pFixBadDialogIdentifiers;
+         }
       }
 
       inline bool getFixBadCSeqNumbers() const { return mFixBadCSeqNumbers;} 
       inline void setFixBadCSeqNumbers(bool pFixBadCSeqNumbers)
       {
          mFixBadCSeqNumbers = pFixBadCSeqNumbers;
+         for(std::vector<TransactionController*>::iterator it = mShards.begin(); it != mShards.end(); ++it)
+         {
+            (*it)->mFixBadCSeqNumbers = pFixBadCSeqNumbers;
+         }
       }
 
       void abandonServerTransaction(const Data& tid);
@@ -105,9 +101,34 @@ class TransactionController
 
       void invokeAfterSocketCreationFunc(TransportType type);
 
+      /**
+         Splits the transaction layer into count shards. Each shard has its
+         own state machine fifo, timer queue and transaction maps, and is
+         meant to be driven by its own TransactionControllerThread. Messages
+         are assigned to a shard by a hash of their transaction id, so every
+         message of a transaction (including its CANCEL) is handled by the
+         same shard. The TransportSelector and StatisticsManager are shared
+         between the shards.
+
+         This controller is shard 0; it still receives everything from the
+         transports and hands off the messages that belong to other shards.
+         Must be called before the stack starts processing.
+      */
+      void setShardCount(unsigned int count, AsyncProcessHandler* handler);
+      unsigned int getShardCount() const { return (unsigned int)mShards.size() + 1; }
+      TransactionController& getShard(unsigned int index);
+
    private:
       TransactionController(const TransactionController& rhs);
       TransactionController& operator=(const TransactionController& rhs);
+
+      // Creates an additional shard of primary
+      TransactionController(TransactionController& primary, AsyncProcessHandler* handler);
+
+      CongestionManager::RejectionBehavior getShardRejectionBehavior() const;
+      unsigned int shardIndex(const Data& tid) const;
+      unsigned int shardIndex(TransactionMessage* message) const;
+      void sendToShard(TransactionMessage* message, const Data& tid);
       SipStack& mStack;
       
       // If true, indicate to the Transaction to ignore responses for which
@@ -139,8 +160,10 @@ class TransactionController
       // from the sipstack (for convenience)
       TuSelector& mTuSelector;
 
-      // Used to decide which transport to send a sip message on. 
-      TransportSelector mTransportSelector;
+      // Used to decide which transport to send a sip message on. Owned by
+      // shard 0, and shared with the other shards.
+      std::unique_ptr<TransportSelector> mOwnedTransportSelector;
+      TransportSelector& mTransportSelector;
 
       // stores all of the transactions that are currently active in this stack 
       TransactionMap mClientTransactionMap;
@@ -150,11 +173,22 @@ class TransactionController
       // placed in the mStateMacFifo
       TransactionTimerQueue  mTimers;
 
-      bool mShuttingDown;
+      // set by shard 0's shutdown() from the caller's thread
+      std::atomic<bool> mShuttingDown;
       
       StatisticsManager& mStatsManager;
       
       Data mHostname;
+
+      // Additional shards, owned by shard 0; empty in a shard
+      std::vector<TransactionController*> mShards;
+      TransactionController* mPrimary;
+
+      // A shard's map and timer queue sizes as of its last process() call,
+      // for shard 0 to read from its own thread
+      std::atomic<unsigned int> mClientTransactionCount;
+      std::atomic<unsigned int> mServerTransactionCount;
+      std::atomic<unsigned int> mTimerCount;
       
       friend class SipStack; // for debug only
       friend class StatelessHandler;
@@ -3,10 +3,12 @@
 
 #include <iosfwd>
 #include <memory>
+#include <vector>
 #include "rutil/dns/DnsHandler.hxx"
 #include "resip/stack/MethodTypes.hxx"
 #include "resip/stack/SipMessage.hxx"
 #include "resip/stack/Transport.hxx"
+#include "resip/stack/TimerQueue.hxx"
 #include "rutil/HeapInstanceCounter.hxx"
 
 namespace resip
@@ -122,6 +124,12 @@ class TransactionState : public DnsHandler
 
       void startServerNonInviteTimerTrying(SipMessage& sip, const Data& tid);
 
+      // Starts a timer for this transaction. The timer is cancelled if the
+      // transaction is destroyed before it fires.
+      void addTimer(Timer::Type type, unsigned long msOffset);
+      // Forgets the handle of a timer of this type that has just fired.
+      void timerFired(Timer::Type type);
+
       static TransactionState* makeCancelTransaction(TransactionState* tran, Machine machine, const Data& tid);
       static void handleInternalCancel(SipMessage* cancel,
                                        TransactionState& clientInvite);
@@ -193,6 +201,8 @@ class TransactionState : public DnsHandler
       TransportFailure::FailureReason mFailureReason;      
       int mFailureSubCode;
       bool mTcpConnectTimerStarted;
+      // pending timers, by type
+      std::vector<std::pair<Timer::Type, TransactionTimerQueue::Id> > mTimerIds;
 
       static uint32_t StatelessIdCounter;
       
@@ -44,7 +44,8 @@ Transport::Transport(Fifo<TransactionMessage>& rxFifo,
    mTlsDomain(tlsDomain),
    mSocketFunc(socketFunc),
    mCompression(compression),
-   mTransportFlags(0)
+   mTransportFlags(0),
+   mShardGroupKey(0)
 {
 #ifdef USE_NETNS
    // Needs to be implemented for NETNS
@@ -70,7 +71,8 @@ Transport::Transport(Fifo<TransactionMessage>& rxFifo,
    mTlsDomain(tlsDomain),
    mSocketFunc(socketFunc),
    mCompression(compression),
-   mTransportFlags(transportFlags)
+   mTransportFlags(transportFlags),
+   mShardGroupKey(0)
 {
 }
 
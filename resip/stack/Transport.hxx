@@ -50,12 +50,26 @@ class FdPollGrp;
  *    Specifies whether this Transport object has its own thread (ie; if
  *    set, the TransportSelector should not run the select/poll loop for
  *    this transport, since that is another thread's job)
+ * BATCHIO:
+ *    On UDP transports, use recvmmsg() to read a burst of datagrams per
+ *    system call into a ring of receive buffers, and sendmmsg() to flush
+ *    the transmit queue. Only effective where the platform provides
+ *    these calls (HAVE_RECVMMSG/HAVE_SENDMMSG), otherwise ignored.
+ * REUSEPORT:
+ *    Set SO_REUSEPORT on the socket before binding, so that several
+ *    transports can listen on the same ip:port and have the kernel spread
+ *    inbound traffic across them. Used by SipStack::addTransport() when
+ *    a shard count greater than one is requested. A UDP transport with
+ *    both REUSEPORT and OWNTHREAD set starts (and joins) its own
+ *    TransportThread, rather than expecting the app to create one.
  */
 #define RESIP_TRANSPORT_FLAG_NOBIND      (1<<0)
 #define RESIP_TRANSPORT_FLAG_RXALL       (1<<1)
 #define RESIP_TRANSPORT_FLAG_TXALL       (1<<2)
 #define RESIP_TRANSPORT_FLAG_TXNOW       (1<<4)
 #define RESIP_TRANSPORT_FLAG_OWNTHREAD   (1<<5)
+#define RESIP_TRANSPORT_FLAG_BATCHIO     (1<<6)
+#define RESIP_TRANSPORT_FLAG_REUSEPORT   (1<<7)
 
 /**
    @brief The base class for Transport classes.
@@ -390,6 +404,11 @@ class Transport : public FdSetIOObserver
       inline unsigned int getKey() const {return mTuple.mTransportKey;} 
       inline void setKey(unsigned int pKey) { mTuple.mTransportKey = pKey;} // should only be called once after creation
 
+      /// When this transport is an additional SO_REUSEPORT shard of another
+      /// transport, the key of that (first) transport; 0 otherwise.
+      inline unsigned int getShardGroupKey() const { return mShardGroupKey; }
+      inline void setShardGroupKey(unsigned int key) { mShardGroupKey = key; } // should only be called before adding to the stack
+
    protected:
 
       Data mInterface;
@@ -411,6 +430,7 @@ class Transport : public FdSetIOObserver
       AfterSocketCreationFuncPtr mSocketFunc;
       Compression &mCompression;
       unsigned mTransportFlags;
+      unsigned int mShardGroupKey;
 };
 
 EncodeStream& operator<<(EncodeStream& strm, const Transport& rhs);
@@ -60,6 +60,7 @@
 #define gai_strerror strerror
 #endif
 
+#include <algorithm>
 #include <utility>
 #include <sys/types.h>
 
@@ -75,7 +76,8 @@ TransportSelector::TransportSelector(Fifo<TransactionMessage>& fifo, Security* s
    mSigcompStack (0),
    mPollGrp(0),
    mAvgBufferSize(1024),
-   mInterruptorHandle(0)
+   mInterruptorHandle(0),
+   mShared(false)
 {
    memset(&mUnspecified.v4Address, 0, sizeof(sockaddr_in));
    mUnspecified.v4Address.sin_family = AF_UNSPEC;
@@ -167,6 +169,7 @@ TransportSelector::isFinished() const
 void
 TransportSelector::addTransport(std::unique_ptr<Transport> autoTransport, bool isStackRunning)
 {
+   RecursiveLock lock(sharedLock());
    Transport* transport = autoTransport.release();
 
    // !bwc! This is a multimap from TransportType/IpVersion to Transport*.
@@ -214,7 +217,26 @@ TransportSelector::addTransport(std::unique_ptr<Transport> autoTransport, bool i
                transport->netNs());
    tuple.mTransportKey = transport->getKey();
 
-   if(!isSecure(transport->transport()))
+   const bool isShard = transport->getShardGroupKey() != 0;
+   if(isShard)
+   {
+      // Additional SO_REUSEPORT shard - it is only reachable through its
+      // group, so keep it out of the tuple lookup maps.
+      TransportKeyMap::iterator first = mTransports.find(transport->getShardGroupKey());
+      if(first == mTransports.end())
+      {
+         WarningLog (<< "Can't add shard, first transport of group " << transport->getShardGroupKey() << " not found: " << tuple);
+         delete transport;
+         return;
+      }
+      std::vector<Transport*>& group = mShardGroups[first->first];
+      if(group.empty())
+      {
+         group.push_back(first->second);
+      }
+      group.push_back(transport);
+   }
+   else if(!isSecure(transport->transport()))
    {
       if(mExactTransports.find(tuple) == mExactTransports.end() &&
          mAnyInterfaceTransports.find(tuple) == mAnyInterfaceTransports.end())
@@ -287,8 +309,11 @@ TransportSelector::addTransport(std::unique_ptr<Transport> autoTransport, bool i
       mHasOwnProcessTransports.back()->startOwnProcessing();
    }
 
-   mTypeToTransportMap.insert(TypeToTransportMap::value_type(tuple,transport));
-   mDns.addTransportType(transport->transport(), transport->ipVersion());
+   if(!isShard)
+   {
+      mTypeToTransportMap.insert(TypeToTransportMap::value_type(tuple,transport));
+      mDns.addTransportType(transport->transport(), transport->ipVersion());
+   }
    mTransports[transport->getKey()] = transport;
 
    InfoLog(<< "TransportSelector::addTransport:  added transport for tuple=" << tuple << ", key=" << transport->getKey());
@@ -297,6 +322,7 @@ TransportSelector::addTransport(std::unique_ptr<Transport> autoTransport, bool i
 void
 TransportSelector::removeTransport(unsigned int transportKey)
 {
+   RecursiveLock lock(sharedLock());
    Transport* transportToRemove = 0;
 
    // Find transport in global map and remove it
@@ -315,7 +341,47 @@ TransportSelector::removeTransport(unsigned int transportKey)
       // notify transport to shutdown
       transportToRemove->shutdown();
 
-      if(!isSecure(transportToRemove->transport()))
+      const bool isShard = transportToRemove->getShardGroupKey() != 0;
+      if(isShard)
+      {
+         ShardGroupMap::iterator itGroup = mShardGroups.find(transportToRemove->getShardGroupKey());
+         if(itGroup != mShardGroups.end())
+         {
+            std::vector<Transport*>& group = itGroup->second;
+            group.erase(std::remove(group.begin(), group.end(), transportToRemove), group.end());
+            if(group.size() <= 1)
+            {
+               mShardGroups.erase(itGroup);
+            }
+         }
+      }
+      else
+      {
+         // Removing the first shard of a group takes the other shards with it
+         ShardGroupMap::iterator itGroup = mShardGroups.find(transportKey);
+         if(itGroup != mShardGroups.end())
+         {
+            std::vector<unsigned int> shardKeys;
+            for(std::vector<Transport*>::const_iterator itShard = itGroup->second.begin(); itShard != itGroup->second.end(); ++itShard)
+            {
+               if((*itShard)->getKey() != transportKey)
+               {
+                  shardKeys.push_back((*itShard)->getKey());
+               }
+            }
+            mShardGroups.erase(itGroup);
+            for(std::vector<unsigned int>::const_iterator itKey = shardKeys.begin(); itKey != shardKeys.end(); ++itKey)
+            {
+               removeTransport(*itKey);
+            }
+         }
+      }
+
+      if(isShard)
+      {
+         // shards are not present in the lookup maps
+      }
+      else if(!isSecure(transportToRemove->transport()))
       {
          // Ensure transport is removed from all containers
          mExactTransports.erase(transportToRemove->getTuple());
@@ -346,7 +412,10 @@ TransportSelector::removeTransport(unsigned int transportKey)
 
       // Remove transport types from Dns list of supported protocols
       // Note:  DNS tracks use counts so that we will only remove this transport type if this is the last of the type to be removed
-      mDns.removeTransportType(transportToRemove->transport(), transportToRemove->ipVersion());
+      if(!isShard)
+      {
+         mDns.removeTransportType(transportToRemove->transport(), transportToRemove->ipVersion());
+      }
 
       if (transportToRemove->shareStackProcessAndSelect())
       {
@@ -386,7 +455,7 @@ TransportSelector::rebuildAnyPortTransportMaps()
 
     for (TransportKeyMap::iterator it = mTransports.begin(); it != mTransports.end(); it++)
     {
-        if (!isSecure(it->second->transport()))
+        if (!isSecure(it->second->transport()) && !it->second->getShardGroupKey())
         {
             // Store the transport in the ANY interface maps if the tuple specifies ANY
             // interface. Store the transport in the specific interface maps if the tuple
@@ -533,6 +602,7 @@ TransportSelector::checkTransportAddRemoveQueue()
 void 
 TransportSelector::poke()
 {
+   RecursiveLock lock(sharedLock());
    for(TransportList::iterator it = mHasOwnProcessTransports.begin(); it != mHasOwnProcessTransports.end(); it++)
    {
       try
@@ -571,6 +641,7 @@ TransportSelector::hasDataToSend() const
 DnsResult*
 TransportSelector::createDnsResult(DnsHandler* handler)
 {
+   RecursiveLock lock(sharedLock());
    return mDns.createDnsResult(handler);
 }
 
@@ -578,6 +649,7 @@ void
 TransportSelector::dnsResolve(DnsResult* result,
                               SipMessage* msg)
 {
+   RecursiveLock lock(sharedLock());
    // Picking the target destination:
    //   - for request, use forced target if set
    //     otherwise use loose routing behaviour (route or, if none, request-uri)
@@ -927,6 +999,7 @@ TransportSelector::determineSourceInterface(SipMessage* msg, const Tuple& target
 TransportSelector::TransmitState
 TransportSelector::transmit(SipMessage* msg, Tuple& target, SendData* sendData)
 {
+   RecursiveLock lock(sharedLock());
    resip_assert(msg);
 
    if(msg->mIsDecorated)
@@ -1036,6 +1109,10 @@ TransportSelector::transmit(SipMessage* msg, Tuple& target, SendData* sendData)
             }
          }
 
+         if (transport)
+         {
+            transport = selectShard(transport, target);
+         }
          target.mTransportKey = transport ? transport->getKey() : 0;
 
          // .bwc. Topmost Via is only filled out in the request case. Also, if
@@ -1363,6 +1440,7 @@ TransportSelector::transmit(SipMessage* msg, Tuple& target, SendData* sendData)
 void
 TransportSelector::retransmit(const SendData& data)
 {
+   RecursiveLock lock(sharedLock());
    resip_assert(data.destination.mTransportKey);
    Transport* transport = findTransportByDest(data.destination);
 
@@ -1404,6 +1482,7 @@ TransportSelector::retransmit(const SendData& data)
 void 
 TransportSelector::closeConnection(const Tuple& peer)
 {
+   RecursiveLock lock(sharedLock());
    Transport* t = findTransportByDest(peer);
    if(t)
    {
@@ -1436,6 +1515,7 @@ TransportSelector::terminateFlow(const resip::Tuple& flow)
 void 
 TransportSelector::enableFlowTimer(const resip::Tuple& flow)
 {
+   RecursiveLock lock(sharedLock());
    Transport* t = findTransportByDest(flow);
    if(t)
    {
@@ -1451,6 +1531,7 @@ TransportSelector::enableFlowTimer(const resip::Tuple& flow)
 void 
 TransportSelector::invokeAfterSocketCreationFunc(TransportType type)
 {
+   RecursiveLock lock(sharedLock());
     for (TransportKeyMap::iterator it = mTransports.begin(); it != mTransports.end(); it++)
     {
         if (type == UNKNOWN_TRANSPORT || type == it->second->transport())
@@ -1465,6 +1546,16 @@ TransportSelector::invokeAfterSocketCreationFunc(TransportType type)
     }
 }
 
+RecursiveLock
+TransportSelector::sharedLock() const
+{
+   if(mShared)
+   {
+      return RecursiveLock(mSharedMutex);
+   }
+   return RecursiveLock();
+}
+
 Transport*
 TransportSelector::findTransportByDest(const Tuple& target)
 {
@@ -1495,6 +1586,26 @@ TransportSelector::findTransportByDest(const Tuple& target)
    return 0;
 }
 
+/**
+   If {transport} is the first shard of an SO_REUSEPORT group, pick the shard
+   that should send to {dest} by hashing the destination tuple, so a given
+   peer is always served by the same shard. Otherwise returns {transport}.
+**/
+Transport*
+TransportSelector::selectShard(Transport* transport, const Tuple& dest) const
+{
+   if (mShardGroups.empty())
+   {
+      return transport;
+   }
+   ShardGroupMap::const_iterator it = mShardGroups.find(transport->getKey());
+   if (it == mShardGroups.end())
+   {
+      return transport;
+   }
+   return it->second[dest.hash() % it->second.size()];
+}
+
 /**
    Search for Transport on any loopback interface matching {search}.
    WATCHOUT: This is O(N) walk thru (nearly) all transports.
@@ -12,6 +12,7 @@
 #include "rutil/Data.hxx"
 #include "rutil/Fifo.hxx"
 #include "rutil/GenericIPAddress.hxx"
+#include "rutil/Lock.hxx"
 #include "resip/stack/Transport.hxx"
 #include "resip/stack/DnsInterface.hxx"
 #include "rutil/SelectInterruptor.hxx"
@@ -155,6 +156,12 @@ class TransportSelector
 
       void invokeAfterSocketCreationFunc(TransportType type);
 
+      /// Called when the transaction layer is split into several shards that
+      /// share this TransportSelector. From then on the calls made by the
+      /// transaction state machines (transmit, dns, add/remove transport...)
+      /// are serialized.
+      void setShared(bool shared) { mShared = shared; }
+
       /**
          @internal - public only for stream operator access
       */
@@ -202,7 +209,9 @@ class TransportSelector
       Transport* findTransportByVia(SipMessage* msg, const Tuple& dest, Tuple& src) const;
       Transport* findTlsTransport(const Data& domain,TransportType type,IpVersion ipv) const;
       Tuple determineSourceInterface(SipMessage* msg, const Tuple& dest) const;
+      Transport* selectShard(Transport* transport, const Tuple& dest) const;
       void rebuildAnyPortTransportMaps(void);
+      RecursiveLock sharedLock() const;
 
       DnsInterface mDns;
       Fifo<TransactionMessage>& mStateMacFifo;
@@ -237,6 +246,12 @@ class TransportSelector
       typedef std::multimap<Tuple, Transport*, Tuple::AnyPortAnyInterfaceCompare> TypeToTransportMap;
       TypeToTransportMap mTypeToTransportMap;
 
+      // SO_REUSEPORT shard groups, keyed by the key of the first shard (which
+      // is the only one present in the lookup maps above); the vector holds
+      // all shards including the first one.
+      typedef std::map<unsigned int, std::vector<Transport*> > ShardGroupMap;
+      ShardGroupMap mShardGroups;
+
       // fake socket(s) one for each netns, for connect() and route table lookups
       mutable HashMap<Data, Socket> mSockets;
       mutable HashMap<Data, Socket> mSocket6s;
@@ -257,6 +272,9 @@ class TransportSelector
       std::unique_ptr<SelectInterruptor> mSelectInterruptor;
       FdPollItemHandle mInterruptorHandle;
 
+      bool mShared;
+      mutable RecursiveMutex mSharedMutex;
+
       friend class TestTransportSelector;
       friend class SipStack; // for debug only
 };
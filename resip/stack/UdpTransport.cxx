@@ -2,21 +2,30 @@
 #include "config.h"
 #endif
 
+#include <algorithm>
 #include <memory>
 #include <utility>
 
 #include "resip/stack/Helper.hxx"
+#include "resip/stack/RxBufferPool.hxx"
 #include "resip/stack/SendData.hxx"
 #include "resip/stack/SipMessage.hxx"
+#include "resip/stack/TransportThread.hxx"
 #include "resip/stack/UdpTransport.hxx"
 #include "rutil/Data.hxx"
 #include "rutil/DnsUtil.hxx"
+#include "rutil/Lock.hxx"
 #include "rutil/Logger.hxx"
 #include "rutil/Socket.hxx"
 #include "rutil/WinLeakCheck.hxx"
 #include "rutil/compat.hxx"
 #include "rutil/stun/Stun.hxx"
 
+#if !defined(WIN32)
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
 #ifdef USE_SIGCOMP
 #include <osc/Stack.h>
 #include <osc/StateChanges.h>
@@ -28,6 +37,11 @@
 using namespace std;
 using namespace resip;
 
+unsigned int UdpTransport::PooledRxBufferSize = 0;
+
+// Free buffers each transport's pool keeps around for reuse
+static const size_t MaxFreeRxBuffers = 256;
+
 UdpTransport::UdpTransport(Fifo<TransactionMessage>& fifo,
                            int portNum,
                            IpVersion version,
@@ -38,6 +52,8 @@ UdpTransport::UdpTransport(Fifo<TransactionMessage>& fifo,
                            unsigned transportFlags)
    : InternalTransport(fifo, portNum, version, pinterface, socketFunc, compression, transportFlags),  
      mSigcompStack(nullptr),
+     mRxBufferPool(nullptr),
+     mRxPoolCapacity(0),
      mStunSetting(stun),
      mExternalUnknownDatagramHandler(nullptr),
      mInWritable(false)
@@ -45,6 +61,7 @@ UdpTransport::UdpTransport(Fifo<TransactionMessage>& fifo,
    mPollEventCnt = 0;
    mTxTryCnt = mTxMsgCnt = mTxFailCnt = 0;
    mRxTryCnt = mRxMsgCnt = mRxKeepaliveCnt = mRxTransactionCnt = 0;
+   mRxBatchCnt = mTxBatchCnt = mRxPooledCnt = 0;
    mTuple.setType(UDP);
    mFd = InternalTransport::socket(transport(), version);
    mTuple.mFlowKey=(FlowKey)mFd;
@@ -67,12 +84,45 @@ UdpTransport::UdpTransport(Fifo<TransactionMessage>& fifo,
    }
 #else
    DebugLog (<< "No compression library available: " << *this);
+#endif
+   if (mTransportFlags & RESIP_TRANSPORT_FLAG_BATCHIO)
+   {
+      if (useBatchIo())
+      {
+         mRxBatchBuffers.resize((size_t)MaxBatchSize * MaxMessageSize);
+      }
+      else
+      {
+         WarningLog (<< "Batched I/O not available (no recvmmsg/sendmmsg or compression enabled), ignoring flag: " << *this);
+      }
+   }
+#if !defined(WIN32)
+   // recvmsg() lets the tail of an oversized datagram spill into mRxBuffer
+   if (PooledRxBufferSize > 0)
+   {
+      mRxPoolCapacity = resipMin((size_t)PooledRxBufferSize, (size_t)MaxMessageSize);
+      mRxBufferPool = new RxBufferPool(mRxPoolCapacity + MsgHeaderScanner::MaxNumCharsChunkOverflow,
+                                       MaxFreeRxBuffers);
+      mRxPoolBuffers.resize(useBatchIo() ? MaxBatchSize : 1, nullptr);
+   }
 #endif
    mTxFifo.setDescription("UdpTransport::mTxFifo");
 }
 
 UdpTransport::~UdpTransport()
 {
+   if (mShardThread)
+   {
+      mShardThread->shutdown();
+      mShardThread->join();
+      mShardThread.reset();
+   }
+   if (mShardGroup)
+   {
+      Lock lock(mShardGroup->mMutex);
+      std::vector<UdpTransport*>& shards = mShardGroup->mShards;
+      shards.erase(std::remove(shards.begin(), shards.end(), this), shards.end());
+   }
    InfoLog(<< "Shutting down " << mTuple
            <<" tf="<<mTransportFlags<<" evt="<<(mPollGrp?1:0)
            <<" stats:"
@@ -84,13 +134,38 @@ UdpTransport::~UdpTransport()
            <<" rxmsg="<<mRxMsgCnt
            <<" rxka="<<mRxKeepaliveCnt
            <<" rxtr="<<mRxTransactionCnt
+           <<" rxbatch="<<mRxBatchCnt
+           <<" txbatch="<<mTxBatchCnt
+           <<" rxpooled="<<mRxPooledCnt
            );
+   if (mRxBufferPool)
+   {
+      for (std::vector<char*>::iterator i = mRxPoolBuffers.begin(); i != mRxPoolBuffers.end(); ++i)
+      {
+         if (*i)
+         {
+            RxBufferPool::release(*i);
+         }
+      }
+      mRxBufferPool->shutdown();
+   }
 #ifdef USE_SIGCOMP
    delete mSigcompStack;
 #endif
    setPollGrp(nullptr);
 }
 
+void
+UdpTransport::startOwnProcessing()
+{
+   const unsigned shardFlags = RESIP_TRANSPORT_FLAG_REUSEPORT | RESIP_TRANSPORT_FLAG_OWNTHREAD;
+   if ((mTransportFlags & shardFlags) == shardFlags && !mShardThread)
+   {
+      mShardThread.reset(new TransportThread(*this));
+      mShardThread->run();
+   }
+}
+
 void
 UdpTransport::setPollGrp(FdPollGrp *grp)
 {
@@ -221,6 +296,12 @@ UdpTransport::process(FdSet& fdset)
 void
 UdpTransport::processTxAll()
 {
+   if (useBatchIo())
+   {
+      processTxBatch();
+      return;
+   }
+
    SendData *msg;
    ++mTxTryCnt;
    while ( (msg=mTxFifoOutBuffer.getNext(RESIP_FIFO_NOWAIT)) != nullptr)
@@ -305,6 +386,109 @@ UdpTransport::processTxOne(SendData *data)
    }
 }
 
+/**
+ * Batched variant of processTxAll(), used with RESIP_TRANSPORT_FLAG_BATCHIO.
+ * Pulls up to MaxBatchSize messages off the transmit queue and hands them
+ * to the kernel with a single sendmmsg(). With TXALL we keep going until
+ * the queue is empty.
+ */
+void
+UdpTransport::processTxBatch()
+{
+#if defined(HAVE_SENDMMSG)
+   ++mTxTryCnt;
+   std::unique_ptr<SendData> batch[MaxBatchSize];
+   struct mmsghdr msgs[MaxBatchSize];
+   struct iovec iovs[MaxBatchSize];
+
+   for (;;)
+   {
+      int count = 0;
+      SendData* msg;
+      while (count < MaxBatchSize &&
+             (msg=mTxFifoOutBuffer.getNext(RESIP_FIFO_NOWAIT)) != nullptr)
+      {
+         std::unique_ptr<SendData> sendData(msg);
+         if (sendData->command != SendData::NoCommand)
+         {
+            // We don't handle any special SendData commands in the UDP transport yet.
+            continue;
+         }
+         resip_assert( sendData->destination.getPort() != 0 );
+
+         iovs[count].iov_base = const_cast<char*>(sendData->data.data());
+         iovs[count].iov_len = sendData->data.size();
+         memset(&msgs[count], 0, sizeof(msgs[count]));
+         msgs[count].msg_hdr.msg_name = const_cast<sockaddr*>(&sendData->destination.getSockaddr());
+         msgs[count].msg_hdr.msg_namelen = sendData->destination.length();
+         msgs[count].msg_hdr.msg_iov = &iovs[count];
+         msgs[count].msg_hdr.msg_iovlen = 1;
+         batch[count] = std::move(sendData);
+         ++count;
+      }
+      if (count == 0)
+      {
+         break;
+      }
+
+      mTxMsgCnt += count;
+      int done = 0;
+      while (done < count)
+      {
+         ++mTxBatchCnt;
+         const int sent = sendmmsg(mFd, &msgs[done], count - done, 0);
+         if (sent > 0)
+         {
+            for (int i = done; i < done + sent; ++i)
+            {
+               if (msgs[i].msg_len != iovs[i].iov_len)
+               {
+                  ErrLog (<< "UDPTransport - send buffer full" );
+                  fail(batch[i]->transactionId);
+               }
+            }
+            done += sent;
+            continue;
+         }
+
+         // sendmmsg() reports an error only for the first message it could
+         // not send; account for it and carry on with the remainder.
+         int e = getErrno();
+         error(e);
+         InfoLog (<< "Failed (" << e << ") sending to " << batch[done]->destination);
+         fail(batch[done]->transactionId);
+         ++mTxFailCnt;
+         ++done;
+      }
+
+      for (int i = 0; i < count; ++i)
+      {
+         batch[i].reset();
+      }
+
+      if (count < MaxBatchSize || (mTransportFlags & RESIP_TRANSPORT_FLAG_TXALL) == 0)
+      {
+         break;
+      }
+   }
+#else
+   resip_assert(0);
+#endif
+}
+
+bool
+UdpTransport::useBatchIo() const
+{
+#if defined(HAVE_RECVMMSG) && defined(HAVE_SENDMMSG)
+   // SigComp compresses each message into its own datagram buffer, so keep
+   // the one-at-a-time path when compression is in use.
+   return (mTransportFlags & RESIP_TRANSPORT_FLAG_BATCHIO) != 0 &&
+          mSigcompStack == nullptr;
+#else
+   return false;
+#endif
+}
+
 /**
  * Add options RXALL (to try receive all readable data).
  * With RXALL, every read cycle will have end with an EAGAIN read.
@@ -314,18 +498,25 @@ UdpTransport::processTxOne(SendData *data)
 void
 UdpTransport::processRxAll()
 {
+   if (useBatchIo())
+   {
+      processRxBatch();
+      return;
+   }
+
    ++mRxTryCnt;
    for (;;)
    {
       // TBD: check StateMac capacity
       Tuple sender(mTuple);
-      const int len = processRxRecv(sender);
+      char* buffer = mRxBuffer.data();
+      const int len = mRxBufferPool ? processRxRecvPooled(sender, buffer) : processRxRecv(sender);
       if (len <= 0)
       {
          break;
       }
       ++mRxMsgCnt;
-      processRxParse(len, sender);
+      processRxParse(buffer, len, sender, mRxBufferPool ? &mRxPoolBuffers[0] : nullptr);
       if ( (mTransportFlags & RESIP_TRANSPORT_FLAG_RXALL) == 0 )
       {
          break;
@@ -372,16 +563,178 @@ UdpTransport::processRxRecv(Tuple& sender)
    }
 }
 
+/*
+ * Like processRxRecv(), but receives into the next pooled buffer, with
+ * mRxBuffer catching whatever does not fit. {buffer} is set to wherever
+ * the whole datagram can be found afterwards.
+**/
+int
+UdpTransport::processRxRecvPooled(Tuple& sender, char*& buffer)
+{
+#if !defined(WIN32)
+   char*& pooled = mRxPoolBuffers[0];
+   if (!pooled)
+   {
+      pooled = mRxBufferPool->acquire();
+   }
+   for (;;)
+   {
+      struct iovec iovs[2];
+      iovs[0].iov_base = pooled;
+      iovs[0].iov_len = mRxPoolCapacity;
+      iovs[1].iov_base = mRxBuffer.data();
+      iovs[1].iov_len = MaxMessageSize - mRxPoolCapacity;
+      struct msghdr msg;
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_name = &sender.getMutableSockaddr();
+      msg.msg_namelen = sender.length();
+      msg.msg_iov = iovs;
+      msg.msg_iovlen = 2;
+
+      int len = (int)recvmsg(mFd, &msg, 0);
+      if ( len == SOCKET_ERROR )
+      {
+         int err = getErrno();
+         if ( err != EAGAIN && err != EWOULDBLOCK )
+         {
+            error( err );
+         }
+         len = 0;
+      }
+      if (len + 1 >= MaxMessageSize)
+      {
+         InfoLog( << "Datagram exceeded max length " << MaxMessageSize);
+         continue;
+      }
+      buffer = joinRxBuffer(pooled, mRxBuffer.data(), len);
+      return len;
+   }
+#else
+   resip_assert(0);
+   return 0;
+#endif
+}
+
+/*
+ * Returns {pooled} if a datagram of {len} bytes fitted in it; otherwise the
+ * rest of it is in {overflow}, and the two parts are put back together in
+ * mRxBuffer (the oversized case keeps the old copying behaviour).
+**/
+char*
+UdpTransport::joinRxBuffer(char* pooled, const char* overflow, int len)
+{
+   if ((size_t)len <= mRxPoolCapacity)
+   {
+      return pooled;
+   }
+   memmove(mRxBuffer.data() + mRxPoolCapacity, overflow, len - mRxPoolCapacity);
+   memcpy(mRxBuffer.data(), pooled, mRxPoolCapacity);
+   return mRxBuffer.data();
+}
 
 /**
- * Parse the contents of {mRxBuffer} and do something with it.
+ * Batched variant of processRxAll(), used with RESIP_TRANSPORT_FLAG_BATCHIO.
+ * Drains up to MaxBatchSize datagrams per recvmmsg() into mRxBatchBuffers
+ * and parses each of them in turn. Without RXALL only one batch is read.
+ */
+void
+UdpTransport::processRxBatch()
+{
+#if defined(HAVE_RECVMMSG)
+   ++mRxTryCnt;
+   resip_assert(mRxBatchBuffers.size() == (size_t)MaxBatchSize * MaxMessageSize);
+   struct mmsghdr msgs[MaxBatchSize];
+   // a pooled buffer and its overflow area per message, or just the latter
+   struct iovec iovs[2 * MaxBatchSize];
+   std::vector<Tuple> senders(MaxBatchSize, mTuple);
+
+   for (;;)
+   {
+      for (int i = 0; i < MaxBatchSize; ++i)
+      {
+         struct iovec* iov = &iovs[2 * i];
+         memset(&msgs[i], 0, sizeof(msgs[i]));
+         msgs[i].msg_hdr.msg_name = &senders[i].getMutableSockaddr();
+         msgs[i].msg_hdr.msg_namelen = senders[i].length();
+         msgs[i].msg_hdr.msg_iov = iov;
+         if (mRxBufferPool)
+         {
+            if (!mRxPoolBuffers[i])
+            {
+               mRxPoolBuffers[i] = mRxBufferPool->acquire();
+            }
+            iov->iov_base = mRxPoolBuffers[i];
+            iov->iov_len = mRxPoolCapacity;
+            ++iov;
+            msgs[i].msg_hdr.msg_iovlen = 2;
+         }
+         else
+         {
+            msgs[i].msg_hdr.msg_iovlen = 1;
+         }
+         iov->iov_base = &mRxBatchBuffers[(size_t)i * MaxMessageSize];
+         iov->iov_len = MaxMessageSize - mRxPoolCapacity;
+      }
+
+      const int count = recvmmsg(mFd, msgs, MaxBatchSize, 0, nullptr);
+      if (count == SOCKET_ERROR)
+      {
+         int err = getErrno();
+         if ( err != EAGAIN && err != EWOULDBLOCK )
+         {
+            error( err );
+         }
+         break;
+      }
+      if (count <= 0)
+      {
+         break;
+      }
+      ++mRxBatchCnt;
+
+      for (int i = 0; i < count; ++i)
+      {
+         const int len = (int)msgs[i].msg_len;
+         if ((msgs[i].msg_hdr.msg_flags & MSG_TRUNC) || len + 1 >= MaxMessageSize)
+         {
+            InfoLog( << "Datagram exceeded max length " << MaxMessageSize);
+            continue;
+         }
+         if (len <= 0)
+         {
+            continue;
+         }
+         ++mRxMsgCnt;
+         if (mRxBufferPool)
+         {
+            char* buffer = joinRxBuffer(mRxPoolBuffers[i], &mRxBatchBuffers[(size_t)i * MaxMessageSize], len);
+            processRxParse(buffer, len, senders[i], &mRxPoolBuffers[i]);
+         }
+         else
+         {
+            processRxParse(&mRxBatchBuffers[(size_t)i * MaxMessageSize], len, senders[i]);
+         }
+      }
+
+      if (count < MaxBatchSize || (mTransportFlags & RESIP_TRANSPORT_FLAG_RXALL) == 0)
+      {
+         break;
+      }
+   }
+#else
+   resip_assert(0);
+#endif
+}
+
+/**
+ * Parse the contents of {buffer} and do something with it.
 **/
 void
-UdpTransport::processRxParse(int len, const Tuple& sender)
+UdpTransport::processRxParse(char* buffer, int len, const Tuple& sender, char** pooled)
 {
    //handle incoming CRLFCRLF keep-alive packets
    if (len == 4 &&
-       strncmp(mRxBuffer.data(), Symbols::CRLFCRLF, len) == 0)
+       strncmp(buffer, Symbols::CRLFCRLF, len) == 0)
    {
       StackLog(<<"Throwing away incoming firewall keep-alive");
       ++mRxKeepaliveCnt;
@@ -389,7 +742,7 @@ UdpTransport::processRxParse(int len, const Tuple& sender)
    }
 
    // this must be a STUN response (or garbage)
-   if (mRxBuffer[0] == 1 && mRxBuffer[1] == 1 && ipVersion() == V4)
+   if (buffer[0] == 1 && buffer[1] == 1 && ipVersion() == V4)
    {
       resip::Lock lock(myMutex);
       StunMessage resp;
@@ -398,7 +751,7 @@ UdpTransport::processRxParse(int len, const Tuple& sender)
       // Once parsing is successful below, the return code will be updated
       mStunResult = StunResultResponseParseFailed;
 
-      if (stunParseMessage(mRxBuffer.data(), len, resp, false))
+      if (stunParseMessage(buffer, len, resp, false))
       {
          in_addr sin_addr;
          // Use XorMappedAddress if present - if not use MappedAddress
@@ -436,7 +789,7 @@ UdpTransport::processRxParse(int len, const Tuple& sender)
    }
 
    // this must be a STUN request (or garbage)
-   if (mRxBuffer[0] == 0 && mRxBuffer[1] == 1 && ipVersion() == V4)
+   if (buffer[0] == 0 && buffer[1] == 1 && ipVersion() == V4)
    {
       // Drop stun requests unless StunEnabled is set and return false to indicate
       // we did not consume the buffer
@@ -464,7 +817,7 @@ UdpTransport::processRxParse(int len, const Tuple& sender)
       secondary.port = 0;
       secondary.addr = 0;
 
-      bool ok = stunServerProcessMsg( mRxBuffer.data(), len, // input buffer
+      bool ok = stunServerProcessMsg( buffer, len, // input buffer
                                       from,  // packet source
                                       secondary, // not used
                                       myAddr, // address to fill into response
@@ -491,11 +844,11 @@ UdpTransport::processRxParse(int len, const Tuple& sender)
       return;
    }
 
-   processRxParseSip(mRxBuffer.data(), len, sender);
+   processRxParseSip(buffer, len, sender, pooled);
 }
 
 void
-UdpTransport::processRxParseSip(char* buffer, int len, const Tuple& sender)
+UdpTransport::processRxParseSip(char* buffer, int len, const Tuple& sender, char** pooled)
 {
 #ifdef USE_SIGCOMP
    osc::StateChanges *sc = 0;
@@ -534,8 +887,18 @@ UdpTransport::processRxParseSip(char* buffer, int len, const Tuple& sender)
 #endif
    }
 
-   auto* const msgBuffer = MsgHeaderScanner::allocateBuffer(len);
-   memcpy(msgBuffer, buffer, len);
+   // A pooled buffer is parsed in place; anything else is copied out
+   const bool adopt = pooled && buffer == *pooled;
+   auto* const msgBuffer = adopt ? buffer : MsgHeaderScanner::allocateBuffer(len);
+   if (adopt)
+   {
+      *pooled = nullptr;
+      ++mRxPooledCnt;
+   }
+   else
+   {
+      memcpy(msgBuffer, buffer, len);
+   }
    msgBuffer[len] = '\0';  // null terminate the buffer string just to make debug easier and reduce errors
 
    //DebugLog ( << "UDP Rcv : " << len << " b" );
@@ -555,7 +918,14 @@ UdpTransport::processRxParseSip(char* buffer, int len, const Tuple& sender)
 
    // Tell the SipMessage about this datagram buffer.
    // WATCHOUT: below here buffer is consumed by message
-   message->addBuffer(msgBuffer);
+   if (adopt)
+   {
+      message->addPooledBuffer(msgBuffer);
+   }
+   else
+   {
+      message->addBuffer(msgBuffer);
+   }
 
    mMsgHeaderScanner.prepareForMessage(message.get());
 
@@ -722,10 +1092,33 @@ UdpTransport::setExternalUnknownDatagramHandler(ExternalUnknownDatagramHandler *
    mExternalUnknownDatagramHandler = handler;
 }
 
+void
+UdpTransport::joinShardGroup(UdpTransport& first)
+{
+   resip_assert(!mShardGroup);
+   if (!first.mShardGroup)
+   {
+      first.mShardGroup = std::make_shared<ShardGroup>();
+      first.mShardGroup->mShards.push_back(&first);
+   }
+   mShardGroup = first.mShardGroup;
+   Lock lock(mShardGroup->mMutex);
+   mShardGroup->mShards.push_back(this);
+}
+
 void
 UdpTransport::setRcvBufLen(int buflen)
 {
-   setSocketRcvBufLen(mFd, buflen);
+   if (!mShardGroup)
+   {
+      setSocketRcvBufLen(mFd, buflen);
+      return;
+   }
+   Lock lock(mShardGroup->mMutex);
+   for (std::vector<UdpTransport*>::const_iterator it = mShardGroup->mShards.begin(); it != mShardGroup->mShards.end(); ++it)
+   {
+      setSocketRcvBufLen((*it)->mFd, buflen);
+   }
 }
 
 /* ====================================================================
@@ -5,15 +5,19 @@
 #include "resip/stack/InternalTransport.hxx"
 #include "resip/stack/MsgHeaderScanner.hxx"
 #include "rutil/HeapInstanceCounter.hxx"
+#include "rutil/Mutex.hxx"
 #include "resip/stack/Compression.hxx"
 
 #include <array>
+#include <vector>
 
 namespace osc { class Stack; }
 
 namespace resip
 {
 class UdpTransport;
+class TransportThread;
+class RxBufferPool;
 
 /** Interface functor for external unrecognized datagram handling.
   * User can catch datagram messages received that are not recognized by
@@ -76,13 +80,29 @@ public:
    virtual bool hasDataToSend() const;
    virtual void buildFdSet( FdSet& fdset);
    virtual void setPollGrp(FdPollGrp *grp);
+   // Applies to every SO_REUSEPORT shard in this transport's group
    virtual void setRcvBufLen(int buflen);
+   // Makes this transport an additional SO_REUSEPORT shard of {first}
+   void joinShardGroup(UdpTransport& first);
+   // Starts a TransportThread for SO_REUSEPORT shards (REUSEPORT|OWNTHREAD)
+   virtual void startOwnProcessing();
 
    // FdPollItemIf
    // virtual Socket getPollSocket() const;
    virtual void processPollEvent(FdPollEventMask mask);
 
    static constexpr int MaxMessageSize = 65535;
+   /// Maximum number of datagrams moved per recvmmsg()/sendmmsg() call
+   /// when RESIP_TRANSPORT_FLAG_BATCHIO is set.
+   static constexpr int MaxBatchSize = 16;
+
+   /// Usable size of the pooled buffers that datagrams are received into.
+   /// A SIP message that fits is parsed in place from the pooled buffer,
+   /// which the SipMessage then keeps; a larger one is copied out as
+   /// before. Each buffer takes this much memory however small the
+   /// message in it, so the pool is off (0) unless set. Read when the
+   /// transport is created.
+   static unsigned int PooledRxBufferSize;
 
    // STUN client functionality
    enum StunResult
@@ -103,10 +123,17 @@ protected:
 
    void processRxAll();
    int processRxRecv(Tuple& sender);
-   void processRxParse(int len, const Tuple& sender);
-   void processRxParseSip(char* buffer, int len, const Tuple& sender);
+   int processRxRecvPooled(Tuple& sender, char*& buffer);
+   void processRxBatch();
+   char* joinRxBuffer(char* pooled, const char* overflow, int len);
+   // If {buffer} is the one in {pooled}, the SipMessage built from it takes
+   // it over and *pooled is cleared.
+   void processRxParse(char* buffer, int len, const Tuple& sender, char** pooled = nullptr);
+   void processRxParseSip(char* buffer, int len, const Tuple& sender, char** pooled = nullptr);
    void processTxAll();
    void processTxOne(SendData *data);
+   void processTxBatch();
+   bool useBatchIo() const;
    void updateEvents();
 
    osc::Stack *mSigcompStack;
@@ -120,7 +147,18 @@ protected:
    unsigned mRxMsgCnt;
    unsigned mRxKeepaliveCnt;
    unsigned mRxTransactionCnt;
+   unsigned mRxBatchCnt;   // recvmmsg() calls that returned data
+   unsigned mTxBatchCnt;   // sendmmsg() calls
+   unsigned mRxPooledCnt;  // messages parsed in place from a pooled buffer
    std::array<char, MaxMessageSize> mRxBuffer{};
+   // ring of MaxBatchSize receive buffers, only allocated in batched mode
+   std::vector<char> mRxBatchBuffers;
+   // Only used when PooledRxBufferSize is set; the pool deletes itself once
+   // the last SipMessage holding one of its buffers is gone.
+   RxBufferPool* mRxBufferPool;
+   size_t mRxPoolCapacity;
+   // pooled buffers ready for the next receive, one per batch slot
+   std::vector<char*> mRxPoolBuffers;
 private:
 #ifdef USE_SIGCOMP
    std::array<char, MaxMessageSize> mRxUncompressedBuffer{};
@@ -134,6 +172,16 @@ private:
 
    ExternalUnknownDatagramHandler* mExternalUnknownDatagramHandler;
    bool mInWritable;
+   std::unique_ptr<TransportThread> mShardThread;
+   // Transports bound to the same ip:port with SO_REUSEPORT; shared by the
+   // shards and left by each as it is destroyed, in whatever order
+   class ShardGroup
+   {
+   public:
+      Mutex mMutex;
+      std::vector<UdpTransport*> mShards;
+   };
+   std::shared_ptr<ShardGroup> mShardGroup;
 };
 
 }
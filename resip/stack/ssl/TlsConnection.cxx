@@ -68,7 +68,9 @@ TlsConnection::TlsConnection( Transport* transport, const Tuple& tuple,
    mServer(server),
    mSecurity(security),
    mSslType( sslType ),
-   mDomain(domain)
+   mDomain(domain),
+   mCoalesceBuffer(0),
+   mPendingWriteSize(0)
 {
 #if defined(USE_SSL)
    InfoLog (<< "Creating TLS connection for domain " 
@@ -171,6 +173,7 @@ TlsConnection::~TlsConnection()
    }
    SSL_free(mSsl);
 #endif // USE_SSL   
+   delete [] mCoalesceBuffer;
 }
 
 
@@ -541,6 +544,7 @@ TlsConnection::write( const char* buf, int count )
    }
         
    ret = SSL_write(mSsl,(const char*)buf,count);
+   mPendingWriteSize = 0;
    if (ret < 0 )
    {
       int err = SSL_get_error(mSsl,ret);
@@ -551,6 +555,8 @@ TlsConnection::write( const char* buf, int count )
          case SSL_ERROR_NONE:
          {
             StackLog( << "Got TLS write got condition of " << err  );
+            // OpenSSL insists the retry passes the same buffer and length
+            mPendingWriteSize = count;
             return 0;
          }
          break;
@@ -579,6 +585,33 @@ TlsConnection::write( const char* buf, int count )
 }
 
 
+int
+TlsConnection::gatherWrite(const WriteSegment* segments, int count)
+{
+   resip_assert(count > 0);
+   // After WANT_READ/WANT_WRITE the same write has to be repeated. Messages
+   // are only ever appended to the queue, so the first mPendingWriteSize
+   // gathered bytes are exactly what was offered last time.
+   int limit = mPendingWriteSize ? mPendingWriteSize : CoalesceBufferSize;
+   if (count == 1 || segments[0].count >= limit)
+   {
+      return write(segments[0].buffer, resipMin(segments[0].count, limit));
+   }
+
+   if (!mCoalesceBuffer)
+   {
+      mCoalesceBuffer = new char[CoalesceBufferSize];
+   }
+   int size = 0;
+   for (int i = 0; i < count && size < limit; ++i)
+   {
+      int n = resipMin(segments[i].count, limit - size);
+      memcpy(mCoalesceBuffer + size, segments[i].buffer, n);
+      size += n;
+   }
+   return write(mCoalesceBuffer, size);
+}
+
 bool 
 TlsConnection::hasDataToRead() // has data that can be read 
 {
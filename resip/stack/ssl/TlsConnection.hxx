@@ -43,6 +43,7 @@ class TlsConnection : public Connection
 
       int read( char* buf, const int count );
       int write( const char* buf, const int count );
+      virtual int gatherWrite(const WriteSegment* segments, int count);
       virtual bool hasDataToRead(); // has data that can be read 
       virtual bool isGood(); // has valid connection
       virtual bool isWritable();
@@ -72,6 +73,13 @@ class TlsConnection : public Connection
       SSL* mSsl;
       BIO* mBio;
       std::list<BaseSecurity::PeerName> mPeerNames;
+
+      /// gathered writes are copied here and go out in one SSL_write(),
+      /// filling a TLS record instead of producing one record per message
+      static const int CoalesceBufferSize = 16384;
+      char* mCoalesceBuffer;
+      /// size of an SSL_write() that must be repeated with the same bytes
+      int mPendingWriteSize;
 };
  
 }
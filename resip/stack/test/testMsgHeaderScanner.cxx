@@ -0,0 +1,280 @@
+// Compares the scalar MsgHeaderScanner against its vector (SSE2/AVX2) fast
+// paths on the RFC 4475 torture test messages kept in this directory. Each
+// message is checked to yield the same fields, with the same text
+// properties, at every level and however it is split into chunks, then the
+// levels are timed.
+//
+//    testMsgHeaderScanner [directory-with-dat-files [iterations]]
+
+#include <assert.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "resip/stack/MsgHeaderScanner.hxx"
+#include "resip/stack/SipMessage.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/Timer.hxx"
+
+using namespace resip;
+using namespace std;
+
+static const char* tortureMessages[] =
+{
+   "badaspec", "badbranch", "baddate", "baddn", "badinv01", "badvers",
+   "bcast", "bext01", "bigcode", "clerr", "cparam01", "cparam02", "dblreq",
+   "esc01", "esc02", "escnull", "escruri", "insuf", "intmeth", "inv2543",
+   "invut", "longreq", "ltgtruri", "lwsdisp", "lwsruri", "lwsstart", "mcl01",
+   "mismatch01", "mismatch02", "mpart01", "multi01", "ncl", "noreason",
+   "novelsc", "quotbal", "regaut01", "regbadct", "regescrt", "scalar02",
+   "scalarlg", "sdp01", "semiuri", "transports", "trws", "unkscm", "unksm2",
+   "unreason", "wsinv", "zeromf"
+};
+
+// Characters handed to each scanChunk() call; 0 is the whole message. The
+// small ones split text units, and vector blocks, everywhere.
+static const size_t chunkSizes[] = { 0, 1, 2, 3, 7, 16, 31, 64, 97 };
+
+// The start line has an empty name
+struct ScannedField
+{
+      Data name;
+      MsgHeaderScanner::TextPropBitMask nameTextProps;
+      Data value;
+      MsgHeaderScanner::TextPropBitMask valueTextProps;
+
+      bool operator==(const ScannedField& rhs) const
+      {
+         return name == rhs.name && nameTextProps == rhs.nameTextProps &&
+                value == rhs.value && valueTextProps == rhs.valueTextProps;
+      }
+};
+
+struct ScanOutcome
+{
+      MsgHeaderScanner::ScanChunkResult result;
+      unsigned int headerCount;
+      size_t unprocessed;   // offset in the message
+      vector<ScannedField> fields;
+};
+
+static const char*
+levelName(MsgHeaderScanner::SimdLevel level)
+{
+   switch (level)
+   {
+      case MsgHeaderScanner::simdSse2: return "sse2";
+      case MsgHeaderScanner::simdAvx2: return "avx2";
+      default: return "scalar";
+   }
+}
+
+static void
+recordField(void* context,
+            const char* name, unsigned int nameLength, MsgHeaderScanner::TextPropBitMask nameTextProps,
+            const char* value, unsigned int valueLength, MsgHeaderScanner::TextPropBitMask valueTextProps)
+{
+   ScannedField field;
+   field.name = name ? Data(name, nameLength) : Data::Empty;
+   field.nameTextProps = nameTextProps;
+   field.value = value ? Data(value, valueLength) : Data::Empty;
+   field.valueTextProps = valueTextProps;
+   static_cast<vector<ScannedField>*>(context)->push_back(field);
+}
+
+// Feeds text to the scanner chunkSize characters at a time, carrying the
+// unprocessed tail of each chunk over into the next, as a stream transport
+// does
+static ScanOutcome
+scanInChunks(MsgHeaderScanner& scanner, const Data& text, size_t chunkSize)
+{
+   if (chunkSize == 0)
+   {
+      chunkSize = text.size();
+   }
+   ScanOutcome outcome;
+   SipMessage msg;
+   scanner.setFieldObserver(recordField, &outcome.fields);
+   scanner.prepareForMessage(&msg);
+   outcome.result = MsgHeaderScanner::scrNextChunk;
+   outcome.unprocessed = 0;
+   size_t end = 0;
+   while (outcome.result == MsgHeaderScanner::scrNextChunk && end < text.size())
+   {
+      const size_t start = outcome.unprocessed;
+      end = resipMin(end + chunkSize, (size_t)text.size());
+      char* chunk = MsgHeaderScanner::allocateBuffer((int)(end - start));
+      // earlier chunks must live on, as the message refers to them
+      msg.addBuffer(chunk);
+      memcpy(chunk, text.data() + start, end - start);
+      char* unprocessed = 0;
+      outcome.result = scanner.scanChunk(chunk, (unsigned int)(end - start), &unprocessed);
+      outcome.unprocessed = start + (unprocessed - chunk);
+   }
+   outcome.headerCount = scanner.getHeaderCount();
+   scanner.setFieldObserver(0, 0);
+   return outcome;
+}
+
+static void
+checkSame(const ScanOutcome& outcome, const ScanOutcome& expected, const char* message,
+          MsgHeaderScanner::SimdLevel level, size_t chunkSize)
+{
+   if (outcome.result != expected.result ||
+       outcome.headerCount != expected.headerCount ||
+       outcome.unprocessed != expected.unprocessed ||
+       !(outcome.fields == expected.fields))
+   {
+      cerr << message << " scans differently with " << levelName(level)
+           << " in chunks of " << chunkSize << endl;
+      assert(0);
+      exit(1);
+   }
+}
+
+static ScanOutcome
+scan(MsgHeaderScanner& scanner, SipMessage& msg, char* buffer, const Data& text)
+{
+   scanner.prepareForMessage(&msg);
+   char* unprocessed = 0;
+   ScanOutcome outcome;
+   outcome.result = scanner.scanChunk(buffer, (unsigned int)text.size(), &unprocessed);
+   outcome.headerCount = scanner.getHeaderCount();
+   outcome.unprocessed = unprocessed - buffer;
+   return outcome;
+}
+
+int
+main(int argc, char** argv)
+{
+   const string directory = argc > 1 ? argv[1] : ".";
+   // few by default, so that it runs quickly as a unit test
+   const int iterations = argc > 2 ? atoi(argv[2]) : 20;
+
+   vector<Data> messages;
+   vector<char*> buffers;
+   size_t totalBytes = 0;
+   for (size_t i = 0; i < sizeof(tortureMessages) / sizeof(tortureMessages[0]); ++i)
+   {
+      ifstream in((directory + "/" + tortureMessages[i] + ".dat").c_str(), ios::binary);
+      if (!in)
+      {
+         cerr << "can not read " << tortureMessages[i] << ".dat from " << directory << endl;
+         return 1;
+      }
+      stringstream contents;
+      contents << in.rdbuf();
+      messages.push_back(Data(contents.str()));
+      buffers.push_back(MsgHeaderScanner::allocateBuffer((int)messages.back().size()));
+      memcpy(buffers.back(), messages.back().data(), messages.back().size());
+      totalBytes += messages.back().size();
+   }
+
+   MsgHeaderScanner scanner;
+   vector<ScanOutcome> expected;
+   MsgHeaderScanner::SimdLevel best = MsgHeaderScanner::getSimdLevel();
+   for (int level = MsgHeaderScanner::simdNone; level <= best; ++level)
+   {
+      MsgHeaderScanner::setSimdLevel((MsgHeaderScanner::SimdLevel)level);
+
+      for (size_t i = 0; i < messages.size(); ++i)
+      {
+         for (size_t c = 0; c < sizeof(chunkSizes) / sizeof(chunkSizes[0]); ++c)
+         {
+            ScanOutcome outcome = scanInChunks(scanner, messages[i], chunkSizes[c]);
+            if (level == MsgHeaderScanner::simdNone && c == 0)
+            {
+               assert(!outcome.fields.empty());
+               expected.push_back(outcome);
+            }
+            else
+            {
+               checkSame(outcome, expected[i], tortureMessages[i],
+                         (MsgHeaderScanner::SimdLevel)level, chunkSizes[c]);
+            }
+         }
+      }
+
+      // Only the scanning is timed, not making and freeing the messages
+      uint64_t elapsed = 0;
+      for (int n = 0; n < iterations; ++n)
+      {
+         vector<SipMessage> msgs(messages.size());
+         uint64_t start = Timer::getTimeMicroSec();
+         for (size_t i = 0; i < messages.size(); ++i)
+         {
+            scan(scanner, msgs[i], buffers[i], messages[i]);
+         }
+         elapsed += Timer::getTimeMicroSec() - start;
+      }
+      if (elapsed == 0)
+      {
+         elapsed = 1;
+      }
+      cout << levelName((MsgHeaderScanner::SimdLevel)level) << ": "
+           << messages.size() * iterations << " messages in " << elapsed / 1000 << " ms, "
+           << (double)totalBytes * iterations / elapsed << " MB/s" << endl;
+   }
+   MsgHeaderScanner::setSimdLevel(best);
+
+   for (size_t i = 0; i < buffers.size(); ++i)
+   {
+      delete [] buffers[i];
+   }
+
+   cout << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
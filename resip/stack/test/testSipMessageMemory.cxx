@@ -1,9 +1,13 @@
+#include "resip/stack/RxBufferPool.hxx"
 #include "resip/stack/SipMessage.hxx"
 #include "resip/stack/Uri.hxx"
 #include "resip/stack/test/TestSupport.hxx"
 
+#include <cstring>
 #include <iostream>
 #include <memory>
+#include <thread>
+#include <vector>
 
 using namespace resip;
 using namespace std;
@@ -69,6 +73,82 @@ main()
       assert(message1->getRawHeader(Headers::CSeq)->getParserContainer());
    }
 
+   {
+      resipCerr << "Testing pooled receive buffers" << endl;
+
+      RxBufferPool* pool = new RxBufferPool(64, 1);
+      char* first = pool->acquire();
+      char* second = pool->acquire();
+      assert(RxBufferPool::getNumInUse() == 2);
+
+      // goes back on the free list, which only has room for one
+      RxBufferPool::release(first);
+      assert(RxBufferPool::getNumInUse() == 1);
+      assert(RxBufferPool::getNumFree() == 1);
+      assert(pool->acquire() == first);
+      assert(RxBufferPool::getNumFree() == 0);
+
+      unique_ptr<SipMessage> message(new SipMessage);
+      message->addPooledBuffer(second);
+
+      // the pool outlives its owner until the message lets go of its buffer
+      RxBufferPool::release(first);
+      pool->shutdown();
+      assert(RxBufferPool::getNumInUse() == 1);
+      message.reset();
+      assert(RxBufferPool::getNumInUse() == 0);
+      assert(RxBufferPool::getNumFree() == 0);
+   }
+
+   {
+      resipCerr << "Testing pooled receive buffers released from other threads" << endl;
+
+      // each buffer is stamped when acquired, so that one handed out twice
+      // shows up as a changed stamp when it is released
+      RxBufferPool* pool = new RxBufferPool(64, 16);
+      for (int round = 0; round < 200; ++round)
+      {
+         vector<char*> out;
+         for (int i = 0; i < 64; ++i)
+         {
+            out.push_back(pool->acquire());
+            memset(out.back(), i, 64);
+         }
+         vector<thread> releasers;
+         for (int t = 0; t < 4; ++t)
+         {
+            releasers.emplace_back([&out, t]()
+            {
+               for (int i = t; i < 64; i += 4)
+               {
+                  assert(out[i][0] == (char)i && out[i][63] == (char)i);
+                  RxBufferPool::release(out[i]);
+               }
+            });
+         }
+         // the owner keeps taking buffers off the free list meanwhile
+         vector<char*> held;
+         for (int i = 0; i < 16; ++i)
+         {
+            held.push_back(pool->acquire());
+            memset(held.back(), 100 + i, 64);
+         }
+         for (vector<thread>::iterator it = releasers.begin(); it != releasers.end(); ++it)
+         {
+            it->join();
+         }
+         for (int i = 0; i < 16; ++i)
+         {
+            assert(held[i][0] == (char)(100 + i) && held[i][63] == (char)(100 + i));
+            RxBufferPool::release(held[i]);
+         }
+      }
+      assert(RxBufferPool::getNumInUse() == 0);
+      assert(RxBufferPool::getNumFree() <= 16);
+      pool->shutdown();
+      assert(RxBufferPool::getNumFree() == 0);
+   }
+
    resipCout << "All OK" << endl;
    return 0;
 }
@@ -25,6 +25,7 @@
 #include "resip/stack/StackThread.hxx"
 #include "rutil/SelectInterruptor.hxx"
 #include "resip/stack/TransportThread.hxx"
+#include "resip/stack/UdpTransport.hxx"
 #include "resip/stack/InterruptableStackThread.hxx"
 #include "resip/stack/EventStackThread.hxx"
 #include "resip/stack/Uri.hxx"
@@ -616,6 +617,9 @@ main(int argc, char* argv[])
    int portBase = 0;
    const char* threadType = "event";
    int tpFlags = 0;
+   int udpShards = 1;
+   int txShards = 1;
+   int rxPoolSize = (int)UdpTransport::PooledRxBufferSize;
    int sendSleepMs = 0;
    int cManager=0;
    int statisticsInterval=60;
@@ -642,6 +646,9 @@ main(int argc, char* argv[])
       {"numports",    'n', POPT_ARG_INT,    &numPorts,  0, "number of parallel sessions(ports)", 0},
       {"thread-type", 't', POPT_ARG_STRING, &threadType,0, "stack thread type", threadTypeDesc},
       {"tf",          0,   POPT_ARG_INT,    &tpFlags,   0, "bit encoding of transportFlags", 0},
+      {"udp-shards",  0,   POPT_ARG_INT,    &udpShards, 0, "number of SO_REUSEPORT shards for the receiver UDP transport", 0},
+      {"tx-shards",   0,   POPT_ARG_INT,    &txShards,  0, "number of transaction layer shards in each stack", 0},
+      {"rx-pool-size",0,   POPT_ARG_INT,    &rxPoolSize,0, "size of the pooled UDP receive buffers, 0 to copy each datagram", 0},
       {"sleep",       0,   POPT_ARG_INT,    &sendSleepMs,0, "time (ms) to sleep after each sent request", 0},
       {"use-congestion-manager",0, POPT_ARG_NONE, &cManager ,   0, "use a CongestionManager", 0},
       {"statistics-interval",       0,   POPT_ARG_INT,    &statisticsInterval,0, "time in seconds between statistics logging", 0},
@@ -684,6 +691,9 @@ main(int argc, char* argv[])
      <<" bindIf="<<bindIfAddr
      <<" listen="<<doListen
      <<" tf="<<tpFlags
+     <<" udpShards="<<udpShards
+     <<" txShards="<<txShards
+     <<" rxPoolSize="<<rxPoolSize
      <<" domain="<<sipDomain
      <<"." << endl;
 
@@ -717,10 +727,17 @@ main(int argc, char* argv[])
    {
       notifyUp = &sharedUp;
    }
+   UdpTransport::PooledRxBufferSize = (unsigned int)rxPoolSize;
+
    SipStackAndThread receiver(eachThreadType, commonIntr, notifyUp);
    SipStackAndThread sender(eachThreadType, commonIntr, notifyUp);
    receiver.getStack().setStatisticsInterval(statisticsInterval);
    sender.getStack().setStatisticsInterval(statisticsInterval);
+   if (txShards > 1)
+   {
+      receiver.getStack().setTransactionShards(txShards);
+      sender.getStack().setTransactionShards(txShards);
+   }
 
    IpVersion version = (v6 ? V6 : V4);
 
@@ -813,7 +830,7 @@ main(int argc, char* argv[])
 
       // NOTE: we could also bind receive to bindIfAddr, but existing code
       // doesn't do this. Responses are sent from here, so why don't we?
-      transports.push_back(receiver->addTransport(UDP, 
+      Transport* receiverUdp = receiver->addTransport(UDP, 
                              registrarPort+idx, 
                              version, 
                              StunDisabled,
@@ -821,7 +838,18 @@ main(int argc, char* argv[])
                              /*sipDomain*/Data::Empty, 
                              /*keypass*/Data::Empty, 
                              SecurityTypes::SSLv23,
-                             tpFlags));
+                             tpFlags,
+                             /*certificateFilename*/"", /*privateKeyFilename*/"",
+                             SecurityTypes::None,
+                             /*useEmailAsSIP*/false,
+                             nullptr, nullptr,
+                             /*netNs*/Data::Empty,
+                             udpShards);
+      // sharded transports run their own threads
+      if (udpShards <= 1)
+      {
+         transports.push_back(receiverUdp);
+      }
 
       transports.push_back(receiver->addTransport(TCP, 
                              registrarPort+idx, 
@@ -1,9 +1,13 @@
 #include <iostream>
 #include "resip/stack/TransactionMessage.hxx"
 #include "resip/stack/TimerQueue.hxx"
+#include "resip/stack/TimerWheel.hxx"
 #include "resip/stack/TuSelector.hxx"
 #include "rutil/Fifo.hxx"
 #include "rutil/TimeLimitFifo.hxx"
+
+#include <map>
+#include <stdlib.h>
 #ifdef WIN32
 #include <io.h>
 #else
@@ -25,6 +29,101 @@ isNear(int value, int reference, int epsilon=250)
    return (diff < epsilon);
 }
 
+class WheelTimer
+{
+   public:
+      WheelTimer(uint64_t when, int tag) : mWhen(when), mTag(tag) {}
+      uint64_t getWhen() const { return mWhen; }
+      int getTag() const { return mTag; }
+   private:
+      uint64_t mWhen;
+      int mTag;
+};
+
+// Drives a TimerWheel with a simulated clock, and checks every timer fires
+// exactly once, in order, no earlier than its expiry and no later than the
+// process() call that follows it.
+void
+testTimerWheel()
+{
+   const uint64_t start = 1000000007ULL;
+   TimerWheel<WheelTimer> wheel(start);
+   std::map<int, uint64_t> pending;
+   std::map<int, TimerWheel<WheelTimer>::Id> ids;
+
+   srand(42);
+   uint64_t now = start;
+   uint64_t floor = start; // the wheel has processed every tick before this
+   int tag = 0;
+   for (int round = 0; round < 2000; ++round)
+   {
+      for (int i = rand() % 20; i > 0; --i)
+      {
+         // mostly short timers, some spanning the upper levels of the wheel
+         uint64_t offset = rand() % 4 == 0 ? 
+                           ((uint64_t)rand() * rand()) % (1ULL << 34) : 
+                           rand() % 70000;
+         ids[tag] = wheel.add(WheelTimer(now + offset, tag));
+         pending[tag] = now + offset;
+         ++tag;
+      }
+
+      // cancel a few at random
+      for (int i = rand() % 5; i > 0 && !pending.empty(); --i)
+      {
+         std::map<int, uint64_t>::iterator it = pending.lower_bound(rand() % tag);
+         if (it == pending.end())
+         {
+            continue;
+         }
+         assert(wheel.cancel(ids[it->first]));
+         assert(!wheel.cancel(ids[it->first]));
+         pending.erase(it);
+      }
+      assert(wheel.size() == pending.size());
+
+      if (!pending.empty())
+      {
+         uint64_t earliest = (uint64_t)-1;
+         for (std::map<int, uint64_t>::const_iterator it = pending.begin(); it != pending.end(); ++it)
+         {
+            earliest = resipMin(earliest, it->second);
+         }
+         assert(wheel.nextTick() == resipMax(earliest, floor));
+      }
+
+      now += round % 100 == 0 ? ((uint64_t)rand() * rand()) % (1ULL << 32) : rand() % 3000;
+      uint64_t lastFired = 0;
+      wheel.process(now, [&](const WheelTimer& t)
+      {
+         std::map<int, uint64_t>::iterator it = pending.find(t.getTag());
+         assert(it != pending.end());
+         assert(t.getWhen() <= now);
+         // timers added after the last process() that were already due
+         // fire first
+         uint64_t tick = resipMax(t.getWhen(), floor);
+         assert(tick >= lastFired);
+         lastFired = tick;
+         pending.erase(it);
+      });
+      floor = now + 1;
+
+      for (std::map<int, uint64_t>::const_iterator it = pending.begin(); it != pending.end(); ++it)
+      {
+         assert(it->second > now);
+      }
+      assert(wheel.size() == pending.size());
+   }
+
+   // handles of fired timers are stale
+   for (std::map<int, TimerWheel<WheelTimer>::Id>::const_iterator it = ids.begin(); it != ids.end(); ++it)
+   {
+      assert(wheel.cancel(it->second) == (pending.count(it->first) == 1));
+   }
+   assert(wheel.empty());
+   cerr << "TimerWheel: " << tag << " timers OK" << endl;
+}
+
 
 int
 main()
@@ -118,6 +217,40 @@ main()
    timer.process();   
    assert(r.size() == 5);
 
+   testTimerWheel();
+
+   {
+      // Same queue, kept in a timing wheel, with cancellation
+      TimerQueueBase::UseTimerWheel = true;
+      Fifo<TimerMessage> w;
+      TransactionTimerQueue wheelTimer(w);
+      TimerQueueBase::UseTimerWheel = false;
+
+      assert(wheelTimer.msTillNextTimer() == INT_MAX);
+      TransactionTimerQueue::Id first = wheelTimer.add(Timer::TimerE1, "first", 500);
+      TransactionTimerQueue::Id second = wheelTimer.add(Timer::TimerF, "second", 1000);
+      wheelTimer.add(Timer::TimerK, "third", 32000);
+      assert(first && second && first != second);
+      assert(wheelTimer.size() == 3);
+      assert(isNear(wheelTimer.msTillNextTimer(), 500));
+
+      assert(wheelTimer.cancel(first));
+      assert(!wheelTimer.cancel(first));
+      assert(wheelTimer.size() == 2);
+      assert(isNear(wheelTimer.msTillNextTimer(), 1000));
+      cerr << wheelTimer << endl;
+
+      sleep(1);
+      wheelTimer.process();
+      assert(w.size() == 1);
+      TimerMessage* fired = w.getNext();
+      assert(fired->getTransactionId() == "second");
+      delete fired;
+      assert(!wheelTimer.cancel(second));
+      assert(wheelTimer.size() == 1);
+      assert(isNear(wheelTimer.msTillNextTimer(), 31000));
+   }
+
    cerr << "All OK" << endl;
    return 0;
 }
@@ -53,6 +53,9 @@ GeneralCongestionManager::updateFifoTolerances(
                                           uint32_t maxTolerance )
 {
    Lock lock(mFifosMutex);
+   // Several fifos can share a description (eg. the state machine fifos of a
+   // sharded TransactionController), so update all of them
+   bool found = false;
    for(std::vector<FifoInfo>::iterator i=mFifos.begin(); i!=mFifos.end(); ++i)
    {
       if(i->fifo && // ensure fifo isn't 0'd out from unregister call
@@ -61,10 +64,10 @@ GeneralCongestionManager::updateFifoTolerances(
          i->maxTolerance=UINT_MAX;  // Set temporarily to UINT_MAX, so that we don't inadvertantly reject a request while the metric and tolerance are being changed.
          i->metric=metric;
          i->maxTolerance=maxTolerance;
-         if(!fifoDescription.empty()) return true;
+         found = true;
       }
    }
-   return false || fifoDescription.empty();
+   return found || fifoDescription.empty();
 }
 
 CongestionManager::RejectionBehavior 
@@ -58,7 +58,8 @@ class GeneralCongestionManager : public CongestionManager
          Update the metric type and tolerances of a given fifo that the 
             GeneralCongestionManager is already aware of.
          @param fifoDescription The description of the fifo that we are 
-            modifying the tolerances of.  Specify as empty to adjust all
+            modifying the tolerances of; every registered fifo with this 
+            description is adjusted.  Specify as empty to adjust all
             registered fifos.
          @param metric The type of metric that will be used to define this 
             fifo's congestion state.
@@ -17,7 +17,9 @@
 
 #include "rutil/Log.hxx"
 #include "rutil/Logger.hxx"
+#include "rutil/MpscRing.hxx"
 #include "rutil/ParseBuffer.hxx"
+#include "rutil/Time.hxx"
 #include "rutil/ThreadIf.hxx"
 #include "rutil/Subsystem.hxx"
 #include "rutil/SysLogStream.hxx"
@@ -82,6 +84,182 @@ Log::mSyslogPriority[] = { 0, LOG_CRIT, LOG_CRIT, LOG_CRIT, LOG_ERR, LOG_WARNING
 
 Mutex Log::_mutex;
 
+/**
+   Writer thread for asynchronous logging. Logging threads format their
+   entry as usual and copy it into a slot of mRing; this thread takes the
+   entries out in order and writes them exactly as a synchronous Guard
+   would have (see Log::output()).
+*/
+class Log::AsyncWriter : public ThreadIf
+{
+   public:
+      struct Entry
+      {
+         Entry()
+            : level(Log::Info), subsystem(0), file(0), line(0),
+              headerLength(0), loggerData(0)
+         {}
+
+         Log::Level level;
+         const Subsystem* subsystem;
+         const char* file;
+         int line;
+         Data::size_type headerLength;
+         Log::ThreadData* loggerData;
+         Data message; // keeps its capacity from one use of the slot to the next
+      };
+
+      AsyncWriter(unsigned int queueSize, bool dropWhenFull)
+         : mRing(queueSize),
+           mDropWhenFull(dropWhenFull),
+           mPushed(0),
+           mWritten(0),
+           mSleeping(false)
+      {}
+
+      /** Queues an entry. Returns false if the caller has to write the entry
+          itself, which is the case when the writer thread logs (e.g. from an
+          ExternalLogger). Dropped entries count as handled. */
+      bool push(Log::Level level, const Subsystem& subsystem,
+                const char* file, int line, Data::size_type headerLength,
+                Log::ThreadData& loggerData, const Data& message)
+      {
+         if (ThreadIf::selfId() == mId)
+         {
+            return false;
+         }
+
+         Filler fill(level, subsystem, file, line, headerLength, loggerData, message);
+         while (!mRing.tryPush(fill))
+         {
+            if (mDropWhenFull)
+            {
+               ++Log::mAsyncDropped;
+               return true;
+            }
+            wake();
+            std::this_thread::yield();
+         }
+         ++mPushed;
+         if (mSleeping.load(std::memory_order_relaxed))
+         {
+            wake();
+         }
+         return true;
+      }
+
+      /// returns once everything pushed before the call has been written
+      void flush()
+      {
+         if (ThreadIf::selfId() == mId)
+         {
+            return;
+         }
+         const uint64_t target = mPushed.load();
+         while (mWritten.load() < target)
+         {
+            wake();
+            sleepMs(1);
+         }
+      }
+
+      virtual void shutdown()
+      {
+         ThreadIf::shutdown();
+         wake();
+      }
+
+      virtual void thread()
+      {
+         while (!isShutdown())
+         {
+            if (!drain())
+            {
+               Lock lock(mWakeMutex);
+               mSleeping = true;
+               if (mRing.size() == 0 && !isShutdown())
+               {
+                  // a wake-up can slip past the flag; the timeout bounds the delay
+                  mWakeCondition.wait_for(lock, std::chrono::milliseconds(20));
+               }
+               mSleeping = false;
+            }
+         }
+         while (drain())
+         {
+         }
+      }
+
+   private:
+      struct Filler
+      {
+         Filler(Log::Level level, const Subsystem& subsystem,
+                const char* file, int line, Data::size_type headerLength,
+                Log::ThreadData& loggerData, const Data& message)
+            : mLevel(level), mSubsystem(subsystem), mFile(file), mLine(line),
+              mHeaderLength(headerLength), mLoggerData(loggerData), mMessage(message)
+         {}
+
+         void operator()(Entry& entry)
+         {
+            entry.level = mLevel;
+            entry.subsystem = &mSubsystem;
+            entry.file = mFile;
+            entry.line = mLine;
+            entry.headerLength = mHeaderLength;
+            entry.loggerData = &mLoggerData;
+            entry.message = mMessage;
+         }
+
+         Log::Level mLevel;
+         const Subsystem& mSubsystem;
+         const char* mFile;
+         int mLine;
+         Data::size_type mHeaderLength;
+         Log::ThreadData& mLoggerData;
+         const Data& mMessage;
+      };
+
+      struct Writer
+      {
+         void operator()(Entry& entry)
+         {
+            Log::output(*entry.loggerData, entry.level, *entry.subsystem,
+                        entry.file, entry.line, entry.headerLength, entry.message);
+         }
+      };
+
+      /// writes a batch of entries; returns false if there was nothing to write
+      bool drain()
+      {
+         Writer write;
+         int count = 0;
+         while (count < 256 && mRing.tryPop(write))
+         {
+            ++count;
+         }
+         mWritten += count;
+         return count > 0;
+      }
+
+      void wake()
+      {
+         mWakeCondition.notify_one();
+      }
+
+      MpscRing<Entry> mRing;
+      const bool mDropWhenFull;
+      std::atomic<uint64_t> mPushed;
+      std::atomic<uint64_t> mWritten;
+      std::atomic<bool> mSleeping;
+      Mutex mWakeMutex;
+      Condition mWakeCondition;
+};
+
+std::atomic<Log::AsyncWriter*> Log::mAsyncWriter(0);
+std::atomic<int> Log::mAsyncUsers(0);
+std::atomic<uint64_t> Log::mAsyncDropped(0);
+
 extern "C"
 {
    void freeThreadSetting(void* setting)
@@ -391,6 +569,55 @@ Log::initialize(const ConfigParse& configParse, const Data& appName, ExternalLog
 
    unsigned int loggingFileMaxLineCount = configParse.getConfigUnsignedLong("LogFileMaxLines", RESIP_LOG_MAX_LINE_COUNT_DEFAULT);
    Log::setMaxLineCount(loggingFileMaxLineCount);
+
+   if (configParse.getConfigBool("LogAsync", false))
+   {
+      Log::startAsync(configParse.getConfigUnsignedLong("LogAsyncQueueSize", 8192),
+                      configParse.getConfigBool("LogAsyncDropWhenFull", true));
+   }
+   else
+   {
+      Log::stopAsync();
+   }
+}
+
+void
+Log::startAsync(unsigned int queueSize, bool dropWhenFull)
+{
+   stopAsync();
+   AsyncWriter* writer = new AsyncWriter(queueSize ? queueSize : 8192, dropWhenFull);
+   writer->run();
+   mAsyncWriter = writer;
+}
+
+void
+Log::stopAsync()
+{
+   AsyncWriter* writer = mAsyncWriter.exchange(0);
+   if (writer == 0)
+   {
+      return;
+   }
+   // a Guard that saw the writer before the exchange may still be pushing
+   while (mAsyncUsers.load() != 0)
+   {
+      std::this_thread::yield();
+   }
+   writer->shutdown();
+   writer->join();  // the thread writes whatever is left before it exits
+   delete writer;
+}
+
+void
+Log::flushAsync()
+{
+   ++mAsyncUsers;
+   AsyncWriter* writer = mAsyncWriter.load();
+   if (writer)
+   {
+      writer->flush();
+   }
+   --mAsyncUsers;
 }
 
 void
@@ -893,11 +1120,15 @@ int Log::localLoggerReinitialize(Log::LocalLoggerId loggerId,
                                  ExternalLogger* externalLogger,
                                  MessageStructure messageStructure)
 {
+   // queued entries for this logger were meant for its old settings
+   flushAsync();
    return mLocalLoggerMap.reinitialize(loggerId, type, level, logFileName, externalLogger, messageStructure);
 }
 
 int Log::localLoggerRemove(Log::LocalLoggerId loggerId)
 {
+   // queued entries may still point at this logger's ThreadData
+   flushAsync();
    return mLocalLoggerMap.remove(loggerId);
 }
 
@@ -1125,25 +1356,51 @@ Log::Guard::~Guard()
 
    mStream.flush();
 
-   if (resip::Log::getExternal())
+   if (mAsyncWriter.load(std::memory_order_relaxed))
+   {
+      ++mAsyncUsers;
+      AsyncWriter* writer = mAsyncWriter.load();
+      const bool queued = writer &&
+         writer->push(mLevel, mSubsystem, mFile, mLine, mHeaderLength,
+                      resip::Log::getLoggerData(), mData);
+      --mAsyncUsers;
+      if (queued)
+      {
+         return;
+      }
+   }
+
+   output(resip::Log::getLoggerData(), mLevel, mSubsystem, mFile, mLine, mHeaderLength, mData);
+}
+
+void
+Log::output(ThreadData& loggerData,
+            Level level,
+            const Subsystem& subsystem,
+            const char* file,
+            int line,
+            Data::size_type headerLength,
+            Data& message)
+{
+   if (loggerData.mExternalLogger)
    {
       const resip::Data rest(resip::Data::Share,
-                             mData.data() + mHeaderLength,
-                             (int)mData.size() - mHeaderLength);
-      if (!(*resip::Log::getExternal())(mLevel, 
-                                        mSubsystem, 
-                                        resip::Log::getAppName(),
-                                        mFile,
-                                        mLine, 
-                                        rest, 
-                                        mData,
-                                        mInstanceName))
+                             message.data() + headerLength,
+                             (int)message.size() - headerLength);
+      if (!(*loggerData.mExternalLogger)(level, 
+                                         subsystem, 
+                                         resip::Log::getAppName(),
+                                         file,
+                                         line, 
+                                         rest, 
+                                         message,
+                                         mInstanceName))
       {
          return;
       }
    }
     
-   Type logType = resip::Log::getLoggerData().mType;
+   Type logType = loggerData.type();
 
    if(logType == resip::Log::OnlyExternal ||
       logType == resip::Log::OnlyExternalNoHeaders) 
@@ -1155,18 +1412,18 @@ Log::Guard::~Guard()
    // !dlb! implement VSDebugWindow as an external logger
    if (logType == resip::Log::VSDebugWindow)
    {
-      mData += "\r\n";
-      OutputToWin32DebugWindow(mData);
+      message += "\r\n";
+      OutputToWin32DebugWindow(message);
    }
    else 
    {
       // endl is magic in syslog -- so put it here
-      std::ostream& _instance = Instance((int)mData.size()+2);
+      std::ostream& _instance = loggerData.Instance((int)message.size()+2);
       if (logType == resip::Log::Syslog)
       {
-         _instance << mLevel;
+         _instance << level;
       }
-      _instance << mData << std::endl;  
+      _instance << message << std::endl;  
    }
 }
 
@@ -8,6 +8,7 @@
 #include <unistd.h>
 #endif
 
+#include <atomic>
 #include <set>
 
 #include "rutil/ConfigParse.hxx"
@@ -206,6 +207,26 @@ class Log
                              const Data& appName,
                              ExternalLogger* externalLogger = 0);
 
+      /** @brief Switch to asynchronous logging.
+      * Log statements are still formatted on the calling thread, but are then
+      * copied into a lock-free queue of queueSize entries instead of being
+      * written under the log mutex. A writer thread takes them off the queue
+      * and writes them to the configured destination (including any
+      * ExternalLogger), in order. If the queue is full the entry is dropped
+      * and counted when dropWhenFull is set; otherwise the logging thread
+      * waits for room. Call stopAsync() before exit, or whatever is still
+      * queued is lost.
+      */
+      static void startAsync(unsigned int queueSize = 8192, bool dropWhenFull = true);
+      /** @brief Write out everything queued, stop the writer thread and return
+      * to synchronous logging. */
+      static void stopAsync();
+      static bool isAsync() { return mAsyncWriter.load() != 0; }
+      /** @brief Wait until everything logged so far has been written. */
+      static void flushAsync();
+      /** @brief Number of entries dropped because the async queue was full. */
+      static uint64_t getAsyncDropped() { return mAsyncDropped.load(); }
+
       /** @brief Set logging level for current thread.
       * If thread has no local logger attached, then set global logging level.
       */
@@ -285,6 +306,9 @@ class Log
 #endif
 
    protected:
+      class AsyncWriter;
+      friend class AsyncWriter;
+
       static Mutex _mutex;
       static volatile short touchCount;
       static const Data delim;
@@ -370,6 +394,19 @@ class Log
       static const int mSyslogPriority[];
       static Data mInstanceName;
 
+      /// hands a formatted entry to the logger (external, then stream)
+      static void output(ThreadData& loggerData,
+                         Level level,
+                         const Subsystem& subsystem,
+                         const char* file,
+                         int line,
+                         Data::size_type headerLength,
+                         Data& message);
+
+      static std::atomic<AsyncWriter*> mAsyncWriter;
+      static std::atomic<int> mAsyncUsers; ///< Guards between loading and using mAsyncWriter
+      static std::atomic<uint64_t> mAsyncDropped;
+
       static ThreadData &getLoggerData()
       {
          ThreadData* pData = static_cast<ThreadData*>(ThreadIf::tlsGetValue(*Log::mLocalLoggerKey));
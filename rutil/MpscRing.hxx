@@ -0,0 +1,196 @@
+#if !defined(RESIP_MpscRing_hxx)
+#define RESIP_MpscRing_hxx
+
+#include <atomic>
+#include <cstddef>
+
+#include "rutil/ResipAssert.h"
+
+namespace resip
+{
+
+/**
+   @brief Bounded lock-free queue for many producers and a single consumer.
+
+   A ring of capacity slots (rounded up to a power of two), each with a
+   sequence number that tells producers and the consumer whose turn the
+   slot is (D. Vyukov's bounded queue). Producers claim a slot with one
+   compare-and-swap on the enqueue position; nothing ever blocks, a full
+   ring simply makes tryPush() fail.
+
+   Elements are not moved in and out: the slots are constructed once and
+   tryPush()/tryPop() hand a reference to the slot to a functor. This lets
+   T keep its storage between uses (e.g. a Data that is assigned to
+   rather than reallocated).
+
+   @ingroup message_passing
+*/
+template <class T>
+class MpscRing
+{
+   public:
+      explicit MpscRing(size_t capacity)
+         : mCapacity(roundUp(capacity)),
+           mMask(mCapacity - 1),
+           mCells(new Cell[mCapacity]),
+           mEnqueuePos(0),
+           mDequeuePos(0)
+      {
+         for (size_t i = 0; i < mCapacity; ++i)
+         {
+            mCells[i].sequence.store(i, std::memory_order_relaxed);
+         }
+      }
+
+      ~MpscRing()
+      {
+         delete [] mCells;
+      }
+
+      /** Claims a free slot and calls fill(T&) on it. Safe from any number
+          of threads at once. Returns false, without calling fill, if the
+          ring is full. */
+      template <class Fill>
+      bool tryPush(Fill& fill)
+      {
+         Cell* cell;
+         size_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+         for (;;)
+         {
+            cell = &mCells[pos & mMask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            ptrdiff_t diff = (ptrdiff_t)seq - (ptrdiff_t)pos;
+            if (diff == 0)
+            {
+               if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+               {
+                  break;
+               }
+            }
+            else if (diff < 0)
+            {
+               return false;
+            }
+            else
+            {
+               pos = mEnqueuePos.load(std::memory_order_relaxed);
+            }
+         }
+         fill(cell->value);
+         cell->sequence.store(pos + 1, std::memory_order_release);
+         return true;
+      }
+
+      /** Calls consume(T&) on the oldest element and releases its slot.
+          Only one thread may pop. Returns false if the ring is empty. A
+          slot that has been claimed but not yet filled also reads as
+          empty, so the consumer never waits on a producer. */
+      template <class Consume>
+      bool tryPop(Consume& consume)
+      {
+         const size_t pos = mDequeuePos.load(std::memory_order_relaxed);
+         Cell* cell = &mCells[pos & mMask];
+         size_t seq = cell->sequence.load(std::memory_order_acquire);
+         if ((ptrdiff_t)seq - (ptrdiff_t)(pos + 1) < 0)
+         {
+            return false;
+         }
+         consume(cell->value);
+         cell->sequence.store(pos + mMask + 1, std::memory_order_release);
+         mDequeuePos.store(pos + 1, std::memory_order_relaxed);
+         return true;
+      }
+
+      size_t capacity() const { return mCapacity; }
+
+      /// approximate; exact only when no push or pop is in progress
+      size_t size() const
+      {
+         const size_t dequeued = mDequeuePos.load(std::memory_order_relaxed);
+         return mEnqueuePos.load(std::memory_order_relaxed) - dequeued;
+      }
+
+   private:
+      struct Cell
+      {
+         std::atomic<size_t> sequence;
+         T value;
+      };
+
+      static size_t roundUp(size_t capacity)
+      {
+         size_t result = 2;
+         while (result < capacity)
+         {
+            result <<= 1;
+         }
+         return result;
+      }
+
+      const size_t mCapacity;
+      const size_t mMask;
+      Cell* mCells;
+      // keep producers and the consumer off each other's cache line
+      char mPad0[64];
+      std::atomic<size_t> mEnqueuePos;
+      char mPad1[64];
+      std::atomic<size_t> mDequeuePos;
+
+      // no value semantics
+      MpscRing(const MpscRing&);
+      MpscRing& operator=(const MpscRing&);
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,169 @@
+#if !defined(RESIP_SpscRing_hxx)
+#define RESIP_SpscRing_hxx
+
+#include <atomic>
+#include <cstddef>
+
+namespace resip
+{
+
+/**
+   @brief Bounded lock-free queue for one producer and one consumer.
+
+   A ring of capacity slots (rounded up to a power of two) with a read and
+   a write position. Each side only writes its own position, so a push or
+   pop is a load of the other side's position and a store of its own; no
+   compare-and-swap and nothing that blocks. A full ring makes tryPush()
+   fail, an empty one tryPop().
+
+   As with MpscRing, the slots are constructed once and tryPush()/tryPop()
+   hand a reference to the slot to a functor, so T can be moved in and out
+   without allocating.
+
+   Only one thread may push and only one (other) thread may pop at a time.
+   Use MpscRing when there are several producers.
+
+   @ingroup message_passing
+*/
+template <class T>
+class SpscRing
+{
+   public:
+      explicit SpscRing(size_t capacity)
+         : mCapacity(roundUp(capacity)),
+           mMask(mCapacity - 1),
+           mSlots(new T[mCapacity]),
+           mWritePos(0),
+           mReadPos(0)
+      {
+      }
+
+      ~SpscRing()
+      {
+         delete [] mSlots;
+      }
+
+      /** Calls fill(T&) on the next free slot and makes it visible to the
+          consumer. Returns false, without calling fill, if the ring is
+          full. */
+      template <class Fill>
+      bool tryPush(Fill& fill)
+      {
+         const size_t pos = mWritePos.load(std::memory_order_relaxed);
+         if (pos - mReadPos.load(std::memory_order_acquire) == mCapacity)
+         {
+            return false;
+         }
+         fill(mSlots[pos & mMask]);
+         mWritePos.store(pos + 1, std::memory_order_release);
+         return true;
+      }
+
+      /** Calls consume(T&) on the oldest element and frees its slot.
+          Returns false if the ring is empty. */
+      template <class Consume>
+      bool tryPop(Consume& consume)
+      {
+         const size_t pos = mReadPos.load(std::memory_order_relaxed);
+         if (pos == mWritePos.load(std::memory_order_acquire))
+         {
+            return false;
+         }
+         consume(mSlots[pos & mMask]);
+         mReadPos.store(pos + 1, std::memory_order_release);
+         return true;
+      }
+
+      /// exact for the consumer; the producer may add more at any time
+      bool empty() const
+      {
+         return mReadPos.load(std::memory_order_relaxed) == mWritePos.load(std::memory_order_acquire);
+      }
+
+      size_t capacity() const { return mCapacity; }
+
+      /// approximate; exact only when no push or pop is in progress
+      size_t size() const
+      {
+         const size_t read = mReadPos.load(std::memory_order_relaxed);
+         return mWritePos.load(std::memory_order_relaxed) - read;
+      }
+
+   private:
+      static size_t roundUp(size_t capacity)
+      {
+         size_t result = 2;
+         while (result < capacity)
+         {
+            result <<= 1;
+         }
+         return result;
+      }
+
+      const size_t mCapacity;
+      const size_t mMask;
+      T* mSlots;
+      // keep the producer and the consumer off each other's cache line
+      char mPad0[64];
+      std::atomic<size_t> mWritePos;
+      char mPad1[64];
+      std::atomic<size_t> mReadPos;
+
+      // no value semantics
+      SpscRing(const SpscRing&);
+      SpscRing& operator=(const SpscRing&);
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -88,6 +88,9 @@ DnsStub::DnsStub(const NameserverList& additional,
    mTransform(0),
    mDnsProvider(ExternalDnsFactory::createExternalDns()),
    mPollGrp(0),
+   mQueriesSent(0),
+   mQueriesCoalesced(0),
+   mCacheRefreshes(0),
    mAsyncProcessHandler(asyncProcessHandler)
 {
    setPollGrp(pollGrp);
@@ -116,8 +119,30 @@ DnsStub::~DnsStub()
       delete *it;
    }
 
+   // the queries are gone; anything the provider reports while shutting down
+   // must not reach them, nor the cache
+   for (PendingLookupMap::iterator it = mPendingLookups.begin(); it != mPendingLookups.end(); ++it)
+   {
+      it->second->mSinks.clear();
+      it->second->mRefresh = false;
+   }
+   for (set<PendingLookup*>::iterator it = mOrphanedLookups.begin(); it != mOrphanedLookups.end(); ++it)
+   {
+      (*it)->mSinks.clear();
+      (*it)->mRefresh = false;
+   }
+
    setPollGrp(0);
    delete mDnsProvider;
+
+   for (PendingLookupMap::iterator it = mPendingLookups.begin(); it != mPendingLookups.end(); ++it)
+   {
+      delete it->second;
+   }
+   for (set<PendingLookup*>::iterator it = mOrphanedLookups.begin(); it != mOrphanedLookups.end(); ++it)
+   {
+      delete *it;
+   }
 }
 
 unsigned int
@@ -468,8 +493,15 @@ DnsStub::Query::go()
    DnsResourceRecordsByPtr records;
    int status = 0;
    bool cached = false;
+   // each cache hit on the way may ask for its own name to be refreshed
+   std::vector<std::pair<Data, int> > refreshes;
+   bool refresh = false;
    Data targetToQuery = mTarget;
-   cached = mStub.mRRCache.lookup(mTarget, mRRType, mProto, records, status);
+   cached = mStub.mRRCache.lookup(mTarget, mRRType, mProto, records, status, refresh);
+   if (refresh)
+   {
+      refreshes.push_back(std::make_pair(mTarget, mRRType));
+   }
 
    if (!cached)
    {
@@ -478,9 +510,14 @@ DnsStub::Query::go()
          do
          {
             DnsResourceRecordsByPtr cnames;
-            cached = mStub.mRRCache.lookup(targetToQuery, T_CNAME, mProto, cnames, status);
+            refresh = false;
+            cached = mStub.mRRCache.lookup(targetToQuery, T_CNAME, mProto, cnames, status, refresh);
             if (cached)
             {
+               if (refresh)
+               {
+                  refreshes.push_back(std::make_pair(targetToQuery, (int)T_CNAME));
+               }
                targetToQuery = (dynamic_cast<DnsCnameRecord*>(cnames[0]))->cname();
             }
          } while(cached);
@@ -490,7 +527,18 @@ DnsStub::Query::go()
    if (targetToQuery != mTarget)
    {
       StackLog(<< mTarget << " mapped to CNAME " << targetToQuery);
-      cached = mStub.mRRCache.lookup(targetToQuery, mRRType, mProto, records, status);
+      refresh = false;
+      cached = mStub.mRRCache.lookup(targetToQuery, mRRType, mProto, records, status, refresh);
+      if (refresh)
+      {
+         refreshes.push_back(std::make_pair(targetToQuery, mRRType));
+      }
+   }
+
+   // the refreshes go out whether or not the answer itself was cached
+   for (std::vector<std::pair<Data, int> >::const_iterator it = refreshes.begin(); it != refreshes.end(); ++it)
+   {
+      mStub.refreshRecords(it->first, it->second);
    }
 
    if (!cached)
@@ -774,7 +822,130 @@ DnsStub::errorMessage(int status)
 void
 DnsStub::lookupRecords(const Data& target, unsigned short type, DnsRawSink* sink)
 {
-   mDnsProvider->lookup(target.c_str(), type, this, sink);
+   // Concurrent lookups of the same name and type (typically a burst of
+   // requests toward one domain right after its records expired) share one
+   // query on the wire. Every sink gets the raw response and processes it as
+   // if it had been its own, so protocol specific filtering of the cached
+   // result still happens per Query.
+   PendingLookupKey key(Data(target).lowercase(), type);
+   PendingLookupMap::iterator it = mPendingLookups.find(key);
+   if (it != mPendingLookups.end())
+   {
+      StackLog(<< "Joining DNS lookup already in flight for " << target << " " << typeToData(type));
+      it->second->mSinks.push_back(sink);
+      ++mQueriesCoalesced;
+      return;
+   }
+
+   PendingLookup* pending = new PendingLookup(*this, key);
+   pending->mSinks.push_back(sink);
+   mPendingLookups[key] = pending;
+   ++mQueriesSent;
+   mDnsProvider->lookup(target.c_str(), type, this, pending);
+}
+
+void
+DnsStub::refreshRecords(const Data& target, unsigned short type)
+{
+   // a lookup already in flight will refresh the cache anyway
+   PendingLookupKey key(Data(target).lowercase(), type);
+   if (mPendingLookups.find(key) != mPendingLookups.end())
+   {
+      return;
+   }
+
+   DebugLog(<< "Refreshing cached " << target << " " << typeToData(type));
+   PendingLookup* pending = new PendingLookup(*this, key, true);
+   mPendingLookups[key] = pending;
+   ++mQueriesSent;
+   ++mCacheRefreshes;
+   mDnsProvider->lookup(target.c_str(), type, this, pending);
+}
+
+void
+DnsStub::cacheRefreshResult(const Data& target, int rrType, int status, const unsigned char* abuf, int alen)
+{
+   try
+   {
+      switch (status)
+      {
+         case 0:
+            if (DNS_HEADER_ANCOUNT(abuf) > 0)
+            {
+               // the records are cached under the name of the first answer,
+               // as Query::followCname() does
+               const unsigned char* aptr = abuf + HFIXEDSZ;
+               int qdcount = DNS_HEADER_QDCOUNT(abuf);
+               for (int i = 0; i < qdcount && aptr; ++i)
+               {
+                  aptr = skipDNSQuestion(aptr, abuf, alen);
+               }
+               char* name = 0;
+               long len = 0;
+               if (ARES_SUCCESS == ares_expand_name(aptr, abuf, alen, &name, &len))
+               {
+                  Data answerName(name);
+                  free(name);
+                  cache(answerName, abuf, alen);
+               }
+            }
+            break;
+         case ARES_ENODATA:
+         case ARES_EFORMERR:
+         case ARES_ESERVFAIL:
+         case ARES_ENOTFOUND:
+         case ARES_ENOTIMP:
+         case ARES_EREFUSED:
+            cacheTTL(target, rrType, status, abuf, alen);
+            break;
+         default:
+            // the cached entry is kept, and refreshed again later
+            InfoLog(<< "Refresh of " << target << " failed: " << errorMessage(status));
+            break;
+      }
+   }
+   catch (BaseException& e)
+   {
+      ErrLog(<< "Couldn't parse refresh response for " << target << ": " << e.getMessage());
+   }
+}
+
+DnsStub::PendingLookup::PendingLookup(DnsStub& stub, const PendingLookupKey& key, bool refresh)
+   : mStub(stub),
+     mKey(key),
+     mRefresh(refresh)
+{
+}
+
+void
+DnsStub::PendingLookup::onDnsRaw(int status, const unsigned char* abuf, int alen)
+{
+   // Unlink first: a sink may well start a new lookup for the same name
+   PendingLookupMap::iterator it = mStub.mPendingLookups.find(mKey);
+   if (it != mStub.mPendingLookups.end() && it->second == this)
+   {
+      mStub.mPendingLookups.erase(it);
+   }
+   else
+   {
+      mStub.mOrphanedLookups.erase(this);
+   }
+
+   if (mRefresh && mSinks.empty())
+   {
+      // nobody joined, so nobody else puts the answer in the cache
+      mStub.cacheRefreshResult(mKey.first, mKey.second, status, abuf, alen);
+   }
+   else if (mSinks.size() > 1)
+   {
+      DebugLog(<< "DNS response for " << mKey.first << " " << typeToData(mKey.second)
+               << " answers " << mSinks.size() << " queries");
+   }
+   for (std::vector<DnsRawSink*>::iterator i = mSinks.begin(); i != mSinks.end(); ++i)
+   {
+      (*i)->onDnsRaw(status, abuf, alen);
+   }
+   delete this;
 }
 
 void
@@ -880,6 +1051,14 @@ DnsStub::doReloadDnsServers()
         doClearDnsCache();
 
         mDnsProvider->init(mDnsTimeout, mDnsTries, mDnsFeatures);
+
+        // Lookups still pending were sent to the old servers and may never
+        // be answered; new queries for the same names must not wait on them.
+        for (PendingLookupMap::iterator it = mPendingLookups.begin(); it != mPendingLookups.end(); ++it)
+        {
+           mOrphanedLookups.insert(it->second);
+        }
+        mPendingLookups.clear();
     }
 }
 
@@ -889,12 +1068,36 @@ DnsStub::setDnsCacheTTL(int ttl)
    mRRCache.setTTL(ttl);
 }
 
+void
+DnsStub::setDnsCacheTTLSecs(int ttlSecs)
+{
+   mRRCache.setTTLSecs(ttlSecs);
+}
+
 void
 DnsStub::setDnsCacheSize(int size)
 {
    mRRCache.setSize(size);
 }
 
+void
+DnsStub::setDnsCachePrefetch(unsigned int minHits, int windowSecs)
+{
+   mRRCache.setPrefetch(minHits, windowSecs);
+}
+
+void
+DnsStub::setDnsCacheStaleGrace(int graceSecs)
+{
+   mRRCache.setStaleGrace(graceSecs);
+}
+
+void
+DnsStub::setDnsCacheRefreshRetry(int retrySecs)
+{
+   mRRCache.setRefreshRetry(retrySecs);
+}
+
 /* ====================================================================
  * The Vovida Software License, Version 1.0 
  * 
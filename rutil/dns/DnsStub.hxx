@@ -6,6 +6,7 @@
 #endif
 
 
+#include <atomic>
 #include <vector>
 #include <list>
 #include <map>
@@ -179,12 +180,31 @@ class DnsStub : public ExternalDnsHandler
       void clearDnsCache();
       void logDnsCache();
       void getDnsCacheDump(std::pair<unsigned long, unsigned long> key, GetDnsCacheDumpHandler* handler);
+      // Records with a lower TTL than this (in minutes) are kept this long
       void setDnsCacheTTL(int ttl);
+      // As setDnsCacheTTL(), in seconds, for a minimum below one minute
+      void setDnsCacheTTLSecs(int ttlSecs);
       void setDnsCacheSize(int size);
+      // Refresh cache entries hit at least minHits times in the background
+      // once they are within windowSecs of expiry (0 hits disables)
+      void setDnsCachePrefetch(unsigned int minHits, int windowSecs);
+      // Keep answering from expired entries for up to graceSecs while they
+      // are being refreshed (0 disables)
+      void setDnsCacheStaleGrace(int graceSecs);
+      // Give up on a background refresh not answered within retrySecs, so
+      // that a later lookup sends another one (default 10)
+      void setDnsCacheRefreshRetry(int retrySecs);
       void reloadDnsServers();
       bool checkDnsChange();
       bool supportedType(int);
 
+      /// Queries handed to the DNS provider, and lookups that instead joined
+      /// an identical query already in flight
+      unsigned long getNumQueriesSent() const { return mQueriesSent; }
+      unsigned long getNumQueriesCoalesced() const { return mQueriesCoalesced; }
+      /// Queries sent to refresh cache entries ahead of (or just after) expiry
+      unsigned long getNumCacheRefreshes() const { return mCacheRefreshes; }
+
       template<class QueryType> void lookup(const Data& target, DnsResultSink* sink)
       {
          lookup<QueryType>(target, Protocol::Reserved, sink);
@@ -292,6 +312,23 @@ class DnsStub : public ExternalDnsHandler
             bool mFollowCname;
       };
 
+      // One query on the wire, shared by every Query that asked for the same
+      // name and type while it was outstanding. A cache refresh is a
+      // PendingLookup started without any Query.
+      typedef std::pair<Data, unsigned short> PendingLookupKey;
+      class PendingLookup : public DnsRawSink
+      {
+         public:
+            PendingLookup(DnsStub& stub, const PendingLookupKey& key, bool refresh=false);
+            void onDnsRaw(int status, const unsigned char* abuf, int alen);
+
+            DnsStub& mStub;
+            PendingLookupKey mKey;
+            bool mRefresh;
+            std::vector<DnsRawSink*> mSinks;
+      };
+      typedef std::map<PendingLookupKey, PendingLookup*> PendingLookupMap;
+
    private:
       DnsStub(const DnsStub&);   // disable copy ctor.
       DnsStub& operator=(const DnsStub&);
@@ -471,12 +508,19 @@ class DnsStub : public ExternalDnsHandler
                                          bool discard=false);
       void removeQuery(Query*);
       void lookupRecords(const Data& target, unsigned short type, DnsRawSink* sink);
+      void refreshRecords(const Data& target, unsigned short type);
+      void cacheRefreshResult(const Data& target, int rrType, int status, const unsigned char* abuf, int alen);
       Data errorMessage(int status);
 
       ResultTransform* mTransform;
       ExternalDns* mDnsProvider;
       FdPollGrp* mPollGrp;
       std::set<Query*> mQueries;
+      PendingLookupMap mPendingLookups;
+      std::set<PendingLookup*> mOrphanedLookups; // outstanding across a server reload
+      std::atomic<unsigned long> mQueriesSent;
+      std::atomic<unsigned long> mQueriesCoalesced;
+      std::atomic<unsigned long> mCacheRefreshes;
 
       std::vector<Data> mEnumSuffixes; // where to do enum lookups
       std::map<Data,Data> mEnumDomains;
@@ -30,6 +30,7 @@
 #include "rutil/ResipAssert.h"
 #include "rutil/BaseException.hxx"
 #include "rutil/Data.hxx"
+#include "rutil/Logger.hxx"
 #include "rutil/Timer.hxx"
 #include "rutil/dns/RRFactory.hxx"
 #include "rutil/dns/RROverlay.hxx"
@@ -46,11 +47,17 @@
 using namespace resip;
 using namespace std;
 
+#define RESIPROCATE_SUBSYSTEM resip::Subsystem::DNS
+
 RRCache::RRCache() 
    : mHead(),
      mLruHead(LruListType::makeList(&mHead)),
      mUserDefinedTTL(DEFAULT_USER_DEFINED_TTL),
-     mSize(DEFAULT_SIZE)
+     mSize(DEFAULT_SIZE),
+     mPrefetchHits(0),
+     mPrefetchWindow(0),
+     mStaleGrace(0),
+     mRefreshRetry(DEFAULT_REFRESH_RETRY)
 {
    mFactoryMap[T_CNAME] = &mCnameRecordFactory;
    mFactoryMap[T_NAPTR] = &mNaptrRecordFacotry;
@@ -152,6 +159,29 @@ RRCache::lookup(const Data& target,
                 const int protocol,
                 Result& records, 
                 int& status)
+{
+   return lookup(target, type, protocol, records, status, 0);
+}
+
+bool 
+RRCache::lookup(const Data& target, 
+                const int type, 
+                const int protocol,
+                Result& records, 
+                int& status,
+                bool& refresh)
+{
+   refresh = false;
+   return lookup(target, type, protocol, records, status, &refresh);
+}
+
+bool 
+RRCache::lookup(const Data& target, 
+                const int type, 
+                const int protocol,
+                Result& records, 
+                int& status,
+                bool* refresh)
 {
    records.clear();
    status = 0;
@@ -162,22 +192,49 @@ RRCache::lookup(const Data& target,
    {
       return false;
    }
-   else
+
+   RRList* list = *it;
+   uint64_t now = Timer::getTimeSecs();
+   bool refreshOutstanding = list->refreshTime() != 0 && 
+                             now < list->refreshTime() + mRefreshRetry;
+   if (now >= list->absoluteExpiry())
    {
-      if (Timer::getTimeSecs() >= (*it)->absoluteExpiry())
+      if (now >= list->absoluteExpiry() + mStaleGrace)
       {
-         delete *it;
+         delete list;
          mRRSet.erase(it);
          return false;
       }
-      else
+      // within the grace period: only callers that will refresh the entry
+      // get it stale
+      if (!refresh)
       {
-         records = (*it)->records(protocol);
-         status = (*it)->status();
-         touch(*it);
-         return true;
+         return false;
+      }
+      if (!refreshOutstanding)
+      {
+         DebugLog(<< "Serving expired " << target << " while it is refreshed");
+         list->setRefreshTime(now);
+         *refresh = true;
       }
    }
+   else if (refresh && mPrefetchHits > 0)
+   {
+      list->hit();
+      if (list->hits() >= mPrefetchHits &&
+          now + mPrefetchWindow >= list->absoluteExpiry() &&
+          !refreshOutstanding)
+      {
+         DebugLog(<< "Prefetching " << target << " after " << list->hits() << " hits");
+         list->setRefreshTime(now);
+         *refresh = true;
+      }
+   }
+
+   records = list->records(protocol);
+   status = list->status();
+   touch(list);
+   return true;
 }
 
 void 
@@ -241,7 +298,7 @@ RRCache::logCache()
    uint64_t now = Timer::getTimeSecs();
    for (std::set<RRList*, CompareT>::iterator it = mRRSet.begin(); it != mRRSet.end(); )
    {
-      if (now >= (*it)->absoluteExpiry())
+      if (now >= (*it)->absoluteExpiry() + mStaleGrace)
       {
          delete *it;
          mRRSet.erase(it++);
@@ -261,7 +318,7 @@ RRCache::getCacheDump(Data& dnsCacheDump)
    DataStream strm(dnsCacheDump);
    for (std::set<RRList*, CompareT>::iterator it = mRRSet.begin(); it != mRRSet.end(); )
    {
-      if (now >= (*it)->absoluteExpiry())
+      if (now >= (*it)->absoluteExpiry() + mStaleGrace)
       {
          delete *it;
          mRRSet.erase(it++);
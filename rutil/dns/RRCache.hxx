@@ -30,7 +30,19 @@ class RRCache
       RRCache();
       ~RRCache();
       void setTTL(int ttl) { if (ttl > 0) mUserDefinedTTL = ttl * MIN_TO_SEC; }
+      // As setTTL(), in seconds
+      void setTTLSecs(int ttlSecs) { if (ttlSecs > 0) mUserDefinedTTL = ttlSecs; }
       void setSize(int size) { mSize = size; }
+      // Entries looked up at least minHits times since they were last filled
+      // are flagged for a background refresh once they are within windowSecs
+      // of expiry. 0 hits disables prefetching.
+      void setPrefetch(unsigned int minHits, int windowSecs) { mPrefetchHits = minHits; mPrefetchWindow = windowSecs; }
+      // Expired entries keep being served for up to graceSecs while a refresh
+      // of them is outstanding. 0 disables serving stale records.
+      void setStaleGrace(int graceSecs) { mStaleGrace = graceSecs > 0 ? graceSecs : 0; }
+      // A refresh not answered within retrySecs is given up on, and the next
+      // lookup may send another one.
+      void setRefreshRetry(int retrySecs) { mRefreshRetry = retrySecs > 0 ? retrySecs : 1; }
       // Update existing cache record, or add a new one
       void updateCache(const Data& target,
                        const int rrType,
@@ -43,6 +55,9 @@ class RRCache
                     const int status,
                     RROverlay overlay);
       bool lookup(const Data& target, const int type, const int proto, Result& records, int& status);
+      // As above, but counts the hit and may serve a stale entry. refresh is
+      // set when the caller should fetch the records again in the background.
+      bool lookup(const Data& target, const int type, const int proto, Result& records, int& status, bool& refresh);
       void clearCache();
       void logCache();
       void getCacheDump(Data& dnsCacheDump);
@@ -52,6 +67,7 @@ class RRCache
       static const int DEFAULT_USER_DEFINED_TTL = 10; // in seconds.
 
       static const int DEFAULT_SIZE = 512;
+      static const int DEFAULT_REFRESH_RETRY = 10; // in seconds
       class CompareT
       {
          public:
@@ -76,6 +92,7 @@ class RRCache
       void cleanup();
       int getTTL(const RROverlay& overlay);
       void purge();
+      bool lookup(const Data& target, const int type, const int proto, Result& records, int& status, bool* refresh);
 
       RRList mHead;
       LruListType* mLruHead;                     
@@ -95,6 +112,10 @@ class RRCache
       
       int mUserDefinedTTL; // used when the ttl in RR is 0 or less than default(60). in seconds.
       unsigned int mSize;
+      unsigned int mPrefetchHits;
+      int mPrefetchWindow; // in seconds
+      int mStaleGrace; // in seconds
+      int mRefreshRetry; // in seconds
 };
 
 }
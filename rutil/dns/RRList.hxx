@@ -52,6 +52,12 @@ class RRList : public IntrusiveListElement<RRList*>
       int rrType() const { return mRRType; }
       uint64_t absoluteExpiry() const { return mAbsoluteExpiry; }
       uint64_t& absoluteExpiry() { return mAbsoluteExpiry; }
+      // lookups served from this entry since it was last filled
+      unsigned int hits() const { return mHits; }
+      void hit() { ++mHits; }
+      // when a background refresh was last started for this entry, 0 if none
+      uint64_t refreshTime() const { return mRefreshTime; }
+      void setRefreshTime(uint64_t secs) { mRefreshTime = secs; }
       void log();
       EncodeStream& encodeRRList(EncodeStream& strm);
 
@@ -73,6 +79,8 @@ class RRList : public IntrusiveListElement<RRList*>
 
       int mStatus; // dns query status.
       uint64_t mAbsoluteExpiry;
+      unsigned int mHits;
+      uint64_t mRefreshTime;
 
       RecordItr find(const Data&);
       void clear();
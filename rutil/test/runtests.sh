@@ -14,6 +14,7 @@ for i in \
 	testData \
 	testDataPerformance \
 	testDataStream \
+	testDnsStub \
 	testDnsUtil \
 	testFifo \
 	testFileSystem \
@@ -24,6 +25,7 @@ for i in \
 	testMD5Stream \
 	testRandomHex \
 	testSHA1Stream \
+	testSpscRing \
 	testParseBuffer \
 	testThreadIf \
 	testXMLCursor;
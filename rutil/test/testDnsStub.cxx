@@ -0,0 +1,413 @@
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "rutil/Data.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/ParseBuffer.hxx"
+#include "rutil/Time.hxx"
+#include "rutil/dns/AresCompat.hxx"
+#include "rutil/dns/DnsStub.hxx"
+#include "rutil/dns/ExternalDns.hxx"
+#include "rutil/dns/ExternalDnsFactory.hxx"
+#include "rutil/dns/QueryTypes.hxx"
+
+using namespace resip;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TEST
+
+// Stands in for ares: remembers each lookup DnsStub puts on the "wire" so
+// the test can answer it.
+class FakeDns : public ExternalDns
+{
+   public:
+      struct Lookup
+      {
+         Data target;
+         unsigned short type;
+         ExternalDnsHandler* handler;
+         void* userData;
+      };
+
+      virtual int init(const std::vector<GenericIPAddress>&, AfterSocketCreationFuncPtr,
+                       int, int, unsigned int) { return Success; }
+      virtual int init(int, int, unsigned int) { return Success; }
+      virtual bool checkDnsChange() { return false; }
+      virtual unsigned int getTimeTillNextProcessMS() { return 1000; }
+      virtual void buildFdSet(fd_set&, fd_set&, int&) {}
+      virtual void process(fd_set&, fd_set&) {}
+      virtual void setPollGrp(FdPollGrp*) {}
+      virtual void processTimers() {}
+      virtual void freeResult(ExternalDnsRawResult) {}
+      virtual void freeResult(ExternalDnsHostResult) {}
+      virtual char* errorMessage(long errorCode)
+      {
+         Data msg("error " + Data((int)errorCode));
+         char* result = new char[msg.size() + 1];
+         memcpy(result, msg.c_str(), msg.size() + 1);
+         return result;
+      }
+      virtual void lookup(const char* target, unsigned short type, ExternalDnsHandler* handler, void* userData)
+      {
+         Lookup lookup = { target, type, handler, userData };
+         mLookups.push_back(lookup);
+      }
+      virtual bool hostFileLookup(const char*, in_addr&) { return false; }
+      virtual bool hostFileLookupLookupOnlyMode() { return false; }
+
+      std::vector<Lookup> mLookups;
+};
+
+class FakeDnsCreator : public ExternalDnsCreator
+{
+   public:
+      FakeDnsCreator() : mLast(0) {}
+      virtual ExternalDns* createExternalDns() { return mLast = new FakeDns; }
+      FakeDns* mLast;
+};
+
+class CountingSink : public DnsResultSink
+{
+   public:
+      CountingSink() : mResults(0), mStatus(-1), mRecords(0) {}
+
+      virtual void onDnsResult(const DNSResult<DnsHostRecord>& result)
+      {
+         ++mResults;
+         mStatus = result.status;
+         mRecords = (int)result.records.size();
+         if (!result.records.empty())
+         {
+            mHost = result.records[0].host();
+         }
+      }
+      virtual void onDnsResult(const DNSResult<DnsAAAARecord>&) { assert(0); }
+      virtual void onDnsResult(const DNSResult<DnsSrvRecord>&) { assert(0); }
+      virtual void onDnsResult(const DNSResult<DnsNaptrRecord>&) { assert(0); }
+      virtual void onDnsResult(const DNSResult<DnsCnameRecord>&) { assert(0); }
+
+      int mResults;
+      int mStatus;
+      int mRecords;
+      Data mHost;
+};
+
+static void
+appendName(Data& msg, const Data& name)
+{
+   ParseBuffer pb(name);
+   while (!pb.eof())
+   {
+      const char* start = pb.position();
+      pb.skipToChar('.');
+      Data label(pb.data(start));
+      msg += (char)label.size();
+      msg += label;
+      if (!pb.eof())
+      {
+         pb.skipChar();
+      }
+   }
+   msg += (char)0;
+}
+
+// A response carrying one A record for name
+static Data
+makeAResponse(const Data& name, const unsigned char address[4], unsigned short ttl=3600)
+{
+   Data msg;
+   const unsigned char header[] = { 0, 1, 0x81, 0x80, 0, 1, 0, 1, 0, 0, 0, 0 };
+   msg.append((const char*)header, sizeof(header));
+   appendName(msg, name);
+   const unsigned char question[] = { 0, 1, 0, 1 };
+   msg.append((const char*)question, sizeof(question));
+   const unsigned char answer[] = { 0xc0, 0x0c, 0, 1, 0, 1, 0, 0,
+                                    (unsigned char)(ttl >> 8), (unsigned char)(ttl & 0xff), 0, 4 };
+   msg.append((const char*)answer, sizeof(answer));
+   msg.append((const char*)address, 4);
+   return msg;
+}
+
+// A response to an A query for alias, carrying the CNAME alias -> name and
+// one A record for name
+static Data
+makeCnameResponse(const Data& alias, const Data& name, const unsigned char address[4])
+{
+   Data msg;
+   const unsigned char header[] = { 0, 1, 0x81, 0x80, 0, 1, 0, 2, 0, 0, 0, 0 };
+   msg.append((const char*)header, sizeof(header));
+   appendName(msg, alias);
+   const unsigned char question[] = { 0, 1, 0, 1 };
+   msg.append((const char*)question, sizeof(question));
+
+   Data target;
+   appendName(target, name);
+   const unsigned char cname[] = { 0xc0, 0x0c, 0, 5, 0, 1, 0, 0, 0x0e, 0x10,
+                                   (unsigned char)(target.size() >> 8), (unsigned char)(target.size() & 0xff) };
+   msg.append((const char*)cname, sizeof(cname));
+   msg += target;
+
+   msg += target;
+   const unsigned char a[] = { 0, 1, 0, 1, 0, 0, 0x0e, 0x10, 0, 4 };
+   msg.append((const char*)a, sizeof(a));
+   msg.append((const char*)address, 4);
+   return msg;
+}
+
+static void
+answer(const FakeDns::Lookup& lookup, Data& response)
+{
+   ExternalDnsRawResult result((unsigned char*)response.data(), (int)response.size(), lookup.userData);
+   lookup.handler->handleDnsRaw(result);
+}
+
+static void
+testCoalescing(FakeDnsCreator& creator)
+{
+   DnsStub stub;
+   FakeDns& dns = *creator.mLast;
+
+   // A burst toward one domain: one query on the wire. Case and protocol
+   // differences do not matter to the wire query.
+   CountingSink a1, a2, a3, other1, other2;
+   stub.lookup<RR_A>("example.com", &a1);
+   stub.lookup<RR_A>("EXAMPLE.com", &a2);
+   stub.lookup<RR_A>("example.com", 1, &a3);
+   stub.lookup<RR_A>("other.example", &other1);
+   stub.lookup<RR_A>("other.example", &other2);
+   stub.processTimers();
+
+   assert(dns.mLookups.size() == 2);
+   assert(dns.mLookups[0].target == "example.com");
+   assert(dns.mLookups[1].target == "other.example");
+   assert(stub.getNumQueriesSent() == 2);
+   assert(stub.getNumQueriesCoalesced() == 3);
+   assert(a1.mResults == 0 && a2.mResults == 0 && a3.mResults == 0);
+
+   // one answer reaches every query that joined
+   const unsigned char address[4] = { 192, 0, 2, 1 };
+   Data response = makeAResponse("example.com", address);
+   answer(dns.mLookups[0], response);
+   CountingSink* sinks[] = { &a1, &a2, &a3 };
+   for (int i = 0; i < 3; ++i)
+   {
+      assert(sinks[i]->mResults == 1);
+      assert(sinks[i]->mStatus == 0);
+      assert(sinks[i]->mRecords == 1);
+      assert(sinks[i]->mHost == "192.0.2.1");
+   }
+
+   // the answer is cached now
+   CountingSink cached;
+   stub.lookup<RR_A>("example.com", &cached);
+   stub.processTimers();
+   assert(cached.mResults == 1 && cached.mHost == "192.0.2.1");
+   assert(dns.mLookups.size() == 2);
+
+   // a failure is shared as well
+   ExternalDnsRawResult timeout(ARES_ETIMEOUT, 0, 0, dns.mLookups[1].userData);
+   dns.mLookups[1].handler->handleDnsRaw(timeout);
+   assert(other1.mResults == 1 && other1.mStatus == ARES_ETIMEOUT);
+   assert(other2.mResults == 1 && other2.mStatus == ARES_ETIMEOUT);
+
+   // once the lookup is finished, the next one goes on the wire again
+   CountingSink retry;
+   stub.lookup<RR_A>("other.example", &retry);
+   stub.processTimers();
+   assert(dns.mLookups.size() == 3);
+   assert(stub.getNumQueriesSent() == 3);
+   assert(stub.getNumQueriesCoalesced() == 3);
+
+   // the stub cleans up the lookup still in flight
+}
+
+static void
+lookupA(DnsStub& stub, const Data& name, CountingSink& sink)
+{
+   stub.lookup<RR_A>(name, &sink);
+   stub.processTimers();
+}
+
+static void
+testPrefetch(FakeDnsCreator& creator)
+{
+   DnsStub stub;
+   FakeDns& dns = *creator.mLast;
+   stub.setDnsCachePrefetch(2, 7200); // every entry is close enough to expiry
+
+   CountingSink first;
+   lookupA(stub, "hot.example", first);
+   assert(dns.mLookups.size() == 1);
+   const unsigned char address[4] = { 192, 0, 2, 1 };
+   Data response = makeAResponse("hot.example", address);
+   answer(dns.mLookups[0], response);
+   assert(first.mHost == "192.0.2.1");
+
+   CountingSink hit1;
+   lookupA(stub, "hot.example", hit1);
+   assert(hit1.mHost == "192.0.2.1");
+   assert(dns.mLookups.size() == 1);
+
+   // the second hit makes the entry hot: it is still answered from the
+   // cache, and fetched again in the background
+   CountingSink hit2;
+   lookupA(stub, "hot.example", hit2);
+   assert(hit2.mResults == 1 && hit2.mHost == "192.0.2.1");
+   assert(dns.mLookups.size() == 2);
+   assert(dns.mLookups[1].target == "hot.example");
+   assert(stub.getNumCacheRefreshes() == 1);
+
+   // one refresh at a time
+   CountingSink hit3;
+   lookupA(stub, "hot.example", hit3);
+   assert(hit3.mResults == 1);
+   assert(dns.mLookups.size() == 2);
+
+   // the refreshed records replace the cached ones
+   const unsigned char newAddress[4] = { 192, 0, 2, 2 };
+   Data refreshed = makeAResponse("hot.example", newAddress);
+   answer(dns.mLookups[1], refreshed);
+   CountingSink after;
+   lookupA(stub, "hot.example", after);
+   assert(after.mHost == "192.0.2.2");
+   assert(dns.mLookups.size() == 2);
+   assert(stub.getNumQueriesSent() == 2);
+}
+
+static void
+testStaleWhileRevalidate(FakeDnsCreator& creator)
+{
+   DnsStub stub;
+   FakeDns& dns = *creator.mLast;
+   stub.setDnsCacheStaleGrace(60);
+   // cache for as little as a second, so the entry expires quickly
+   stub.setDnsCacheTTLSecs(1);
+   stub.setDnsCacheRefreshRetry(1);
+
+   CountingSink first;
+   lookupA(stub, "stale.example", first);
+   const unsigned char address[4] = { 192, 0, 2, 1 };
+   Data response = makeAResponse("stale.example", address, 1);
+   answer(dns.mLookups[0], response);
+   assert(first.mHost == "192.0.2.1");
+   sleepSeconds(2);
+
+   // expired, but still answered while the refresh is outstanding
+   CountingSink stale1, stale2;
+   lookupA(stub, "stale.example", stale1);
+   lookupA(stub, "stale.example", stale2);
+   assert(stale1.mResults == 1 && stale1.mHost == "192.0.2.1");
+   assert(stale2.mResults == 1 && stale2.mHost == "192.0.2.1");
+   assert(dns.mLookups.size() == 2);
+   assert(stub.getNumCacheRefreshes() == 1);
+
+   const unsigned char newAddress[4] = { 192, 0, 2, 2 };
+   Data refreshed = makeAResponse("stale.example", newAddress);
+   answer(dns.mLookups[1], refreshed);
+   CountingSink after;
+   lookupA(stub, "stale.example", after);
+   assert(after.mHost == "192.0.2.2");
+   assert(dns.mLookups.size() == 2);
+}
+
+static void
+testPrefetchCname(FakeDnsCreator& creator)
+{
+   DnsStub stub;
+   FakeDns& dns = *creator.mLast;
+   stub.setDnsCachePrefetch(2, 7200);
+
+   CountingSink first;
+   lookupA(stub, "alias.example", first);
+   assert(dns.mLookups.size() == 1);
+   const unsigned char address[4] = { 192, 0, 2, 1 };
+   Data response = makeCnameResponse("alias.example", "real.example", address);
+   answer(dns.mLookups[0], response);
+   assert(first.mHost == "192.0.2.1");
+
+   CountingSink hit1, hit2;
+   lookupA(stub, "alias.example", hit1);
+   assert(dns.mLookups.size() == 1);
+   lookupA(stub, "alias.example", hit2);
+   assert(hit2.mResults == 1 && hit2.mHost == "192.0.2.1");
+
+   // the CNAME and the record it leads to both turned hot
+   assert(stub.getNumCacheRefreshes() == 2);
+   assert(dns.mLookups.size() == 3);
+   bool cname = false, a = false;
+   for (size_t i = 1; i < dns.mLookups.size(); ++i)
+   {
+      cname = cname || (dns.mLookups[i].target == "alias.example" && dns.mLookups[i].type == T_CNAME);
+      a = a || (dns.mLookups[i].target == "real.example" && dns.mLookups[i].type == T_A);
+   }
+   assert(cname && a);
+}
+
+int
+main(int argc, char* argv[])
+{
+   Log::initialize(Log::Cout, argc > 1 ? Log::toLevel(argv[1]) : Log::Warning, argv[0]);
+
+   FakeDnsCreator creator;
+   ExternalDnsFactory::setExternalCreator(&creator);
+   testCoalescing(creator);
+   testPrefetch(creator);
+   testPrefetchCname(creator);
+   testStaleWhileRevalidate(creator);
+   ExternalDnsFactory::setExternalCreator(0);
+
+   cout << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -1,6 +1,10 @@
 
+#include <cassert>
+#include <map>
+
 #include "rutil/Logger.hxx"
 #include "rutil/Data.hxx"
+#include "rutil/ParseBuffer.hxx"
 #include "rutil/ThreadIf.hxx"
 #include "rutil/Timer.hxx"
 
@@ -77,6 +81,108 @@ class TestExternalLogger : public ExternalLogger
       }
 };
 
+// Counts what reaches it and checks that each thread's entries arrive in
+// the order they were logged ("<thread> <sequence>").
+class CountingExternalLogger : public ExternalLogger
+{
+   public:
+      CountingExternalLogger() : mCount(0), mOutOfOrder(0) {}
+
+      virtual bool operator()(Log::Level level,
+                              const Subsystem& subsystem, 
+                              const Data& appName,
+                              const char* file,
+                              int line,
+                              const Data& message,
+                              const Data& messageWithHeaders,
+                              const Data& instanceName)
+      {
+         if (message.empty() || !isdigit((unsigned char)message[0]))
+         {
+            return true;  // e.g. the "logger initialized" line
+         }
+         ParseBuffer pb(message);
+         int thread = pb.integer();
+         pb.skipWhitespace();
+         int sequence = pb.integer();
+         std::map<int, int>::iterator it = mLast.find(thread);
+         if (it != mLast.end() && sequence <= it->second)
+         {
+            ++mOutOfOrder;
+         }
+         mLast[thread] = sequence;
+         ++mCount;
+         return true;
+      }
+
+      // only touched by the async writer thread while logging is async
+      int mCount;
+      int mOutOfOrder;
+      std::map<int, int> mLast;
+};
+
+class AsyncLogThread : public ThreadIf
+{
+   public:
+      AsyncLogThread(int index, int count) : mIndex(index), mCount(count) {}
+
+      void thread()
+      {
+         for (int i = 0; i < mCount; ++i)
+         {
+            InfoLog(<< mIndex << " " << i);
+         }
+      }
+
+   private:
+      int mIndex;
+      int mCount;
+};
+
+void
+testAsyncLogging(const char *appname)
+{
+   const int threads = 4;
+   const int perThread = 5000;
+
+   for (int pass = 0; pass < 2; ++pass)
+   {
+      const bool dropWhenFull = (pass == 1);
+      CountingExternalLogger counter;
+      Log::initialize(Log::OnlyExternal, Log::Info, appname, counter);
+      const uint64_t droppedBefore = Log::getAsyncDropped();
+      // a tiny queue makes the producers outrun the writer
+      Log::startAsync(dropWhenFull ? 16 : 1024, dropWhenFull);
+      assert(Log::isAsync());
+
+      AsyncLogThread* logThreads[threads];
+      for (int t = 0; t < threads; ++t)
+      {
+         logThreads[t] = new AsyncLogThread(t, perThread);
+         logThreads[t]->run();
+      }
+      for (int t = 0; t < threads; ++t)
+      {
+         logThreads[t]->join();
+         delete logThreads[t];
+      }
+      Log::stopAsync();
+      assert(!Log::isAsync());
+
+      const uint64_t dropped = Log::getAsyncDropped() - droppedBefore;
+      cout << "async logging, " << (dropWhenFull ? "dropping" : "blocking")
+           << " when full: " << counter.mCount << " written, " << dropped << " dropped" << endl;
+      assert(counter.mOutOfOrder == 0);
+      assert(counter.mCount + dropped == (uint64_t)(threads * perThread));
+      if (!dropWhenFull)
+      {
+         assert(dropped == 0);
+      }
+   }
+
+   Log::initialize(Log::Cout, Log::Info, appname);
+}
+
 void
 testThreadLocalLoggers(const char *appname)
 {
@@ -258,6 +364,8 @@ main(int argc, char* argv[])
    Log::initialize(Log::Cout, Log::Info, argv[0], 0, 0, "LOG_DAEMON", Log::MessageStructure::JSON_CEE, "TestDev");
    ErrLog(<<"This should appear-back to Cout as JSON, \"Hello World\"");
 
+   testAsyncLogging(argv[0]);
+
 #ifndef WIN32
    Log::initialize(Log::Syslog, Log::Info, argv[0], 0, 0, "LOG_LOCAL4", Log::MessageStructure::JSON_CEE, "TestDev");
    ErrLog(<<"This should appear on Syslog as JSON, \"Hello World\" LOG_LOCAL4");
@@ -0,0 +1,273 @@
+#include <iostream>
+#include <memory>
+#include <thread>
+
+#include "rutil/SpscRing.hxx"
+#include "rutil/ThreadIf.hxx"
+#include "rutil/ResipAssert.h"
+
+using namespace resip;
+using namespace std;
+
+// functors handed to tryPush()/tryPop()
+class Put
+{
+   public:
+      explicit Put(unsigned int value) : mValue(value), mCalled(false) {}
+      void operator()(unsigned int& slot) { slot = mValue; mCalled = true; }
+
+      unsigned int mValue;
+      bool mCalled;
+};
+
+class Take
+{
+   public:
+      Take() : mValue(0), mCalled(false) {}
+      void operator()(unsigned int& slot) { mValue = slot; mCalled = true; }
+
+      unsigned int mValue;
+      bool mCalled;
+};
+
+// moves the pointer in and out, the way Flow passes its buffers
+class PutPtr
+{
+   public:
+      explicit PutPtr(unsigned int value) : mValue(new unsigned int(value)) {}
+      void operator()(unique_ptr<unsigned int>& slot) { slot = std::move(mValue); }
+
+      unique_ptr<unsigned int> mValue;
+};
+
+class TakePtr
+{
+   public:
+      void operator()(unique_ptr<unsigned int>& slot) { mValue = std::move(slot); }
+
+      unique_ptr<unsigned int> mValue;
+};
+
+static const unsigned int RaceCount = 200000;
+
+class Producer : public ThreadIf
+{
+   public:
+      explicit Producer(SpscRing<unsigned int>& ring) : mRing(ring), mFull(0) {}
+      ~Producer() { shutdown(); join(); }
+
+      void thread()
+      {
+         for (unsigned int i = 0; i < RaceCount; )
+         {
+            Put put(i);
+            if (mRing.tryPush(put))
+            {
+               i++;
+            }
+            else
+            {
+               resip_assert(!put.mCalled);
+               mFull++;
+               std::this_thread::yield();
+            }
+         }
+      }
+
+      SpscRing<unsigned int>& mRing;
+      unsigned int mFull;
+};
+
+int
+main()
+{
+   {
+      cerr << "capacity" << endl;
+      resip_assert(SpscRing<unsigned int>(0).capacity() == 2);
+      resip_assert(SpscRing<unsigned int>(1).capacity() == 2);
+      resip_assert(SpscRing<unsigned int>(2).capacity() == 2);
+      resip_assert(SpscRing<unsigned int>(5).capacity() == 8);
+      resip_assert(SpscRing<unsigned int>(1000).capacity() == 1024);
+      resip_assert(SpscRing<unsigned int>(1024).capacity() == 1024);
+   }
+
+   {
+      cerr << "empty ring" << endl;
+      SpscRing<unsigned int> ring(4);
+      resip_assert(ring.empty());
+      resip_assert(ring.size() == 0);
+      Take take;
+      bool popped = ring.tryPop(take);
+      resip_assert(!popped);
+      resip_assert(!take.mCalled);
+   }
+
+   {
+      cerr << "full ring" << endl;
+      SpscRing<unsigned int> ring(5);
+      for (unsigned int i = 0; i < 8; i++)
+      {
+         Put put(i);
+         bool pushed = ring.tryPush(put);
+         resip_assert(pushed);
+         resip_assert(ring.size() == i + 1);
+      }
+      Put put(8);
+      bool pushed = ring.tryPush(put);
+      resip_assert(!pushed);
+      resip_assert(!put.mCalled);
+      resip_assert(ring.size() == 8);
+
+      // one pop makes room for exactly one push
+      Take take;
+      bool popped = ring.tryPop(take);
+      resip_assert(popped);
+      resip_assert(take.mValue == 0);
+      pushed = ring.tryPush(put);
+      resip_assert(pushed);
+      Put put9(9);
+      pushed = ring.tryPush(put9);
+      resip_assert(!pushed);
+
+      for (unsigned int i = 1; i <= 8; i++)
+      {
+         Take take;
+         popped = ring.tryPop(take);
+         resip_assert(popped);
+         resip_assert(take.mValue == i);
+      }
+      resip_assert(ring.empty());
+   }
+
+   {
+      cerr << "wraparound" << endl;
+      // the positions run many times round the slots, with the ring
+      // holding up to its capacity
+      SpscRing<unsigned int> ring(4);
+      unsigned int next = 0;
+      unsigned int expected = 0;
+      for (unsigned int round = 0; round < 1000; round++)
+      {
+         for (unsigned int i = 0; i < round % 4; i++)
+         {
+            Put put(next++);
+            bool pushed = ring.tryPush(put);
+            resip_assert(pushed);
+         }
+         // leaves 0 or 1 elements behind, so reads and writes go out of step
+         while (ring.size() > round % 2)
+         {
+            Take take;
+            bool popped = ring.tryPop(take);
+            resip_assert(popped);
+            resip_assert(take.mValue == expected);
+            expected++;
+         }
+      }
+      Take take;
+      while (ring.tryPop(take))
+      {
+         resip_assert(take.mValue == expected);
+         expected++;
+      }
+      resip_assert(expected == next);
+      resip_assert(ring.empty());
+   }
+
+   {
+      cerr << "move-only elements" << endl;
+      SpscRing<unique_ptr<unsigned int> > ring(2);
+      for (unsigned int i = 0; i < 10; i++)
+      {
+         PutPtr put(i);
+         bool pushed = ring.tryPush(put);
+         resip_assert(pushed);
+         resip_assert(!put.mValue);
+         TakePtr take;
+         bool popped = ring.tryPop(take);
+         resip_assert(popped);
+         resip_assert(take.mValue && *take.mValue == i);
+      }
+   }
+
+   {
+      cerr << "producer and consumer threads" << endl;
+      // a small ring, so that both the full and the empty case are hit often
+      SpscRing<unsigned int> ring(16);
+      Producer producer(ring);
+      producer.run();
+      unsigned int next = 0;
+      unsigned int empty = 0;
+      while (next < RaceCount)
+      {
+         Take take;
+         if (ring.tryPop(take))
+         {
+            resip_assert(take.mValue == next);
+            next++;
+         }
+         else
+         {
+            empty++;
+            // both sides must get to run, even on a single core
+            std::this_thread::yield();
+         }
+      }
+      producer.join();
+      resip_assert(ring.empty());
+      cerr << "ring was full " << producer.mFull << " times, empty " << empty << " times" << endl;
+   }
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -29,6 +29,7 @@ CommandLineParser::CommandLineParser(int argc, char** argv)
    int noV4 = 0;
    int noV6 = 0;
    int disableThreadedStack = 0;
+   int proxyWorkerThreads = 0;
    int useCongestionManager = 0;
    const char* certPath = 0;
    int noChallenge = 0;
@@ -79,6 +80,7 @@ CommandLineParser::CommandLineParser(int argc, char** argv)
       {"disable-v6",   0,   POPT_ARG_NONE, &noV6, 0, "disable IPV6", 0},
       {"disable-v4",   0,   POPT_ARG_NONE, &noV4, 0, "disable IPV4", 0},
       {"disable-threaded-stack",   0,   POPT_ARG_NONE, &disableThreadedStack, 0, "disable multithreaded stack", 0},
+      {"proxy-worker-threads",   0,   POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT, &proxyWorkerThreads, 0, "process requests on this many proxy worker threads", "0"},
       {"use-congestion-manager",   0,   POPT_ARG_NONE, &useCongestionManager, 0, "enable congestion manager", 0},
       {"disable-auth",   0,  POPT_ARG_NONE,   &noChallenge, 0, "disable DIGEST challenges", 0},
       {"disable-web-auth",0, POPT_ARG_NONE,   &noWebChallenge, 0, "disable HTTP challenges", 0},
@@ -147,6 +149,7 @@ CommandLineParser::CommandLineParser(int argc, char** argv)
    mNoV4 = noV4 != 0;
    mNoV6 = noV6 != 0;
    mThreadedStack = disableThreadedStack == 0;
+   mProxyWorkerThreads = proxyWorkerThreads;
    mUseCongestionManager = useCongestionManager != 0;
    if (certPath) mCertPath = certPath;
    else mCertPath = basePath + "/.sipCerts";
@@ -30,6 +30,7 @@ class CommandLineParser
       bool mNoV4;
       bool mNoV6;
       bool mThreadedStack;
+      int mProxyWorkerThreads;
       bool mUseCongestionManager;
 
       resip::Data mCertPath;
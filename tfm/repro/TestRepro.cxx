@@ -51,6 +51,8 @@ TfmProxyConfig::TfmProxyConfig(AbstractDb* db, const CommandLineParser& args)
    insertConfigValue("TimerC", "40");
 
    insertConfigValue("ForceRecordRouting", "true");
+
+   insertConfigValue("NumProxyWorkerThreads", Data(args.mProxyWorkerThreads));
    //insertConfigValue("RecordRouteUri", "sip:127.0.0.1:5060");  // Set below per transport
 }
 